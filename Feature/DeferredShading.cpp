@@ -1,18 +1,18 @@
 #include "DeferredShading.h"
 #include "GraphicEngine.h"
 
-DeferredShading::DeferredShading(int Width, int Height)
+DeferredShading::DeferredShading(int Width, int Height, UINT features)
 {
 	mTextureWidth = Width;
 	mTextureHeight = Height;
+	mFeatures = features;
 	CreateGBufferTexture();
-	CreateGbufferView();
 
 	CreateDeferredTexture();
 	CreateDeferredView();
 
 	CreateGBufferPSO();
-	BuildPSO(L"Shader\\Default.hlsl", L"Shader\\Default.hlsl");
+	BuildPSO(L"Shader\\Default.hlsl", L"Shader\\Default.hlsl", mFeatures);
 }
 
 void DeferredShading::CreateGBufferTexture()
@@ -31,18 +31,11 @@ void DeferredShading::CreateGBufferTexture()
 	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
 
+	static const char* names[BUFFER_COUNT] = { "GBuffer Diffuse", "GBuffer Pos", "GBuffer Normal", "GBuffer Material", "GBuffer FeatureAttr" };
 	float ClearColor[] = { 0.0f, 0.0f, 1.0f, 0.0f };
 	CD3DX12_CLEAR_VALUE optClear(mGbufferFormat, ClearColor);
 	for (int i = 0; i < BUFFER_COUNT; ++i)
-	{
-		ThrowIfFailed(GetEngine()->GetDevice()->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			&optClear,
-			IID_PPV_ARGS(&mGBufferArray[i])));
-	}
+		mGBufferTexture[i] = GetEngine()->GetRenderGraph()->AddTexture(names[i], texDesc, optClear, &mGBufferArray[i]);
 }
 
 void DeferredShading::CreateDeferredTexture()
@@ -79,12 +72,14 @@ void DeferredShading::CreateGbufferView()
 	rtvDesc.Format = mGbufferFormat;
 	rtvDesc.Texture2D.MipSlice = 0;
 	rtvDesc.Texture2D.PlaneSlice = 0;
+	// OMSetRenderTargets takes the G-buffer as one contiguous range, and the
+	// lighting pass binds its SRVs as one table, so each set is a single block.
+	int rtvBase = GetEngine()->GetDescriptorHeap()->AllocateRtv(BUFFER_COUNT);
 	for (int i = 0; i < BUFFER_COUNT; ++i)
 	{
+		mGBufferRtv[i] = rtvBase + i;
 		GetEngine()->GetDevice()->CreateRenderTargetView(mGBufferArray[i].Get(), &rtvDesc,
-			GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle());
-
-		mGBufferRtv[i] = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorIndex();
+			GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mGBufferRtv[i]));
 	}
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -93,12 +88,12 @@ void DeferredShading::CreateGbufferView()
 	srvDesc.Format = mGbufferFormat;
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = 1;
+	int srvBase = GetEngine()->GetDescriptorHeap()->AllocateSrv(BUFFER_COUNT);
 	for (int i = 0; i < BUFFER_COUNT; ++i)
 	{
-
+		mGBufferSrv[i] = srvBase + i;
 		GetEngine()->GetDevice()->CreateShaderResourceView(mGBufferArray[i].Get(), &srvDesc,
-			GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-		mGBufferSrv[i] = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+			GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mGBufferSrv[i]));
 	}
 }
 
@@ -109,10 +104,9 @@ void DeferredShading::CreateDeferredView()
 	rtvDesc.Format = GetEngine()->mBackBufferFormat;
 	rtvDesc.Texture2D.MipSlice = 0;
 	rtvDesc.Texture2D.PlaneSlice = 0;
+	mDeferredRtv = GetEngine()->GetDescriptorHeap()->SetRtvDescriptorIndex();
 	GetEngine()->GetDevice()->CreateRenderTargetView(mDeferredTex.Get(), &rtvDesc,
-		GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle());
-
-	mDeferredRtv = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorIndex();
+		GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mDeferredRtv));
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -121,43 +115,38 @@ void DeferredShading::CreateDeferredView()
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = 1;
 
+	mDeferredSrv = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
 	GetEngine()->GetDevice()->CreateShaderResourceView(mDeferredTex.Get(), &srvDesc,
-		GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	mDeferredSrv = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+		GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mDeferredSrv));
 }
 
-void DeferredShading::RenderGBuffer(ID3D12GraphicsCommandList* cmdList)
+void DeferredShading::BeginGBuffer(ID3D12GraphicsCommandList* cmdList)
 {
-	cmdList->RSSetViewports(1, GetEngine()->GetViewport());
-	cmdList->RSSetScissorRects(1, GetEngine()->GetScissor());
-
-	cmdList->SetPipelineState(mGBufferPSO.Get());
 	float clearValue[] = { 0.0f, 0.0f, 1.0f, 0.0f };
 	for (int i = 0; i < BUFFER_COUNT; ++i)
 	{
-		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mGBufferArray[i].Get(),
-			D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
 		D3D12_CPU_DESCRIPTOR_HANDLE GBufferView = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mGBufferRtv[i]);
 		cmdList->ClearRenderTargetView(GBufferView, clearValue, 0, nullptr);
 	}
 
 	// Clear the screen normal map and depth buffer.
-	D3D12_CPU_DESCRIPTOR_HANDLE GBufferView = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mGBufferRtv[0]);
-
 	cmdList->ClearDepthStencilView(GetEngine()->DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+}
 
-	// Specify the buffers we are going to render to.
-	cmdList->OMSetRenderTargets(BUFFER_COUNT, &GBufferView, true, &GetEngine()->DepthStencilView());
+void DeferredShading::DrawGBuffer(ID3D12GraphicsCommandList* cmdList, size_t begin, size_t end)
+{
+	cmdList->RSSetViewports(1, GetEngine()->GetViewport());
+	cmdList->RSSetScissorRects(1, GetEngine()->GetScissor());
 
+	cmdList->SetPipelineState(mGBufferPSO.Get());
 
-	GetEngine()->DrawRenderItems(RenderLayer::Opaque);
+	// Specify the buffers we are going to render to.
+	D3D12_CPU_DESCRIPTOR_HANDLE GBufferView = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mGBufferRtv[0]);
+	cmdList->OMSetRenderTargets(BUFFER_COUNT, &GBufferView, true, &GetEngine()->DepthStencilView());
 
-	for (int i = 0; i < BUFFER_COUNT; ++i)
-	{
-		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mGBufferArray[i].Get(),
-			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
-	}
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(GetEngine()->GetView(), GetEngine()->GetProj()));
+	GetEngine()->ExecuteRenderItems(cmdList, mGBufferPSO.Get(), RenderLayer::Opaque, begin, end, &viewProj);
 }
 
 void DeferredShading::CreateGBufferPSO()
@@ -165,20 +154,8 @@ void DeferredShading::CreateGBufferPSO()
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC GbufferPsoDesc;
 	ZeroMemory(&GbufferPsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
 	ShaderState* shader = GetEngine()->GetShader();
-	ComPtr<ID3DBlob> vs = shader->CreateVSShader(L"Shader\\GBufferShader.hlsl");
-	ComPtr<ID3DBlob> ps = shader->CreatePSShader(L"Shader\\GBufferShader.hlsl");
 	GbufferPsoDesc.InputLayout = { shader->GetLayout().data(), (UINT)shader->GetLayout().size() };
 	GbufferPsoDesc.pRootSignature = GetEngine()->GetBaseRootSignature();
-	GbufferPsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(vs->GetBufferPointer()),
-		vs->GetBufferSize()
-	};
-	GbufferPsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
-		ps->GetBufferSize()
-	};
 
 	GbufferPsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	GbufferPsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
@@ -196,15 +173,11 @@ void DeferredShading::CreateGBufferPSO()
 	GbufferPsoDesc.SampleDesc.Count = 1;
 	GbufferPsoDesc.SampleDesc.Quality = 0;
 	GbufferPsoDesc.DSVFormat = GetEngine()->mDepthStencilFormat;
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateGraphicsPipelineState(&GbufferPsoDesc, IID_PPV_ARGS(&mGBufferPSO)));
+	GetEngine()->GetPipelineBuilder()->Add("GBuffer", GbufferPsoDesc, L"Shader\\GBufferShader.hlsl", L"Shader\\GBufferShader.hlsl", &mGBufferPSO);
 }
 
-void DeferredShading::BuildPSO(const wchar_t* vsFile, const wchar_t* psFile)
+void DeferredShading::BuildPSO(const wchar_t* vsFile, const wchar_t* psFile, UINT features)
 {
-	ShaderState* shader = GetEngine()->GetShader();
-	ComPtr<ID3DBlob> vs = shader->CreateVSShader(vsFile);
-	ComPtr<ID3DBlob> ps = shader->CreatePSShader(psFile);
-
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
 	//
@@ -213,16 +186,6 @@ void DeferredShading::BuildPSO(const wchar_t* vsFile, const wchar_t* psFile)
 	ZeroMemory(&opaquePsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
 	opaquePsoDesc.InputLayout = { nullptr, 0 };
 	opaquePsoDesc.pRootSignature = GetEngine()->GetBaseRootSignature();
-	opaquePsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(vs->GetBufferPointer()),
-		vs->GetBufferSize()
-	};
-	opaquePsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
-		ps->GetBufferSize()
-	};
 	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
@@ -235,12 +198,15 @@ void DeferredShading::BuildPSO(const wchar_t* vsFile, const wchar_t* psFile)
 	opaquePsoDesc.SampleDesc.Count = /*m4xMsaaState ? 4 : */1;
 	opaquePsoDesc.SampleDesc.Quality = /*m4xMsaaState ? (m4xMsaaQuality - 1) : */0;
 	opaquePsoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mBasePSO)));
+	// Map nodes do not move, so the builder can write the PSO in place.
+	GetEngine()->GetPipelineBuilder()->Add("Deferred", opaquePsoDesc, vsFile, psFile, &mBasePSOs[features], features);
 }
 
 void DeferredShading::Render(ID3D12GraphicsCommandList* mCommandList)
 {
-	mCommandList->SetPipelineState(mBasePSO.Get());
+	auto pso = mBasePSOs.find(mFeatures);
+	assert(pso != mBasePSOs.end());
+	mCommandList->SetPipelineState(pso->second.Get());
 
 	mCommandList->RSSetViewports(1, GetEngine()->GetViewport());
 	mCommandList->RSSetScissorRects(1, GetEngine()->GetScissor());
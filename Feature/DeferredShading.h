@@ -1,5 +1,6 @@
 #pragma once
 #include "framework.h"
+#include "RenderGraph.h"
 
 enum GBufferType
 {
@@ -16,17 +17,24 @@ enum GBufferType
 class DeferredShading
 {
 public:
-	DeferredShading(int Width, int Height);
+	// features (ShaderFeature bits) selects the lighting permutation.
+	DeferredShading(int Width, int Height, UINT features);
+	// Registers the G-buffer as render graph transients.
 	void CreateGBufferTexture();
 	void CreateDeferredTexture();
+	// Once the render graph has placed the G-buffer.
 	void CreateGbufferView();
 	void CreateDeferredView();
 	void CreateGBufferPSO();
-	void RenderGBuffer(ID3D12GraphicsCommandList* cmdList);
-	void BuildPSO(const wchar_t* vsFile, const wchar_t* psFile);
+	// The G-buffer pass in two parts, so its draws can be split over several
+	// lists recorded in parallel: Begin clears and goes first in submission order.
+	void BeginGBuffer(ID3D12GraphicsCommandList* cmdList);
+	void DrawGBuffer(ID3D12GraphicsCommandList* cmdList, size_t begin, size_t end);
+	void BuildPSO(const wchar_t* vsFile, const wchar_t* psFile, UINT features);
 	void Render(ID3D12GraphicsCommandList* mCommandList);
 	CD3DX12_GPU_DESCRIPTOR_HANDLE GetGBufferSrvGpuHandle();
 	int GetGBufferSrv(GBufferType type) { return mGBufferSrv[type]; }
+	RenderGraph::Handle GetGBufferTexture(GBufferType type) { return mGBufferTexture[type]; }
 	ID3D12Resource* GetDeferredResource() { return mDeferredTex.Get(); }
 	int GetDeferredSrv() { return mDeferredSrv; }
 
@@ -35,6 +43,7 @@ private:
 	int mTextureHeight;
 	const DXGI_FORMAT mGbufferFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	ComPtr<ID3D12Resource> mGBufferArray[BUFFER_COUNT];
+	RenderGraph::Handle mGBufferTexture[BUFFER_COUNT];
 	ComPtr<ID3D12Resource> mDeferredTex;
 	int mGBufferRtv[BUFFER_COUNT];
 	int mGBufferSrv[BUFFER_COUNT];
@@ -42,7 +51,9 @@ private:
 	int mDeferredSrv;
 
 	ComPtr<ID3D12PipelineState> mGBufferPSO;
-	ComPtr<ID3D12PipelineState> mBasePSO;
+	// Lighting PSOs by ShaderFeature mask; only requested permutations are built.
+	unordered_map<UINT, ComPtr<ID3D12PipelineState>> mBasePSOs;
+	UINT mFeatures;
 
 
 };
\ No newline at end of file
@@ -22,7 +22,6 @@ PostProcess::PostProcess(int width, int height, float FarPlane)
 	mSsr = new Ssr(mWidth, mHeight, FarPlane);
 
 	CreatePostProcessTexture();
-	CreatePostProcessView();
 }
 
 void PostProcess::CreatePostProcessTexture()
@@ -43,13 +42,7 @@ void PostProcess::CreatePostProcessTexture()
 
 	float ClearColor[] = { 0.0f, 0.0f, 1.0f, 0.0f };
 	CD3DX12_CLEAR_VALUE optClear(GetEngine()->mBackBufferFormat, ClearColor);
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&texDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		&optClear,
-		IID_PPV_ARGS(&mPostProcessTex)));
+	mPostProcessTexture = GetEngine()->GetRenderGraph()->AddTexture("PostProcess copy", texDesc, optClear, &mPostProcessTex);
 }
 
 void PostProcess::CreatePostProcessView()
@@ -59,10 +52,9 @@ void PostProcess::CreatePostProcessView()
 	rtvDesc.Format = GetEngine()->mBackBufferFormat;
 	rtvDesc.Texture2D.MipSlice = 0;
 	rtvDesc.Texture2D.PlaneSlice = 0;
+		mPostProcessRtv = GetEngine()->GetDescriptorHeap()->SetRtvDescriptorIndex();
 		GetEngine()->GetDevice()->CreateRenderTargetView(mPostProcessTex.Get(), &rtvDesc,
-			GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle());
-
-		mPostProcessRtv = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorIndex();
+			GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mPostProcessRtv));
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -71,19 +63,15 @@ void PostProcess::CreatePostProcessView()
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = 1;
 
+		mPostProcessSrv = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
 		GetEngine()->GetDevice()->CreateShaderResourceView(mPostProcessTex.Get(), &srvDesc,
-			GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-		mPostProcessSrv = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+			GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mPostProcessSrv));
 }
 
 void PostProcess::Prepare(ID3D12GraphicsCommandList* cmdList, DeferredShading* deferred)
 {
-	// Copy 
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(GetEngine()->CurrentBackBuffer(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_SOURCE));
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mPostProcessTex.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
+	// Copy; a full copy also initializes the texture after it takes over aliased memory.
 	cmdList->CopyResource(mPostProcessTex.Get(), GetEngine()->CurrentBackBuffer());
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(GetEngine()->CurrentBackBuffer(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET));
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mPostProcessTex.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
 
 	SetNormalSrvIndex(deferred->GetGBufferSrv(GBufferType::Normal));
 	SetWPosSrvIndex(deferred->GetGBufferSrv(GBufferType::Pos));
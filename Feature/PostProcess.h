@@ -1,6 +1,7 @@
 #pragma once
 #include "framework.h"
 #include "GameTimer.h"
+#include "RenderGraph.h"
 
 class DeferredShading;
 class Ssao;
@@ -10,8 +11,11 @@ class PostProcess
 {
 public:
 	PostProcess(int Width, int Height, float FarPlane);
+	// Registers the copy of the lit frame as a render graph transient.
 	void CreatePostProcessTexture();
+	// Once the render graph has placed it.
 	void CreatePostProcessView();
+	// Copies the lit frame; the render graph has the back buffer in COPY_SOURCE.
 	void Prepare(ID3D12GraphicsCommandList* cmdList, DeferredShading* deferred);
 	void Render(ID3D12GraphicsCommandList* cmdList);
 	void BindRootDescriptor(ID3D12GraphicsCommandList* cmdList);
@@ -20,6 +24,7 @@ public:
 	void SetWPosSrvIndex(int value) { mWPosSrvIndex = value; };
 	void SetFeatureAttrSrvIndex(int value) { mFeatureAttrSrvIndex = value; };
 	void SetDeferredSrvIndex(int value) { mDeferredSrvIndex = value; };
+	RenderGraph::Handle GetPostProcessTexture() { return mPostProcessTexture; }
 
 private:
 	int mNormalSrvIndex;
@@ -29,6 +34,7 @@ private:
 	int mWidth;
 	int mHeight;
 	ComPtr<ID3D12Resource> mPostProcessTex;
+	RenderGraph::Handle mPostProcessTexture;
 	int mPostProcessRtv;
 	int mPostProcessSrv;
 	D3D12_VIEWPORT mViewport;
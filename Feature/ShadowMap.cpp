@@ -25,7 +25,8 @@ void ShadowMap::CreateShadowMapTex()
 		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 		D3D12_HEAP_FLAG_NONE,
 		&texDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
+		// The state the render graph imports it in.
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
 		&optClear,
 		IID_PPV_ARGS(&mShadowMap)));
 }
@@ -38,8 +39,8 @@ void ShadowMap::CreateDescriptors()
 	dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
 	dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	dsvDesc.Texture2D.MipSlice = 0;
-	GetEngine()->GetDevice()->CreateDepthStencilView(mShadowMap.Get(), &dsvDesc, GetEngine()->GetDescriptorHeap()->GetDsvDescriptorCpuHandle());
-	mShadowMapDsvIndex = GetEngine()->GetDescriptorHeap()->GetDsvDescriptorIndex();
+	mShadowMapDsvIndex = GetEngine()->GetDescriptorHeap()->SetDsvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateDepthStencilView(mShadowMap.Get(), &dsvDesc, GetEngine()->GetDescriptorHeap()->GetDsvDescriptorCpuHandle(mShadowMapDsvIndex));
 
 	// Create SRV to resource so we can sample the shadow map in a shader program.
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -50,8 +51,8 @@ void ShadowMap::CreateDescriptors()
 	srvDesc.Texture2D.MipLevels = 1;
 	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
 	srvDesc.Texture2D.PlaneSlice = 0;
-	GetEngine()->GetDevice()->CreateShaderResourceView(mShadowMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	mShadowMapRsvIndex = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+	mShadowMapRsvIndex = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateShaderResourceView(mShadowMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mShadowMapRsvIndex));
 }
 
 ShadowMap::ShadowMap(UINT width, UINT height)
@@ -69,49 +70,37 @@ ShadowMap::ShadowMap(UINT width, UINT height)
 	mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
 	mSceneBounds.Radius = sqrtf(10.0f*10.0f + 15.0f*15.0f);
 
-	PassCB = make_unique<ConstantBuffer<CBPerPass>>(GetEngine()->GetDevice(), 1, true);
+	PassCB = make_unique<ConstantBuffer<CBPerPass>>(GetEngine()->GetDevice(), GetEngine()->GetFrameResource(), 1, true);
 	CreateShadowMapTex();
 	CreateDescriptors();
 	CreatePSO();
 }
 
-void ShadowMap::DrawSceneToShadowMap()
+void ShadowMap::DrawSceneToShadowMap(ID3D12GraphicsCommandList* cmdList)
 {
-	ID3D12GraphicsCommandList* mCommandList = GetEngine()->GetCommandList();
-	mCommandList->RSSetViewports(1, &mViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
-
-	// Change to DEPTH_WRITE.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap.Get(),
-		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+	cmdList->RSSetViewports(1, &mViewport);
+	cmdList->RSSetScissorRects(1, &mScissorRect);
 
 	// Clear the back buffer and depth buffer.
-	mCommandList->ClearDepthStencilView(GetEngine()->GetDescriptorHeap()->GetDsvDescriptorCpuHandle(mShadowMapDsvIndex),
+	cmdList->ClearDepthStencilView(GetEngine()->GetDescriptorHeap()->GetDsvDescriptorCpuHandle(mShadowMapDsvIndex),
 		D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
 	// Set null render target because we are only going to draw to
 	// depth buffer.  Setting a null render target will disable color writes.
 	// Note the active PSO also must specify a render target count of 0.
-	mCommandList->OMSetRenderTargets(0, nullptr, false, &GetEngine()->GetDescriptorHeap()->GetDsvDescriptorCpuHandle(mShadowMapDsvIndex));
+	cmdList->OMSetRenderTargets(0, nullptr, false, &GetEngine()->GetDescriptorHeap()->GetDsvDescriptorCpuHandle(mShadowMapDsvIndex));
 	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(CBPerPass));
 	// Bind the pass constant buffer for the shadow map pass.
 	D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = PassCB->Resource()->GetGPUVirtualAddress() + 0 * passCBByteSize;
-	mCommandList->SetGraphicsRootConstantBufferView(1, passCBAddress);
-	mCommandList->SetPipelineState(mShadowMapPSO.Get());
-
-	GetEngine()->DrawRenderItems(RenderLayer::Opaque);
-
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap.Get(),
-		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ));
+	cmdList->SetGraphicsRootConstantBufferView(1, passCBAddress);
+	cmdList->SetPipelineState(mShadowMapPSO.Get());
 
+	GetEngine()->ExecuteRenderItems(cmdList, mShadowMapPSO.Get(), RenderLayer::Opaque);
 }
 
 void ShadowMap::CreatePSO()
 {
 	ShaderState* shader = GetEngine()->GetShader();
-	ComPtr<ID3DBlob> vs = shader->CreateVSShader(L"Shader\\Shadows.hlsl");
-	ComPtr<ID3DBlob> ps = shader->CreatePSShader(L"Shader\\Shadows.hlsl");
 	//
 	// PSO for opaque objects.
 	//
@@ -124,16 +113,6 @@ void ShadowMap::CreatePSO()
 	smapPsoDesc.RasterizerState.DepthBiasClamp = 0.0f;
 	smapPsoDesc.RasterizerState.SlopeScaledDepthBias = 1.0f;
 
-	smapPsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(vs->GetBufferPointer()),
-		vs->GetBufferSize()
-	};
-	smapPsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
-		ps->GetBufferSize()
-	};
 	smapPsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 	smapPsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
 	smapPsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
@@ -145,7 +124,7 @@ void ShadowMap::CreatePSO()
 	smapPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
 	smapPsoDesc.NumRenderTargets = 0;
 
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateGraphicsPipelineState(&smapPsoDesc, IID_PPV_ARGS(&mShadowMapPSO)));
+	GetEngine()->GetPipelineBuilder()->Add("ShadowMap", smapPsoDesc, L"Shader\\Shadows.hlsl", L"Shader\\Shadows.hlsl", &mShadowMapPSO);
 }
 
 void ShadowMap::UpdateShadowTransform()
@@ -205,7 +184,6 @@ void ShadowMap::Update(const GameTimer& Timer)
 
 void ShadowMap::UpdateShadowPassCB()
 {
-	PassCB->Update();
 	XMMATRIX view = XMLoadFloat4x4(&mLightView);
 	XMMATRIX proj = XMLoadFloat4x4(&mLightProj);
 
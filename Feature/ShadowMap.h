@@ -9,13 +9,16 @@ public:
 	void CreateShadowMapTex();
 	void CreateDescriptors();
 	void CreatePSO();
-	void DrawSceneToShadowMap();
+	void DrawSceneToShadowMap(ID3D12GraphicsCommandList* cmdList);
 	void UpdateShadowPassCB();
 	void UpdateShadowTransform();
 	void Update(const GameTimer& Timer);
 	XMFLOAT4X4& GetShadowTransform() { return mShadowTransform; }
+	ID3D12Resource* GetResource() { return mShadowMap.Get(); }
 
 
+	int GetShadowMapSrvIndex() const { return mShadowMapRsvIndex; }
+
 private:
 	ComPtr<ID3D12Resource> mShadowMap = nullptr;
 	ComPtr<ID3D12RootSignature> mShdowMapRootSignature;
@@ -1,8 +1,13 @@
 #include "Sky.h"
 
-CD3DX12_GPU_DESCRIPTOR_HANDLE Sky::GetSkyHeapStart()
+int Sky::GetSkySrvIndex()
 {
-	return GetEngine()->GetDescriptorHeap()->GetSrvDescriptorGpuHandle(mSkyTexHeapIndex);
+	return GetEngine()->GetTextureList()->GetSrvIndex(mSkyTexHeapIndex);
+}
+
+void Sky::PrefetchAssets()
+{
+	GetEngine()->GetAssetLoader()->PrefetchTexture(L"source/Textures/grasscube1024.dds", true);
 }
 
 void Sky::LoadRenderItem()
@@ -49,8 +54,6 @@ void Sky::BuildSkyPSO(const wchar_t* vsFile, const wchar_t* psFile)
 		// PSO for sky.
 		//
 	ShaderState* shader = GetEngine()->GetShader();
-	ComPtr<ID3DBlob> vs = shader->CreateVSShader(vsFile);
-	ComPtr<ID3DBlob> ps = shader->CreatePSShader(psFile);
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC skyPsoDesc;
 
@@ -60,16 +63,6 @@ void Sky::BuildSkyPSO(const wchar_t* vsFile, const wchar_t* psFile)
 	ZeroMemory(&skyPsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
 	skyPsoDesc.InputLayout = { shader->GetLayout().data(), (UINT)shader->GetLayout().size() };
 	skyPsoDesc.pRootSignature = GetEngine()->GetBaseRootSignature();
-	skyPsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(vs->GetBufferPointer()),
-		vs->GetBufferSize()
-	};
-	skyPsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
-		ps->GetBufferSize()
-	};
 	skyPsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	skyPsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 	skyPsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
@@ -90,14 +83,13 @@ void Sky::BuildSkyPSO(const wchar_t* vsFile, const wchar_t* psFile)
 	// fail the depth test if the depth buffer was cleared to 1.
 	skyPsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
 
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateGraphicsPipelineState(&skyPsoDesc, IID_PPV_ARGS(&mSkyPSO)));
+	GetEngine()->GetPipelineBuilder()->Add("Sky", skyPsoDesc, vsFile, psFile, &mSkyPSO);
 
 }
 
-void Sky::Draw(const GameTimer& Timer)
+void Sky::Draw(ID3D12GraphicsCommandList* cmdList)
 {
-	auto mCommandList = GetEngine()->GetCommandList();
-	mCommandList->SetPipelineState(mSkyPSO.Get());
-	mCommandList->OMSetRenderTargets(1, &GetEngine()->CurrentBackBufferView(), true, &GetEngine()->DepthStencilView());
-	GetEngine()->DrawRenderItems(RenderLayer::Sky);
+	cmdList->SetPipelineState(mSkyPSO.Get());
+	cmdList->OMSetRenderTargets(1, &GetEngine()->CurrentBackBufferView(), true, &GetEngine()->DepthStencilView());
+	GetEngine()->DrawRenderItems(cmdList, RenderLayer::Sky);
 }
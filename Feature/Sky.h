@@ -6,10 +6,12 @@ class Sky
 public:
 	void BuildSkyPSO(const wchar_t* vsFile, const wchar_t* psFile);
 	//void BuildBaseRootSignature();
+	void PrefetchAssets();
 	void LoadRenderItem();
-	void Draw(const GameTimer& Timer);
+	void Draw(ID3D12GraphicsCommandList* cmdList);
 	UINT GetSkyHeapIndex() { return mSkyTexHeapIndex; }
-	CD3DX12_GPU_DESCRIPTOR_HANDLE GetSkyHeapStart();
+	// SRV to bind this frame, the streamed one once the cube map is resident.
+	int GetSkySrvIndex();
 
 private:
 	ComPtr<ID3D12PipelineState> mSkyPSO;
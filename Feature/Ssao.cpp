@@ -18,11 +18,10 @@ Ssao::Ssao(UINT width, UINT height)
 
 	mScissorRect = { 0, 0, (long)mWidth, (long)mHeight };
 
-	mCBSsao = make_unique<ConstantBuffer<CBSsao>>(GetEngine()->GetDevice(), 1, true);
+	mCBSsao = make_unique<ConstantBuffer<CBSsao>>(GetEngine()->GetDevice(), GetEngine()->GetFrameResource(), 1, true);
 	CreateDepthDescriptors();
 
 	CreateSsaoTex();
-	CreateSsaoDescriptors();
 
 	CreateRandomVectorTexture();
 	CreateRandomDescriptors();
@@ -47,8 +46,8 @@ void Ssao::CreateDepthDescriptors()
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = 1;
 
-	GetEngine()->GetDevice()->CreateShaderResourceView(GetEngine()->GetDsBuffer(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	mDepthSrvIndex = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+	mDepthSrvIndex = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateShaderResourceView(GetEngine()->GetDsBuffer(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mDepthSrvIndex));
 }
 
 void Ssao::CreateSsaoPSO()
@@ -56,21 +55,8 @@ void Ssao::CreateSsaoPSO()
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC ssaoPsoDesc;
 
 	ZeroMemory(&ssaoPsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-	ShaderState* shader = GetEngine()->GetShader();
-	ComPtr<ID3DBlob> vs = shader->CreateVSShader(L"Shader\\Ssao.hlsl");
-	ComPtr<ID3DBlob> ps = shader->CreatePSShader(L"Shader\\Ssao.hlsl");
 	ssaoPsoDesc.InputLayout = { nullptr, 0 };
 	ssaoPsoDesc.pRootSignature = mSsaoRootSignature.Get();
-	ssaoPsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(vs->GetBufferPointer()),
-		vs->GetBufferSize()
-	};
-	ssaoPsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
-		ps->GetBufferSize()
-	};
 
 	ssaoPsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	ssaoPsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
@@ -84,7 +70,7 @@ void Ssao::CreateSsaoPSO()
 	ssaoPsoDesc.SampleDesc.Count = 1;
 	ssaoPsoDesc.SampleDesc.Quality = 0;
 	ssaoPsoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateGraphicsPipelineState(&ssaoPsoDesc, IID_PPV_ARGS(&mSsaoPSO)));
+	GetEngine()->GetPipelineBuilder()->Add("Ssao", ssaoPsoDesc, L"Shader\\Ssao.hlsl", L"Shader\\Ssao.hlsl", &mSsaoPSO);
 }
 
 void Ssao::BuildSsaoRootSignature()
@@ -182,11 +168,6 @@ void Ssao::ComputeSsao(ID3D12GraphicsCommandList* cmdList, PostProcess* postProc
 	cmdList->RSSetScissorRects(1, &mScissorRect);
 
 	// We compute the initial SSAO to AmbientMap0.
-
-	// Change to RENDER_TARGET.
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mSsaoMap.Get(),
-		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
 	float clearValue[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	CD3DX12_CPU_DESCRIPTOR_HANDLE SsaoHandle = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mSsaoRtvIndex);
 	cmdList->ClearRenderTargetView(SsaoHandle, clearValue, 0, nullptr);
@@ -215,11 +196,6 @@ void Ssao::ComputeSsao(ID3D12GraphicsCommandList* cmdList, PostProcess* postProc
 	cmdList->IASetIndexBuffer(nullptr);
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	cmdList->DrawInstanced(6, 1, 0, 0);
-
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mSsaoMap.Get(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
-
 }
 
 void Ssao::CreateSsaoTex()
@@ -241,14 +217,7 @@ void Ssao::CreateSsaoTex()
 
 	float ambientClearColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	D3D12_CLEAR_VALUE optClear = CD3DX12_CLEAR_VALUE(AmbientMapFormat, ambientClearColor);
-
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&texDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		&optClear,
-		IID_PPV_ARGS(&mSsaoMap)));
+	mSsaoTexture = GetEngine()->GetRenderGraph()->AddTexture("Ssao map", texDesc, optClear, &mSsaoMap);
 }
 
 void Ssao::CreateSsaoDescriptors()
@@ -260,8 +229,8 @@ void Ssao::CreateSsaoDescriptors()
 	srvDesc.Texture2D.MipLevels = 1;
 
 	srvDesc.Format = AmbientMapFormat;
-	GetEngine()->GetDevice()->CreateShaderResourceView(mSsaoMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	mSsaoSrvIndex = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+	mSsaoSrvIndex = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateShaderResourceView(mSsaoMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mSsaoSrvIndex));
 
 	D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
 	rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
@@ -269,8 +238,8 @@ void Ssao::CreateSsaoDescriptors()
 	rtvDesc.Texture2D.PlaneSlice = 0;
 	rtvDesc.Format = AmbientMapFormat;
 
-	GetEngine()->GetDevice()->CreateRenderTargetView(mSsaoMap.Get(), &rtvDesc, GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle());
-	mSsaoRtvIndex = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorIndex();
+	mSsaoRtvIndex = GetEngine()->GetDescriptorHeap()->SetRtvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateRenderTargetView(mSsaoMap.Get(), &rtvDesc, GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mSsaoRtvIndex));
 }
 
 void Ssao::CreateRandomVectorTexture()
@@ -318,8 +287,8 @@ void Ssao::CreateRandomDescriptors()
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.MipLevels = 1;
 
-	GetEngine()->GetDevice()->CreateShaderResourceView(mRandomVectorMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	mRandomVectorSrvIndex = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+	mRandomVectorSrvIndex = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateShaderResourceView(mRandomVectorMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mRandomVectorSrvIndex));
 }
 
 void Ssao::InitSsaoCb()
@@ -381,7 +350,6 @@ void Ssao::BuildOffsetVectors()
 
 void Ssao::UpdateSsaoCB(const GameTimer& Timer)
 {
-	mCBSsao->Update();
 
 	XMMATRIX view = GetEngine()->GetView();
 	XMMATRIX proj = GetEngine()->GetProj();
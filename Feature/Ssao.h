@@ -26,7 +26,9 @@ public:
 	void CreateDepthDescriptors();
 	void BuildSsaoRootSignature();
 	void CreateSsaoPSO();
+	// Registers the SSAO map as a render graph transient.
 	void CreateSsaoTex();
+	// Once the render graph has placed the SSAO map.
 	void CreateSsaoDescriptors();
 	void CreateRandomVectorTexture();
 	void CreateRandomDescriptors();
@@ -38,11 +40,13 @@ public:
 	CD3DX12_GPU_DESCRIPTOR_HANDLE GetSsaoSrvGpuHandle();
 	void SetNormalSrvIndex(int value) { mNormalSrvIndex = value; };
 	void SetWPosSrvIndex(int value) { mWPosSrvIndex = value; };
+	RenderGraph::Handle GetSsaoTexture() { return mSsaoTexture; }
 
 private:
 	UINT mWidth;
 	UINT mHeight;
 	ComPtr<ID3D12Resource> mSsaoMap = nullptr;
+	RenderGraph::Handle mSsaoTexture;
 	ComPtr<ID3D12Resource> mRandomVectorMap = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> mRandomVectorMapUploadBuffer;
 	static const DXGI_FORMAT AmbientMapFormat = DXGI_FORMAT_R16_UNORM;
@@ -45,22 +45,9 @@ void Ssr::CreateSsrPSO()
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC SsrPsoDesc;
 
 	ZeroMemory(&SsrPsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-	ShaderState* shader = GetEngine()->GetShader();
-	ComPtr<ID3DBlob> vs = shader->CreateVSShader(L"Shader\\Ssr.hlsl");
-	ComPtr<ID3DBlob> ps = shader->CreatePSShader(L"Shader\\Ssr.hlsl");
 	//SsrPsoDesc.InputLayout = { shader->GetLayout().data(), (UINT)shader->GetLayout().size() };
 	SsrPsoDesc.InputLayout = { nullptr, 0 };
 	SsrPsoDesc.pRootSignature = mSsrRootSignature.Get();
-	SsrPsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(vs->GetBufferPointer()),
-		vs->GetBufferSize()
-	};
-	SsrPsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
-		ps->GetBufferSize()
-	};
 
 	SsrPsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	SsrPsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
@@ -75,7 +62,7 @@ void Ssr::CreateSsrPSO()
 	SsrPsoDesc.SampleDesc.Count = 1;
 	SsrPsoDesc.SampleDesc.Quality = 0;
 	SsrPsoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateGraphicsPipelineState(&SsrPsoDesc, IID_PPV_ARGS(&mSsrPSO)));
+	GetEngine()->GetPipelineBuilder()->Add("Ssr", SsrPsoDesc, L"Shader\\Ssr.hlsl", L"Shader\\Ssr.hlsl", &mSsrPSO);
 }
 
 void Ssr::BuildSsrRootSignature()
@@ -251,8 +238,8 @@ void Ssr::CreateSsrDescriptors()
 	srvDesc.Texture2D.MipLevels = 1;
 
 	srvDesc.Format = SsrMapFormat;
-	GetEngine()->GetDevice()->CreateShaderResourceView(mSsrMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	mSsrSrvIndex = GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+	mSsrSrvIndex = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateShaderResourceView(mSsrMap.Get(), &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(mSsrSrvIndex));
 
 	D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
 	rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
@@ -260,13 +247,13 @@ void Ssr::CreateSsrDescriptors()
 	rtvDesc.Texture2D.PlaneSlice = 0;
 	rtvDesc.Format = SsrMapFormat;
 
-	GetEngine()->GetDevice()->CreateRenderTargetView(mSsrMap.Get(), &rtvDesc, GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle());
-	mSsrRtvIndex = GetEngine()->GetDescriptorHeap()->GetRtvDescriptorIndex();
+	mSsrRtvIndex = GetEngine()->GetDescriptorHeap()->SetRtvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateRenderTargetView(mSsrMap.Get(), &rtvDesc, GetEngine()->GetDescriptorHeap()->GetRtvDescriptorCpuHandle(mSsrRtvIndex));
 }
 
 void Ssr::InitSsrCb(float farPlane)
 {
-	mCBSsr = make_unique<ConstantBuffer<CBSsr>>(GetEngine()->GetDevice(), 1, true);
+	mCBSsr = make_unique<ConstantBuffer<CBSsr>>(GetEngine()->GetDevice(), GetEngine()->GetFrameResource(), 1, true);
 
 	//SsrCB.FarClip = farPlane;
 	//SsrCB.Dimensions = { (float)mWidth, (float)mHeight };
@@ -279,7 +266,6 @@ CD3DX12_GPU_DESCRIPTOR_HANDLE Ssr::GetSsrSrvGpuHandle()
 
 void Ssr::UpdateSsrCB(const GameTimer& Timer)
 {
-	mCBSsr->Update();
 
 	XMMATRIX view = GetEngine()->GetView();
 	XMMATRIX proj = GetEngine()->GetProj();
@@ -0,0 +1,372 @@
+#include "AssetLoader.h"
+#include "GraphicEngine.h"
+#include "BlockCompression.h"
+#include "PixelConvert.h"
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+AssetLoader::~AssetLoader()
+{
+	// Workers still reference the maps and the mutex below.
+	mPool.Stop();
+}
+
+void AssetLoader::Begin(bool parallel)
+{
+	mParallel = parallel;
+	mTimings.clear();
+	mWallMs = 0.0;
+	mBeginTime = Clock::now();
+	mPool.Start(parallel ? ThreadPool::GetDefaultThreadCount() : 0);
+}
+
+void AssetLoader::End()
+{
+	size_t threadCount = mPool.GetThreadCount();
+	mPool.Stop();
+	mWallMs = ElapsedMs(mBeginTime);
+	{
+		// Prefetched but never loaded: the uploads were never recorded, drop them.
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTextures.clear();
+		mMeshes.clear();
+	}
+
+	char buffer[256];
+	sprintf_s(buffer, "Asset load: %s with %zu loader threads\n", mParallel ? "parallel" : "serial", threadCount);
+	::OutputDebugStringA(buffer);
+	LogTimings();
+	mParallel = false;
+}
+
+wstring AssetLoader::GetTextureKey(const wchar_t* file, bool isCube)
+{
+	wstring key(file);
+	if (isCube)
+		key += L"|cube";
+	return key;
+}
+
+size_t AssetLoader::AddTiming(const wstring& name, bool prefetched)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Timing timing;
+	timing.Name = name;
+	timing.Prefetched = prefetched;
+	mTimings.push_back(timing);
+	return mTimings.size() - 1;
+}
+
+void AssetLoader::PrefetchTexture(const wchar_t* file, bool isCube)
+{
+	if (!mParallel)
+		return;
+
+	wstring key = GetTextureKey(file, isCube);
+	if (mTextures.count(key))
+		return;
+	auto pending = make_shared<Pending<PreparedTexture>>();
+	pending->TimingIndex = AddTiming(file, true);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTextures[key] = pending;
+	}
+
+	wstring name(file);
+	mPool.Submit([this, pending, name, isCube]()
+	{
+		unique_ptr<PreparedTexture> asset = PrepareTexture(name.c_str(), isCube, pending->TimingIndex);
+		std::lock_guard<std::mutex> lock(mMutex);
+		pending->Asset = move(asset);
+		pending->Done = true;
+		mDone.notify_all();
+	});
+}
+
+void AssetLoader::PrefetchMesh(const char* file)
+{
+	if (!mParallel)
+		return;
+
+	wstring key(file, file + strlen(file));
+	if (mMeshes.count(key))
+		return;
+	auto pending = make_shared<Pending<PreparedMesh>>();
+	pending->TimingIndex = AddTiming(key, true);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mMeshes[key] = pending;
+	}
+
+	string name(file);
+	mPool.Submit([this, pending, name]()
+	{
+		unique_ptr<PreparedMesh> asset = PrepareMesh(name.c_str(), pending->TimingIndex);
+		std::lock_guard<std::mutex> lock(mMutex);
+		pending->Asset = move(asset);
+		pending->Done = true;
+		mDone.notify_all();
+	});
+}
+
+template<typename T>
+unique_ptr<T> AssetLoader::Wait(unordered_map<wstring, shared_ptr<Pending<T>>>& pending, const wstring& key, size_t& timingIndex)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	auto it = pending.find(key);
+	if (it == pending.end())
+		return nullptr;
+	shared_ptr<Pending<T>> entry = it->second;
+	pending.erase(it);
+
+	Clock::time_point start = Clock::now();
+	mDone.wait(lock, [&entry]() { return entry->Done; });
+	timingIndex = entry->TimingIndex;
+	mTimings[timingIndex].WaitMs = ElapsedMs(start);
+	return move(entry->Asset);
+}
+
+unique_ptr<AssetLoader::PreparedTexture> AssetLoader::TakeTexture(const wchar_t* file, bool isCube)
+{
+	size_t timingIndex;
+	unique_ptr<PreparedTexture> asset = Wait(mTextures, GetTextureKey(file, isCube), timingIndex);
+	if (asset == nullptr)
+		asset = PrepareTexture(file, isCube, AddTiming(file, false));
+	return asset;
+}
+
+unique_ptr<AssetLoader::PreparedMesh> AssetLoader::TakeMesh(const char* file)
+{
+	wstring key(file, file + strlen(file));
+	size_t timingIndex;
+	unique_ptr<PreparedMesh> asset = Wait(mMeshes, key, timingIndex);
+	if (asset == nullptr)
+		asset = PrepareMesh(file, AddTiming(key, false));
+	return asset;
+}
+
+unique_ptr<AssetLoader::PreparedTexture> AssetLoader::PrepareTexture(const wchar_t* file, bool isCube, size_t timingIndex)
+{
+	Clock::time_point start = Clock::now();
+	unique_ptr<PreparedTexture> tex(new PreparedTexture());
+
+	if (!tex->File.Open(file))
+	{
+		tex->Hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+	}
+	else
+	{
+		const uint8_t* data = tex->File.GetData();
+		size_t size = tex->File.GetSize();
+		// The index hashed the file already unless it changed since startup.
+		const TextureIndex::Entry* entry = GetEngine()->GetTextureIndex()->Find(file);
+		if (entry && (entry->Flags & TextureIndex::Valid) && entry->FileSize == size)
+			tex->ContentHash = entry->ContentHash;
+		else
+			tex->ContentHash = LoadTexture::HashContent(data, size);
+
+		// Same choice LoadTexture makes: 2D textures start with their mip tail.
+		if (!isCube && TextureStreamer::PrepareTail(data, size, tex->Upload, tex->TailMip))
+		{
+			tex->Streamed = true;
+			tex->Hr = S_OK;
+		}
+		else
+		{
+			tex->Upload = DDSTextureUpload12();
+			tex->Hr = PrepareGeneratedMips(data, size, tex->Upload);
+			if (tex->Hr == S_FALSE)
+				tex->Hr = PrepareDDSTextureFromMemory12(GetEngine()->GetDevice(), data, size, tex->Upload);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mTimings[timingIndex].WorkMs = ElapsedMs(start);
+	return tex;
+}
+
+bool AssetLoader::IsSRGBFormat(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+		format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB || format == DXGI_FORMAT_BC1_UNORM_SRGB ||
+		format == DXGI_FORMAT_BC2_UNORM_SRGB || format == DXGI_FORMAT_BC3_UNORM_SRGB;
+}
+
+bool AssetLoader::ExpandToRGBA8(DXGI_FORMAT format, const DDSSubresource& src, vector<uint8_t>& rgba)
+{
+	UINT width = src.Width;
+	UINT height = src.Height;
+	rgba.resize((size_t)width * height * 4);
+	if (BlockCompression::CanDecode(format))
+		return BlockCompression::Decode(format, src.Data, src.RowPitch, width, height, rgba.data(), (size_t)width * 4);
+
+	// RGBA8 rows are copied as they are.
+	bool copy = false;
+	PixelConvert::Source source = PixelConvert::Source::BGRA8;
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		copy = true;
+		break;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		break;
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		// The X channel is undefined, treat it as opaque.
+		source = PixelConvert::Source::BGRX8;
+		break;
+	default:
+		return false;
+	}
+
+	for (UINT y = 0; y < height; ++y)
+	{
+		uint8_t* row = &rgba[(size_t)y * width * 4];
+		const uint8_t* srcRow = src.Data + y * src.RowPitch;
+		if (copy)
+			memcpy(row, srcRow, (size_t)width * 4);
+		else
+			PixelConvert::ToRGBA8(source, srcRow, row, width);
+	}
+	return true;
+}
+
+bool AssetLoader::HasAlpha(const vector<vector<MipLevel>>& chains)
+{
+	for (auto& chain : chains)
+	{
+		const vector<uint8_t>& pixels = chain[0].Pixels;
+		for (size_t i = 3; i < pixels.size(); i += 4)
+		{
+			if (pixels[i] != 255)
+				return true;
+		}
+	}
+	return false;
+}
+
+HRESULT AssetLoader::PrepareChainUpload(vector<vector<MipLevel>>& chains, DXGI_FORMAT blockFormat, bool srgb,
+	DDSTextureUpload12& upload)
+{
+	// BC needs a 4 aligned top level; anything else stays RGBA8.
+	UINT width = chains[0][0].Width;
+	UINT height = chains[0][0].Height;
+	if (width % 4 != 0 || height % 4 != 0)
+		blockFormat = DXGI_FORMAT_UNKNOWN;
+
+	vector<D3D12_SUBRESOURCE_DATA> initData;
+	vector<vector<uint8_t>> blocks;
+	for (auto& chain : chains)
+	{
+		for (auto& level : chain)
+		{
+			if (blockFormat == DXGI_FORMAT_UNKNOWN)
+			{
+				initData.push_back({ level.Pixels.data(), (LONG_PTR)level.Width * 4, (LONG_PTR)level.Pixels.size() });
+				continue;
+			}
+
+			size_t blockPitch = ((level.Width + 3) / 4) * BlockCompression::GetBlockSize(blockFormat);
+			size_t blockRows = (level.Height + 3) / 4;
+			blocks.emplace_back(blockPitch * blockRows);
+			BlockCompression::Encode(blockFormat, level.Pixels.data(), (size_t)level.Width * 4, level.Width, level.Height,
+				blocks.back().data(), blockPitch, BlockCompression::Quality::Normal);
+			initData.push_back({ blocks.back().data(), (LONG_PTR)blockPitch, (LONG_PTR)blocks.back().size() });
+		}
+	}
+
+	DXGI_FORMAT format = blockFormat;
+	if (format == DXGI_FORMAT_UNKNOWN)
+		format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	D3D12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, width, height,
+		(UINT16)chains.size(), (UINT16)chains[0].size());
+	return PrepareTextureUpload12(GetEngine()->GetDevice(), texDesc, initData.data(), upload);
+}
+
+HRESULT AssetLoader::PrepareGeneratedMips(const uint8_t* data, size_t size, DDSTextureUpload12& upload)
+{
+	DDSFileView view;
+	if (!view.Parse(data, size) || view.GetMipCount() != 1 || view.GetDepth() != 1 ||
+		(view.GetWidth() == 1 && view.GetHeight() == 1))
+		return S_FALSE;
+
+	vector<DDSSubresource> subresources;
+	if (!view.GetSubresources(subresources))
+		return S_FALSE;
+
+	// Filtering runs on RGBA8: 8 bit RGBA/BGRA as they are, BC1-BC5 decoded first.
+	DXGI_FORMAT format = (DXGI_FORMAT)view.GetDxgiFormat();
+	bool srgb = IsSRGBFormat(format);
+	UINT arraySize = view.GetArraySize();
+	vector<vector<MipLevel>> chains(arraySize);
+	vector<uint8_t> rgba;
+	for (UINT slice = 0; slice < arraySize; ++slice)
+	{
+		if (!ExpandToRGBA8(format, subresources[slice], rgba))
+			return S_FALSE;
+
+		UINT width = view.GetWidth();
+		UINT height = view.GetHeight();
+		MipGenerator::Options options;
+		options.SRGB = srgb;
+		options.PreserveAlphaCoverage = MipGenerator::IsAlphaTested(rgba.data(), width, height, width * 4);
+		MipGenerator::Generate(rgba.data(), width, height, width * 4, options, chains[slice]);
+	}
+
+	// Back to blocks: BC sources keep their family (BC2 becomes BC3, which has the
+	// same size and smoother alpha), 8 bit sources become BC3 with alpha and BC7
+	// without.
+	DXGI_FORMAT blockFormat;
+	if (BlockCompression::CanEncode(format))
+		blockFormat = format;
+	else if (BlockCompression::CanDecode(format) || HasAlpha(chains))
+		blockFormat = srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	else
+		blockFormat = srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	return PrepareChainUpload(chains, blockFormat, srgb, upload);
+}
+
+unique_ptr<AssetLoader::PreparedMesh> AssetLoader::PrepareMesh(const char* file, size_t timingIndex)
+{
+	Clock::time_point start = Clock::now();
+	unique_ptr<PreparedMesh> mesh(new PreparedMesh());
+	mesh->Loaded = MeshInfo::ParseTextMesh(file, mesh->Vertices, mesh->Indices, mesh->Bounds);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mTimings[timingIndex].WorkMs = ElapsedMs(start);
+	return mesh;
+}
+
+void AssetLoader::LogTimings() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	char buffer[512];
+	double workMs = 0.0;
+	double waitMs = 0.0;
+	for (auto& timing : mTimings)
+	{
+		sprintf_s(buffer, "Asset load: %-40S %8.2f ms work %8.2f ms wait%s\n", timing.Name.c_str(),
+			timing.WorkMs, timing.WaitMs, timing.Prefetched ? "" : " (inline)");
+		::OutputDebugStringA(buffer);
+		workMs += timing.WorkMs;
+		waitMs += timing.WaitMs;
+	}
+
+	// In serial mode every millisecond of work is on the main thread; in parallel
+	// mode only the waits are, so the two totals compare the modes directly.
+	double mainThreadMs = mParallel ? waitMs : workMs;
+	for (auto& timing : mTimings)
+	{
+		if (mParallel && !timing.Prefetched)
+			mainThreadMs += timing.WorkMs;
+	}
+	sprintf_s(buffer, "Asset load: %zu assets, %.2f ms work, %.2f ms of it on the main thread, %.2f ms startup\n",
+		mTimings.size(), workMs, mainThreadMs, mWallMs);
+	::OutputDebugStringA(buffer);
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "framework.h"
+#include "ResourceStruct.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "MipGenerator.h"
+#include "DDSFileView.h"
+#include <chrono>
+
+// Startup asset front end. Scene setup names the files it is about to load with
+// Prefetch*, and mapping, hashing, parsing and filling upload heaps for them run
+// on a thread pool while the main thread keeps building PSOs and render items.
+// LoadTexture and MeshInfo::LoadTextMesh then Take the prepared data and only
+// record the copies, on the submitting thread and in the same order as before.
+// Anything not prefetched, or everything in serial mode, is prepared inline by
+// Take, so both modes share one code path and one set of timings.
+class AssetLoader
+{
+public:
+	struct PreparedTexture
+	{
+		HRESULT Hr = E_FAIL;
+		MappedFile File;
+		UINT64 ContentHash = 0;
+		// Mip tail only for streamed textures, the whole texture otherwise.
+		DDSTextureUpload12 Upload;
+		bool Streamed = false;
+		UINT TailMip = 0;
+	};
+
+	struct PreparedMesh
+	{
+		bool Loaded = false;
+		vector<Vertex> Vertices;
+		vector<int32_t> Indices;
+		DirectX::BoundingSphere Bounds;
+	};
+
+	~AssetLoader();
+
+	// Starts the clock and the workers. Serial runs every load on the caller.
+	void Begin(bool parallel);
+	// Drops prefetched assets nobody took, stops the workers and logs timings.
+	void End();
+
+	void PrefetchTexture(const wchar_t* file, bool isCube = false);
+	void PrefetchMesh(const char* file);
+
+	// Waits for the prefetched asset, or prepares it now. Never returns null;
+	// check Hr / Loaded.
+	unique_ptr<PreparedTexture> TakeTexture(const wchar_t* file, bool isCube);
+	unique_ptr<PreparedMesh> TakeMesh(const char* file);
+
+	void LogTimings() const;
+
+	// Level 0 of a DDS subresource as tight RGBA8, for formats the CPU tools can
+	// filter: BC1-BC5 and 8 bit RGBA/BGRA/BGRX.
+	static bool ExpandToRGBA8(DXGI_FORMAT format, const DDSSubresource& src, vector<uint8_t>& rgba);
+	static bool IsSRGBFormat(DXGI_FORMAT format);
+	// True when any top level texel is not fully opaque.
+	static bool HasAlpha(const vector<vector<MipLevel>>& chains);
+	// Compresses RGBA8 chains (one per array slice) to blockFormat and fills the
+	// upload heap. DXGI_FORMAT_UNKNOWN, or a top level that is not 4 aligned,
+	// uploads RGBA8 instead.
+	static HRESULT PrepareChainUpload(vector<vector<MipLevel>>& chains, DXGI_FORMAT blockFormat, bool srgb,
+		DDSTextureUpload12& upload);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	template<typename T>
+	struct Pending
+	{
+		bool Done = false;
+		unique_ptr<T> Asset;
+		size_t TimingIndex = 0;
+	};
+
+	struct Timing
+	{
+		wstring Name;
+		// Spent preparing, on whichever thread ran it.
+		double WorkMs = 0.0;
+		// Main thread blocked in Take waiting for a worker.
+		double WaitMs = 0.0;
+		bool Prefetched = false;
+	};
+
+	static wstring GetTextureKey(const wchar_t* file, bool isCube);
+	unique_ptr<PreparedTexture> PrepareTexture(const wchar_t* file, bool isCube, size_t timingIndex);
+	// Builds the mip chain for DDS files that only have level 0 and compresses it
+	// to BC on the calling thread. S_FALSE when the file has mips or its format is
+	// not handled.
+	static HRESULT PrepareGeneratedMips(const uint8_t* data, size_t size, DDSTextureUpload12& upload);
+	unique_ptr<PreparedMesh> PrepareMesh(const char* file, size_t timingIndex);
+	size_t AddTiming(const wstring& name, bool prefetched);
+
+	template<typename T>
+	unique_ptr<T> Wait(unordered_map<wstring, shared_ptr<Pending<T>>>& pending, const wstring& key, size_t& timingIndex);
+
+	ThreadPool mPool;
+	bool mParallel = false;
+	Clock::time_point mBeginTime;
+	double mWallMs = 0.0;
+
+	// Guards the pending maps, their entries and mTimings.
+	mutable std::mutex mMutex;
+	std::condition_variable mDone;
+	unordered_map<wstring, shared_ptr<Pending<PreparedTexture>>> mTextures;
+	unordered_map<wstring, shared_ptr<Pending<PreparedMesh>>> mMeshes;
+	vector<Timing> mTimings;
+};
@@ -0,0 +1,87 @@
+#include "CommandListPool.h"
+
+void CommandListPool::Init(ID3D12Device* device, size_t participants, int frameCount)
+{
+	mDevice = device;
+	mParticipants = participants;
+	mFrame = 0;
+	mSlots.clear();
+	mSlots.resize(participants * frameCount);
+}
+
+void CommandListPool::BeginFrame(int frameIndex)
+{
+	mFrame = frameIndex;
+	for (size_t i = 0; i < mParticipants; ++i)
+	{
+		Slot& slot = mSlots[mFrame * mParticipants + i];
+		for (size_t j = 0; j < slot.Used; ++j)
+			ThrowIfFailed(slot.Entries[j].Allocator->Reset());
+		slot.Used = 0;
+	}
+}
+
+ID3D12GraphicsCommandList* CommandListPool::Acquire(size_t participant)
+{
+	assert(participant < mParticipants);
+	Slot& slot = mSlots[mFrame * mParticipants + participant];
+	if (slot.Used < slot.Entries.size())
+	{
+		Entry& entry = slot.Entries[slot.Used];
+		HRESULT hr = entry.List->Reset(entry.Allocator.Get(), nullptr);
+		if (FAILED(hr))
+		{
+			SetFailure(hr);
+			return nullptr;
+		}
+		++slot.Used;
+		return entry.List.Get();
+	}
+
+	// Creation is free threaded; a new list starts out open.
+	Entry entry;
+	HRESULT hr = mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(entry.Allocator.GetAddressOf()));
+	if (SUCCEEDED(hr))
+	{
+		hr = mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, entry.Allocator.Get(), nullptr,
+			IID_PPV_ARGS(entry.List.GetAddressOf()));
+	}
+	if (FAILED(hr))
+	{
+		SetFailure(hr);
+		return nullptr;
+	}
+	slot.Entries.push_back(entry);
+	++slot.Used;
+	return entry.List.Get();
+}
+
+void CommandListPool::Close(ID3D12GraphicsCommandList* cmdList)
+{
+	HRESULT hr = cmdList->Close();
+	if (FAILED(hr))
+		SetFailure(hr);
+}
+
+void CommandListPool::SetFailure(HRESULT hr)
+{
+	std::lock_guard<std::mutex> lock(mFailureMutex);
+	if (SUCCEEDED(mFailure))
+		mFailure = hr;
+}
+
+HRESULT CommandListPool::TakeFailure()
+{
+	std::lock_guard<std::mutex> lock(mFailureMutex);
+	HRESULT hr = mFailure;
+	mFailure = S_OK;
+	return hr;
+}
+
+size_t CommandListPool::GetUsedCount() const
+{
+	size_t used = 0;
+	for (size_t i = 0; i < mParticipants; ++i)
+		used += mSlots[mFrame * mParticipants + i].Used;
+	return used;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "framework.h"
+#include <mutex>
+
+// Command lists for passes recorded on job system workers. Every participant has
+// its own allocators for each frame resource, one allocator per list handed
+// out, so no allocator is ever shared between threads or reset while the GPU
+// may still read the frame that filled it.
+class CommandListPool
+{
+public:
+	void Init(ID3D12Device* device, size_t participants, int frameCount);
+	// Resets every list handed out the last time frameIndex was current. The GPU
+	// must already be past that frame's fence.
+	void BeginFrame(int frameIndex);
+	// An open list, on the allocators of participant. Only that participant may
+	// call this while a frame records. Null on failure, see TakeFailure.
+	ID3D12GraphicsCommandList* Acquire(size_t participant);
+	// Closes a list from Acquire. Failures are kept for TakeFailure, since jobs
+	// cannot throw.
+	void Close(ID3D12GraphicsCommandList* cmdList);
+	// The first failure since the last call, S_OK if none.
+	HRESULT TakeFailure();
+	// Lists handed out this frame, over all participants.
+	size_t GetUsedCount() const;
+
+private:
+	struct Entry
+	{
+		ComPtr<ID3D12CommandAllocator> Allocator;
+		ComPtr<ID3D12GraphicsCommandList> List;
+	};
+
+	struct Slot
+	{
+		vector<Entry> Entries;
+		size_t Used = 0;
+	};
+
+	void SetFailure(HRESULT hr);
+
+	ID3D12Device* mDevice = nullptr;
+	size_t mParticipants = 0;
+	int mFrame = 0;
+	// mSlots[frame * mParticipants + participant].
+	vector<Slot> mSlots;
+	std::mutex mFailureMutex;
+	HRESULT mFailure = S_OK;
+};
@@ -4,21 +4,20 @@
 #include "Util.h"
 #include "MathHelper.h"
 #include "UploadBuffer.h"
+#include "FrameResource.h"
 //#include "GraphicEngine.h"
 
-#define MAX_CONSTENT_BUFFER_SIZE 3
-
 // Stores the resources needed for the CPU to build the command lists
-// for a frame.  
+// for a frame: one buffer per frame resource, the current frame's picked
+// by its index.
 template<class T>
 class ConstantBuffer
 {
 public:
 	//ConstantBuffer() {};
-	ConstantBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer);
+	ConstantBuffer(ID3D12Device* device, const FrameResource* frames, UINT elementCount, bool isConstantBuffer);
 	~ConstantBuffer();
 	void Update(int elementIndex, const T& data);
-	void Update();
 	D3D12_GPU_VIRTUAL_ADDRESS GetGPUAddress();
 
 	// We cannot reset the allocator until the GPU is done processing the commands.
@@ -26,7 +25,7 @@ public:
 	//ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 	ID3D12Resource* Resource()const
 	{
-		return CBuffer[CurrentSize]->Resource();
+		return CBuffer[mFrames->GetIndex()]->Resource();
 	}
 
 
@@ -38,13 +37,14 @@ private:
 	// Fence value to mark commands up to this fence point.  This lets us
 	// check if these frame resources are still in use by the GPU.
 	//UINT64 Fence = 0;
-	int CurrentSize = 0;
+	const FrameResource* mFrames;
 };
 
 template<class T>
-ConstantBuffer<T>::ConstantBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer)
+ConstantBuffer<T>::ConstantBuffer(ID3D12Device* device, const FrameResource* frames, UINT elementCount, bool isConstantBuffer)
+	: mFrames(frames)
 {
-	for (int i = 0; i != MAX_CONSTENT_BUFFER_SIZE; ++i)
+	for (int i = 0; i != frames->GetCount(); ++i)
 	{
 		CBuffer.push_back(make_unique<UploadBuffer<T>>(device, elementCount, isConstantBuffer));
 	}
@@ -53,7 +53,7 @@ ConstantBuffer<T>::ConstantBuffer(ID3D12Device* device, UINT elementCount, bool
 template<class T>
 ConstantBuffer<T>::~ConstantBuffer()
 {
-	for (int i = 0; i != MAX_CONSTENT_BUFFER_SIZE; ++i)
+	for (size_t i = 0; i != CBuffer.size(); ++i)
 	{
 		CBuffer[i].release();
 	}
@@ -62,20 +62,11 @@ ConstantBuffer<T>::~ConstantBuffer()
 template<class T>
 void ConstantBuffer<T>::Update(int elementIndex, const T& data)
 {
-	CBuffer[CurrentSize]->CopyData(elementIndex, data);
-}
-
-template<class T>
-void ConstantBuffer<T>::Update()
-{
-	if (++CurrentSize >= MAX_CONSTENT_BUFFER_SIZE)
-	{
-		CurrentSize = 0;
-	}
+	CBuffer[mFrames->GetIndex()]->CopyData(elementIndex, data);
 }
 
 template<class T>
 D3D12_GPU_VIRTUAL_ADDRESS ConstantBuffer<T>::GetGPUAddress()
 {
-	CBuffer[CurrentSize]->Resource()->GetGPUVirtualAddress();
+	return CBuffer[mFrames->GetIndex()]->Resource()->GetGPUVirtualAddress();
 }
\ No newline at end of file
@@ -24,6 +24,9 @@
 #include <wrl.h>
 
 #include "DDSTextureLoader.h" 
+#include "MappedFile.h"
+#include "DDSFileView.h"
+#include "PixelConvert.h"
 
 using namespace Microsoft::WRL;
 
@@ -143,9 +146,13 @@ namespace
 
 };
 
+//--------------------------------------------------------------------------------------
+// Maps the file instead of reading it into a heap buffer. The header is validated in
+// place and the returned pointers stay valid for as long as ddsFile is open, so the
+// subresource copies into the upload heap read straight from the file cache.
 //--------------------------------------------------------------------------------------
 static HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
-	std::unique_ptr<uint8_t[]>& ddsData,
+	MappedFile& ddsFile,
 	DDS_HEADER** header,
 	uint8_t** bitData,
 	size_t* bitSize
@@ -156,114 +163,23 @@ static HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
 		return E_POINTER;
 	}
 
-	// open the file
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-	ScopedHandle hFile(safe_handle(CreateFile2(fileName,
-		GENERIC_READ,
-		FILE_SHARE_READ,
-		OPEN_EXISTING,
-		nullptr)));
-#else
-	ScopedHandle hFile(safe_handle(CreateFileW(fileName,
-		GENERIC_READ,
-		FILE_SHARE_READ,
-		nullptr,
-		OPEN_EXISTING,
-		FILE_ATTRIBUTE_NORMAL,
-		nullptr)));
-#endif
-
-	if (!hFile)
-	{
-		return HRESULT_FROM_WIN32(GetLastError());
-	}
-
-	// Get the file size
-	LARGE_INTEGER FileSize = { 0 };
-
-#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
-	FILE_STANDARD_INFO fileInfo;
-	if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
-	{
-		return HRESULT_FROM_WIN32(GetLastError());
-	}
-	FileSize = fileInfo.EndOfFile;
-#else
-	GetFileSizeEx(hFile.get(), &FileSize);
-#endif
-
-	// File is too big for 32-bit allocation, so reject read
-	if (FileSize.HighPart > 0)
-	{
-		return E_FAIL;
-	}
-
-	// Need at least enough data to fill the header and magic number to be a valid DDS
-	if (FileSize.LowPart < (sizeof(DDS_HEADER) + sizeof(uint32_t)))
-	{
-		return E_FAIL;
-	}
-
-	// create enough space for the file data
-	ddsData.reset(new (std::nothrow) uint8_t[FileSize.LowPart]);
-	if (!ddsData)
-	{
-		return E_OUTOFMEMORY;
-	}
-
-	// read the data in
-	DWORD BytesRead = 0;
-	if (!ReadFile(hFile.get(),
-		ddsData.get(),
-		FileSize.LowPart,
-		&BytesRead,
-		nullptr
-	))
+	if (!ddsFile.Open(fileName))
 	{
-		return HRESULT_FROM_WIN32(GetLastError());
+		DWORD error = GetLastError();
+		return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
 	}
 
-	if (BytesRead < FileSize.LowPart)
+	DDSFileView view;
+	if (!view.Parse(ddsFile.GetData(), ddsFile.GetSize()))
 	{
 		return E_FAIL;
 	}
 
-	// DDS files always start with the same magic number ("DDS ")
-	uint32_t dwMagicNumber = *(const uint32_t*)(ddsData.get());
-	if (dwMagicNumber != DDS_MAGIC)
-	{
-		return E_FAIL;
-	}
-
-	auto hdr = reinterpret_cast<DDS_HEADER*>(ddsData.get() + sizeof(uint32_t));
-
-	// Verify header to validate DDS file
-	if (hdr->size != sizeof(DDS_HEADER) ||
-		hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
-	{
-		return E_FAIL;
-	}
-
-	// Check for DX10 extension
-	bool bDXT10Header = false;
-	if ((hdr->ddspf.flags & DDS_FOURCC) &&
-		(MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
-	{
-		// Must be long enough for both headers and magic value
-		if (FileSize.LowPart < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
-		{
-			return E_FAIL;
-		}
-
-		bDXT10Header = true;
-	}
-
-	// setup the pointers in the process request
-	*header = hdr;
-	ptrdiff_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER)
-		+ (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
-	*bitData = ddsData.get() + offset;
-	*bitSize = FileSize.LowPart - offset;
+	// setup the pointers in the process request. The mapping is read-only, nothing
+	// downstream writes through these.
+	*header = reinterpret_cast<DDS_HEADER*>(const_cast<uint8_t*>(view.GetHeader()));
+	*bitData = const_cast<uint8_t*>(view.GetBitData());
+	*bitSize = view.GetBitSize();
 
 	return S_OK;
 }
@@ -765,6 +681,71 @@ static DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf)
 }
 
 
+//--------------------------------------------------------------------------------------
+static bool IsSampleable(_In_ ID3D12Device* device, _In_ DXGI_FORMAT format)
+{
+	D3D12_FEATURE_DATA_FORMAT_SUPPORT support = { format };
+	return SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &support, sizeof(support))) &&
+		(support.Support1 & D3D12_FORMAT_SUPPORT1_SHADER_SAMPLE) != 0;
+}
+
+// Legacy layouts with no DXGI format, or whose closest one samples differently
+// (L8 as R8 reads back red only), are converted to RGBA8 on the CPU at load time.
+static bool GetLegacyConversion(_In_ ID3D12Device* device, const DDS_PIXELFORMAT& ddpf, _Out_ PixelConvert::Source& source)
+{
+	if (ddpf.flags & DDS_RGB)
+	{
+		switch (ddpf.RGBBitCount)
+		{
+		case 32:
+			// D3DFMT_X8B8G8R8
+			if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000))
+			{
+				source = PixelConvert::Source::RGBX8;
+				return true;
+			}
+			break;
+
+		case 24:
+			// D3DFMT_R8G8B8, stored blue first
+			if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000))
+			{
+				source = PixelConvert::Source::BGR8;
+				return true;
+			}
+			if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000))
+			{
+				source = PixelConvert::Source::RGB8;
+				return true;
+			}
+			break;
+
+		case 16:
+			// B5G6R5 is optional for sampling on older hardware.
+			if (ISBITMASK(0xf800, 0x07e0, 0x001f, 0x0000) && !IsSampleable(device, DXGI_FORMAT_B5G6R5_UNORM))
+			{
+				source = PixelConvert::Source::B5G6R5;
+				return true;
+			}
+			break;
+		}
+	}
+	else if (ddpf.flags & DDS_LUMINANCE)
+	{
+		if (8 == ddpf.RGBBitCount && ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x00000000))
+		{
+			source = PixelConvert::Source::L8;
+			return true;
+		}
+		if (16 == ddpf.RGBBitCount && ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00))
+		{
+			source = PixelConvert::Source::A8L8;
+			return true;
+		}
+	}
+	return false;
+}
+
 //--------------------------------------------------------------------------------------
 static DXGI_FORMAT MakeSRGB(_In_ DXGI_FORMAT format)
 {
@@ -1229,7 +1210,6 @@ static HRESULT CreateD3DResources(_In_ ID3D11Device* d3dDevice,
 
 static HRESULT CreateD3DResources12(
 	ID3D12Device* device,
-	ID3D12GraphicsCommandList* cmdList,
 	_In_ uint32_t resDim,
 	_In_ size_t width,
 	_In_ size_t height,
@@ -1240,8 +1220,7 @@ static HRESULT CreateD3DResources12(
 	_In_ bool forceSRGB,
 	_In_ bool isCubeMap,
 	_In_reads_opt_(mipCount*arraySize) D3D12_SUBRESOURCE_DATA* initData,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap
+	DDSTextureUpload12& upload
 )
 {
 	if (device == nullptr)
@@ -1269,49 +1248,7 @@ static HRESULT CreateD3DResources12(
 		texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 		texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-		hr = device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
-			D3D12_RESOURCE_STATE_COMMON,
-			nullptr,
-			IID_PPV_ARGS(&texture)
-		);
-
-		if (FAILED(hr))
-		{
-			texture = nullptr;
-			return hr;
-		}
-		else
-		{
-			const UINT num2DSubresources = texDesc.DepthOrArraySize * texDesc.MipLevels;
-			const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, num2DSubresources);
-
-			hr = device->CreateCommittedResource(
-				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-				D3D12_HEAP_FLAG_NONE,
-				&CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-				D3D12_RESOURCE_STATE_GENERIC_READ,
-				nullptr,
-				IID_PPV_ARGS(&textureUploadHeap));
-			if (FAILED(hr))
-			{
-				texture = nullptr;
-				return hr;
-			}
-			else
-			{
-				cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
-					D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
-
-				// Use Heap-allocating UpdateSubresources implementation for variable number of subresources (which is the case for textures).
-				UpdateSubresources(cmdList, texture.Get(), textureUploadHeap.Get(), 0, 0, num2DSubresources, initData);
-
-				cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
-					D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-			}
-		}
+		hr = PrepareTextureUpload12(device, texDesc, initData, upload);
 	} break;
 	}
 
@@ -1671,14 +1608,12 @@ static HRESULT CreateTextureFromDDS(_In_ ID3D11Device* d3dDevice,
 
 static HRESULT CreateTextureFromDDS12(
 	_In_ ID3D12Device* device,
-	_In_opt_ ID3D12GraphicsCommandList* cmdList,
 	_In_ const DDS_HEADER* header,
 	_In_reads_bytes_(bitSize) const uint8_t* bitData,
 	_In_ size_t bitSize,
 	_In_ size_t maxsize,
 	_In_ bool forceSRGB,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	DDSTextureUpload12& upload)
 {
 	HRESULT hr = S_OK;
 
@@ -1690,6 +1625,8 @@ static HRESULT CreateTextureFromDDS12(
 	UINT arraySize = 1;
 	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
 	bool isCubeMap = false;
+	bool convert = false;
+	PixelConvert::Source convertSource = PixelConvert::Source::RGB8;
 
 	size_t mipCount = header->mipMapCount;
 	if (0 == mipCount) mipCount = 1;
@@ -1760,7 +1697,15 @@ static HRESULT CreateTextureFromDDS12(
 	}
 	else
 	{
-		format = GetDXGIFormat(header->ddspf);
+		if (GetLegacyConversion(device, header->ddspf, convertSource))
+		{
+			convert = true;
+			format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+		else
+		{
+			format = GetDXGIFormat(header->ddspf);
+		}
 
 		if (format == DXGI_FORMAT_UNKNOWN)
 			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
@@ -1845,6 +1790,17 @@ static HRESULT CreateTextureFromDDS12(
 		return E_OUTOFMEMORY;
 	}
 
+	// Legacy surfaces are tightly packed, like RGBA8, so the whole chain converts as one run.
+	std::vector<uint8_t> converted;
+	if (convert)
+	{
+		size_t pixels = bitSize / PixelConvert::GetSourceBytes(convertSource);
+		converted.resize(pixels * 4);
+		PixelConvert::ToRGBA8(convertSource, bitData, converted.data(), pixels);
+		bitData = converted.data();
+		bitSize = converted.size();
+	}
+
 	size_t skipMip = 0;
 	size_t twidth = 0;
 	size_t theight = 0;
@@ -1858,7 +1814,7 @@ static HRESULT CreateTextureFromDDS12(
 	if (SUCCEEDED(hr))
 	{
 		hr = CreateD3DResources12(
-			device, cmdList,
+			device,
 			resDim, twidth, theight, tdepth,
 			mipCount - skipMip,
 			arraySize,
@@ -1866,8 +1822,7 @@ static HRESULT CreateTextureFromDDS12(
 			false, // forceSRGB
 			isCubeMap,
 			initData.get(),
-			texture,
-			textureUploadHeap);
+			upload);
 	}
 
 	return hr;
@@ -1918,13 +1873,11 @@ HRESULT DirectX::CreateDDSTextureFromMemory(ID3D11Device* d3dDevice,
 }
 
 _Use_decl_annotations_
-HRESULT DirectX::CreateDDSTextureFromMemory12(
+HRESULT DirectX::PrepareDDSTextureFromMemory12(
 	ID3D12Device* device,
-	_In_ ID3D12GraphicsCommandList* cmdList,
 	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
 	_In_ size_t ddsDataSize,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap,
+	DDSTextureUpload12& upload,
 	_In_ size_t maxsize,
 	_Out_opt_ DDS_ALPHA_MODE* alphaMode
 )
@@ -1932,7 +1885,7 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 	if (alphaMode)
 		(*alphaMode) = DDS_ALPHA_MODE_UNKNOWN;
 
-	if (!device || !cmdList || !ddsData || !ddsDataSize)
+	if (!device || !ddsData || !ddsDataSize)
 	{
 		return E_INVALIDARG;
 	}
@@ -1972,14 +1925,12 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 
 	HRESULT hr = CreateTextureFromDDS12(
 		device,
-		cmdList,
 		header,
 		ddsData + offset,
 		ddsDataSize - offset,
 		maxsize,
 		false,
-		texture,
-		textureUploadHeap
+		upload
 	);
 
 	if (SUCCEEDED(hr))
@@ -1991,6 +1942,107 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 	return hr;
 }
 
+HRESULT DirectX::PrepareTextureUpload12(
+	_In_ ID3D12Device* device,
+	_In_ const D3D12_RESOURCE_DESC& texDesc,
+	_In_ const D3D12_SUBRESOURCE_DATA* initData,
+	DDSTextureUpload12& upload)
+{
+	upload = DDSTextureUpload12();
+
+	// Created straight in COPY_DEST, RecordDDSTextureUpload12 moves it on.
+	HRESULT hr = device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&upload.Texture)
+	);
+	if (FAILED(hr))
+		return hr;
+
+	const UINT num2DSubresources = texDesc.DepthOrArraySize * texDesc.MipLevels;
+	std::vector<UINT> numRows(num2DSubresources);
+	std::vector<UINT64> rowSizes(num2DSubresources);
+	UINT64 uploadBufferSize = 0;
+	upload.Layouts.resize(num2DSubresources);
+	device->GetCopyableFootprints(&texDesc, 0, num2DSubresources, 0,
+		upload.Layouts.data(), numRows.data(), rowSizes.data(), &uploadBufferSize);
+
+	hr = device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&upload.UploadHeap));
+
+	// The CPU half of UpdateSubresources; the copies are recorded later.
+	BYTE* pData = nullptr;
+	if (SUCCEEDED(hr))
+		hr = upload.UploadHeap->Map(0, nullptr, reinterpret_cast<void**>(&pData));
+	if (FAILED(hr))
+	{
+		upload = DDSTextureUpload12();
+		return hr;
+	}
+	for (UINT i = 0; i < num2DSubresources; ++i)
+	{
+		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = upload.Layouts[i];
+		D3D12_MEMCPY_DEST destData = { pData + layout.Offset, layout.Footprint.RowPitch, SIZE_T(layout.Footprint.RowPitch) * SIZE_T(numRows[i]) };
+		MemcpySubresource(&destData, &initData[i], static_cast<SIZE_T>(rowSizes[i]), numRows[i], layout.Footprint.Depth);
+	}
+	upload.UploadHeap->Unmap(0, nullptr);
+	return S_OK;
+}
+
+void DirectX::RecordDDSTextureCopies12(
+	_In_ ID3D12GraphicsCommandList* cmdList,
+	const DDSTextureUpload12& upload)
+{
+	for (UINT i = 0; i < (UINT)upload.Layouts.size(); ++i)
+	{
+		CD3DX12_TEXTURE_COPY_LOCATION dst(upload.Texture.Get(), i);
+		CD3DX12_TEXTURE_COPY_LOCATION src(upload.UploadHeap.Get(), upload.Layouts[i]);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+}
+
+void DirectX::RecordDDSTextureUpload12(
+	_In_ ID3D12GraphicsCommandList* cmdList,
+	const DDSTextureUpload12& upload)
+{
+	RecordDDSTextureCopies12(cmdList, upload);
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(upload.Texture.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+}
+
+HRESULT DirectX::CreateDDSTextureFromMemory12(
+	ID3D12Device* device,
+	_In_ ID3D12GraphicsCommandList* cmdList,
+	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+	_In_ size_t ddsDataSize,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	_In_ size_t maxsize,
+	_Out_opt_ DDS_ALPHA_MODE* alphaMode
+)
+{
+	if (!cmdList)
+		return E_INVALIDARG;
+
+	DDSTextureUpload12 upload;
+	HRESULT hr = PrepareDDSTextureFromMemory12(device, ddsData, ddsDataSize, upload, maxsize, alphaMode);
+	if (SUCCEEDED(hr))
+	{
+		RecordDDSTextureUpload12(cmdList, upload);
+		texture = upload.Texture;
+		textureUploadHeap = upload.UploadHeap;
+	}
+	return hr;
+}
+
 _Use_decl_annotations_
 HRESULT DirectX::CreateDDSTextureFromMemory(ID3D11Device* d3dDevice,
 	ID3D11DeviceContext* d3dContext,
@@ -2164,15 +2216,22 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 	uint8_t* bitData = nullptr;
 	size_t bitSize = 0;
 
-	std::unique_ptr<uint8_t[]> ddsData;
-	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+	MappedFile ddsFile;
+	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsFile, &header, &bitData, &bitSize);
 	if (FAILED(hr))
 	{
 		return hr;
 	}
 
-	hr = CreateTextureFromDDS12(device, cmdList, header,
-		bitData, bitSize, maxsize, false, texture, textureUploadHeap);
+	DDSTextureUpload12 upload;
+	hr = CreateTextureFromDDS12(device, header,
+		bitData, bitSize, maxsize, false, upload);
+	if (SUCCEEDED(hr))
+	{
+		RecordDDSTextureUpload12(cmdList, upload);
+		texture = upload.Texture;
+		textureUploadHeap = upload.UploadHeap;
+	}
 
 	if (SUCCEEDED(hr))
 	{
@@ -2296,9 +2355,9 @@ HRESULT DirectX::CreateDDSTextureFromFileEx(ID3D11Device* d3dDevice,
 	uint8_t* bitData = nullptr;
 	size_t bitSize = 0;
 
-	std::unique_ptr<uint8_t[]> ddsData;
+	MappedFile ddsFile;
 	HRESULT hr = LoadTextureDataFromFile(fileName,
-		ddsData,
+		ddsFile,
 		&header,
 		&bitData,
 		&bitSize
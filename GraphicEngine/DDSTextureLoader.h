@@ -63,6 +63,39 @@ namespace DirectX
                                         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                       );
 
+	// A texture created in COPY_DEST plus an upload heap that already holds its data.
+	// Preparing only touches the device, so it can run on any thread; the copies are
+	// recorded later by whoever owns the command list.
+	struct DDSTextureUpload12
+	{
+		ComPtr<ID3D12Resource> Texture;
+		ComPtr<ID3D12Resource> UploadHeap;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Layouts;
+	};
+
+	HRESULT PrepareDDSTextureFromMemory12(_In_ ID3D12Device* device,
+		                                  _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+		                                  _In_ size_t ddsDataSize,
+		                                  _Out_ DDSTextureUpload12& upload,
+		                                  _In_ size_t maxsize = 0,
+		                                  _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+		                                  );
+
+	// Same for a texture described by hand, e.g. with generated mips.
+	// initData holds DepthOrArraySize * MipLevels entries, slice major.
+	HRESULT PrepareTextureUpload12(_In_ ID3D12Device* device,
+		                           _In_ const D3D12_RESOURCE_DESC& texDesc,
+		                           _In_ const D3D12_SUBRESOURCE_DATA* initData,
+		                           _Out_ DDSTextureUpload12& upload);
+
+	// Copies every subresource; the texture stays in COPY_DEST.
+	void RecordDDSTextureCopies12(_In_ ID3D12GraphicsCommandList* cmdList,
+		                          _In_ const DDSTextureUpload12& upload);
+
+	// Copies every subresource and transitions the texture to PIXEL_SHADER_RESOURCE.
+	void RecordDDSTextureUpload12(_In_ ID3D12GraphicsCommandList* cmdList,
+		                          _In_ const DDSTextureUpload12& upload);
+
 	HRESULT CreateDDSTextureFromMemory12(_In_ ID3D12Device* device,
 		                                 _In_ ID3D12GraphicsCommandList* cmdList,
 		                                 _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
@@ -1,71 +1,343 @@
 #include "DescriptorHeap.h"
 #include "GraphicEngine.h"
 
-void DescriptorHeap::CreateSrvDescriptorHeap(int size)
+void DescriptorFreeList::Reset(UINT capacity)
 {
-	SrvSize = size;
-	SrvIndex = -1;
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = size;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+	std::lock_guard<std::mutex> lock(mMutex);
+	mFree.clear();
+	if (capacity > 0)
+		mFree.push_back({ 0, capacity });
+	mCapacity = capacity;
+	mAllocated = 0;
+}
+
+void DescriptorFreeList::Grow(UINT newCapacity)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (newCapacity <= mCapacity)
+		return;
+
+	if (!mFree.empty() && mFree.back().Start + mFree.back().Count == mCapacity)
+		mFree.back().Count += newCapacity - mCapacity;
+	else
+		mFree.push_back({ mCapacity, newCapacity - mCapacity });
+	mCapacity = newCapacity;
+}
+
+int DescriptorFreeList::Allocate(UINT count)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (size_t i = 0; i < mFree.size(); ++i)
+	{
+		Range& range = mFree[i];
+		if (range.Count < count)
+			continue;
+
+		UINT start = range.Start;
+		range.Start += count;
+		range.Count -= count;
+		if (range.Count == 0)
+			mFree.erase(mFree.begin() + i);
+		mAllocated += count;
+		return (int)start;
+	}
+	return -1;
+}
+
+void DescriptorFreeList::Free(UINT start, UINT count)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto it = lower_bound(mFree.begin(), mFree.end(), start,
+		[](const Range& r, UINT value) { return r.Start < value; });
+	it = mFree.insert(it, { start, count });
+	mAllocated -= count;
+
+	// Merge with the following range, then with the preceding one.
+	auto next = it + 1;
+	if (next != mFree.end() && it->Start + it->Count == next->Start)
+	{
+		it->Count += next->Count;
+		mFree.erase(next);
+	}
+	if (it != mFree.begin())
+	{
+		auto prev = it - 1;
+		if (prev->Start + prev->Count == it->Start)
+		{
+			prev->Count += it->Count;
+			mFree.erase(it);
+		}
+	}
+}
+
+void DescriptorRing::Reset(UINT base, UINT capacity)
+{
+	mFrames.clear();
+	mBase = base;
+	mCapacity = capacity;
+	mHead = 0;
+	mTail = 0;
+}
+
+void DescriptorRing::Reclaim(UINT64 completedFence)
+{
+	while (!mFrames.empty() && mFrames.front().Fence <= completedFence)
+	{
+		mTail = mFrames.front().Head;
+		mFrames.pop_front();
+	}
+}
+
+int DescriptorRing::Allocate(UINT count, UINT64 completedFence)
+{
+	if (count == 0 || count > mCapacity)
+		return -1;
+
+	Reclaim(completedFence);
+
+	// A table has to be contiguous, so skip the tail end of the ring if it does not fit.
+	UINT offset = (UINT)(mHead % mCapacity);
+	UINT64 skip = offset + count > mCapacity ? mCapacity - offset : 0;
+	if (mHead + skip + count - mTail > mCapacity)
+		return -1;
+
+	mHead += skip;
+	int index = (int)(mBase + mHead % mCapacity);
+	mHead += count;
+	return index;
+}
+
+void DescriptorRing::EndFrame(UINT64 fenceValue)
+{
+	if (!mFrames.empty() && mFrames.back().Head == mHead)
+		return;
+	mFrames.push_back({ fenceValue, mHead });
+}
+
+DescriptorHeap::DescriptorHeap()
+{
+
+}
+
+ComPtr<ID3D12DescriptorHeap> DescriptorHeap::CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE type, UINT size, bool shaderVisible)
+{
+	ComPtr<ID3D12DescriptorHeap> heap;
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = size;
+	heapDesc.Type = type;
+	heapDesc.Flags = shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(GetEngine()->GetDevice()->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(heap.GetAddressOf())));
+	return heap;
+}
+
+void DescriptorHeap::CreateSrvDescriptorHeap(int size, int transientSize)
+{
+	mTransientSize = transientSize;
+	mSrvFreeList.Reset(size);
+	mSrvStagingHeap = CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, size, false);
+	RebuildVisibleHeap();
 }
 
 void DescriptorHeap::CreateRtvDescriptorHeap(int size)
 {
-	RtvSize = size;
-	RtvIndex = -1;
-	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
-	rtvHeapDesc.NumDescriptors = size;
-	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	rtvHeapDesc.NodeMask = 0;
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateDescriptorHeap(
-		&rtvHeapDesc, IID_PPV_ARGS(mRtvDescriptorHeap.GetAddressOf())));
+	mRtvFreeList.Reset(size);
+	mRtvDescriptorHeap = CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, size, false);
 }
 
 void DescriptorHeap::CreateDsvDescriptorHeap(int size)
 {
-	DsvSize = size;
-	DsvIndex = -1;
-	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
-	dsvHeapDesc.NumDescriptors = size;
-	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-	dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	dsvHeapDesc.NodeMask = 0;
-	ThrowIfFailed(GetEngine()->GetDevice()->CreateDescriptorHeap(
-		&dsvHeapDesc, IID_PPV_ARGS(mDsvDescriptorHeap.GetAddressOf())));
+	mDsvFreeList.Reset(size);
+	mDsvDescriptorHeap = CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, size, false);
+}
+
+void DescriptorHeap::GrowCpuHeap(ComPtr<ID3D12DescriptorHeap>& heap, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT oldSize, UINT newSize)
+{
+	ComPtr<ID3D12DescriptorHeap> newHeap = CreateHeap(type, newSize, false);
+	// Descriptors are copied by value, so the old CPU-only heap can go right away.
+	if (oldSize > 0)
+	{
+		GetEngine()->GetDevice()->CopyDescriptorsSimple(oldSize,
+			newHeap->GetCPUDescriptorHandleForHeapStart(), heap->GetCPUDescriptorHandleForHeapStart(), type);
+	}
+	heap = newHeap;
+}
+
+int DescriptorHeap::Allocate(DescriptorFreeList& freeList, ComPtr<ID3D12DescriptorHeap>& heap, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT count)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	int index = freeList.Allocate(count);
+	if (index >= 0)
+		return index;
+
+	UINT oldSize = freeList.GetCapacity();
+	UINT newSize = max(oldSize * 2, oldSize + count);
+	GrowCpuHeap(heap, type, oldSize, newSize);
+	freeList.Grow(newSize);
+	return freeList.Allocate(count);
+}
+
+void DescriptorHeap::DeferFree(DescriptorFreeList& freeList, int index, UINT count)
+{
+	if (index < 0 || count == 0)
+		return;
+
+	GpuTimeline* timeline = GetEngine()->GetTimeline();
+	DescriptorFreeList* list = &freeList;
+	timeline->OnCompletion(timeline->GetLastSignaledValue() + 1, [list, index, count]()
+	{
+		list->Free(index, count);
+	});
+}
+
+int DescriptorHeap::AllocateSrv(UINT count)
+{
+	int index = Allocate(mSrvFreeList, mSrvStagingHeap, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, count);
+	MarkSrvDirty(index, count);
+	return index;
+}
+
+int DescriptorHeap::AllocateRtv(UINT count)
+{
+	return Allocate(mRtvFreeList, mRtvDescriptorHeap, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, count);
+}
+
+int DescriptorHeap::AllocateDsv(UINT count)
+{
+	return Allocate(mDsvFreeList, mDsvDescriptorHeap, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, count);
 }
 
 int DescriptorHeap::SetDsvDescriptorIndex()
 {
-	return ++DsvIndex;
+	return AllocateDsv(1);
 }
 
 int DescriptorHeap::SetSrvDescriptorIndex()
 {
-	return ++SrvIndex;
+	return AllocateSrv(1);
 }
 
 int DescriptorHeap::SetRtvDescriptorIndex()
 {
-	return ++RtvIndex;
+	return AllocateRtv(1);
+}
+
+void DescriptorHeap::FreeSrv(int index, UINT count)
+{
+	DeferFree(mSrvFreeList, index, count);
+}
+
+void DescriptorHeap::FreeRtv(int index, UINT count)
+{
+	DeferFree(mRtvFreeList, index, count);
+}
+
+void DescriptorHeap::FreeDsv(int index, UINT count)
+{
+	DeferFree(mDsvFreeList, index, count);
+}
+
+int DescriptorHeap::AllocateTransientSrv(UINT count)
+{
+	GpuTimeline* timeline = GetEngine()->GetTimeline();
+	std::unique_lock<std::mutex> lock(mMutex);
+	int index = mSrvRing.Allocate(count, timeline->GetCompletedValue());
+	while (index < 0 && mSrvRing.GetOldestFence() != 0)
+	{
+		// Ring is full of frames still in flight: wait for the oldest one.
+		UINT64 oldest = mSrvRing.GetOldestFence();
+		lock.unlock();
+		timeline->Wait(oldest);
+		lock.lock();
+		index = mSrvRing.Allocate(count, timeline->GetCompletedValue());
+	}
+	if (index < 0)
+	{
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+	return index;
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::CopyToTransientSrv(const int* srvIndices, UINT count)
+{
+	int index = AllocateTransientSrv(count);
+	D3D12_CPU_DESCRIPTOR_HANDLE dest = GetSrvVisibleCpuHandle(index);
+	UINT destCount = count;
+	// The staging heap may be swapped by a loader growing it, hold it while copying.
+	std::lock_guard<std::mutex> lock(mMutex);
+	vector<D3D12_CPU_DESCRIPTOR_HANDLE> src(count);
+	for (UINT i = 0; i < count; ++i)
+		src[i] = CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvStagingHeap->GetCPUDescriptorHandleForHeapStart(), srvIndices[i], GetEngine()->mCbvSrvUavDescriptorSize);
+	// One destination range, count single-descriptor source ranges.
+	GetEngine()->GetDevice()->CopyDescriptors(1, &dest, &destCount, count, src.data(), nullptr,
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	return GetSrvDescriptorGpuHandle(index);
 }
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetSrvDescriptorCpuHandle()
+void DescriptorHeap::MarkSrvDirty(UINT start, UINT count)
 {
-	return GetSrvDescriptorCpuHandle(SetSrvDescriptorIndex());
+	std::lock_guard<std::mutex> lock(mMutex);
+	mDirtyRanges.push_back({ start, count });
 }
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetRtvDescriptorCpuHandle()
+void DescriptorHeap::RebuildVisibleHeap()
 {
-	return GetRtvDescriptorCpuHandle(SetRtvDescriptorIndex());
+	UINT persistentSize = mSrvFreeList.GetCapacity();
+	if (mSrvDescriptorHeap != nullptr)
+	{
+		// Frames in flight may still reference the old heap.
+		ComPtr<ID3D12DescriptorHeap> oldHeap = mSrvDescriptorHeap;
+		GpuTimeline* timeline = GetEngine()->GetTimeline();
+		timeline->OnCompletion(timeline->GetLastSignaledValue() + 1, [oldHeap]() {});
+	}
+
+	mSrvDescriptorHeap = CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, persistentSize + mTransientSize, true);
+	mVisiblePersistentSize = persistentSize;
+
+	// Nothing reads the new heap yet, so all of it is filled in one copy.
+	std::lock_guard<std::mutex> lock(mMutex);
+	mSrvRing.Reset(persistentSize, mTransientSize);
+	mDirtyRanges.clear();
+	mDirtyRanges.push_back({ 0, persistentSize });
+}
+
+void DescriptorHeap::CommitSrvDescriptors()
+{
+	if (mVisiblePersistentSize != mSrvFreeList.GetCapacity())
+		RebuildVisibleHeap();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mDirtyRanges.empty())
+		return;
+
+	// Merge ranges that overlap or touch, never across a gap.
+	sort(mDirtyRanges.begin(), mDirtyRanges.end(), [](const DirtyRange& a, const DirtyRange& b) { return a.Start < b.Start; });
+	UINT begin = mDirtyRanges[0].Start;
+	UINT end = begin;
+	for (size_t i = 0; i <= mDirtyRanges.size(); ++i)
+	{
+		if (i < mDirtyRanges.size() && mDirtyRanges[i].Start <= end)
+		{
+			end = max(end, mDirtyRanges[i].Start + mDirtyRanges[i].Count);
+			continue;
+		}
+		GetEngine()->GetDevice()->CopyDescriptorsSimple(end - begin,
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), begin, GetEngine()->mCbvSrvUavDescriptorSize),
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvStagingHeap->GetCPUDescriptorHandleForHeapStart(), begin, GetEngine()->mCbvSrvUavDescriptorSize),
+			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		if (i < mDirtyRanges.size())
+		{
+			begin = mDirtyRanges[i].Start;
+			end = begin + mDirtyRanges[i].Count;
+		}
+	}
+	mDirtyRanges.clear();
 }
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetDsvDescriptorCpuHandle()
+void DescriptorHeap::EndFrame(UINT64 fenceValue)
 {
-	return GetDsvDescriptorCpuHandle(SetDsvDescriptorIndex());
+	std::lock_guard<std::mutex> lock(mMutex);
+	mSrvRing.EndFrame(fenceValue);
 }
 
 CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GetSrvDescriptorGpuHandle(int offset)
@@ -77,14 +349,17 @@ CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GetSrvDescriptorGpuHandle(int offs
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetSrvDescriptorCpuHandle(int offset)
 {
-	CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	// Handing out the handle means the caller is about to write through it.
+	MarkSrvDirty(offset, 1);
+	std::lock_guard<std::mutex> lock(mMutex);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(mSrvStagingHeap->GetCPUDescriptorHandleForHeapStart());
 	descriptor.Offset(offset, GetEngine()->mCbvSrvUavDescriptorSize);
 	return descriptor;
 }
 
-CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GetRtvDescriptorGpuHandle(int offset)
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetSrvVisibleCpuHandle(int offset)
 {
-	CD3DX12_GPU_DESCRIPTOR_HANDLE descriptor(mRtvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 	descriptor.Offset(offset, GetEngine()->mCbvSrvUavDescriptorSize);
 	return descriptor;
 }
@@ -96,24 +371,9 @@ CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetRtvDescriptorCpuHandle(int offs
 	return descriptor;
 }
 
-CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GetDsvDescriptorGpuHandle(int offset)
-{
-	CD3DX12_GPU_DESCRIPTOR_HANDLE descriptor(mDsvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	descriptor.Offset(offset, GetEngine()->mDsvDescriptorSize);
-	return descriptor;
-}
-
 CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetDsvDescriptorCpuHandle(int offset)
 {
 	CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(mDsvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-	descriptor.Offset(offset, GetEngine()->mCbvSrvUavDescriptorSize);
+	descriptor.Offset(offset, GetEngine()->mDsvDescriptorSize);
 	return descriptor;
 }
-
-DescriptorHeap::DescriptorHeap()
-{
-
-}
-
-
-
@@ -1,40 +1,159 @@
 #pragma once
 #include "framework.h"
+#include <deque>
+#include <mutex>
 
+// First-fit allocator over descriptor slots [0, capacity). Free ranges are kept
+// sorted and merged with their neighbours, so a released texture table can be
+// handed out again as one contiguous run.
+class DescriptorFreeList
+{
+public:
+	void Reset(UINT capacity);
+	// Makes [capacity, newCapacity) available.
+	void Grow(UINT newCapacity);
+
+	// Returns the first slot of count contiguous descriptors, or -1 if no run is large enough.
+	int Allocate(UINT count);
+	void Free(UINT start, UINT count);
+
+	UINT GetCapacity() const { return mCapacity; }
+	UINT GetAllocatedCount() const { return mAllocated; }
+
+private:
+	struct Range
+	{
+		UINT Start;
+		UINT Count;
+	};
+
+	std::mutex mMutex;
+	vector<Range> mFree;
+	UINT mCapacity = 0;
+	UINT mAllocated = 0;
+};
+
+// Descriptors that only live for one frame. Allocation is a pointer bump; a
+// frame's block is given back once the GPU passed the fence it was submitted with.
+class DescriptorRing
+{
+public:
+	void Reset(UINT base, UINT capacity);
+
+	// Returns an absolute heap index, or -1 when the in-flight frames still hold the space.
+	int Allocate(UINT count, UINT64 completedFence);
+	// Everything allocated since the previous call belongs to fenceValue.
+	void EndFrame(UINT64 fenceValue);
+	// Fence the oldest unreclaimed frame is waiting on, 0 if none.
+	UINT64 GetOldestFence() const { return mFrames.empty() ? 0 : mFrames.front().Fence; }
+
+	UINT GetCapacity() const { return mCapacity; }
+	UINT GetUsedCount() const { return (UINT)(mHead - mTail); }
+
+private:
+	void Reclaim(UINT64 completedFence);
+
+	struct FrameMark
+	{
+		UINT64 Fence;
+		UINT64 Head;
+	};
+
+	std::deque<FrameMark> mFrames;
+	UINT mBase = 0;
+	UINT mCapacity = 0;
+	// Monotonic counters, the ring position is value % mCapacity.
+	UINT64 mHead = 0;
+	UINT64 mTail = 0;
+};
+
+// CBV/SRV/UAV descriptors are written into a CPU-only staging heap and copied into
+// the single shader visible heap by CommitSrvDescriptors, which runs once per frame
+// before the heap is bound. The visible heap holds the persistent descriptors at
+// [0, persistent capacity) followed by the transient ring. Every heap grows on demand:
+// staging, RTV and DSV heaps are recreated and copied right away, the visible heap
+// is recreated on the next commit and the old one is released through the timeline.
+// Loader threads allocate and write persistent descriptors; the transient ring and
+// the commit belong to the render thread.
 class DescriptorHeap
 {
 public:
 	DescriptorHeap();
-	void CreateSrvDescriptorHeap(int size);
+	void CreateSrvDescriptorHeap(int size, int transientSize = 256);
 	void CreateRtvDescriptorHeap(int size);
 	void CreateDsvDescriptorHeap(int size);
+
+	// Persistent allocation of count contiguous descriptors; the Set versions take
+	// one slot. Views that are bound as a range must come from a single call.
+	int AllocateSrv(UINT count);
+	int AllocateRtv(UINT count);
+	int AllocateDsv(UINT count);
 	int SetDsvDescriptorIndex();
 	int SetSrvDescriptorIndex();
 	int SetRtvDescriptorIndex();
-	CD3DX12_CPU_DESCRIPTOR_HANDLE GetSrvDescriptorCpuHandle();
-	CD3DX12_CPU_DESCRIPTOR_HANDLE GetRtvDescriptorCpuHandle();
-	CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsvDescriptorCpuHandle();
+	// Shader visible slots may still be read by frames in flight, so they only
+	// return to the free list once the GPU passed the next signal.
+	void FreeSrv(int index, UINT count = 1);
+	void FreeRtv(int index, UINT count = 1);
+	void FreeDsv(int index, UINT count = 1);
+
+	// Per-frame descriptors in the visible heap, written directly (no staging).
+	int AllocateTransientSrv(UINT count);
+	// Gathers the given persistent SRVs into one contiguous transient table,
+	// valid for the frame being recorded.
+	CD3DX12_GPU_DESCRIPTOR_HANDLE CopyToTransientSrv(const int* srvIndices, UINT count);
+	// Publishes persistent writes to the visible heap. Call before SetDescriptorHeaps.
+	void CommitSrvDescriptors();
+	// Closes the current transient block against the fence of the frame just submitted.
+	void EndFrame(UINT64 fenceValue);
+
 	CD3DX12_GPU_DESCRIPTOR_HANDLE GetSrvDescriptorGpuHandle(int offset);
+	// Staging handle: writes through it become visible after the next commit.
 	CD3DX12_CPU_DESCRIPTOR_HANDLE GetSrvDescriptorCpuHandle(int offset);
-	CD3DX12_GPU_DESCRIPTOR_HANDLE GetRtvDescriptorGpuHandle(int offset);
+	// Handle into the visible heap, only meaningful for transient slots.
+	CD3DX12_CPU_DESCRIPTOR_HANDLE GetSrvVisibleCpuHandle(int offset);
 	CD3DX12_CPU_DESCRIPTOR_HANDLE GetRtvDescriptorCpuHandle(int offset);
-	CD3DX12_GPU_DESCRIPTOR_HANDLE GetDsvDescriptorGpuHandle(int offset);
 	CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsvDescriptorCpuHandle(int offset);
 	ID3D12DescriptorHeap* GetSrvDescHeap() { return mSrvDescriptorHeap.Get(); }
 	ID3D12DescriptorHeap* GetRtvDescHeap() { return mRtvDescriptorHeap.Get(); }
 	ID3D12DescriptorHeap* GetDsvDescHeap() { return mDsvDescriptorHeap.Get(); }
-	int GetSrvDescriptorIndex() { return SrvIndex; }
-	int GetRtvDescriptorIndex() { return RtvIndex; }
-	int GetDsvDescriptorIndex() { return DsvIndex; }
+
+	UINT GetSrvCapacity() const { return mSrvFreeList.GetCapacity(); }
+	UINT GetSrvAllocatedCount() const { return mSrvFreeList.GetAllocatedCount(); }
+	UINT GetTransientUsedCount() { std::lock_guard<std::mutex> lock(mMutex); return mSrvRing.GetUsedCount(); }
 
 private:
+	ComPtr<ID3D12DescriptorHeap> CreateHeap(D3D12_DESCRIPTOR_HEAP_TYPE type, UINT size, bool shaderVisible);
+	// Recreates a CPU-only heap with newSize slots and copies the first oldSize over.
+	void GrowCpuHeap(ComPtr<ID3D12DescriptorHeap>& heap, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT oldSize, UINT newSize);
+	int Allocate(DescriptorFreeList& freeList, ComPtr<ID3D12DescriptorHeap>& heap, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT count);
+	void DeferFree(DescriptorFreeList& freeList, int index, UINT count);
+	void MarkSrvDirty(UINT start, UINT count);
+	void RebuildVisibleHeap();
+
+	// Shader visible heap: persistent mirror + transient ring.
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
+	// CPU-only source of the persistent range.
+	ComPtr<ID3D12DescriptorHeap> mSrvStagingHeap = nullptr;
 	ComPtr<ID3D12DescriptorHeap> mRtvDescriptorHeap = nullptr;
 	ComPtr<ID3D12DescriptorHeap> mDsvDescriptorHeap = nullptr;
-	int SrvSize;
-	int SrvIndex;
-	int RtvSize;
-	int RtvIndex;
-	int DsvSize;
-	int DsvIndex;
+
+	DescriptorFreeList mSrvFreeList;
+	DescriptorFreeList mRtvFreeList;
+	DescriptorFreeList mDsvFreeList;
+	DescriptorRing mSrvRing;
+
+	// Persistent capacity the visible heap was built for.
+	UINT mVisiblePersistentSize = 0;
+	UINT mTransientSize = 0;
+	struct DirtyRange
+	{
+		UINT Start;
+		UINT Count;
+	};
+	// Staging slots written since the last commit. Only these are copied, the
+	// slots between them may be read by frames in flight.
+	vector<DirtyRange> mDirtyRanges;
+	// Guards the staging heaps while they grow, mDirtyRanges and mSrvRing.
+	std::mutex mMutex;
 };
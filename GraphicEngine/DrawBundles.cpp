@@ -0,0 +1,59 @@
+#include "DrawBundles.h"
+
+ID3D12GraphicsCommandList* DrawBundles::Get(const Key& key, const Recorder& record)
+{
+	Bundle* bundle;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		unique_ptr<Bundle>& entry = mBundles[key];
+		if (entry == nullptr)
+			entry = make_unique<Bundle>();
+		bundle = entry.get();
+	}
+
+	UINT64 version = mVersion.load();
+	if (bundle->Version == version)
+	{
+		++mReplayed;
+		return bundle->List.Get();
+	}
+
+	HRESULT hr = S_OK;
+	if (bundle->List == nullptr)
+	{
+		// A new list starts out open.
+		hr = mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(bundle->Allocator.GetAddressOf()));
+		if (SUCCEEDED(hr))
+		{
+			hr = mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, bundle->Allocator.Get(), key.Pso,
+				IID_PPV_ARGS(bundle->List.GetAddressOf()));
+		}
+	}
+	else
+	{
+		// Last executed by the previous use of key.Frame, which the GPU is past.
+		hr = bundle->Allocator->Reset();
+		if (SUCCEEDED(hr))
+			hr = bundle->List->Reset(bundle->Allocator.Get(), key.Pso);
+	}
+	if (FAILED(hr))
+		return nullptr;
+
+	// Root arguments the bundle does not set come from the list that executes
+	// it, as long as the recorder sets the same root signature.
+	record(bundle->List.Get());
+	if (FAILED(bundle->List->Close()))
+	{
+		bundle->Version = 0;
+		return nullptr;
+	}
+	bundle->Version = version;
+	++mRecorded;
+	return bundle->List.Get();
+}
+
+void DrawBundles::TakeCounts(size_t* recorded, size_t* replayed)
+{
+	*recorded = mRecorded.exchange(0);
+	*replayed = mReplayed.exchange(0);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "framework.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+// Bundles for draw lists that are the same every frame. A bundle is recorded
+// the first time its key is asked for and replayed after that, until
+// Invalidate says the items or what they bind changed. Keys carry the frame
+// resource index, since the constants a bundle points at are per frame; a
+// stale bundle is therefore only recorded again once the GPU is past the
+// frame that last executed it.
+class DrawBundles
+{
+public:
+	typedef std::function<void(ID3D12GraphicsCommandList*)> Recorder;
+
+	struct Key
+	{
+		ID3D12PipelineState* Pso;
+		int Layer;
+		size_t Begin;
+		size_t End;
+		int Frame;
+		bool operator==(const Key& other) const
+		{
+			return Pso == other.Pso && Layer == other.Layer && Begin == other.Begin && End == other.End && Frame == other.Frame;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			size_t hash = std::hash<void*>()(key.Pso);
+			hash = hash * 31 + key.Layer;
+			hash = hash * 31 + key.Begin;
+			hash = hash * 31 + key.End;
+			return hash * 31 + key.Frame;
+		}
+	};
+
+	DrawBundles() : mVersion(1), mRecorded(0), mReplayed(0) {}
+	void Init(ID3D12Device* device) { mDevice = device; }
+	// Every bundle is recorded again the next time it is used.
+	void Invalidate() { ++mVersion; }
+	// The bundle of key, recorded through record on key.Pso if it is missing or
+	// stale. Null if a bundle could not be made; the caller then draws directly.
+	// Different threads may ask for different keys at once.
+	ID3D12GraphicsCommandList* Get(const Key& key, const Recorder& record);
+	// Bundles recorded and replayed since the last call.
+	void TakeCounts(size_t* recorded, size_t* replayed);
+
+private:
+	struct Bundle
+	{
+		ComPtr<ID3D12CommandAllocator> Allocator;
+		ComPtr<ID3D12GraphicsCommandList> List;
+		// mVersion when recorded, 0 while it has never been.
+		UINT64 Version = 0;
+	};
+
+	ID3D12Device* mDevice = nullptr;
+	std::atomic<UINT64> mVersion;
+	// Entries are never removed, so a Bundle stays where it is once created.
+	std::mutex mMutex;
+	unordered_map<Key, unique_ptr<Bundle>, KeyHash> mBundles;
+	std::atomic<size_t> mRecorded;
+	std::atomic<size_t> mReplayed;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include "framework.h"
+#include "RenderItem.h"
+#include "Camera.h"
+#include "GameTimer.h"
+#include <chrono>
+
+// Per frame state of a render item; the rest of the item does not change once
+// it is loaded.
+struct ItemState
+{
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 TexTransform;
+};
+
+// One simulated frame, all the render thread reads of the game's state. The game
+// thread fills it and does not touch it again until the render thread is done
+// with it, so rendering never sees the scene halfway through an update.
+struct FramePacket
+{
+	UINT64 Frame = 0;
+	// The clock as of this frame.
+	GameTimer Timer;
+	Camera View;
+	XMFLOAT4 AmbientLight;
+	Light Lights[MaxLights];
+	// Per layer, in the order of the engine's render items. Nothing is culled
+	// yet, so every item is visible.
+	vector<ItemState> Items[(int)RenderLayer::Count];
+	// When input was sampled, for the input to present latency.
+	std::chrono::steady_clock::time_point InputTime;
+};
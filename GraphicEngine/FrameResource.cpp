@@ -1,32 +1,91 @@
 #include "FrameResource.h"
 #include "GraphicEngine.h"
-
-
-//const int gNumFrameResources = 3;
+#include <chrono>
 
 FrameResource::FrameResource()
 {
 
 }
 
-void FrameResource::Init()
+void FrameResource::Init(int count)
 {
-	for (int i = 0; i != gNumFrameResources; ++i)
+	mCount = count;
+	CmdListAlloc.resize(count);
+	Fence.assign(count, 0);
+	for (int i = 0; i != count; ++i)
 	{
 		ThrowIfFailed(GetEngine()->GetDevice()->CreateCommandAllocator(
 			D3D12_COMMAND_LIST_TYPE_DIRECT,
 			IID_PPV_ARGS(CmdListAlloc[i].GetAddressOf())));
 	}
+
+	D3D12_QUERY_HEAP_DESC queryDesc = {};
+	queryDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryDesc.Count = 2 * count;
+	ThrowIfFailed(GetEngine()->GetDevice()->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(&mTimestamps)));
+	ThrowIfFailed(GetEngine()->GetDevice()->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(2 * count * sizeof(UINT64)),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&mTimestampReadback)));
+	ThrowIfFailed(GetEngine()->GetCommandQueue()->GetTimestampFrequency(&mTimestampFrequency));
 }
 
 FrameResource::~FrameResource()
 {
-	
+
+}
+
+void FrameResource::Begin()
+{
+	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % mCount;
+
+	// Has the GPU finished processing the commands of the current frame resource?
+	// If not, wait until the GPU has completed commands up to this fence point.
+	auto start = std::chrono::steady_clock::now();
+	GetEngine()->GetTimeline()->Wait(GetFence());
+	mStats.CpuWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	ReadTimestamps();
+}
+
+void FrameResource::ReadTimestamps()
+{
+	// Nothing was recorded with this frame resource yet.
+	if (GetFence() == 0)
+		return;
+
+	UINT64 first = 2 * mCurrFrameResourceIndex;
+	D3D12_RANGE range = { first * sizeof(UINT64), (first + 2) * sizeof(UINT64) };
+	UINT64* data = nullptr;
+	ThrowIfFailed(mTimestampReadback->Map(0, &range, reinterpret_cast<void**>(&data)));
+	UINT64 begin = data[first];
+	UINT64 end = data[first + 1];
+	D3D12_RANGE written = { 0, 0 };
+	mTimestampReadback->Unmap(0, &written);
+
+	// Frames finish in order, so this one started after the last one read ended,
+	// unless the GPU was already busy with it.
+	double msPerTick = 1000.0 / mTimestampFrequency;
+	if (mLastGpuEnd != 0 && begin > mLastGpuEnd)
+		mStats.GpuIdleMs += (begin - mLastGpuEnd) * msPerTick;
+	mStats.GpuBusyMs += (end - begin) * msPerTick;
+	mLastGpuEnd = end;
+	++mStats.Frames;
 }
 
-void FrameResource::Update()
+void FrameResource::WriteStartTimestamp(ID3D12GraphicsCommandList* cmdList)
 {
-	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
+	cmdList->EndQuery(mTimestamps.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * mCurrFrameResourceIndex);
+}
+
+void FrameResource::WriteEndTimestamp(ID3D12GraphicsCommandList* cmdList)
+{
+	UINT first = 2 * mCurrFrameResourceIndex;
+	cmdList->EndQuery(mTimestamps.Get(), D3D12_QUERY_TYPE_TIMESTAMP, first + 1);
+	cmdList->ResolveQueryData(mTimestamps.Get(), D3D12_QUERY_TYPE_TIMESTAMP, first, 2,
+		mTimestampReadback.Get(), first * sizeof(UINT64));
 }
 
 ComPtr<ID3D12CommandAllocator> FrameResource::GetCurrentCommandAllocator()
@@ -34,3 +93,9 @@ ComPtr<ID3D12CommandAllocator> FrameResource::GetCurrentCommandAllocator()
 	return CmdListAlloc[mCurrFrameResourceIndex];
 }
 
+FrameResource::Stats FrameResource::TakeStats()
+{
+	Stats stats = mStats;
+	mStats = Stats();
+	return stats;
+}
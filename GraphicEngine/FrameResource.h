@@ -4,34 +4,66 @@
 #include "MathHelper.h"
 #include "UploadBuffer.h"
 
-const int gNumFrameResources = 3;
-// Stores the resources needed for the CPU to build the command lists
-// for a frame.  
+// Upper bound of frames in flight; the count itself is picked at startup.
+const int MaxFrameResources = 3;
 
+// The frames the CPU may record while the GPU still executes earlier ones, and
+// everything that has to exist once per such frame: command allocators, the
+// fence each frame signalled, and the constant buffers that index by
+// GetIndex. It also times the GPU work of every frame, so how much the CPU
+// waited and the GPU idled shows up for any count.
 class FrameResource
 {
 public:
+	struct Stats
+	{
+		size_t Frames = 0;
+		// Blocked in Begin for the frame's previous use to finish.
+		double CpuWaitMs = 0.0;
+		// Between the end of one frame's GPU work and the start of the next.
+		double GpuIdleMs = 0.0;
+		double GpuBusyMs = 0.0;
+	};
 
 	FrameResource();
 	~FrameResource();
-	void Init();
+	void Init(int count);
 
-	// We cannot reset the allocator until the GPU is done processing the commands.
-	// So each frame needs their own allocator.
+	int GetCount() const { return mCount; }
+	int GetIndex() const { return mCurrFrameResourceIndex; }
+
+	// Moves to the next frame and waits until the GPU is done with its
+	// previous use, so its allocator and constants may be overwritten.
+	void Begin();
+	// First and last command of the frame on the GPU, for GetStats.
+	void WriteStartTimestamp(ID3D12GraphicsCommandList* cmdList);
+	void WriteEndTimestamp(ID3D12GraphicsCommandList* cmdList);
 
 	UINT64 GetFence() { return Fence[mCurrFrameResourceIndex]; }
 	void SetFence(UINT64 value) { Fence[mCurrFrameResourceIndex] = value; }
 	ComPtr<ID3D12CommandAllocator> GetCurrentCommandAllocator();
 
-	void Update();
-
+	// Totals since the last call.
+	Stats TakeStats();
 
 private:
-	ComPtr<ID3D12CommandAllocator> CmdListAlloc[gNumFrameResources];
+	// Adds the timestamps of the current frame's previous use to mStats.
+	void ReadTimestamps();
+
+	int mCount = 0;
+	vector<ComPtr<ID3D12CommandAllocator>> CmdListAlloc;
 
-    // Fence value to mark commands up to this fence point.  This lets us
-    // check if these frame resources are still in use by the GPU.
-	UINT64 Fence[gNumFrameResources] = { 0 };
+	// Fence value to mark commands up to this fence point.  This lets us
+	// check if these frame resources are still in use by the GPU.
+	vector<UINT64> Fence;
 	int mCurrFrameResourceIndex = 0;
 
-};
\ No newline at end of file
+	// Two timestamps per frame, resolved into the readback buffer at the end
+	// of the frame.
+	ComPtr<ID3D12QueryHeap> mTimestamps;
+	ComPtr<ID3D12Resource> mTimestampReadback;
+	UINT64 mTimestampFrequency = 0;
+	// End of the last frame read, in GPU ticks; 0 before the first.
+	UINT64 mLastGpuEnd = 0;
+	Stats mStats;
+};
@@ -0,0 +1,185 @@
+#include "GpuTimeline.h"
+
+GpuTimeline::GpuTimeline()
+{
+
+}
+
+GpuTimeline::~GpuTimeline()
+{
+	Shutdown();
+}
+
+void GpuTimeline::Init(ID3D12Device* device, ID3D12CommandQueue* queue)
+{
+	mQueue = queue;
+	mLastSignaled = 0;
+	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+
+	mWaitEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	if (mWaitEvent == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+}
+
+void GpuTimeline::Shutdown()
+{
+	StopRetireThread();
+
+	if (mFence != nullptr && mQueue != nullptr)
+	{
+		Flush();
+	}
+	mRetireQueue.Clear();
+
+	if (mWaitEvent)
+	{
+		CloseHandle(mWaitEvent);
+		mWaitEvent = nullptr;
+	}
+	mFence = nullptr;
+	mQueue = nullptr;
+}
+
+UINT64 GpuTimeline::Signal()
+{
+	// Add an instruction to the command queue to set a new fence point.  Because we
+	// are on the GPU timeline, the new fence point won't be set until the GPU finishes
+	// processing all the commands prior to this Signal().
+	UINT64 value = mLastSignaled + 1;
+	ThrowIfFailed(mQueue->Signal(mFence.Get(), value));
+	mLastSignaled = value;
+	return value;
+}
+
+UINT64 GpuTimeline::GetCompletedValue() const
+{
+	return mFence->GetCompletedValue();
+}
+
+void GpuTimeline::Wait(UINT64 fenceValue)
+{
+	if (fenceValue == 0 || mFence->GetCompletedValue() >= fenceValue)
+		return;
+
+	// Fire event when GPU hits the fence. The event is auto-reset, so it can be reused.
+	std::unique_lock<std::mutex> lock(mWaitMutex, std::try_to_lock);
+	if (lock.owns_lock())
+	{
+		ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mWaitEvent));
+		WaitForSingleObject(mWaitEvent, INFINITE);
+		return;
+	}
+
+	// Another thread is waiting on the shared event, which may signal for its
+	// fence value first, so this wait gets an event of its own.
+	HANDLE event = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	if (event == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+	HRESULT hr = mFence->SetEventOnCompletion(fenceValue, event);
+	if (SUCCEEDED(hr))
+		WaitForSingleObject(event, INFINITE);
+	CloseHandle(event);
+	ThrowIfFailed(hr);
+}
+
+void GpuTimeline::Flush()
+{
+	Wait(Signal());
+	Retire();
+}
+
+void GpuTimeline::DeferRelease(ComPtr<ID3D12Resource>& resource)
+{
+	// Commands recorded after the last signal are covered by the next one.
+	DeferRelease(mLastSignaled + 1, resource);
+}
+
+void GpuTimeline::DeferRelease(UINT64 fenceValue, ComPtr<ID3D12Resource>& resource)
+{
+	if (resource == nullptr)
+		return;
+
+	// The callback holds the last reference; it goes when the callback is destroyed.
+	ComPtr<ID3D12Resource> held = move(resource);
+	mRetireQueue.Enqueue(fenceValue, [held]() {});
+	resource = nullptr;
+
+	if (mWakeEvent)
+		SetEvent(mWakeEvent);
+}
+
+void GpuTimeline::OnCompletion(UINT64 fenceValue, std::function<void()> callback)
+{
+	mRetireQueue.Enqueue(fenceValue, move(callback));
+
+	if (mWakeEvent)
+		SetEvent(mWakeEvent);
+}
+
+size_t GpuTimeline::Retire()
+{
+	// The retire thread owns retirement while it runs, so callbacks keep to one thread.
+	if (mRetireThreadRunning || mRetireQueue.GetPendingCount() == 0)
+		return 0;
+
+	UINT64 completed = mFence->GetCompletedValue();
+	if (completed < mRetireQueue.GetOldestFenceValue())
+		return 0;
+
+	return mRetireQueue.Retire(completed);
+}
+
+void GpuTimeline::StartRetireThread()
+{
+	if (mRetireThreadRunning)
+		return;
+
+	mRetireEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	mWakeEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	mRetireThreadRunning = true;
+	mRetireThread = std::thread(&GpuTimeline::RetireThreadMain, this);
+}
+
+void GpuTimeline::StopRetireThread()
+{
+	if (!mRetireThreadRunning)
+		return;
+
+	mRetireThreadRunning = false;
+	SetEvent(mWakeEvent);
+	mRetireThread.join();
+
+	CloseHandle(mRetireEvent);
+	CloseHandle(mWakeEvent);
+	mRetireEvent = nullptr;
+	mWakeEvent = nullptr;
+}
+
+void GpuTimeline::RetireThreadMain()
+{
+	HANDLE events[] = { mRetireEvent, mWakeEvent };
+
+	while (mRetireThreadRunning)
+	{
+		UINT64 oldest = mRetireQueue.GetOldestFenceValue();
+		if (mRetireQueue.GetPendingCount() == 0)
+		{
+			// Nothing pending, sleep until something is enqueued or we are stopped.
+			WaitForSingleObject(mWakeEvent, INFINITE);
+			continue;
+		}
+
+		if (mFence->GetCompletedValue() < oldest)
+		{
+			if (FAILED(mFence->SetEventOnCompletion(oldest, mRetireEvent)))
+				break;
+			WaitForMultipleObjects(_countof(events), events, FALSE, INFINITE);
+		}
+
+		mRetireQueue.Retire(mFence->GetCompletedValue());
+	}
+}
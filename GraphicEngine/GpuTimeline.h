@@ -0,0 +1,69 @@
+#pragma once
+#include "framework.h"
+#include "FenceRetireQueue.h"
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+// Owns the queue fence and everything that is keyed to it. One event object is
+// created up front and reused for every CPU wait.
+class GpuTimeline
+{
+public:
+	GpuTimeline();
+	~GpuTimeline();
+
+	void Init(ID3D12Device* device, ID3D12CommandQueue* queue);
+	void Shutdown();
+
+	// Advances the fence value and adds a Signal to the queue. Returns the new value.
+	UINT64 Signal();
+	// Signal is for the render thread only; any thread may read the last value.
+	UINT64 GetLastSignaledValue() const { return mLastSignaled; }
+	UINT64 GetCompletedValue() const;
+	bool IsComplete(UINT64 fenceValue) const { return GetCompletedValue() >= fenceValue; }
+
+	// Blocks until the GPU reaches fenceValue. Any thread; one waiter at a time
+	// uses the shared event, others wait on an event of their own.
+	void Wait(UINT64 fenceValue);
+	// Signal + Wait + Retire: the old GraphicEngine::Flush behaviour.
+	void Flush();
+
+	// The resource is kept alive until the next signal completes, i.e. until every
+	// command recorded so far has executed. The caller's reference is cleared.
+	void DeferRelease(ComPtr<ID3D12Resource>& resource);
+	void DeferRelease(UINT64 fenceValue, ComPtr<ID3D12Resource>& resource);
+	// Runs callback once the GPU passed fenceValue.
+	void OnCompletion(UINT64 fenceValue, std::function<void()> callback);
+
+	// Polls the fence and drains finished entries. Cheap when nothing completed.
+	size_t Retire();
+
+	// Optional: drain on a background thread instead of polling from the frame loop.
+	// Callbacks then run on that thread.
+	void StartRetireThread();
+	void StopRetireThread();
+
+	ID3D12Fence* GetFence() { return mFence.Get(); }
+	FenceRetireQueue* GetRetireQueue() { return &mRetireQueue; }
+
+private:
+	void RetireThreadMain();
+
+	ComPtr<ID3D12Fence> mFence;
+	ID3D12CommandQueue* mQueue = nullptr;
+	// Read by loader and streaming threads deferring releases.
+	std::atomic<UINT64> mLastSignaled{ 0 };
+	HANDLE mWaitEvent = nullptr;
+	// Held by whoever waits on mWaitEvent.
+	std::mutex mWaitMutex;
+
+	FenceRetireQueue mRetireQueue;
+
+	std::thread mRetireThread;
+	std::atomic<bool> mRetireThreadRunning{ false };
+	HANDLE mRetireEvent = nullptr;
+	HANDLE mWakeEvent = nullptr;
+};
@@ -1,4 +1,7 @@
 #include "GraphicEngine.h"
+#include "StaticBatchPlanner.h"
+#include <set>
+#include <unordered_set>
 
 IMPLEMENT_SINGLE(GraphicEngine)
 
@@ -9,21 +12,38 @@ bool GraphicEngine::Init(int Width, int Height, HWND wnd, D3D_FEATURE_LEVEL leve
 	mClientHeight = Height;
 	mhMainWnd = wnd;
 	m_D3DMinFeatureLevel = level;
+	// "-serialjobs" runs every job on this thread, to compare frame timings.
+	mJobs.Start(wcsstr(GetCommandLineW(), L"-serialjobs") ? 0 : JobSystem::GetDefaultThreadCount());
 	InitDevice();
 	InitGPUCommand();
 
-	InitDescriptorHeap(20, SwapChainBufferCount + 20, 10);
+	// "-frames N" sets how many frames the CPU may record ahead of the GPU, 1 to
+	// MaxFrameResources. Everything kept per frame sizes itself from this.
+	int frameCount = MaxFrameResources;
+	if (const wchar_t* frames = wcsstr(GetCommandLineW(), L"-frames "))
+		frameCount = max(1, min(MaxFrameResources, _wtoi(frames + wcslen(L"-frames "))));
+	mFrameResource = new FrameResource();
+	mFrameResource->Init(frameCount);
+	mCommandListPool.Init(m_D3DDevice.Get(), mJobs.GetParticipantCount(), frameCount);
+	// "-nobundles" records every draw every frame, to compare.
+	mDrawBundles.Init(m_D3DDevice.Get());
+	mUseBundles = wcsstr(GetCommandLineW(), L"-nobundles") == nullptr;
+	// "-noindirect" draws without ExecuteIndirect and culling, to compare.
+	mUseIndirect = wcsstr(GetCommandLineW(), L"-noindirect") == nullptr;
+	mTextureStreamer.Init();
+	InitTextureIndex();
+
 	InitDesHeap();
+	// A streamed texture takes two SRVs. Initial sizes only, every heap grows on demand.
+	InitDescriptorHeap(32 + 2 * (int)mTextureIndex.GetEntries().size(), mFrameResource->GetCount() + 1 + 16, 8);
 	InitSwapchainAndRvt();
 	Flush();
 	InitDsv();
 	InitViewportAndScissor();
 
-	mFrameResource = new FrameResource();
-	mFrameResource->Init();
-	mMainPassCB.AmbientLight = { 0.4f, 0.4f, 0.6f, 1.0f };
-	mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
-	mMainPassCB.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
+	mAmbientLight = { 0.4f, 0.4f, 0.6f, 1.0f };
+	mLights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+	mLights[0].Strength = { 0.6f, 0.6f, 0.6f };
 	return true;
 }
 
@@ -88,22 +108,22 @@ void GraphicEngine::SetPosition(const XMFLOAT3& v)
 
 XMVECTOR GraphicEngine::GetPosition()const
 {
-	return mCamera.GetPosition();
+	return mFrameCamera.GetPosition();
 }
 
 XMFLOAT3 GraphicEngine::GetPosition3f()const
 {
-	return mCamera.GetPosition3f();
+	return mFrameCamera.GetPosition3f();
 }
 
 XMMATRIX GraphicEngine::GetView()const
 {
-	return mCamera.GetView();
+	return mFrameCamera.GetView();
 }
 
 XMMATRIX GraphicEngine::GetProj()const
 {
-	return mCamera.GetProj();
+	return mFrameCamera.GetProj();
 }
 
 void GraphicEngine::OnMouseUp(WPARAM btnState, int x, int y)
@@ -116,11 +136,8 @@ void GraphicEngine::OnMouseMove(WPARAM btnState, int x, int y)
 	if ((btnState & MK_LBUTTON) != 0)
 	{
 		// Make each pixel correspond to a quarter of a degree.
-		float dx = XMConvertToRadians(0.25f*static_cast<float>(x - mLastMousePos.x));
-		float dy = XMConvertToRadians(0.25f*static_cast<float>(y - mLastMousePos.y));
-
-		mCamera.Pitch(dy);
-		mCamera.RotateY(dx);
+		mMouseDx += x - mLastMousePos.x;
+		mMouseDy += y - mLastMousePos.y;
 	}
 
 	mLastMousePos.x = x;
@@ -129,6 +146,7 @@ void GraphicEngine::OnMouseMove(WPARAM btnState, int x, int y)
 }
 
 GraphicEngine::GraphicEngine()
+	: mMouseDx(0), mMouseDy(0)
 {
 
 }
@@ -149,6 +167,10 @@ void GraphicEngine::OnKeyboardInput()
 	if (GetAsyncKeyState('D') & 0x8000)
 		mCamera.Strafe(10.0f*dt);
 
+	// Make each pixel correspond to a quarter of a degree.
+	mCamera.Pitch(XMConvertToRadians(0.25f*static_cast<float>(mMouseDy.exchange(0))));
+	mCamera.RotateY(XMConvertToRadians(0.25f*static_cast<float>(mMouseDx.exchange(0))));
+
 	mCamera.UpdateViewMatrix();
 }
 
@@ -165,26 +187,9 @@ void GraphicEngine::SendCommandAndFulsh()
 
 void GraphicEngine::Flush()
 {
-	// Advance the fence value to mark commands up to this fence point.
-	m_CurrentFence++;
-
-	// Add an instruction to the command queue to set a new fence point.  Because we 
-	// are on the GPU timeline, the new fence point won't be set until the GPU finishes
-	// processing all the commands prior to this Signal().
-	ThrowIfFailed(mCommandQueue->Signal(m_Fence.Get(), m_CurrentFence));
-
-	// Wait until the GPU has completed commands up to this fence point.
-	if (m_Fence->GetCompletedValue() < m_CurrentFence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-
-		// Fire event when GPU hits current fence.  
-		ThrowIfFailed(m_Fence->SetEventOnCompletion(m_CurrentFence, eventHandle));
-
-		// Wait until the GPU hits current fence event is fired.
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+	// Wait until the GPU has completed every command submitted so far, then
+	// release whatever was waiting on those commands.
+	mTimeline.Flush();
 }
 
 ID3D12Resource* GraphicEngine::CurrentBackBuffer()const
@@ -194,12 +199,26 @@ ID3D12Resource* GraphicEngine::CurrentBackBuffer()const
 
 D3D12_CPU_DESCRIPTOR_HANDLE GraphicEngine::CurrentBackBufferView()const
 {
-	return mDescriptorHeap->GetRtvDescriptorCpuHandle(mCurrBackBufferIndex);
+	return mDescriptorHeap->GetRtvDescriptorCpuHandle(mSwapChainRtv + mCurrBackBufferIndex);
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE GraphicEngine::DepthStencilView()const
 {
-	return mDescriptorHeap->GetDsvDescriptorCpuHandle(0);
+	return mDescriptorHeap->GetDsvDescriptorCpuHandle(mDepthStencilDsv);
+}
+
+void GraphicEngine::InitTextureIndex()
+{
+	// One small file instead of a header read per texture; stale entries are rebuilt here.
+	if (!mTextureIndex.Refresh("source/Textures", "source/Textures/textures.idx"))
+		::OutputDebugStringA("Texture index: cannot list source/Textures\n");
+	size_t count = mTextureIndex.GetEntries().size();
+	TextureList.Reserve(count);
+	mTextureStreamer.Reserve(count);
+
+	char buffer[128];
+	sprintf_s(buffer, "Texture index: %zu textures, %zu rebuilt\n", count, mTextureIndex.GetRebuiltCount());
+	::OutputDebugStringA(buffer);
 }
 
 void GraphicEngine::InitDescriptorHeap(int Srvsize, int RtvSize, int DsvSize)
@@ -212,13 +231,15 @@ void GraphicEngine::InitDescriptorHeap(int Srvsize, int RtvSize, int DsvSize)
 
 void GraphicEngine::InitGPUCommand()
 {
-	ThrowIfFailed(m_D3DDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE,
-		IID_PPV_ARGS(&m_Fence)));
-
 	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
 	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
 	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
 	ThrowIfFailed(m_D3DDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCommandQueue)));
+	mTimeline.Init(m_D3DDevice.Get(), mCommandQueue.Get());
+	// "-retirethread" retires released resources and completion callbacks on a
+	// thread of their own instead of polling once per frame.
+	if (wcsstr(GetCommandLineW(), L"-retirethread"))
+		mTimeline.StartRetireThread();
 
 	ThrowIfFailed(m_D3DDevice->CreateCommandAllocator(
 		D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -259,7 +280,7 @@ void GraphicEngine::InitSwapchainAndRvt()
 	sd.SampleDesc.Count = 1;
 	sd.SampleDesc.Quality = 0;
 	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	sd.BufferCount = SwapChainBufferCount;
+	sd.BufferCount = mFrameResource->GetCount() + 1;
 	sd.OutputWindow = mhMainWnd;
 	sd.Windowed = true;
 	sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
@@ -274,10 +295,12 @@ void GraphicEngine::InitSwapchainAndRvt()
 
 	mCurrBackBufferIndex = 0;
 
-	for (UINT i = 0; i < SwapChainBufferCount; i++)
+	mSwapChainBuffer.resize(sd.BufferCount);
+	mSwapChainRtv = mDescriptorHeap->AllocateRtv(sd.BufferCount);
+	for (UINT i = 0; i < sd.BufferCount; i++)
 	{
 		ThrowIfFailed(mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])));
-		m_D3DDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, mDescriptorHeap->GetRtvDescriptorCpuHandle());
+		m_D3DDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, mDescriptorHeap->GetRtvDescriptorCpuHandle(mSwapChainRtv + i));
 	}
 }
 
@@ -312,7 +335,8 @@ void GraphicEngine::InitDsv()
 		IID_PPV_ARGS(mDepthStencilBuffer.GetAddressOf())));
 
 	// Create descriptor to mip level 0 of entire resource using the format of the resource.
-	m_D3DDevice->CreateDepthStencilView(mDepthStencilBuffer.Get(), nullptr, mDescriptorHeap->GetDsvDescriptorCpuHandle());
+	mDepthStencilDsv = mDescriptorHeap->SetDsvDescriptorIndex();
+	m_D3DDevice->CreateDepthStencilView(mDepthStencilBuffer.Get(), nullptr, mDescriptorHeap->GetDsvDescriptorCpuHandle(mDepthStencilDsv));
 
 	//ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
@@ -337,63 +361,144 @@ void GraphicEngine::InitViewportAndScissor()
 	mScissorRect = { 0, 0, mClientWidth, mClientHeight };
 }
 
-void GraphicEngine::Run()
+void GraphicEngine::Simulate(FramePacket& packet)
 {
 	mTimer.Tick();
-	CalculateFrameStats();
-	Update(mTimer);
+	packet.InputTime = std::chrono::steady_clock::now();
+	OnKeyboardInput();
+
+	packet.Frame = mSimulatedFrames++;
+	packet.Timer = mTimer;
+	packet.View = mCamera;
+	packet.AmbientLight = mAmbientLight;
+	std::copy(std::begin(mLights), std::end(mLights), packet.Lights);
+	for (int i = 0; i != (int)RenderLayer::Count; ++i)
+	{
+		// The slot is reused, so this only allocates when items were added.
+		packet.Items[i].resize(mRitemLayer[i].size());
+		for (size_t j = 0; j != mRitemLayer[i].size(); ++j)
+		{
+			packet.Items[i][j].World = mRitemLayer[i][j]->World;
+			packet.Items[i][j].TexTransform = mRitemLayer[i][j]->TexTransform;
+		}
+	}
 }
 
-void GraphicEngine::Update(const GameTimer& Timer)
+void GraphicEngine::BeginFrame(const FramePacket& packet)
 {
-	OnKeyboardInput();
-	UpdateShaderParameter(Timer);
+	mFrameCamera = packet.View;
+	mFramePacket = &packet;
+	UpdateTextureStreaming(packet);
+	UpdateShaderParameter(packet);
 }
 
-void GraphicEngine::UpdateShaderParameter(const GameTimer& Timer)
+void GraphicEngine::EndFrame(const FramePacket& packet)
 {
-	UpdateObjectCBs(Timer);
-	UpdateMaterialBuffer(Timer);
-	UpdateMainPassCB(Timer);
+	CalculateFrameStats(packet);
+	mFramePacket = nullptr;
 }
 
-void GraphicEngine::UpdateObjectCBs(const GameTimer& Timer)
+void GraphicEngine::UpdateTextureStreaming(const FramePacket& packet)
 {
-	mCBPerObject->Update();
+	XMFLOAT3 eye = GetCamera()->GetPosition3f();
+	XMVECTOR eyePos = XMLoadFloat3(&eye);
+	float nearZ = GetCamera()->GetNearZ();
+	// Pixels covered by one world unit at distance 1.
+	float pixelsPerUnit = mClientHeight / (2.0f * tanf(0.5f * GetCamera()->GetFovY()));
+
+	mTextureStreamer.BeginFrame();
 	for (int i = 0; i != (int)RenderLayer::Count; ++i)
 	{
 		for (int j = 0; j != mRitemLayer[i].size(); ++j)
 		{
 			RenderItem* e = mRitemLayer[i][j].get();
-			// Only update the cbuffer data if the constants have changed.  
-			// This needs to be tracked per frame resource.
-			//if (e->NumFramesDirty > 0)
-			{
-				XMMATRIX world = XMLoadFloat4x4(&e->World);
-				XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
-
-				CBPerObject objConstants;
-				XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-				XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-				objConstants.MaterialIndex = e->Mat->MatCBIndex;
+			const ItemState& state = packet.Items[i][j];
+			int streamId = TextureList.GetStreamId(e->Mat->DiffuseSrvHeapIndex);
+			if (streamId < 0)
+				continue;
+
+			BoundingSphere bounds;
+			e->Geo->Bounds.Transform(bounds, XMLoadFloat4x4(&state.World));
+			float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - eyePos)) - bounds.Radius;
+			float pixelsAcross = 2.0f * bounds.Radius * pixelsPerUnit / max(distance, nearZ);
+
+			// Texture coordinates may repeat across the object.
+			XMFLOAT4X4 texTransform;
+			XMStoreFloat4x4(&texTransform, XMLoadFloat4x4(&state.TexTransform) * XMLoadFloat4x4(&e->Mat->MatTransform));
+			float repeat = max(XMVectorGetX(XMVector2Length(XMVectorSet(texTransform._11, texTransform._12, 0.0f, 0.0f))),
+				XMVectorGetX(XMVector2Length(XMVectorSet(texTransform._21, texTransform._22, 0.0f, 0.0f))));
+			float texelsAcross = mTextureStreamer.GetWidth(streamId) * max(repeat, 1.0f);
+
+			mTextureStreamer.Request(streamId, MipResidency::ComputeDesiredMip(texelsAcross, pixelsAcross));
+		}
+	}
+	mTextureStreamer.EndFrame();
+}
 
-				mCBPerObject->Update(e->ObjCBIndex, objConstants);
+void GraphicEngine::UpdateShaderParameter(const FramePacket& packet)
+{
+	UpdateObjectCBs(packet);
+	UpdateMaterialBuffer(packet.Timer);
+	UpdateMainPassCB(packet);
+}
 
-				// Next FrameResource need to be updated too.
-				e->NumFramesDirty--;
+void GraphicEngine::UpdateObjectCBs(const FramePacket& packet)
+{
+	for (int i = 0; i != (int)RenderLayer::Count; ++i)
+	{
+		const vector<unique_ptr<RenderItem>>& ritems = mRitemLayer[i];
+		const vector<ItemState>& states = packet.Items[i];
+		// Every item packs its own slot, so ranges of items run as separate jobs.
+		mJobs.ParallelFor(0, ritems.size(), 64, [&](size_t begin, size_t end)
+		{
+			for (size_t j = begin; j != end; ++j)
+			{
+				RenderItem* e = ritems[j].get();
+				// Only update the cbuffer data if the constants have changed.  
+				// This needs to be tracked per frame resource.
+				//if (e->NumFramesDirty > 0)
+				{
+					XMMATRIX world = XMLoadFloat4x4(&states[j].World);
+					XMMATRIX texTransform = XMLoadFloat4x4(&states[j].TexTransform);
+
+					CBPerObject objConstants;
+					XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+					XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+					objConstants.MaterialIndex = e->Mat->MatCBIndex;
+
+					mCBPerObject->Update(e->ObjCBIndex, objConstants);
+
+					// Next FrameResource need to be updated too.
+					e->NumFramesDirty--;
+				}
 			}
-		}
+		});
 	}
 }
 
 void GraphicEngine::UpdateMaterialBuffer(const GameTimer& Timer)
 {
-	mCBMaterial->Update();
+	// The texture list and the streamer are not safe to read from the jobs, so
+	// SRVs are resolved here. Items sharing a material, e.g. static batches of
+	// one material in different cells, add it once, so no two jobs write a slot.
+	mFrameMaterials.clear();
+	std::unordered_set<int> seen;
 	for (int i = 0; i != (int)RenderLayer::Count; ++i)
 	{
-		for (int j = 0; j != mRitemLayer[i].size(); ++j)
+		for (const unique_ptr<RenderItem>& ritem : mRitemLayer[i])
 		{
-			LoadMaterial* mat = (mRitemLayer[i][j]->Mat).get();
+			LoadMaterial* mat = ritem->Mat.get();
+			// Streamed textures switch SRVs as mips come and go.
+			if (seen.insert(mat->MatCBIndex).second)
+				mFrameMaterials.push_back({ mat, TextureList.GetSrvIndex(mat->DiffuseSrvHeapIndex) });
+		}
+	}
+
+	mJobs.ParallelFor(0, mFrameMaterials.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j != end; ++j)
+		{
+			LoadMaterial* mat = mFrameMaterials[j].Mat;
 			//for (auto& e : mMaterials)
 			//{
 				// Only update the cbuffer data if the constants have changed.  If the cbuffer
@@ -401,7 +506,7 @@ void GraphicEngine::UpdateMaterialBuffer(const GameTimer& Timer)
 				//LoadMaterial* mat = mRitemLayer[(int)RenderLayer::Opaque][0]->Mat.get();
 				//if (mat->NumFramesDirty > 0)
 			{
-				XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+				XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform) * XMLoadFloat4x4(&mat->AtlasTransform);
 
 				CBMaterial matData;
 				matData.DiffuseAlbedo = mat->DiffuseAlbedo;
@@ -409,7 +514,7 @@ void GraphicEngine::UpdateMaterialBuffer(const GameTimer& Timer)
 				matData.Roughness = mat->Roughness;
 				matData.SsrAttr = mat->SsrAttr;
 				XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-				matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+				matData.DiffuseMapIndex = mFrameMaterials[j].DiffuseSrvIndex;
 				//matData.NormalMapIndex = mat->NormalSrvHeapIndex;
 
 				mCBMaterial->Update(mat->MatCBIndex, matData);
@@ -418,12 +523,11 @@ void GraphicEngine::UpdateMaterialBuffer(const GameTimer& Timer)
 				//mat->NumFramesDirty--;
 			}
 		}
-	}
+	});
 }
 
-void GraphicEngine::UpdateMainPassCB(const GameTimer& Timer)
+void GraphicEngine::UpdateMainPassCB(const FramePacket& packet)
 {
-	mCBPerPass->Update();
 	XMMATRIX view = GetCamera()->GetView();
 	XMMATRIX proj = GetCamera()->GetProj();
 	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
@@ -440,6 +544,8 @@ void GraphicEngine::UpdateMainPassCB(const GameTimer& Timer)
 	XMStoreFloat4x4(&mMainPassCB.gView, XMMatrixTranspose(view));
 	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
 	mMainPassCB.EyePosW = GetCamera()->GetPosition3f();
+	mMainPassCB.AmbientLight = packet.AmbientLight;
+	std::copy(std::begin(packet.Lights), std::end(packet.Lights), mMainPassCB.Lights);
 
 	mCBPerPass->Update(0, mMainPassCB);
 }
@@ -447,31 +553,37 @@ void GraphicEngine::UpdateMainPassCB(const GameTimer& Timer)
 void GraphicEngine::CreateShaderParameter()
 {
 	int count = 0;
+	int materialCount = 0;
 	for (int i = 0; i != (int)RenderLayer::Count; ++i)
 	{
 		for (int j = 0; j != mRitemLayer[i].size(); ++j)
 		{
 			count++;
+			// Render items may share materials, the buffer is indexed by MatCBIndex.
+			materialCount = max(materialCount, mRitemLayer[i][j]->Mat->MatCBIndex + 1);
 		}
 	}
-	mCBPerPass = make_unique<ConstantBuffer<CBPerPass>>(m_D3DDevice.Get(), 1, true);
-	mCBPerObject = make_unique<ConstantBuffer<CBPerObject>>(m_D3DDevice.Get(), count, true);
-	mCBMaterial = make_unique<ConstantBuffer<CBMaterial>>(m_D3DDevice.Get(), count, false);
+	mCBPerPass = make_unique<ConstantBuffer<CBPerPass>>(m_D3DDevice.Get(), mFrameResource, 1, true);
+	// A structured buffer, indexed by gObjectIndex rather than bound per item.
+	mCBPerObject = make_unique<ConstantBuffer<CBPerObject>>(m_D3DDevice.Get(), mFrameResource, count, false);
+	mCBMaterial = make_unique<ConstantBuffer<CBMaterial>>(m_D3DDevice.Get(), mFrameResource, max(materialCount, 1), false);
+	// Bundles were recorded against the old buffers.
+	mDrawBundles.Invalidate();
 }
 
-void GraphicEngine::SetBaseRootSignature0()
+void GraphicEngine::SetBaseRootSignature0(ID3D12GraphicsCommandList* cmdList)
 {
-
+	cmdList->SetGraphicsRootShaderResourceView(0, mCBPerObject->Resource()->GetGPUVirtualAddress());
 }
 
-void GraphicEngine::SetBaseRootSignature1()
+void GraphicEngine::SetBaseRootSignature1(ID3D12GraphicsCommandList* cmdList)
 {
-	mCommandList->SetGraphicsRootConstantBufferView(1, mCBPerPass->Resource()->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootConstantBufferView(1, mCBPerPass->Resource()->GetGPUVirtualAddress());
 }
 
-void GraphicEngine::SetBaseRootSignature3()
+void GraphicEngine::SetBaseRootSignature3(ID3D12GraphicsCommandList* cmdList)
 {
-	mCommandList->SetGraphicsRootShaderResourceView(3, mCBMaterial->Resource()->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(3, mCBMaterial->Resource()->GetGPUVirtualAddress());
 }
 
 void GraphicEngine::BuildBaseRootSignature()
@@ -482,17 +594,19 @@ void GraphicEngine::BuildBaseRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE texTable1;
 	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 12, 0);
 
+	// Bindless: every texture in the shader visible heap, indexed by MaterialData.DiffuseMapIndex.
+	// Unbounded, so it lives in its own register space to not swallow the tables above.
 	CD3DX12_DESCRIPTOR_RANGE texTable2;
-	texTable2.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 2, 0);
+	texTable2.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 2);
 
 	CD3DX12_DESCRIPTOR_RANGE texTable3;
 	texTable3.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, 13, 0);
 
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[8];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[9];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
-	slotRootParameter[0].InitAsConstantBufferView(0);
+	slotRootParameter[0].InitAsShaderResourceView(1, 1);
 	slotRootParameter[1].InitAsConstantBufferView(1);
 	slotRootParameter[2].InitAsConstantBufferView(2);
 	slotRootParameter[3].InitAsShaderResourceView(0, 1);
@@ -500,11 +614,13 @@ void GraphicEngine::BuildBaseRootSignature()
 	slotRootParameter[5].InitAsDescriptorTable(1, &texTable2, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[6].InitAsDescriptorTable(1, &texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
 	slotRootParameter[7].InitAsDescriptorTable(1, &texTable3, D3D12_SHADER_VISIBILITY_PIXEL);
+	// The object index into parameter 0, set by every draw.
+	slotRootParameter[8].InitAsConstants(1, 3);
 
 	auto staticSamplers = GetStaticSamplers();
 
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(8, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(9, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -525,6 +641,8 @@ void GraphicEngine::BuildBaseRootSignature()
 		serializedRootSig->GetBufferPointer(),
 		serializedRootSig->GetBufferSize(),
 		IID_PPV_ARGS(mBaseRootSignature.GetAddressOf())));
+
+	mIndirectDraws.Init(m_D3DDevice.Get(), mBaseRootSignature.Get(), 8);
 }
 
 
@@ -601,32 +719,219 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GraphicEngine::GetStaticSampler
 void GraphicEngine::AddRenderItem(RenderLayer layer, unique_ptr<RenderItem>& item)
 {
 	mRitemLayer[(int)layer].push_back(move(item));
+	mDrawBundles.Invalidate();
 }
 
-void GraphicEngine::DrawRenderItems(RenderLayer layer/*ID3D12GraphicsCommandList* cmdList, *//*const std::vector<unique_ptr<RenderItem>>& ritems*/)
+void GraphicEngine::BakeStaticBatches(float cellSize, size_t byteBudget)
 {
-	const vector<unique_ptr<RenderItem>>& ritems = mRitemLayer[(int)layer];
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(CBPerObject));
+	vector<unique_ptr<RenderItem>>& ritems = mRitemLayer[(int)RenderLayer::Opaque];
+	size_t drawsBefore = ritems.size();
+
+	// Only triangle lists whose mesh kept its CPU copy can be merged.
+	vector<RenderItem*> candidates;
+	vector<StaticBatchPlanner::Item> planned;
+	for (const unique_ptr<RenderItem>& ri : ritems)
+	{
+		const MeshInfo* geo = ri->Geo.get();
+		if (!ri->Static || ri->PrimitiveType != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST ||
+			geo->VertexBufferCPU == nullptr || geo->IndexBufferCPU == nullptr || geo->VertexByteStride != sizeof(Vertex))
+			continue;
+		BoundingSphere bounds;
+		geo->Bounds.Transform(bounds, XMLoadFloat4x4(&ri->World));
+		StaticBatchPlanner::Item item;
+		item.Material = (uint32_t)ri->Mat->MatCBIndex;
+		item.Center[0] = bounds.Center.x;
+		item.Center[1] = bounds.Center.y;
+		item.Center[2] = bounds.Center.z;
+		item.Bytes = geo->VertexBufferByteSize + ri->IndexCount * sizeof(uint32_t);
+		candidates.push_back(ri.get());
+		planned.push_back(item);
+	}
+	StaticBatchPlanner planner;
+	planner.Plan(planned, cellSize, byteBudget);
+
+	vector<unique_ptr<RenderItem>> batches;
+	set<RenderItem*> merged;
+	size_t bytesFreed = 0;
+	for (const StaticBatchPlanner::Batch& batch : planner.GetBatches())
+	{
+		vector<Vertex> vertices;
+		vector<uint32_t> indices;
+		for (uint32_t index : batch.Items)
+		{
+			RenderItem* ri = candidates[index];
+			MeshInfo* geo = ri->Geo.get();
+			const Vertex* source = reinterpret_cast<const Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+			UINT vertexCount = geo->VertexBufferByteSize / sizeof(Vertex);
+			XMMATRIX world = XMLoadFloat4x4(&ri->World);
+			XMMATRIX normalWorld = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+			XMMATRIX texTransform = XMLoadFloat4x4(&ri->TexTransform);
+
+			uint32_t baseVertex = (uint32_t)vertices.size() + ri->BaseVertexLocation;
+			for (UINT i = 0; i < vertexCount; ++i)
+			{
+				Vertex v;
+				XMStoreFloat3(&v.Pos, XMVector3TransformCoord(XMLoadFloat3(&source[i].Pos), world));
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&source[i].Normal), normalWorld)));
+				// The batch draws with an identity TexTransform.
+				XMStoreFloat2(&v.TexC, XMVector4Transform(XMVectorSet(source[i].TexC.x, source[i].TexC.y, 0.0f, 1.0f), texTransform));
+				vertices.push_back(v);
+			}
+
+			const void* sourceIndices = geo->IndexBufferCPU->GetBufferPointer();
+			size_t firstIndex = indices.size();
+			for (UINT i = ri->StartIndexLocation; i < ri->StartIndexLocation + ri->IndexCount; ++i)
+			{
+				uint32_t value = geo->IndexFormat == DXGI_FORMAT_R16_UINT ?
+					static_cast<const uint16_t*>(sourceIndices)[i] : static_cast<const uint32_t*>(sourceIndices)[i];
+				indices.push_back(baseVertex + value);
+			}
+			// A mirroring world matrix flips the winding; undo it so culling still sees front faces.
+			if (XMVectorGetX(XMMatrixDeterminant(world)) < 0.0f)
+			{
+				for (size_t i = firstIndex; i + 2 < indices.size(); i += 3)
+					std::swap(indices[i + 1], indices[i + 2]);
+			}
+
+			// The source buffers may still have their upload copies pending.
+			bytesFreed += geo->VertexBufferByteSize + geo->IndexBufferByteSize;
+			mTimeline.DeferRelease(geo->VertexBufferGPU);
+			mTimeline.DeferRelease(geo->IndexBufferGPU);
+			merged.insert(ri);
+		}
+
+		auto geo = make_unique<MeshInfo>();
+		geo->CreateFromData(vertices, indices);
+		geo->Name = "static batch";
+		auto batchItem = make_unique<RenderItem>();
+		batchItem->Mat = candidates[batch.Items[0]]->Mat;
+		batchItem->IndexCount = geo->IndexCount;
+		batchItem->Geo = move(geo);
+		batchItem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		batchItem->Static = true;
+		batches.push_back(move(batchItem));
+	}
 
+	if (!batches.empty())
+	{
+		ritems.erase(remove_if(ritems.begin(), ritems.end(), [&](const unique_ptr<RenderItem>& ri)
+		{
+			return merged.count(ri.get()) != 0;
+		}), ritems.end());
+		for (unique_ptr<RenderItem>& batchItem : batches)
+			ritems.push_back(move(batchItem));
+
+		// Items went away, so number the object constants again.
+		UINT objCBIndex = 0;
+		for (int i = 0; i != (int)RenderLayer::Count; ++i)
+		{
+			for (unique_ptr<RenderItem>& ri : mRitemLayer[i])
+				ri->ObjCBIndex = objCBIndex++;
+		}
+		mDrawBundles.Invalidate();
+	}
+
+	char bakeText[192];
+	sprintf_s(bakeText, "Static batching: %zu of %zu opaque draws merged into %zu, %zu bytes added, %zu bytes freed\n",
+		merged.size(), drawsBefore, planner.GetBatches().size(), planner.GetBytes(), bytesFreed);
+	::OutputDebugStringA(bakeText);
+}
+
+void GraphicEngine::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, size_t begin, size_t end)
+{
+	const vector<unique_ptr<RenderItem>>& ritems = mRitemLayer[(int)layer];
 
 	// For each render item...
-	for (size_t i = 0; i < ritems.size(); ++i)
+	for (size_t i = begin; i < min(end, ritems.size()); ++i)
 	{
 		auto ri = ritems[i].get();
 
-		mCommandList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		mCommandList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-		mCommandList->IASetPrimitiveTopology(ri->PrimitiveType);
+		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+		cmdList->SetGraphicsRoot32BitConstant(8, ri->ObjCBIndex, 0);
+
+		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+	}
+}
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = mCBPerObject->Resource()->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
+void GraphicEngine::ExecuteRenderItems(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* pso, RenderLayer layer,
+	size_t begin, size_t end, const XMFLOAT4X4* cullViewProj)
+{
+	end = min(end, mRitemLayer[(int)layer].size());
+	if (begin >= end)
+		return;
+	// Items added after the packet was simulated have no world matrix to cull with.
+	if (mUseIndirect && mFramePacket != nullptr && mFramePacket->Items[(int)layer].size() >= end)
+	{
+		const vector<unique_ptr<RenderItem>>& ritems = mRitemLayer[(int)layer];
+		const vector<ItemState>& states = mFramePacket->Items[(int)layer];
 
-		mCommandList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+		float planes[6][4];
+		size_t planeCount = 0;
+		if (cullViewProj != nullptr)
+		{
+			IndirectDrawBuilder::ExtractFrustumPlanes(cullViewProj->m, planes);
+			planeCount = 6;
+		}
 
-		mCommandList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		DrawBundles::Key key = { pso, (int)layer, begin, end, mFrameResource->GetIndex() };
+		bool drawn = mIndirectDraws.Draw(cmdList, key, end - begin, planes, planeCount,
+			[&](uint32_t item, IndirectDrawBuilder::Item& bounds)
+		{
+			const RenderItem* ri = ritems[begin + item].get();
+			BoundingSphere sphere;
+			ri->Geo->Bounds.Transform(sphere, XMLoadFloat4x4(&states[begin + item].World));
+			bounds.Group = (uint32_t)ri->PrimitiveType;
+			bounds.Center[0] = sphere.Center.x;
+			bounds.Center[1] = sphere.Center.y;
+			bounds.Center[2] = sphere.Center.z;
+			bounds.Radius = sphere.Radius;
+			// Front to back: clip w is the view depth, and the bits of a
+			// positive float sort like its value.
+			float depth = 0.0f;
+			if (cullViewProj != nullptr)
+			{
+				const XMFLOAT4X4& m = *cullViewProj;
+				depth = max(0.0f, sphere.Center.x * m._14 + sphere.Center.y * m._24 + sphere.Center.z * m._34 + m._44);
+			}
+			memcpy(&bounds.SortKey, &depth, sizeof(depth));
+		},
+			[&](uint32_t item, IndirectDraws::Command& command)
+		{
+			const RenderItem* ri = ritems[begin + item].get();
+			command.VertexBuffer = ri->Geo->VertexBufferView();
+			command.IndexBuffer = ri->Geo->IndexBufferView();
+			command.ObjectIndex = ri->ObjCBIndex;
+			command.Draw.IndexCountPerInstance = ri->IndexCount;
+			command.Draw.InstanceCount = 1;
+			command.Draw.StartIndexLocation = ri->StartIndexLocation;
+			command.Draw.BaseVertexLocation = ri->BaseVertexLocation;
+			command.Draw.StartInstanceLocation = 0;
+		});
+		if (drawn)
+			return;
 	}
+	if (mUseBundles)
+	{
+		DrawBundles::Key key = { pso, (int)layer, begin, end, mFrameResource->GetIndex() };
+		ID3D12GraphicsCommandList* bundle = mDrawBundles.Get(key, [&](ID3D12GraphicsCommandList* bundleList)
+		{
+			// A bundle that sets root arguments has to set the root signature first.
+			bundleList->SetGraphicsRootSignature(GetBaseRootSignature());
+			DrawRenderItems(bundleList, layer, begin, end);
+		});
+		if (bundle != nullptr)
+		{
+			cmdList->ExecuteBundle(bundle);
+			return;
+		}
+	}
+	DrawRenderItems(cmdList, layer, begin, end);
 }
 
-void GraphicEngine::CalculateFrameStats()
+void GraphicEngine::CalculateFrameStats(const FramePacket& packet)
 {
 	// Code computes the average frames per second, and also the 
 	// average time it takes to render one frame.  These stats 
@@ -634,11 +939,16 @@ void GraphicEngine::CalculateFrameStats()
 
 	static int frameCnt = 0;
 	static float timeElapsed = 0.0f;
+	static double latencySum = 0.0;
+	static double latencyMax = 0.0;
 
 	frameCnt++;
+	double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - packet.InputTime).count();
+	latencySum += latency;
+	latencyMax = max(latencyMax, latency);
 
 	// Compute averages over one second period.
-	if ((mTimer.TotalTime() - timeElapsed) >= 1.0f)
+	if ((packet.Timer.TotalTime() - timeElapsed) >= 1.0f)
 	{
 		float fps = (float)frameCnt; // fps = frameCnt / 1
 		float mspf = 1000.0f / fps;
@@ -652,8 +962,40 @@ void GraphicEngine::CalculateFrameStats()
 
 		//SetWindowText(mhMainWnd, windowText.c_str());
 
+		ResourceStateTracker::Counters barriers = ResourceStateTracker::TakeCounters();
+		char barrierText[128];
+		sprintf_s(barrierText, "Barriers per frame: %.1f requested, %.1f issued, %.1f merged\n",
+			barriers.Requested / fps, barriers.Issued / fps, barriers.Merged / fps);
+		::OutputDebugStringA(barrierText);
+
+		FrameResource::Stats frames = mFrameResource->TakeStats();
+		char framesText[160];
+		sprintf_s(framesText, "%d frames in flight: %.1f fps, CPU wait %.2f ms, GPU busy %.2f ms, GPU idle %.2f ms per frame\n",
+			mFrameResource->GetCount(), fps, frames.CpuWaitMs / frameCnt,
+			frames.GpuBusyMs / max<size_t>(frames.Frames, 1), frames.GpuIdleMs / max<size_t>(frames.Frames, 1));
+		::OutputDebugStringA(framesText);
+
+		size_t bundlesRecorded, bundlesReplayed;
+		mDrawBundles.TakeCounts(&bundlesRecorded, &bundlesReplayed);
+		char bundleText[128];
+		sprintf_s(bundleText, "Draw bundles: %zu recorded, %zu replayed\n", bundlesRecorded, bundlesReplayed);
+		::OutputDebugStringA(bundleText);
+
+		size_t indirectRecords, indirectCalls, indirectCulled;
+		mIndirectDraws.TakeCounts(&indirectRecords, &indirectCalls, &indirectCulled);
+		char indirectText[128];
+		sprintf_s(indirectText, "Indirect draws per frame: %.1f records, %.1f ExecuteIndirect, %.1f culled\n",
+			indirectRecords / fps, indirectCalls / fps, indirectCulled / fps);
+		::OutputDebugStringA(indirectText);
+
+		char latencyText[128];
+		sprintf_s(latencyText, "Input to present: %.2f ms average, %.2f ms max\n", latencySum / frameCnt, latencyMax);
+		::OutputDebugStringA(latencyText);
+
 		// Reset for next average.
 		frameCnt = 0;
+		latencySum = 0.0;
+		latencyMax = 0.0;
 		timeElapsed += 1.0f;
 	}
 }
@@ -703,8 +1045,8 @@ ComPtr<ID3D12Resource> GraphicEngine::CreateDefaultBuffer(
 
 	// Note: uploadBuffer has to be kept alive after the above function calls because
 	// the command list has not been executed yet that performs the actual copy.
-	// The caller can Release the uploadBuffer after it knows the copy has been executed.
-
+	// The timeline takes it over and releases it once the copy has been executed.
+	mTimeline.DeferRelease(uploadBuffer);
 
 	return defaultBuffer;
 }
@@ -758,6 +1100,7 @@ UpdateSubresources(mCommandList.Get(), defaultBuffer.Get(), uploadBuffer.Get(),
 	0, 0, num2DSubresources, &subResourceData);
 mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
 	D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+mTimeline.DeferRelease(uploadBuffer);
 
 return defaultBuffer;
 }
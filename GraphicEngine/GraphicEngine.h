@@ -12,8 +12,18 @@
 #include "Camera.h"
 #include "Macro.h"
 #include "ConstantBuffer.h"
-
-static const int SwapChainBufferCount = 2;
+#include "GpuTimeline.h"
+#include "TextureStreamer.h"
+#include "AssetLoader.h"
+#include "TextureIndex.h"
+#include "PipelineBuilder.h"
+#include "JobSystem.h"
+#include "CommandListPool.h"
+#include "RenderGraphHeap.h"
+#include "FramePacket.h"
+#include "DrawBundles.h"
+#include "IndirectDraws.h"
+#include <atomic>
 
 class GraphicEngine
 {
@@ -23,11 +33,17 @@ public:
 	GraphicEngine();
 	bool Init(int Width, int Height, HWND wnd, D3D_FEATURE_LEVEL level);
 	void InitDescriptorHeap(int Srvsize, int RtvSize, int DsvSize);
-	void Run();
-	void Update(const GameTimer& Timer);
+	// Game thread: advances the clock, applies input and fills packet.
+	void Simulate(FramePacket& packet);
+	// Render thread: makes packet the frame being rendered and packs its
+	// constants. The frame resource must be free already.
+	void BeginFrame(const FramePacket& packet);
+	// Render thread, after Present.
+	void EndFrame(const FramePacket& packet);
 	void Flush();
 
-	//camera
+	//camera; the setters move the game's camera, the getters read the one of
+	// the frame being rendered.
 	void SetPosition(float x, float y, float z);
 	void SetPosition(const XMFLOAT3& v);
 	void SetLens(float fovY, float aspect, float zn, float zf);
@@ -36,7 +52,8 @@ public:
 	XMVECTOR GetPosition()const;
 	XMFLOAT3 GetPosition3f()const;
 
-	// Convenience overrides for handling mouse input.
+	// Convenience overrides for handling mouse input. They run on the window
+	// thread and only queue the drag for the game thread.
 	//void OnMouseDown(WPARAM btnState, int x, int y);
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
@@ -63,38 +80,59 @@ public:
 	LoadTexture* GetTextureList() { return &TextureList; }
 	DescriptorHeap* GetDescriptorHeap() { return mDescriptorHeap; }
 	ShaderState* GetShader() { return &mShader; }
-	Camera* GetCamera() { return &mCamera; }
+	Camera* GetCamera() { return &mFrameCamera; }
 	FrameResource* GetFrameResource() { return mFrameResource; }
 	ID3D12DescriptorHeap* GetSrvDescHeap() { return GetDescriptorHeap()->GetSrvDescHeap(); }
-	ID3D12Fence* GetFence() { return m_Fence.Get(); }
-	UINT64 GetCurrentFence() { return m_CurrentFence; }
-	GameTimer& GetTimer() { return mTimer; }
+	ID3D12Fence* GetFence() { return mTimeline.GetFence(); }
+	UINT64 GetCurrentFence() { return mTimeline.GetLastSignaledValue(); }
+	GpuTimeline* GetTimeline() { return &mTimeline; }
+	TextureStreamer* GetTextureStreamer() { return &mTextureStreamer; }
+	AssetLoader* GetAssetLoader() { return &mAssetLoader; }
+	const TextureIndex* GetTextureIndex() const { return &mTextureIndex; }
+	PipelineBuilder* GetPipelineBuilder() { return &mPipelineBuilder; }
+	JobSystem* GetJobs() { return &mJobs; }
+	CommandListPool* GetCommandListPool() { return &mCommandListPool; }
+	RenderGraphHeap* GetRenderGraph() { return &mRenderGraph; }
 	ID3D12RootSignature* GetBaseRootSignature() { return mBaseRootSignature.Get(); }
 
-	UINT64 IncreaseFence() { return ++m_CurrentFence; }
 	void SendCommandAndFulsh();
 	int GetCurrBackBufferIndex() { return mCurrBackBufferIndex; }
 	void SetCurrBackBufferIndex()
 	{
-		mCurrBackBufferIndex = (mCurrBackBufferIndex + 1) % SwapChainBufferCount;
+		mCurrBackBufferIndex = (mCurrBackBufferIndex + 1) % (int)mSwapChainBuffer.size();
 	}
 	ID3D12Resource* CurrentBackBuffer()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE CurrentBackBufferView()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView()const;
 
-	void DrawRenderItems(RenderLayer layer/*ID3D12GraphicsCommandList* cmdList, *//*const std::vector<unique_ptr<RenderItem>>& ritems*/);
-	void UpdateObjectCBs(const GameTimer& Timer);
+	// Items [begin, end) of layer, so a pass can split its draws over several lists.
+	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, RenderLayer layer, size_t begin = 0, size_t end = SIZE_MAX);
+	// The same draws, for pso which the caller has set as well. Items outside
+	// the frustum of cullViewProj are skipped, the rest go through one
+	// ExecuteIndirect per topology, front to back. With "-noindirect", or if
+	// that fails, they are replayed from a bundle instead, which only the
+	// first frames, and those after the items or their constant buffers
+	// changed, record again.
+	void ExecuteRenderItems(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* pso, RenderLayer layer,
+		size_t begin = 0, size_t end = SIZE_MAX, const XMFLOAT4X4* cullViewProj = nullptr);
+	size_t GetRenderItemCount(RenderLayer layer) { return mRitemLayer[(int)layer].size(); }
+	void UpdateObjectCBs(const FramePacket& packet);
 	void UpdateMaterialBuffer(const GameTimer& Timer);
-	void UpdateMainPassCB(const GameTimer& Timer);
-	void UpdateShaderParameter(const GameTimer& Timer);
+	void UpdateMainPassCB(const FramePacket& packet);
+	void UpdateShaderParameter(const FramePacket& packet);
+	void UpdateTextureStreaming(const FramePacket& packet);
 	void CreateShaderParameter();
 	void AddRenderItem(RenderLayer layer, unique_ptr<RenderItem>& item);
+	// Merges static opaque items sharing a material and a cellSize grid cell
+	// into world space meshes, at most byteBudget bytes of them, and logs the
+	// result. Call once the scene is added, before CreateShaderParameter.
+	void BakeStaticBatches(float cellSize, size_t byteBudget);
 	void BuildBaseRootSignature();
 	array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GetStaticSamplers();
 
-	void SetBaseRootSignature0();
-	void SetBaseRootSignature1();
-	void SetBaseRootSignature3();
+	void SetBaseRootSignature0(ID3D12GraphicsCommandList* cmdList);
+	void SetBaseRootSignature1(ID3D12GraphicsCommandList* cmdList);
+	void SetBaseRootSignature3(ID3D12GraphicsCommandList* cmdList);
 
 	UINT mRtvDescriptorSize = 0;
 	UINT mDsvDescriptorSize = 0;
@@ -113,11 +151,12 @@ public:
 private:
 	bool InitDevice();
 	void InitGPUCommand();
+	void InitTextureIndex();
 	void InitDesHeap();
 	void InitSwapchainAndRvt();
 	void InitDsv();
 	void InitViewportAndScissor();
-	void CalculateFrameStats();
+	void CalculateFrameStats(const FramePacket& packet);
 
 	ComPtr<IDXGIFactory4>               m_DxgiFactory;
 	std::wstring                                        m_AdapterDescription;
@@ -125,8 +164,23 @@ private:
 	ComPtr<ID3D12Device>                m_D3DDevice;
 	D3D_FEATURE_LEVEL                                   m_D3DMinFeatureLevel;
 
-	ComPtr<ID3D12Fence> m_Fence;
-	UINT64 m_CurrentFence = 0;
+	GpuTimeline mTimeline;
+	TextureStreamer mTextureStreamer;
+	AssetLoader mAssetLoader;
+	TextureIndex mTextureIndex;
+	PipelineBuilder mPipelineBuilder;
+	// Per frame work; the window thread is participant 0.
+	JobSystem mJobs;
+	// Lists for passes recorded on mJobs.
+	CommandListPool mCommandListPool;
+	// Frame passes and the transient textures they share memory through.
+	RenderGraphHeap mRenderGraph;
+	// Replayed by ExecuteRenderItems unless "-nobundles" was given.
+	DrawBundles mDrawBundles;
+	bool mUseBundles = true;
+	// Used by ExecuteRenderItems before bundles unless "-noindirect" was given.
+	IndirectDraws mIndirectDraws;
+	bool mUseIndirect = true;
 
 	ComPtr<ID3D12CommandQueue> mCommandQueue;
 	ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
@@ -134,26 +188,48 @@ private:
 
 	ComPtr<IDXGISwapChain> mSwapChain;
 	int mCurrBackBufferIndex = 0;
-	ComPtr<ID3D12Resource> mSwapChainBuffer[SwapChainBufferCount];
+	// One more than frames in flight, so Present rarely waits for a buffer.
+	vector<ComPtr<ID3D12Resource>> mSwapChainBuffer;
+	// First of the swap chain's RTVs, one per buffer.
+	int mSwapChainRtv = -1;
 
 	ComPtr<ID3D12Resource> mDepthStencilBuffer;
+	int mDepthStencilDsv = -1;
 
 	D3D12_VIEWPORT mScreenViewport;
 	D3D12_RECT mScissorRect;
 
 	HWND      mhMainWnd = nullptr; // main window handle
+	// Moved by the game thread; mFrameCamera is its copy in the packet rendered.
 	Camera mCamera;
+	Camera mFrameCamera;
+	// The packet being rendered, from BeginFrame to EndFrame.
+	const FramePacket* mFramePacket = nullptr;
 	LoadTexture TextureList;
 	DescriptorHeap* mDescriptorHeap;
 	ShaderState mShader;
 	FrameResource* mFrameResource;
 	POINT mLastMousePos;
+	// Mouse drag in pixels not yet applied to mCamera.
+	std::atomic<int> mMouseDx;
+	std::atomic<int> mMouseDy;
+	// Game thread state.
 	GameTimer mTimer;
+	UINT64 mSimulatedFrames = 0;
+	XMFLOAT4 mAmbientLight;
+	Light mLights[MaxLights];
 	std::unique_ptr< ConstantBuffer<CBPerPass> > mCBPerPass = nullptr;
 	std::unique_ptr< ConstantBuffer<CBPerObject> > mCBPerObject = nullptr;
 	std::unique_ptr< ConstantBuffer<CBMaterial> > mCBMaterial = nullptr;
 	CBPerPass mMainPassCB;  // index 0 of pass cbuffer.
 	std::vector<unique_ptr<RenderItem>> mRitemLayer[(int)RenderLayer::Count];
+	// Each material of this frame once, with the SRV its diffuse map binds.
+	struct FrameMaterial
+	{
+		LoadMaterial* Mat;
+		int DiffuseSrvIndex;
+	};
+	std::vector<FrameMaterial> mFrameMaterials;
 	ComPtr<ID3D12RootSignature> mBaseRootSignature;
 
 };
@@ -0,0 +1,88 @@
+#include "IndirectDraws.h"
+
+static_assert(sizeof(IndirectDraws::Command) == 56, "Command must match the command signature layout");
+
+void IndirectDraws::Init(ID3D12Device* device, ID3D12RootSignature* rootSignature, UINT objectIndexParameter)
+{
+	mDevice = device;
+
+	D3D12_INDIRECT_ARGUMENT_DESC arguments[4] = {};
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+	arguments[0].VertexBuffer.Slot = 0;
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+	arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[2].Constant.RootParameterIndex = objectIndexParameter;
+	arguments[2].Constant.DestOffsetIn32BitValues = 0;
+	arguments[2].Constant.Num32BitValuesToSet = 1;
+	arguments[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC desc = {};
+	desc.ByteStride = sizeof(Command);
+	desc.NumArgumentDescs = _countof(arguments);
+	desc.pArgumentDescs = arguments;
+	ThrowIfFailed(device->CreateCommandSignature(&desc, rootSignature, IID_PPV_ARGS(&mSignature)));
+}
+
+bool IndirectDraws::Draw(ID3D12GraphicsCommandList* cmdList, const DrawBundles::Key& key, size_t count,
+	const float (*planes)[4], size_t planeCount, const Describer& describe, const Writer& write)
+{
+	Batch* batch;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		unique_ptr<Batch>& entry = mBatches[key];
+		if (entry == nullptr)
+			entry = make_unique<Batch>();
+		batch = entry.get();
+	}
+
+	batch->Items.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		describe((uint32_t)i, batch->Items[i]);
+	batch->Builder.Build(batch->Items, planes, planeCount);
+	const vector<uint32_t>& order = batch->Builder.GetOrder();
+	mCulled += batch->Builder.GetCulledCount();
+	if (order.empty())
+		return true;
+
+	if (batch->Capacity < order.size())
+	{
+		// The old buffer was last read by the previous use of key.Frame, which
+		// the GPU is past.
+		size_t capacity = max(order.size(), batch->Capacity * 2);
+		ComPtr<ID3D12Resource> arguments;
+		HRESULT hr = mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(capacity * sizeof(Command)),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&arguments));
+		Command* mapped = nullptr;
+		if (SUCCEEDED(hr))
+			hr = arguments->Map(0, nullptr, reinterpret_cast<void**>(&mapped));
+		if (FAILED(hr))
+			return false;
+		batch->Arguments = arguments;
+		batch->Mapped = mapped;
+		batch->Capacity = capacity;
+	}
+
+	for (size_t i = 0; i < order.size(); ++i)
+		write(order[i], batch->Mapped[i]);
+	mRecords += order.size();
+
+	for (const IndirectDrawBuilder::Range& range : batch->Builder.GetRanges())
+	{
+		cmdList->IASetPrimitiveTopology((D3D12_PRIMITIVE_TOPOLOGY)range.Group);
+		cmdList->ExecuteIndirect(mSignature.Get(), range.Count, batch->Arguments.Get(), range.First * sizeof(Command), nullptr, 0);
+		++mCalls;
+	}
+	return true;
+}
+
+void IndirectDraws::TakeCounts(size_t* records, size_t* calls, size_t* culled)
+{
+	*records = mRecords.exchange(0);
+	*calls = mCalls.exchange(0);
+	*culled = mCulled.exchange(0);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "framework.h"
+#include "DrawBundles.h"
+#include "IndirectDrawBuilder.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+// Draws ranges of render items with ExecuteIndirect. IndirectDrawBuilder culls
+// and orders the items on the CPU, then one Command per visible item goes into
+// an upload buffer and each group is a single ExecuteIndirect. A compute pass
+// culling on the GPU can write the same Commands into a default buffer, along
+// with a count buffer, and execute them with the same signature.
+class IndirectDraws
+{
+public:
+	// One argument record, laid out in command signature order; every field is
+	// naturally aligned, so the struct has no padding. The object's data is
+	// found through ObjectIndex, so no root descriptor changes per draw.
+	struct Command
+	{
+		D3D12_VERTEX_BUFFER_VIEW VertexBuffer;
+		D3D12_INDEX_BUFFER_VIEW IndexBuffer;
+		UINT ObjectIndex;
+		D3D12_DRAW_INDEXED_ARGUMENTS Draw;
+	};
+
+	typedef std::function<void(uint32_t item, IndirectDrawBuilder::Item& bounds)> Describer;
+	typedef std::function<void(uint32_t item, Command& command)> Writer;
+
+	IndirectDraws() : mRecords(0), mCalls(0), mCulled(0) {}
+	// The signature sets the single root constant at objectIndexParameter of
+	// rootSignature.
+	void Init(ID3D12Device* device, ID3D12RootSignature* rootSignature, UINT objectIndexParameter);
+	// Draws count items: describe gives each one's group and bounds, write its
+	// record if it is visible. A group is the primitive topology the caller set
+	// it to. key.Frame picks the argument buffer, the GPU must be past its last
+	// use. False if the buffer could not be made, nothing was drawn then.
+	// Different threads may draw different keys at once.
+	bool Draw(ID3D12GraphicsCommandList* cmdList, const DrawBundles::Key& key, size_t count,
+		const float (*planes)[4], size_t planeCount, const Describer& describe, const Writer& write);
+	// Records written, ExecuteIndirect calls made and items culled since the last call.
+	void TakeCounts(size_t* records, size_t* calls, size_t* culled);
+
+private:
+	struct Batch
+	{
+		vector<IndirectDrawBuilder::Item> Items;
+		IndirectDrawBuilder Builder;
+		ComPtr<ID3D12Resource> Arguments;
+		Command* Mapped = nullptr;
+		size_t Capacity = 0;
+	};
+
+	ID3D12Device* mDevice = nullptr;
+	ComPtr<ID3D12CommandSignature> mSignature;
+	// Entries are never removed, so a Batch stays where it is once created.
+	std::mutex mMutex;
+	unordered_map<DrawBundles::Key, unique_ptr<Batch>, DrawBundles::KeyHash> mBatches;
+	std::atomic<size_t> mRecords;
+	std::atomic<size_t> mCalls;
+	std::atomic<size_t> mCulled;
+};
@@ -15,10 +15,17 @@ void LoadMaterial::AddMaterial(string name, int CBIndex, XMFLOAT4& diffuse, XMFL
 
 void LoadMaterial::SetDiffuseSrv(const wchar_t* file)
 {
-	DiffuseSrvHeapIndex = GetEngine()->GetTextureList()->Load(file);
+	// Load before releasing, re-setting the same file must not evict it.
+	int index = GetEngine()->GetTextureList()->Load(file);
+	GetEngine()->GetTextureList()->Release(DiffuseSrvHeapIndex);
+	DiffuseSrvHeapIndex = index;
+	if (!GetEngine()->GetTextureList()->GetAtlasTransform(file, AtlasTransform))
+		AtlasTransform = MathHelper::Identity4x4();
 }
 
 void LoadMaterial::SetNormaSrv(const wchar_t* file)
 {
-	NormalSrvHeapIndex = GetEngine()->GetTextureList()->Load(file);
+	int index = GetEngine()->GetTextureList()->Load(file);
+	GetEngine()->GetTextureList()->Release(NormalSrvHeapIndex);
+	NormalSrvHeapIndex = index;
 }
@@ -31,6 +31,9 @@ public:
 		float Roughness = .25f;
 		float SsrAttr = 0.0f;
 		XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+		// UV remap into a texture atlas when the diffuse texture was packed into one,
+		// applied after MatTransform.
+		XMFLOAT4X4 AtlasTransform = MathHelper::Identity4x4();
 
 private:
 	
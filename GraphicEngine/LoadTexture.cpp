@@ -1,33 +1,321 @@
 #include "LoadTexture.h"
 #include "DDSTextureLoader.h"
 #include "GraphicEngine.h"
+#include "TexturePacker.h"
 
 int LoadTexture::Load(const wchar_t* file)
 {
+	return LoadCached(file, false);
+}
+
+int LoadTexture::LoadCure(const wchar_t* file)
+{
+	return LoadCached(file, true);
+}
+
+wstring LoadTexture::NormalizePath(const wchar_t* file, bool isCube)
+{
+	// Lower case, one separator, no "." and resolved "..": "Source\\Textures/./tile.DDS"
+	// and "source/Textures/tile.dds" must land on the same key.
+	vector<wstring> parts;
+	wstring part;
+	for (const wchar_t* c = file; ; ++c)
+	{
+		if (*c == L'/' || *c == L'\\' || *c == 0)
+		{
+			if (part == L"..")
+			{
+				if (!parts.empty() && parts.back() != L"..")
+					parts.pop_back();
+				else
+					parts.push_back(part);
+			}
+			else if (!part.empty() && part != L".")
+			{
+				parts.push_back(part);
+			}
+			part.clear();
+			if (*c == 0)
+				break;
+		}
+		else
+		{
+			part.push_back((wchar_t)towlower(*c));
+		}
+	}
+
+	wstring key;
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		if (i > 0)
+			key.push_back(L'/');
+		key += parts[i];
+	}
+	// The same file viewed as a cube map is a different SRV.
+	if (isCube)
+		key += L"|cube";
+	return key;
+}
+
+UINT64 LoadTexture::HashContent(const uint8_t* data, size_t size)
+{
+	return TextureIndex::HashContent(data, size);
+}
+
+void LoadTexture::Reserve(size_t count)
+{
+	TextureList.reserve(count);
+	mPathToIndex.reserve(count);
+	mHashToIndex.reserve(count);
+}
+
+int LoadTexture::AddReference(Texture& tex, const wstring& key, bool contentHit)
+{
+	++tex.RefCount;
+	if (contentHit)
+	{
+		++mStats.ContentHits;
+		tex.Keys.push_back(key);
+		mPathToIndex[key] = tex.DescriptorIndex;
+	}
+	else
+	{
+		++mStats.PathHits;
+	}
+	mStats.BytesSaved += tex.GpuBytes;
+	return tex.DescriptorIndex;
+}
+
+int LoadTexture::LoadCached(const wchar_t* file, bool isCube)
+{
+	++mStats.Requests;
+
+	wstring key = NormalizePath(file, isCube);
+	auto pathIt = mPathToIndex.find(key);
+	if (pathIt != mPathToIndex.end())
+		return AddReference(TextureList[pathIt->second], key, false);
+
+	// Unknown path: the loader mapped the file, hashed it and filled the upload
+	// heap, on a worker if it was prefetched. It is either a copy of something we
+	// already have or the data we are going to upload.
+	unique_ptr<AssetLoader::PreparedTexture> prepared = GetEngine()->GetAssetLoader()->TakeTexture(file, isCube);
+	ThrowIfFailed(prepared->Hr);
+	const MappedFile& fileData = prepared->File;
+	size_t fileSize = fileData.GetSize();
+
+	UINT64 hash = prepared->ContentHash;
+	if (isCube)
+		hash = hash * 1099511628211ull + 1;
+
+	auto hashIt = mHashToIndex.find(hash);
+	if (hashIt != mHashToIndex.end())
+	{
+		Texture& tex = TextureList[hashIt->second];
+		if (tex.FileBytes == fileSize)
+			return AddReference(tex, key, true);
+	}
+
 	Texture texMap;
 	texMap.Filename = file;
-	ThrowIfFailed(CreateDDSTextureFromFile12(GetEngine()->GetDevice(),
-		GetEngine()->GetCommandList(), file,
-		texMap.Resource, texMap.UploadHeap));
+	RecordDDSTextureUpload12(GetEngine()->GetCommandList(), prepared->Upload);
+	texMap.Resource = prepared->Upload.Texture;
+	texMap.UploadHeap = prepared->Upload.UploadHeap;
+	// 2D textures start with their mip tail only and stream the rest on demand.
+	if (prepared->Streamed)
+		texMap.StreamId = GetEngine()->GetTextureStreamer()->AddTail(file, fileData.GetData(), fileSize, prepared->TailMip);
+	GetEngine()->GetTimeline()->DeferRelease(texMap.UploadHeap);
 
-	texMap.DescriptorIndex = SetTexDescriptor(texMap.Resource.Get());
-	TextureList.push_back(move(texMap));
+	D3D12_RESOURCE_DESC desc = texMap.Resource->GetDesc();
+	texMap.GpuBytes = GetEngine()->GetDevice()->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+	texMap.DescriptorIndex = isCube ? SetCubeTexDescriptor(texMap.Resource.Get()) : SetTexDescriptor(texMap.Resource.Get());
+	texMap.RefCount = 1;
+	texMap.IsCube = isCube;
+	texMap.ContentHash = hash;
+	texMap.FileBytes = fileSize;
+	texMap.Keys.push_back(key);
+	if (texMap.StreamId >= 0)
+		GetEngine()->GetTextureStreamer()->Bind(texMap.StreamId, texMap.DescriptorIndex);
 
-	return TextureList.back().DescriptorIndex;
+	int index = texMap.DescriptorIndex;
+	mStats.BytesResident += texMap.GpuBytes;
+	mPathToIndex[key] = index;
+	mHashToIndex[hash] = index;
+	TextureList[index] = move(texMap);
+	return index;
 }
 
-int LoadTexture::LoadCure(const wchar_t* file)
+int LoadTexture::LoadAtlas(const wchar_t* name, const vector<wstring>& files)
 {
+	++mStats.Requests;
+
+	wstring atlasKey = NormalizePath(name, false);
+	auto pathIt = mPathToIndex.find(atlasKey);
+	if (pathIt != mPathToIndex.end())
+		return AddReference(TextureList[pathIt->second], atlasKey, false);
+
+	// Level 0 of every member as RGBA8; their own mips are rebuilt for the atlas.
+	vector<vector<uint8_t>> images(files.size());
+	vector<TexturePacker::Size> sizes(files.size());
+	bool srgb = false;
+	UINT64 fileBytes = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		MappedFile file;
+		DDSFileView view;
+		vector<DDSSubresource> subresources;
+		if (!file.Open(files[i].c_str()))
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+		if (!view.Parse(file.GetData(), file.GetSize()) || !view.GetSubresources(subresources) ||
+			view.IsCube() || view.GetDepth() != 1)
+			ThrowIfFailed(E_FAIL);
+
+		DXGI_FORMAT format = (DXGI_FORMAT)view.GetDxgiFormat();
+		if (i > 0 && AssetLoader::IsSRGBFormat(format) != srgb)
+			ThrowIfFailed(E_INVALIDARG);
+		srgb = AssetLoader::IsSRGBFormat(format);
+		if (!AssetLoader::ExpandToRGBA8(format, subresources[0], images[i]))
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+		sizes[i] = { subresources[0].Width, subresources[0].Height };
+		fileBytes += file.GetSize();
+	}
+
+	TexturePacker::Options options;
+	UINT atlasWidth = 0, atlasHeight = 0;
+	vector<TexturePacker::Placement> placements;
+	if (!TexturePacker::Pack(sizes, options, atlasWidth, atlasHeight, placements))
+		ThrowIfFailed(E_OUTOFMEMORY);
+
+	vector<uint8_t> atlas((size_t)atlasWidth * atlasHeight * 4);
+	for (size_t i = 0; i < files.size(); ++i)
+		TexturePacker::Blit(images[i].data(), (size_t)sizes[i].Width * 4, placements[i], atlas.data(), atlasWidth);
+
+	// Box filtering keeps each cell to itself down to the last level with a gutter.
+	vector<vector<MipLevel>> chains(1);
+	MipGenerator::Options mipOptions;
+	mipOptions.Kernel = MipGenerator::Filter::Box;
+	mipOptions.SRGB = srgb;
+	mipOptions.MaxLevels = TexturePacker::GetMipCount(options, atlasWidth, atlasHeight);
+	MipGenerator::Generate(atlas.data(), atlasWidth, atlasHeight, (size_t)atlasWidth * 4, mipOptions, chains[0]);
+
+	DXGI_FORMAT blockFormat;
+	if (AssetLoader::HasAlpha(chains))
+		blockFormat = srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	else
+		blockFormat = srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	DDSTextureUpload12 upload;
+	ThrowIfFailed(AssetLoader::PrepareChainUpload(chains, blockFormat, srgb, upload));
+	RecordDDSTextureUpload12(GetEngine()->GetCommandList(), upload);
+
 	Texture texMap;
-	texMap.Filename = file;
-	ThrowIfFailed(CreateDDSTextureFromFile12(GetEngine()->GetDevice(),
-		GetEngine()->GetCommandList(), file,
-		texMap.Resource, texMap.UploadHeap));
+	texMap.Filename = name;
+	texMap.Resource = upload.Texture;
+	texMap.UploadHeap = upload.UploadHeap;
+	GetEngine()->GetTimeline()->DeferRelease(texMap.UploadHeap);
+
+	D3D12_RESOURCE_DESC desc = texMap.Resource->GetDesc();
+	texMap.GpuBytes = GetEngine()->GetDevice()->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+	texMap.DescriptorIndex = SetTexDescriptor(texMap.Resource.Get());
+	texMap.RefCount = 1;
+	texMap.FileBytes = fileBytes;
+	texMap.Keys.push_back(atlasKey);
 
-	texMap.DescriptorIndex = SetCubeTexDescriptor(texMap.Resource.Get());
-	TextureList.push_back(move(texMap));
+	// Members resolve to the atlas through the path cache, their keys go with it.
+	int index = texMap.DescriptorIndex;
+	mPathToIndex[atlasKey] = index;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		wstring key = NormalizePath(files[i].c_str(), false);
+		const TexturePacker::Placement& p = placements[i];
+		XMStoreFloat4x4(&mAtlasTransforms[key],
+			XMMatrixScaling(p.ScaleU, p.ScaleV, 1.0f) * XMMatrixTranslation(p.OffsetU, p.OffsetV, 0.0f));
+		mPathToIndex[key] = index;
+		texMap.Keys.push_back(key);
+	}
 
-	return TextureList.back().DescriptorIndex;
+	char buffer[256];
+	sprintf_s(buffer, "Texture atlas: %S, %zu textures in %ux%u, %u mips\n", name, files.size(),
+		atlasWidth, atlasHeight, (UINT)chains[0].size());
+	::OutputDebugStringA(buffer);
+
+	mStats.BytesResident += texMap.GpuBytes;
+	TextureList[index] = move(texMap);
+	return index;
+}
+
+bool LoadTexture::GetAtlasTransform(const wchar_t* file, XMFLOAT4X4& transform) const
+{
+	auto it = mAtlasTransforms.find(NormalizePath(file, false));
+	if (it == mAtlasTransforms.end())
+		return false;
+	transform = it->second;
+	return true;
+}
+
+LoadTexture::Texture* LoadTexture::Find(int descriptorIndex)
+{
+	auto it = TextureList.find(descriptorIndex);
+	return it == TextureList.end() ? nullptr : &it->second;
+}
+
+void LoadTexture::AddRef(int descriptorIndex)
+{
+	Texture* tex = Find(descriptorIndex);
+	if (tex)
+		++tex->RefCount;
+}
+
+void LoadTexture::Release(int descriptorIndex)
+{
+	Texture* tex = Find(descriptorIndex);
+	if (tex == nullptr || --tex->RefCount > 0)
+		return;
+
+	// An atlas may have taken over a path this texture was also loaded from.
+	for (auto& key : tex->Keys)
+	{
+		auto pathIt = mPathToIndex.find(key);
+		if (pathIt != mPathToIndex.end() && pathIt->second == descriptorIndex)
+		{
+			mPathToIndex.erase(pathIt);
+			mAtlasTransforms.erase(key);
+		}
+	}
+	auto hashIt = mHashToIndex.find(tex->ContentHash);
+	if (hashIt != mHashToIndex.end() && hashIt->second == descriptorIndex)
+		mHashToIndex.erase(hashIt);
+
+	// Frames in flight may still sample it, both go away once the GPU is done.
+	GetEngine()->GetTimeline()->DeferRelease(tex->Resource);
+	GetEngine()->GetDescriptorHeap()->FreeSrv(descriptorIndex);
+	if (tex->StreamId >= 0)
+		GetEngine()->GetTextureStreamer()->Remove(tex->StreamId);
+
+	++mStats.Evictions;
+	mStats.BytesResident -= tex->GpuBytes;
+	TextureList.erase(descriptorIndex);
+}
+
+int LoadTexture::GetSrvIndex(int descriptorIndex)
+{
+	Texture* tex = Find(descriptorIndex);
+	if (tex == nullptr || tex->StreamId < 0)
+		return descriptorIndex;
+	return GetEngine()->GetTextureStreamer()->GetSrvIndex(tex->StreamId);
+}
+
+int LoadTexture::GetStreamId(int descriptorIndex)
+{
+	Texture* tex = Find(descriptorIndex);
+	return tex ? tex->StreamId : -1;
+}
+
+void LoadTexture::LogStats() const
+{
+	char buffer[256];
+	sprintf_s(buffer, "Texture cache: %llu requests, %.1f%% hit (%llu path, %llu content), %llu evicted, %.2f MB resident, %.2f MB saved\n",
+		mStats.Requests, mStats.GetHitRate() * 100.0f, mStats.PathHits, mStats.ContentHits, mStats.Evictions,
+		mStats.BytesResident / (1024.0 * 1024.0), mStats.BytesSaved / (1024.0 * 1024.0));
+	::OutputDebugStringA(buffer);
 }
 
 int LoadTexture::SetTexDescriptor(ID3D12Resource* tex)
@@ -40,8 +328,9 @@ int LoadTexture::SetTexDescriptor(ID3D12Resource* tex)
 
 	srvDesc.Format = tex->GetDesc().Format;
 	srvDesc.Texture2D.MipLevels = tex->GetDesc().MipLevels;
-	GetEngine()->GetDevice()->CreateShaderResourceView(tex, &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	return GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+	int index = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateShaderResourceView(tex, &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(index));
+	return index;
 }
 
 int LoadTexture::SetCubeTexDescriptor(ID3D12Resource* tex)
@@ -54,9 +343,7 @@ int LoadTexture::SetCubeTexDescriptor(ID3D12Resource* tex)
 	srvDesc.TextureCube.MipLevels = tex->GetDesc().MipLevels;
 	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
 	srvDesc.Format = tex->GetDesc().Format;
-	GetEngine()->GetDevice()->CreateShaderResourceView(tex, &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle());
-	return GetEngine()->GetDescriptorHeap()->GetSrvDescriptorIndex();
+	int index = GetEngine()->GetDescriptorHeap()->SetSrvDescriptorIndex();
+	GetEngine()->GetDevice()->CreateShaderResourceView(tex, &srvDesc, GetEngine()->GetDescriptorHeap()->GetSrvDescriptorCpuHandle(index));
+	return index;
 }
-
-
-
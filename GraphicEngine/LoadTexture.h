@@ -1,13 +1,29 @@
 #pragma once
 #include "framework.h"
 
+// Texture cache. Files are looked up by normalized path first and by content
+// hash second, so the same file reached through different paths, or two copies
+// of the same file, share one resource and one SRV. The SRV heap index doubles
+// as the handle: Load/LoadCure add a reference, Release drops one and the
+// texture is evicted when the last reference goes away.
 class LoadTexture
 {
 public:
 	int Load(const wchar_t* file);
 	int LoadCure(const wchar_t* file);
+	// Packs small 2D textures into one atlas texture under name and returns its
+	// handle. Afterwards Load on any of the files returns the atlas as well, and
+	// GetAtlasTransform gives the UV remap into it for the material.
+	int LoadAtlas(const wchar_t* name, const vector<wstring>& files);
+	bool GetAtlasTransform(const wchar_t* file, XMFLOAT4X4& transform) const;
+	void AddRef(int descriptorIndex);
+	void Release(int descriptorIndex);
 	int SetTexDescriptor(ID3D12Resource* tex);
 	int SetCubeTexDescriptor(ID3D12Resource* tex);
+	// SRV to bind for a handle this frame: the streamed detail SRV when one is
+	// resident, the handle itself otherwise.
+	int GetSrvIndex(int descriptorIndex);
+	int GetStreamId(int descriptorIndex);
 
 	struct Texture
 	{
@@ -17,8 +33,50 @@ public:
 		ComPtr<ID3D12Resource> Resource = nullptr;
 		ComPtr<ID3D12Resource> UploadHeap = nullptr;
 		int DescriptorIndex;
+		int RefCount = 0;
+		bool IsCube = false;
+		UINT64 ContentHash = 0;
+		UINT64 FileBytes = 0;
+		UINT64 GpuBytes = 0;
+		// TextureStreamer id, -1 when the whole texture was loaded up front.
+		int StreamId = -1;
+		// Every normalized path that resolved to this texture.
+		vector<wstring> Keys;
 	};
 
-	vector<Texture> TextureList;
+	struct CacheStats
+	{
+		UINT64 Requests = 0;
+		UINT64 PathHits = 0;
+		UINT64 ContentHits = 0;
+		UINT64 Evictions = 0;
+		// GPU memory the hits would have allocated as duplicates.
+		UINT64 BytesSaved = 0;
+		UINT64 BytesResident = 0;
+
+		float GetHitRate() const { return Requests ? (float)(PathHits + ContentHits) / Requests : 0.0f; }
+	};
+
+	const CacheStats& GetStats() const { return mStats; }
+	void LogStats() const;
+	Texture* Find(int descriptorIndex);
+	// FNV-1a over the file, the content key. Same hash TextureIndex stores.
+	static UINT64 HashContent(const uint8_t* data, size_t size);
+	// Sizes the lookup tables for count textures up front.
+	void Reserve(size_t count);
+
+	// Keyed by DescriptorIndex.
+	unordered_map<int, Texture> TextureList;
+
+private:
+	int LoadCached(const wchar_t* file, bool isCube);
+	int AddReference(Texture& tex, const wstring& key, bool contentHit);
+
+	static wstring NormalizePath(const wchar_t* file, bool isCube);
 
+	unordered_map<wstring, int> mPathToIndex;
+	unordered_map<UINT64, int> mHashToIndex;
+	// Atlas member path to atlas UV transform.
+	unordered_map<wstring, XMFLOAT4X4> mAtlasTransforms;
+	CacheStats mStats;
 };
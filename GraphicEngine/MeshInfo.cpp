@@ -3,15 +3,12 @@
 #include "GeometryGenerator.h"
 #include "ResourceStruct.h"
 
-void MeshInfo::LoadTextMesh(const char* file)
+bool MeshInfo::ParseTextMesh(const char* file, vector<Vertex>& vertices, vector<int32_t>& indices, BoundingSphere& sphereBounds)
 {
 	ifstream fin(file);
 
 	if (!fin)
-	{
-		MessageBox(0, L"file not found.", 0, 0);
-		//return nullptr;
-	}
+		return false;
 
 	UINT vcount = 0;
 	UINT tcount = 0;
@@ -27,7 +24,7 @@ void MeshInfo::LoadTextMesh(const char* file)
 	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
 	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
 
-	vector<Vertex> vertices(vcount);
+	vertices.resize(vcount);
 	for (UINT i = 0; i < vcount; ++i)
 	{
 		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
@@ -37,8 +34,6 @@ void MeshInfo::LoadTextMesh(const char* file)
 
 		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
 
-		XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
-
 		vMin = XMVectorMin(vMin, P);
 		vMax = XMVectorMax(vMax, P);
 	}
@@ -46,18 +41,36 @@ void MeshInfo::LoadTextMesh(const char* file)
 	BoundingBox bounds;
 	XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
 	XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
+	BoundingSphere::CreateFromBoundingBox(sphereBounds, bounds);
 
 	fin >> ignore;
 	fin >> ignore;
 	fin >> ignore;
 
-	vector<int32_t> indices(3 * tcount);
+	indices.resize(3 * tcount);
 	for (UINT i = 0; i < tcount; ++i)
 	{
 		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
 	}
 
 	fin.close();
+	return true;
+}
+
+void MeshInfo::LoadTextMesh(const char* file)
+{
+	// Parsed on a loader thread when it was prefetched, right here otherwise.
+	unique_ptr<AssetLoader::PreparedMesh> mesh = GetEngine()->GetAssetLoader()->TakeMesh(file);
+
+	if (!mesh->Loaded)
+	{
+		MessageBox(0, L"file not found.", 0, 0);
+		//return nullptr;
+	}
+
+	vector<Vertex>& vertices = mesh->Vertices;
+	vector<int32_t>& indices = mesh->Indices;
+	Bounds = mesh->Bounds;
 
 	//
 	// Pack the indices of all the meshes into one index buffer.
@@ -104,6 +117,7 @@ void MeshInfo::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 	vector<uint16_t> indices;
 
 	indices.insert(indices.end(), begin(sphere.GetIndices16()), end(sphere.GetIndices16()));
+	BoundingSphere::CreateFromPoints(Bounds, vertices.size(), &vertices[0].Pos, sizeof(Vertex));
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 	Name = "sphere";
@@ -143,6 +157,7 @@ void MeshInfo::CreateGrid(float width, float depth, uint32 m, uint32 n)
 	vector<uint16_t> indices;
 
 	indices.insert(indices.end(), begin(sphere.GetIndices16()), end(sphere.GetIndices16()));
+	BoundingSphere::CreateFromPoints(Bounds, vertices.size(), &vertices[0].Pos, sizeof(Vertex));
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 	Name = "grid";
@@ -182,6 +197,7 @@ void MeshInfo::CreateBox(float width, float height, float depth, uint32 numSubdi
 	vector<uint16_t> indices;
 
 	indices.insert(indices.end(), begin(box.GetIndices16()), end(box.GetIndices16()));
+	BoundingSphere::CreateFromPoints(Bounds, vertices.size(), &vertices[0].Pos, sizeof(Vertex));
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 	Name = "grid";
@@ -201,3 +217,26 @@ void MeshInfo::CreateBox(float width, float height, float depth, uint32 numSubdi
 	IndexFormat = DXGI_FORMAT_R16_UINT;
 	IndexBufferByteSize = ibByteSize;
 }
+
+void MeshInfo::CreateFromData(const vector<Vertex>& vertices, const vector<uint32_t>& indices)
+{
+	IndexCount = (UINT)indices.size();
+	BoundingSphere::CreateFromPoints(Bounds, vertices.size(), &vertices[0].Pos, sizeof(Vertex));
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(uint32_t);
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &VertexBufferCPU));
+	CopyMemory(VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &IndexBufferCPU));
+	CopyMemory(IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+	VertexBufferGPU = GetEngine()->CreateDefaultBuffer(vertices.data(), vbByteSize, VertexBufferUploader);
+
+	IndexBufferGPU = GetEngine()->CreateDefaultBuffer(indices.data(), ibByteSize, IndexBufferUploader);
+
+	VertexByteStride = sizeof(Vertex);
+	VertexBufferByteSize = vbByteSize;
+	IndexFormat = DXGI_FORMAT_R32_UINT;
+	IndexBufferByteSize = ibByteSize;
+}
@@ -7,9 +7,13 @@ class MeshInfo
 public:
 
 	void LoadTextMesh(const char* file);
+	// CPU half of LoadTextMesh, safe on any thread. False if the file is missing.
+	static bool ParseTextMesh(const char* file, vector<Vertex>& vertices, vector<int32_t>& indices, DirectX::BoundingSphere& bounds);
 	void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
 	void CreateGrid(float width, float depth, uint32 m, uint32 n);
 	void CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+	// Takes vertices and 32 bit indices built on the CPU, e.g. by a bake.
+	void CreateFromData(const vector<Vertex>& vertices, const vector<uint32_t>& indices);
 	// Give it a name so we can look it up by name.
 	std::string Name;
 
@@ -30,6 +34,8 @@ public:
 	UINT VertexBufferByteSize = 0;
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
 	UINT IndexBufferByteSize = 0;
+	// Object space bounds, used to estimate on-screen size for texture streaming.
+	DirectX::BoundingSphere Bounds;
 
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
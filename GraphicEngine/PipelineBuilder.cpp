@@ -0,0 +1,189 @@
+#include "PipelineBuilder.h"
+#include "GraphicEngine.h"
+#include <map>
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// "SHADOWS+SSAO", or "none" for the permutation without any feature.
+static string DescribeFeatures(UINT features)
+{
+	string result;
+	for (UINT bit = 1; bit & SHADER_FEATURE_ALL; bit <<= 1)
+	{
+		if (features & bit)
+			result += (result.empty() ? "" : "+") + string(ShaderState::GetFeatureName(bit));
+	}
+	return result.empty() ? "none" : result;
+}
+
+size_t PipelineBuilder::AddShader(const wchar_t* file, const char* entryPoint, const char* target, UINT features)
+{
+	UINT declared = GetEngine()->GetShader()->GetKeywords(file);
+	features &= declared;
+	wstring key = wstring(file) + L"|" + wstring(entryPoint, entryPoint + strlen(entryPoint)) +
+		L"|" + wstring(target, target + strlen(target)) + L"|" + to_wstring(features);
+	auto it = mShaderLookup.find(key);
+	if (it != mShaderLookup.end())
+		return it->second;
+
+	Shader shader;
+	shader.File = file;
+	shader.EntryPoint = entryPoint;
+	shader.Target = target;
+	shader.Features = features;
+	shader.Declared = declared;
+	mShaders.push_back(shader);
+	mShaderLookup[key] = mShaders.size() - 1;
+	return mShaders.size() - 1;
+}
+
+void PipelineBuilder::Add(const char* name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+	const wchar_t* vsFile, const wchar_t* psFile, ComPtr<ID3D12PipelineState>* pso, UINT features)
+{
+	unique_ptr<Pipeline> pipeline(new Pipeline());
+	pipeline->Name = name;
+	pipeline->Desc = desc;
+	pipeline->VS = AddShader(vsFile, "VS", "vs_5_1", features);
+	pipeline->PS = AddShader(psFile, "PS", "ps_5_1", features);
+	pipeline->Target = pso;
+	mShaders[pipeline->VS].Users.push_back(mPipelines.size());
+	mShaders[pipeline->PS].Users.push_back(mPipelines.size());
+	mPipelines.push_back(move(pipeline));
+}
+
+void PipelineBuilder::CompileShader(size_t index)
+{
+	Shader& shader = mShaders[index];
+	vector<D3D_SHADER_MACRO> defines;
+	ShaderState::GetDefines(shader.Declared, shader.Features, defines);
+	Clock::time_point start = Clock::now();
+	shader.Hr = GetEngine()->GetShader()->TryCompileShader(shader.File, defines.data(), shader.EntryPoint, shader.Target, shader.ByteCode);
+	shader.Ms = ElapsedMs(start);
+
+	for (size_t user : shader.Users)
+	{
+		// fetch_sub returns the old value: 1 means this was the last shader missing.
+		if (mPipelines[user]->Hr == E_PENDING && mPipelines[user]->Pending.fetch_sub(1) == 1)
+			mPool.Submit([this, user]() { CreatePipeline(user); });
+	}
+}
+
+void PipelineBuilder::CreatePipeline(size_t index)
+{
+	Pipeline& pipeline = *mPipelines[index];
+	const Shader& vs = mShaders[pipeline.VS];
+	const Shader& ps = mShaders[pipeline.PS];
+	if (FAILED(vs.Hr) || FAILED(ps.Hr))
+	{
+		pipeline.Hr = FAILED(vs.Hr) ? vs.Hr : ps.Hr;
+		return;
+	}
+
+	Clock::time_point start = Clock::now();
+	pipeline.Desc.VS = { vs.ByteCode->GetBufferPointer(), vs.ByteCode->GetBufferSize() };
+	pipeline.Desc.PS = { ps.ByteCode->GetBufferPointer(), ps.ByteCode->GetBufferSize() };
+	// The device is free threaded, PSO creation included.
+	pipeline.Hr = GetEngine()->GetDevice()->CreateGraphicsPipelineState(&pipeline.Desc, IID_PPV_ARGS(&pipeline.Result));
+	pipeline.Ms = ElapsedMs(start);
+}
+
+void PipelineBuilder::Build(bool parallel)
+{
+	Clock::time_point start = Clock::now();
+	mThreadCount = parallel ? ThreadPool::GetDefaultThreadCount() : 0;
+	mPool.Start(mThreadCount);
+
+	// Counts are set before any task runs, so a fast shader cannot submit a PSO
+	// early. Shaders an earlier Build compiled do not count.
+	for (auto& pipeline : mPipelines)
+	{
+		pipeline->Pending = (mShaders[pipeline->VS].Hr == E_PENDING ? 1 : 0) +
+			(mShaders[pipeline->PS].Hr == E_PENDING ? 1 : 0);
+	}
+	for (size_t i = 0; i < mShaders.size(); ++i)
+	{
+		if (mShaders[i].Hr == E_PENDING)
+			mPool.Submit([this, i]() { CompileShader(i); });
+	}
+	for (size_t i = 0; i < mPipelines.size(); ++i)
+	{
+		if (mPipelines[i]->Hr == E_PENDING && mPipelines[i]->Pending == 0)
+			mPool.Submit([this, i]() { CreatePipeline(i); });
+	}
+	// Shader tasks submit PSO tasks, so wait for the pool to drain before stopping it.
+	mPool.WaitIdle();
+	mPool.Stop();
+	mWallMs = ElapsedMs(start);
+
+	HRESULT firstFailure = S_OK;
+	for (auto& pipeline : mPipelines)
+	{
+		if (FAILED(pipeline->Hr))
+		{
+			::OutputDebugStringA(("Pipeline build failed: " + pipeline->Name + "\n").c_str());
+			if (SUCCEEDED(firstFailure))
+				firstFailure = pipeline->Hr;
+		}
+		else if (pipeline->Result)
+		{
+			*pipeline->Target = pipeline->Result;
+			pipeline->Result = nullptr;
+		}
+	}
+	ThrowIfFailed(firstFailure);
+}
+
+void PipelineBuilder::LogTimings() const
+{
+	char buffer[512];
+	double shaderMs = 0.0;
+	for (auto& shader : mShaders)
+	{
+		sprintf_s(buffer, "Pipeline build: shader %-32S %s %8.2f ms\n", shader.File.c_str(),
+			shader.Target.c_str(), shader.Ms);
+		::OutputDebugStringA(buffer);
+		shaderMs += shader.Ms;
+	}
+	double pipelineMs = 0.0;
+	for (auto& pipeline : mPipelines)
+	{
+		sprintf_s(buffer, "Pipeline build: PSO    %-32s %8.2f ms\n", pipeline->Name.c_str(), pipeline->Ms);
+		::OutputDebugStringA(buffer);
+		pipelineMs += pipeline->Ms;
+	}
+	sprintf_s(buffer, "Pipeline build: %zu shaders %.2f ms, %zu PSOs %.2f ms, %.2f ms wall on %zu threads\n",
+		mShaders.size(), shaderMs, mPipelines.size(), pipelineMs, mWallMs, mThreadCount ? mThreadCount : 1);
+	::OutputDebugStringA(buffer);
+}
+
+void PipelineBuilder::LogPermutations() const
+{
+	char buffer[512];
+	map<wstring, vector<const Shader*>> byShader;
+	for (auto& shader : mShaders)
+	{
+		if (shader.Declared != 0)
+			byShader[shader.File + L"|" + wstring(shader.EntryPoint.begin(), shader.EntryPoint.end())].push_back(&shader);
+	}
+	size_t possible = 0, built = 0;
+	for (auto& entry : byShader)
+	{
+		const Shader& first = *entry.second.front();
+		UINT count = 0;
+		for (UINT bit = 1; bit & SHADER_FEATURE_ALL; bit <<= 1)
+			count += (first.Declared & bit) ? 1 : 0;
+		string variants;
+		for (const Shader* shader : entry.second)
+			variants += (variants.empty() ? "" : ", ") + DescribeFeatures(shader->Features);
+		sprintf_s(buffer, "Shader permutations: %-32S %s: %zu of %u built, keywords %s, built %s\n", first.File.c_str(),
+			first.EntryPoint.c_str(), entry.second.size(), 1u << count, DescribeFeatures(first.Declared).c_str(), variants.c_str());
+		::OutputDebugStringA(buffer);
+		possible += (size_t)1 << count;
+		built += entry.second.size();
+	}
+	sprintf_s(buffer, "Shader permutations: %zu of %zu built\n", built, possible);
+	::OutputDebugStringA(buffer);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "framework.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+
+// Startup pipeline builds. Features register each PSO description together with
+// the shader files it needs instead of compiling and creating it themselves;
+// Build then compiles every distinct shader as its own task on a thread pool,
+// creates each PSO as soon as both of its shaders are ready, and returns once
+// every PSO has been written back to its owner. Nothing renders before Build,
+// so features keep using their ComPtr members exactly as before.
+class PipelineBuilder
+{
+public:
+	// desc is copied without VS and PS, which Build fills in. Whatever desc points
+	// at (root signature, input layout) must stay alive until Build returns.
+	// features are ShaderFeature bits; each shader only compiles with the ones its
+	// file declares, so a permutation is built once however many PSOs ask for it.
+	void Add(const char* name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+		const wchar_t* vsFile, const wchar_t* psFile, ComPtr<ID3D12PipelineState>* pso, UINT features = 0);
+	// Serial runs every task on the caller, to compare startup timings. Throws
+	// the first failure after every task has finished.
+	void Build(bool parallel);
+	void LogTimings() const;
+	// Per shader: permutations its keywords allow against the ones built.
+	void LogPermutations() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Shader
+	{
+		wstring File;
+		string EntryPoint;
+		string Target;
+		// Permutation: the requested features this file declares.
+		UINT Features = 0;
+		UINT Declared = 0;
+		ComPtr<ID3DBlob> ByteCode;
+		HRESULT Hr = E_PENDING;
+		double Ms = 0.0;
+		// Pipelines waiting on this shader.
+		vector<size_t> Users;
+	};
+
+	struct Pipeline
+	{
+		string Name;
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+		size_t VS = 0;
+		size_t PS = 0;
+		ComPtr<ID3D12PipelineState>* Target = nullptr;
+		ComPtr<ID3D12PipelineState> Result;
+		HRESULT Hr = E_PENDING;
+		double Ms = 0.0;
+		// Shaders still compiling; the last one to finish submits the PSO.
+		std::atomic<int> Pending;
+	};
+
+	size_t AddShader(const wchar_t* file, const char* entryPoint, const char* target, UINT features);
+	void CompileShader(size_t index);
+	void CreatePipeline(size_t index);
+
+	ThreadPool mPool;
+	vector<Shader> mShaders;
+	// Pointers, since the atomics cannot move.
+	vector<unique_ptr<Pipeline>> mPipelines;
+	unordered_map<wstring, size_t> mShaderLookup;
+	double mWallMs = 0.0;
+	size_t mThreadCount = 0;
+};
@@ -0,0 +1,123 @@
+#include "RenderGraphHeap.h"
+#include "GraphicEngine.h"
+
+RenderGraph::Handle RenderGraphHeap::AddTexture(const char* name, const D3D12_RESOURCE_DESC& desc,
+	const D3D12_CLEAR_VALUE& clear, ComPtr<ID3D12Resource>* target)
+{
+	D3D12_RESOURCE_ALLOCATION_INFO info = GetEngine()->GetDevice()->GetResourceAllocationInfo(0, 1, &desc);
+	RenderGraph::Handle texture = mGraph.AddTexture(name, info.SizeInBytes, info.Alignment);
+	Transient transient;
+	transient.Desc = desc;
+	transient.Clear = clear;
+	transient.Target = target;
+	mTransients.push_back(transient);
+	mResources.push_back(nullptr);
+	return texture;
+}
+
+RenderGraph::Handle RenderGraphHeap::Import(const char* name, uint32_t access, ID3D12Resource* resource)
+{
+	RenderGraph::Handle texture = mGraph.Import(name, access);
+	mTransients.push_back(Transient());
+	mResources.push_back(resource);
+	return texture;
+}
+
+void RenderGraphHeap::Create()
+{
+	string error;
+	if (!mGraph.Compile(&error))
+	{
+		::OutputDebugStringA(("Render graph: " + error + "\n").c_str());
+		ThrowIfFailed(E_INVALIDARG);
+	}
+	if (mGraph.GetHeapSize() == 0)
+		return;
+
+	// Every transient is a render target, so tier 1 heaps are enough.
+	D3D12_HEAP_DESC heapDesc = {};
+	heapDesc.SizeInBytes = mGraph.GetHeapSize();
+	heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+	ThrowIfFailed(GetEngine()->GetDevice()->CreateHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+
+	for (RenderGraph::Handle texture = 0; texture < mTransients.size(); ++texture)
+	{
+		Transient& transient = mTransients[texture];
+		if (transient.Target == nullptr)
+			continue;
+		// Created in the state the end of a frame leaves it in, so the first
+		// frame's barriers match every later one.
+		ThrowIfFailed(GetEngine()->GetDevice()->CreatePlacedResource(mHeap.Get(), mGraph.GetOffset(texture),
+			&transient.Desc, ToState(mGraph.GetInitialAccess(texture)), &transient.Clear,
+			IID_PPV_ARGS(transient.Target->ReleaseAndGetAddressOf())));
+		mResources[texture] = transient.Target->Get();
+	}
+}
+
+D3D12_RESOURCE_STATES RenderGraphHeap::ToState(uint32_t access)
+{
+	D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+	if (access & RenderGraph::AccessRenderTarget)
+		state |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+	if (access & RenderGraph::AccessDepthWrite)
+		state |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	if (access & RenderGraph::AccessCopyDest)
+		state |= D3D12_RESOURCE_STATE_COPY_DEST;
+	if (access & RenderGraph::AccessDepthRead)
+		state |= D3D12_RESOURCE_STATE_DEPTH_READ;
+	if (access & RenderGraph::AccessShaderRead)
+		state |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	if (access & RenderGraph::AccessCopySource)
+		state |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+	if (access & RenderGraph::AccessPresent)
+		state |= D3D12_RESOURCE_STATE_PRESENT;
+	return state;
+}
+
+ID3D12Resource* RenderGraphHeap::Track(ResourceStateTracker& tracker, const RenderGraph::Barrier& barrier)
+{
+	ID3D12Resource* resource = mResources[barrier.Texture];
+	assert(resource != nullptr);
+	if (barrier.Kind == RenderGraph::Barrier::Transition && !tracker.IsTracked(resource))
+		tracker.Track(resource, ToState(barrier.Before));
+	return resource;
+}
+
+void RenderGraphHeap::RecordBarriers(ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker, RenderGraph::Handle pass)
+{
+	assert(!mGraph.IsCulled(pass));
+	for (const RenderGraph::Barrier& barrier : mGraph.GetBarriers(pass))
+	{
+		ID3D12Resource* resource = Track(tracker, barrier);
+		if (barrier.Kind == RenderGraph::Barrier::Aliasing)
+			tracker.Aliasing(resource);
+		else
+			tracker.Transition(resource, ToState(barrier.After));
+	}
+	tracker.Flush(cmdList);
+}
+
+void RenderGraphHeap::BeginBarriers(ResourceStateTracker& tracker, RenderGraph::Handle pass, RenderGraph::Handle from)
+{
+	assert(!mGraph.IsCulled(pass) && !mGraph.IsCulled(from));
+	for (const RenderGraph::Barrier& barrier : mGraph.GetBarriers(pass))
+	{
+		if (barrier.Kind == RenderGraph::Barrier::Transition && barrier.Since != pass &&
+			mGraph.GetPosition(barrier.Since) <= mGraph.GetPosition(from))
+			tracker.BeginTransition(Track(tracker, barrier), ToState(barrier.After));
+	}
+}
+
+void RenderGraphHeap::RecordFinalBarriers(ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker)
+{
+	for (const RenderGraph::Barrier& barrier : mGraph.GetFinalBarriers())
+		tracker.Transition(Track(tracker, barrier), ToState(barrier.After));
+	tracker.Flush(cmdList);
+}
+
+void RenderGraphHeap::LogReport() const
+{
+	::OutputDebugStringA(mGraph.GetReport().c_str());
+}
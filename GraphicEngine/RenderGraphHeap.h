@@ -0,0 +1,56 @@
+#pragma once
+#include "framework.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+
+// Puts a RenderGraph on the device. Features register their transient textures
+// here instead of creating committed resources; Create compiles the graph and
+// places them all in one heap at the offsets it chose, so textures whose
+// lifetimes do not overlap share memory. Passes then record the graph's
+// barriers instead of their own transitions.
+class RenderGraphHeap
+{
+public:
+	// A transient texture; target receives the placed resource in Create, so
+	// views on it can only be made after that.
+	RenderGraph::Handle AddTexture(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE& clear,
+		ComPtr<ID3D12Resource>* target);
+	// A texture created elsewhere, in access when the frame starts and ends.
+	// resource may be set later with SetImported, for one that changes per frame.
+	RenderGraph::Handle Import(const char* name, uint32_t access, ID3D12Resource* resource = nullptr);
+	void SetImported(RenderGraph::Handle texture, ID3D12Resource* resource) { mResources[texture] = resource; }
+	RenderGraph* GetGraph() { return &mGraph; }
+
+	// Compiles the graph and creates the heap and every transient in it.
+	// Throws if the graph does not compile.
+	void Create();
+	// Queues the barriers the graph put before pass on the tracker of the list
+	// it records in, ending any split BeginBarriers started, and flushes them.
+	void RecordBarriers(ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker, RenderGraph::Handle pass);
+	// Starts, as split barriers, the transitions of pass that may already start
+	// at from, an earlier pass recorded in the same list. They go out with
+	// from's barriers and end at pass's.
+	void BeginBarriers(ResourceStateTracker& tracker, RenderGraph::Handle pass, RenderGraph::Handle from);
+	// Imported textures back to their import state, after the last pass.
+	void RecordFinalBarriers(ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker);
+	void LogReport() const;
+
+	static D3D12_RESOURCE_STATES ToState(uint32_t access);
+
+private:
+	struct Transient
+	{
+		D3D12_RESOURCE_DESC Desc;
+		D3D12_CLEAR_VALUE Clear;
+		ComPtr<ID3D12Resource>* Target = nullptr;
+	};
+
+	// The resource of barrier, tracked from the state the graph says it is in.
+	ID3D12Resource* Track(ResourceStateTracker& tracker, const RenderGraph::Barrier& barrier);
+
+	RenderGraph mGraph;
+	ComPtr<ID3D12Heap> mHeap;
+	// By texture handle; Target is null for imported textures.
+	vector<Transient> mTransients;
+	vector<ID3D12Resource*> mResources;
+};
@@ -77,13 +77,14 @@ struct RenderItem
 	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
 	// Because we have an object cbuffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
+	// NumFramesDirty = MaxFrameResources so that each frame resource gets the update.
+	int NumFramesDirty = MaxFrameResources;
 
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
+	// Index of this render item in the object buffer, gObjectIndex in the shaders.
 	UINT ObjCBIndex = -1;
 
-	unique_ptr<LoadMaterial> Mat;
+	// Items may share a material; static batches share their source items'.
+	shared_ptr<LoadMaterial> Mat;
 	unique_ptr<MeshInfo> Geo;
 
 	// Primitive topology.
@@ -93,4 +94,7 @@ struct RenderItem
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// Never moves, so BakeStaticBatches may merge it with its neighbours.
+	bool Static = false;
 };
\ No newline at end of file
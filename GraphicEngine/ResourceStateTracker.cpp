@@ -0,0 +1,209 @@
+#include "ResourceStateTracker.h"
+#include <atomic>
+
+static std::atomic<size_t> sRequested(0);
+static std::atomic<size_t> sIssued(0);
+static std::atomic<size_t> sMerged(0);
+
+// Mips times array slices; planes are not tracked apart.
+static UINT GetSubresourceCount(ID3D12Resource* resource)
+{
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		return 1;
+	UINT arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+	return desc.MipLevels * arraySize;
+}
+
+void ResourceStateTracker::Track(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+	State& tracked = mStates[resource];
+	tracked.Whole = state;
+	tracked.Subresources.clear();
+}
+
+ResourceStateTracker::State& ResourceStateTracker::GetTracked(ID3D12Resource* resource)
+{
+	auto it = mStates.find(resource);
+	// The tracker cannot guess the state a list starts in; Track it first.
+	assert(it != mStates.end());
+	return it->second;
+}
+
+D3D12_RESOURCE_STATES ResourceStateTracker::GetState(ID3D12Resource* resource, UINT subresource) const
+{
+	const State& state = mStates.at(resource);
+	if (state.Subresources.empty())
+		return state.Whole;
+	assert(subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+	return state.Subresources[subresource];
+}
+
+void ResourceStateTracker::SetState(State& state, ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES after)
+{
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		state.Whole = after;
+		state.Subresources.clear();
+		return;
+	}
+	if (state.Subresources.empty())
+	{
+		if (state.Whole == after)
+			return;
+		state.Subresources.assign(GetSubresourceCount(resource), state.Whole);
+	}
+	state.Subresources[subresource] = after;
+	for (D3D12_RESOURCE_STATES other : state.Subresources)
+	{
+		if (other != after)
+			return;
+	}
+	state.Whole = after;
+	state.Subresources.clear();
+}
+
+bool ResourceStateTracker::EndSplits(ID3D12Resource* resource, D3D12_RESOURCE_STATES after, UINT subresource)
+{
+	bool ended = false;
+	for (size_t i = 0; i < mSplits.size();)
+	{
+		const Split& split = mSplits[i];
+		bool overlaps = split.Resource == resource && (split.Subresource == subresource ||
+			split.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES || subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+		if (!overlaps)
+		{
+			++i;
+			continue;
+		}
+		// Any other use has to wait for the split to finish as well.
+		ended |= split.Subresource == subresource && split.After == after;
+		mPending.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, split.Before, split.After,
+			split.Subresource, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY));
+		mSplits.erase(mSplits.begin() + i);
+	}
+	return ended;
+}
+
+bool ResourceStateTracker::Queue(ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+	// Fold into the last barrier queued for the resource if it moved the same
+	// subresource; anything else on the resource in between keeps the order.
+	for (size_t i = mPending.size(); i-- > 0;)
+	{
+		D3D12_RESOURCE_BARRIER& barrier = mPending[i];
+		bool touches = barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION ?
+			barrier.Transition.pResource == resource : barrier.Aliasing.pResourceAfter == resource;
+		if (!touches)
+			continue;
+		if (barrier.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION || barrier.Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE ||
+			barrier.Transition.Subresource != subresource)
+			break;
+		assert(barrier.Transition.StateAfter == before);
+		if (barrier.Transition.StateBefore == after)
+		{
+			// There and back: the earlier request needs no barrier either.
+			mPending.erase(mPending.begin() + i);
+			++mCounters.Merged;
+		}
+		else
+		{
+			barrier.Transition.StateAfter = after;
+		}
+		return false;
+	}
+	mPending.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after, subresource));
+	return true;
+}
+
+void ResourceStateTracker::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES after, UINT subresource)
+{
+	++mCounters.Requested;
+	if (EndSplits(resource, after, subresource))
+		return;
+
+	State& state = GetTracked(resource);
+	bool queued = false;
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && !state.Subresources.empty())
+	{
+		for (UINT i = 0; i < (UINT)state.Subresources.size(); ++i)
+		{
+			if (state.Subresources[i] != after)
+				queued |= Queue(resource, i, state.Subresources[i], after);
+		}
+	}
+	else
+	{
+		D3D12_RESOURCE_STATES before = state.Subresources.empty() ? state.Whole : state.Subresources[subresource];
+		if (before != after)
+			queued = Queue(resource, subresource, before, after);
+	}
+	if (!queued)
+		++mCounters.Merged;
+	SetState(state, resource, subresource, after);
+}
+
+void ResourceStateTracker::BeginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES after, UINT subresource)
+{
+	State& state = GetTracked(resource);
+	// Subresources in different states move at once, unsplit.
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && !state.Subresources.empty())
+	{
+		Transition(resource, after, subresource);
+		return;
+	}
+
+	++mCounters.Requested;
+	EndSplits(resource, after, subresource);
+	D3D12_RESOURCE_STATES before = state.Subresources.empty() ? state.Whole : state.Subresources[subresource];
+	if (before == after)
+	{
+		++mCounters.Merged;
+		return;
+	}
+	mPending.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after, subresource,
+		D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY));
+	mSplits.push_back({ resource, subresource, before, after });
+	SetState(state, resource, subresource, after);
+}
+
+void ResourceStateTracker::Aliasing(ID3D12Resource* resource)
+{
+	++mCounters.Requested;
+	mPending.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource));
+}
+
+void ResourceStateTracker::Flush(ID3D12GraphicsCommandList* cmdList)
+{
+	if (mPending.empty())
+		return;
+	cmdList->ResourceBarrier((UINT)mPending.size(), mPending.data());
+	mCounters.Issued += mPending.size();
+	mPending.clear();
+}
+
+void ResourceStateTracker::Finish(ID3D12GraphicsCommandList* cmdList)
+{
+	for (const Split& split : mSplits)
+	{
+		mPending.push_back(CD3DX12_RESOURCE_BARRIER::Transition(split.Resource, split.Before, split.After,
+			split.Subresource, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY));
+	}
+	mSplits.clear();
+	Flush(cmdList);
+
+	sRequested.fetch_add(mCounters.Requested);
+	sIssued.fetch_add(mCounters.Issued);
+	sMerged.fetch_add(mCounters.Merged);
+	mCounters = Counters();
+	mStates.clear();
+}
+
+ResourceStateTracker::Counters ResourceStateTracker::TakeCounters()
+{
+	Counters counters;
+	counters.Requested = sRequested.exchange(0);
+	counters.Issued = sIssued.exchange(0);
+	counters.Merged = sMerged.exchange(0);
+	return counters;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "framework.h"
+
+// Knows the state of every resource, and every subresource, one command list
+// touches and queues the transitions between them, so they go out in a single
+// ResourceBarrier call at Flush:
+//  - a transition to the state a subresource is already in is dropped,
+//  - one queued after another for the same subresource folds into it, A->B
+//    then B->C goes out as A->C and A->B then B->A as nothing,
+//  - BeginTransition starts a split barrier; the next Transition of that
+//    subresource to the same state ends it, and Finish ends any still open.
+// Queued transitions only happen at Flush, so flush before recording work
+// that needs them. One tracker per list, used by the thread recording it.
+class ResourceStateTracker
+{
+public:
+	struct Counters
+	{
+		// Transitions and aliasing barriers asked for.
+		size_t Requested = 0;
+		// Barriers handed to ResourceBarrier; a split counts twice.
+		size_t Issued = 0;
+		// Requests that needed no barrier of their own.
+		size_t Merged = 0;
+	};
+
+	// The state resource is in when the list starts, for every subresource.
+	void Track(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+	bool IsTracked(ID3D12Resource* resource) const { return mStates.count(resource) != 0; }
+	D3D12_RESOURCE_STATES GetState(ID3D12Resource* resource, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES) const;
+
+	void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES after,
+		UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+	// The resource may not be used until a Transition to after ends the split.
+	void BeginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES after,
+		UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+	// resource takes over memory it shares with other placed resources.
+	void Aliasing(ID3D12Resource* resource);
+
+	void Flush(ID3D12GraphicsCommandList* cmdList);
+	// Ends open splits, flushes and adds this list's counts to the frame's.
+	// The tracker starts over empty for the next list.
+	void Finish(ID3D12GraphicsCommandList* cmdList);
+
+	// Counts of every tracker finished since the last call.
+	static Counters TakeCounters();
+
+private:
+	struct State
+	{
+		D3D12_RESOURCE_STATES Whole;
+		// Per subresource once they differ, empty while they all share Whole.
+		vector<D3D12_RESOURCE_STATES> Subresources;
+	};
+
+	struct Split
+	{
+		ID3D12Resource* Resource;
+		UINT Subresource;
+		D3D12_RESOURCE_STATES Before;
+		D3D12_RESOURCE_STATES After;
+	};
+
+	State& GetTracked(ID3D12Resource* resource);
+	// True when a split on resource was ended by this transition.
+	bool EndSplits(ID3D12Resource* resource, D3D12_RESOURCE_STATES after, UINT subresource);
+	// False when it folded into a barrier already queued.
+	bool Queue(ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+	static void SetState(State& state, ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES after);
+
+	unordered_map<ID3D12Resource*, State> mStates;
+	vector<D3D12_RESOURCE_BARRIER> mPending;
+	vector<Split> mSplits;
+	Counters mCounters;
+};
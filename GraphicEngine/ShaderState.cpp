@@ -1,5 +1,32 @@
 #include "ShaderState.h"
 #include "GraphicEngine.h"
+#include <chrono>
+#include <winver.h>
+
+#pragma comment(lib, "version.lib")
+
+static const char* gFeatureNames[SHADER_FEATURE_COUNT] = { "SHADOWS", "SSAO" };
+
+// D3D_COMPILER_VERSION stays 47 across SDK and OS updates that replace the DLL,
+// so the cache keys on the file version of the d3dcompiler actually loaded.
+static uint64_t GetCompilerVersion()
+{
+	uint64_t version = D3D_COMPILER_VERSION;
+	wchar_t path[MAX_PATH];
+	HMODULE compiler = GetModuleHandleW(D3DCOMPILER_DLL_W);
+	if (compiler == nullptr || GetModuleFileNameW(compiler, path, MAX_PATH) == 0)
+		return version;
+
+	DWORD handle = 0;
+	DWORD size = GetFileVersionInfoSizeW(path, &handle);
+	vector<uint8_t> info(size);
+	VS_FIXEDFILEINFO* fixed = nullptr;
+	UINT fixedSize = 0;
+	if (size > 0 && GetFileVersionInfoW(path, 0, size, info.data()) &&
+		VerQueryValueW(info.data(), L"\\", reinterpret_cast<void**>(&fixed), &fixedSize) && fixedSize >= sizeof(VS_FIXEDFILEINFO))
+		version = ((uint64_t)fixed->dwFileVersionMS << 32) | fixed->dwFileVersionLS;
+	return version;
+}
 
 ShaderState::ShaderState()
 {
@@ -9,6 +36,8 @@ ShaderState::ShaderState()
 		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+	mCache.SetDirectory("Shader/Cache");
+	mCompilerVersion = GetCompilerVersion();
 }
 
 ComPtr<ID3DBlob> ShaderState::CreateVSShader(const wchar_t* file)
@@ -34,24 +63,120 @@ ComPtr<ID3DBlob> ShaderState::CompileShader(
 	const D3D_SHADER_MACRO* defines,
 	const std::string& entrypoint,
 	const std::string& target)
+{
+	ComPtr<ID3DBlob> byteCode;
+	ThrowIfFailed(TryCompileShader(filename, defines, entrypoint, target, byteCode));
+	return byteCode;
+}
+
+HRESULT ShaderState::TryCompileShader(
+	const std::wstring& filename,
+	const D3D_SHADER_MACRO* defines,
+	const std::string& entrypoint,
+	const std::string& target,
+	ComPtr<ID3DBlob>& byteCode)
 {
 	UINT compileFlags = 0;
 #if defined(DEBUG) || defined(_DEBUG)  
 	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
-	HRESULT hr = S_OK;
+	ShaderCache::Request request;
+	request.File.assign(filename.begin(), filename.end());
+	for (const D3D_SHADER_MACRO* define = defines; define && define->Name; ++define)
+		request.Defines.push_back({ define->Name, define->Definition ? define->Definition : "" });
+	request.EntryPoint = entrypoint;
+	request.Target = target;
+	request.Flags = compileFlags;
+	request.CompilerVersion = mCompilerVersion;
+
+	byteCode = nullptr;
+	uint64_t key = 0;
+	bool keyed = mCache.ComputeKey(request, key);
+	vector<uint8_t> cached;
+	if (keyed && mCache.Load(key, cached))
+	{
+		HRESULT hr = D3DCreateBlob(cached.size(), &byteCode);
+		if (FAILED(hr))
+			return hr;
+		memcpy(byteCode->GetBufferPointer(), cached.data(), cached.size());
+		std::lock_guard<std::mutex> lock(mStatsMutex);
+		++mCacheHits;
+		return S_OK;
+	}
 
-	ComPtr<ID3DBlob> byteCode = nullptr;
+	auto start = std::chrono::steady_clock::now();
 	ComPtr<ID3DBlob> errors;
-	hr = D3DCompileFromFile(filename.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+	HRESULT hr = D3DCompileFromFile(filename.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		entrypoint.c_str(), target.c_str(), compileFlags, 0, &byteCode, &errors);
+	{
+		std::lock_guard<std::mutex> lock(mStatsMutex);
+		mCompileMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		++mCompiles;
+	}
 
 	if (errors != nullptr)
 		OutputDebugStringA((char*)errors->GetBufferPointer());
 
-	ThrowIfFailed(hr);
+	if (SUCCEEDED(hr) && keyed)
+		mCache.Store(key, byteCode->GetBufferPointer(), byteCode->GetBufferSize());
+	return hr;
+}
 
-	return byteCode;
+void ShaderState::LogStats() const
+{
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	char buffer[128];
+	sprintf_s(buffer, "Shader cache: %u hits, %u compiled in %.1f ms\n", mCacheHits, mCompiles, mCompileMs);
+	::OutputDebugStringA(buffer);
+}
+
+UINT ShaderState::GetKeywords(const std::wstring& filename)
+{
+	auto it = mKeywords.find(filename);
+	if (it != mKeywords.end())
+		return it->second;
+
+	std::ifstream file(filename, std::ios::binary);
+	std::stringstream source;
+	source << file.rdbuf();
+	vector<string> names;
+	ShaderCache::FindKeywords(source.str(), names);
+
+	UINT declared = 0;
+	for (const string& name : names)
+	{
+		UINT bit = 0;
+		for (UINT i = 0; i < SHADER_FEATURE_COUNT; ++i)
+		{
+			if (name == gFeatureNames[i])
+				bit = 1u << i;
+		}
+		if (bit == 0)
+			::OutputDebugStringA(("Shader keyword " + name + " is not a ShaderFeature, ignored\n").c_str());
+		declared |= bit;
+	}
+	mKeywords[filename] = declared;
+	return declared;
+}
+
+const char* ShaderState::GetFeatureName(UINT feature)
+{
+	for (UINT i = 0; i < SHADER_FEATURE_COUNT; ++i)
+	{
+		if (feature == 1u << i)
+			return gFeatureNames[i];
+	}
+	return "";
 }
 
+void ShaderState::GetDefines(UINT declared, UINT features, vector<D3D_SHADER_MACRO>& defines)
+{
+	defines.clear();
+	for (UINT i = 0; i < SHADER_FEATURE_COUNT; ++i)
+	{
+		if (declared & (1u << i))
+			defines.push_back({ gFeatureNames[i], (features & (1u << i)) ? "1" : "0" });
+	}
+	defines.push_back({ nullptr, nullptr });
+}
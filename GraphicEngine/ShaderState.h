@@ -1,5 +1,18 @@
 #pragma once
 #include "framework.h"
+#include "ShaderCache.h"
+#include <mutex>
+
+// Features a shader can be compiled with or without. A shader declares the ones it
+// tests on a "// keywords: SHADOWS SSAO" line; every declared keyword is defined
+// to 1 or 0, and features it does not declare do not make a new permutation.
+enum ShaderFeature
+{
+	SHADER_FEATURE_SHADOWS = 1 << 0,
+	SHADER_FEATURE_SSAO = 1 << 1,
+	SHADER_FEATURE_COUNT = 2,
+	SHADER_FEATURE_ALL = (1 << SHADER_FEATURE_COUNT) - 1,
+};
 
 class ShaderState
 {
@@ -11,10 +24,32 @@ public:
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
+	// Same without throwing, safe to call from several threads at once.
+	HRESULT TryCompileShader(const std::wstring& filename,
+		const D3D_SHADER_MACRO* defines,
+		const std::string& entrypoint,
+		const std::string& target,
+		ComPtr<ID3DBlob>& byteCode);
 	std::vector < D3D12_INPUT_ELEMENT_DESC>& GetLayout() { return mInputLayout; }
 	ComPtr<ID3DBlob> GetShader(string &str) { return mShaders[str]; }
+	void LogStats() const;
+	// Feature bits the file declares, read once per file.
+	UINT GetKeywords(const std::wstring& filename);
+	// The keyword name of one feature bit, "SHADOWS" for SHADER_FEATURE_SHADOWS.
+	static const char* GetFeatureName(UINT feature);
+	// Null terminated defines selecting features out of declared, for CompileShader.
+	static void GetDefines(UINT declared, UINT features, vector<D3D_SHADER_MACRO>& defines);
 
 private:
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+	std::unordered_map<std::wstring, UINT> mKeywords;
+	// Bytecode from earlier runs, see ShaderCache.
+	ShaderCache mCache;
+	// Part of every cache key.
+	uint64_t mCompilerVersion = 0;
+	mutable std::mutex mStatsMutex;
+	UINT mCacheHits = 0;
+	UINT mCompiles = 0;
+	double mCompileMs = 0.0;
 };
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "TextureStreamer.h"
+#include "GraphicEngine.h"
+#include "MappedFile.h"
+
+TextureStreamer::TextureStreamer()
+{
+
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	Shutdown();
+}
+
+void TextureStreamer::Init(int workerCount)
+{
+	mStopping = false;
+	for (int i = 0; i < workerCount; ++i)
+		mWorkers.push_back(std::thread(&TextureStreamer::WorkerMain, this));
+}
+
+void TextureStreamer::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+		mJobs.clear();
+	}
+	mWake.notify_all();
+	for (auto& worker : mWorkers)
+		worker.join();
+	mWorkers.clear();
+	mResults.clear();
+}
+
+bool TextureStreamer::GetTailMip(const DDSFileView& view, UINT& tailMip)
+{
+	// Materials bind plain Texture2D SRVs; cube maps, arrays and volumes load whole.
+	if (view.IsCube() || view.GetArraySize() != 1 || view.GetDepth() != 1 || view.GetDxgiFormat() == 0)
+		return false;
+
+	UINT mipCount = view.GetMipCount();
+	tailMip = 0;
+	while (tailMip + 1 < mipCount && max(view.GetWidth() >> tailMip, view.GetHeight() >> tailMip) > TailSize)
+		++tailMip;
+	if (tailMip == 0)
+		return false;
+
+	// Every mip that can become the top level of a block compressed resource has
+	// to be a whole number of blocks.
+	if (view.IsBlockCompressed())
+	{
+		for (UINT mip = 0; mip <= tailMip; ++mip)
+		{
+			if (((view.GetWidth() >> mip) & 3) != 0 || ((view.GetHeight() >> mip) & 3) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+HRESULT TextureStreamer::BuildMips(ID3D12Device* device, const DDSFileView& view, DXGI_FORMAT format, UINT topMip, DDSTextureUpload12& upload)
+{
+	vector<DDSSubresource> subresources;
+	if (!view.GetSubresources(subresources))
+		return E_FAIL;
+
+	UINT mipCount = view.GetMipCount();
+	UINT arraySize = view.GetArraySize();
+	UINT levels = mipCount - topMip;
+
+	// Rows go straight from the file view into the upload heap.
+	vector<D3D12_SUBRESOURCE_DATA> initData;
+	for (UINT slice = 0; slice < arraySize; ++slice)
+	{
+		for (UINT level = 0; level < levels; ++level)
+		{
+			const DDSSubresource& src = subresources[slice * mipCount + topMip + level];
+			initData.push_back({ src.Data, (LONG_PTR)src.RowPitch, (LONG_PTR)src.SlicePitch });
+		}
+	}
+
+	D3D12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(format,
+		max(1u, view.GetWidth() >> topMip), max(1u, view.GetHeight() >> topMip),
+		(UINT16)arraySize, (UINT16)levels);
+	return PrepareTextureUpload12(device, texDesc, initData.data(), upload);
+}
+
+bool TextureStreamer::PrepareTail(const uint8_t* data, size_t size, DDSTextureUpload12& upload, UINT& tailMip)
+{
+	DDSFileView view;
+	if (!view.Parse(data, size) || !GetTailMip(view, tailMip))
+		return false;
+	return SUCCEEDED(BuildMips(GetEngine()->GetDevice(), view, (DXGI_FORMAT)view.GetDxgiFormat(), tailMip, upload));
+}
+
+int TextureStreamer::AddTail(const wchar_t* file, const uint8_t* data, size_t size, UINT tailMip)
+{
+	DDSFileView view;
+	view.Parse(data, size);
+	vector<DDSSubresource> subresources;
+	view.GetSubresources(subresources);
+	vector<uint64_t> mipBytes(view.GetMipCount(), 0);
+	for (size_t i = 0; i < subresources.size(); ++i)
+		mipBytes[i % view.GetMipCount()] += subresources[i].SlicePitch * subresources[i].Depth;
+
+	int id = mResidency.AddTexture(mipBytes.data(), view.GetMipCount(), tailMip);
+	if (id >= (int)mStreams.size())
+		mStreams.resize(id + 1);
+
+	Stream& stream = mStreams[id];
+	stream = Stream();
+	stream.Used = true;
+	stream.File = file;
+	stream.Format = (DXGI_FORMAT)view.GetDxgiFormat();
+	stream.Width = view.GetWidth();
+	stream.Height = view.GetHeight();
+	stream.MipCount = view.GetMipCount();
+	stream.ArraySize = view.GetArraySize();
+	stream.TailMip = tailMip;
+	stream.ResidentMip = tailMip;
+	stream.Generation = ++mNextGeneration;
+	return id;
+}
+
+void TextureStreamer::Bind(int streamId, int tailSrvIndex)
+{
+	mStreams[streamId].TailSrvIndex = tailSrvIndex;
+}
+
+void TextureStreamer::Remove(int streamId)
+{
+	Publish(streamId, nullptr);
+	mStreams[streamId].Used = false;
+	mResidency.RemoveTexture(streamId);
+}
+
+int TextureStreamer::GetSrvIndex(int streamId) const
+{
+	const Stream& stream = mStreams[streamId];
+	return stream.SrvIndex >= 0 ? stream.SrvIndex : stream.TailSrvIndex;
+}
+
+void TextureStreamer::BeginFrame()
+{
+	mResidency.BeginFrame(++mFrame);
+}
+
+void TextureStreamer::Request(int streamId, float desiredMip)
+{
+	if (mStreams[streamId].Used)
+		mResidency.Request(streamId, desiredMip);
+}
+
+void TextureStreamer::EndFrame()
+{
+	mResidency.Update(mActions);
+
+	for (auto& action : mActions)
+	{
+		Stream& stream = mStreams[action.Id];
+		if (action.TargetMip == stream.TailMip)
+		{
+			// Back to the tail: nothing to load, the tail SRV is always valid.
+			Publish(action.Id, nullptr);
+			mResidency.OnStreamed(action.Id, stream.TailMip);
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back({ action.Id, stream.Generation, action.TargetMip, stream.File });
+	}
+	mWake.notify_all();
+}
+
+void TextureStreamer::WorkerMain()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+			if (mStopping)
+				return;
+			job = move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		Result result;
+		result.StreamId = job.StreamId;
+		result.Generation = job.Generation;
+		result.TopMip = job.TopMip;
+		result.Hr = E_FAIL;
+
+		MappedFile file;
+		DDSFileView view;
+		if (file.Open(job.File.c_str()) && view.Parse(file.GetData(), file.GetSize()))
+		{
+			result.Hr = BuildMips(GetEngine()->GetDevice(), view, (DXGI_FORMAT)view.GetDxgiFormat(), job.TopMip, result.Upload);
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mResults.push_back(move(result));
+	}
+}
+
+void TextureStreamer::RecordUploads(ID3D12GraphicsCommandList* cmdList)
+{
+	std::deque<Result> results;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		results.swap(mResults);
+	}
+
+	// Every texture moves to PIXEL_SHADER_RESOURCE in one barrier after all copies.
+	ResourceStateTracker tracker;
+	for (auto& result : results)
+	{
+		Stream& stream = mStreams[result.StreamId];
+		// Removed (and maybe reused) while the worker was busy. Nothing was
+		// recorded yet, so the resources can simply go.
+		if (!stream.Used || stream.Generation != result.Generation)
+			continue;
+
+		if (FAILED(result.Hr))
+		{
+			::OutputDebugStringW((L"Texture streaming failed: " + stream.File + L"\n").c_str());
+			mResidency.OnStreamed(result.StreamId, stream.ResidentMip);
+			continue;
+		}
+
+		// The copies land before any draw of this frame, later frames can use the
+		// new SRV straight away.
+		RecordDDSTextureCopies12(cmdList, result.Upload);
+		tracker.Track(result.Upload.Texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+		tracker.Transition(result.Upload.Texture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		GetEngine()->GetTimeline()->DeferRelease(result.Upload.UploadHeap);
+		Publish(result.StreamId, result.Upload.Texture);
+		stream.ResidentMip = result.TopMip;
+		mResidency.OnStreamed(result.StreamId, result.TopMip);
+	}
+	tracker.Finish(cmdList);
+}
+
+void TextureStreamer::Publish(int streamId, ComPtr<ID3D12Resource> resource)
+{
+	Stream& stream = mStreams[streamId];
+	ComPtr<ID3D12Resource> oldResource = stream.Resource;
+	int oldSrv = stream.SrvIndex;
+
+	if (resource != nullptr)
+	{
+		stream.SrvIndex = GetEngine()->GetTextureList()->SetTexDescriptor(resource.Get());
+		stream.Resource = resource;
+	}
+	else
+	{
+		stream.SrvIndex = -1;
+		stream.Resource = nullptr;
+		stream.ResidentMip = stream.TailMip;
+	}
+
+	// Frames in flight may still sample through the old SRV.
+	GetEngine()->GetTimeline()->DeferRelease(oldResource);
+	if (oldSrv >= 0)
+		GetEngine()->GetDescriptorHeap()->FreeSrv(oldSrv);
+}
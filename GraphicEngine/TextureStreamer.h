@@ -0,0 +1,113 @@
+#pragma once
+#include "framework.h"
+#include "MipResidency.h"
+#include "DDSFileView.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Mip streaming for 2D DDS textures. A texture is created with only its mip tail
+// (mips no larger than TailSize) and that resource stays behind the texture's cache
+// handle for its whole life. More detailed mips are loaded on worker threads into a
+// second resource holding [target mip, last mip] plus its own SRV; materials pick the
+// current SRV up through GetSrvIndex every frame, so swapping never touches a
+// descriptor the GPU may be reading. Which mips to load or evict is decided by
+// MipResidency against the VRAM budget.
+class TextureStreamer
+{
+public:
+	static const UINT TailSize = 64;
+
+	TextureStreamer();
+	~TextureStreamer();
+	void Init(int workerCount = 2);
+	void Shutdown();
+	// Room for count streams before the first texture is registered.
+	void Reserve(size_t count) { mStreams.reserve(count); }
+
+	void SetBudget(UINT64 bytes) { mResidency.SetBudget(bytes); }
+	UINT64 GetResidentBytes() const { return mResidency.GetResidentBytes(); }
+
+	// Creates the tail-only resource and fills its upload heap; touches only the
+	// device, so loaders call it from worker threads. Fails for files that cannot be
+	// streamed (cube maps, arrays, volumes, formats DDSFileView does not know, block
+	// formats with unaligned mips); the caller then loads the whole texture.
+	static bool PrepareTail(const uint8_t* data, size_t size, DDSTextureUpload12& upload, UINT& tailMip);
+	// Registers a stream once the caller recorded the tail upload. Main thread.
+	int AddTail(const wchar_t* file, const uint8_t* data, size_t size, UINT tailMip);
+	// Ties the stream to the SRV the cache created for the tail resource.
+	void Bind(int streamId, int tailSrvIndex);
+	void Remove(int streamId);
+
+	// SRV materials should use right now.
+	int GetSrvIndex(int streamId) const;
+	UINT GetWidth(int streamId) const { return mStreams[streamId].Width; }
+
+	// Per frame, CPU side: collect requests between BeginFrame and EndFrame. EndFrame
+	// runs the residency decision and hands loads to the workers.
+	void BeginFrame();
+	void Request(int streamId, float desiredMip);
+	void EndFrame();
+	// Records copies for finished loads and publishes their SRVs.
+	void RecordUploads(ID3D12GraphicsCommandList* cmdList);
+
+private:
+	struct Stream
+	{
+		bool Used = false;
+		wstring File;
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		UINT Width = 0;
+		UINT Height = 0;
+		UINT MipCount = 0;
+		UINT ArraySize = 0;
+		UINT TailMip = 0;
+		// Most detailed mip the published SRV covers.
+		UINT ResidentMip = 0;
+		// Fresh per stream so late results for a removed one are dropped.
+		UINT64 Generation = 0;
+		int TailSrvIndex = -1;
+		// Detail resource and its SRV, empty while only the tail is resident.
+		ComPtr<ID3D12Resource> Resource;
+		int SrvIndex = -1;
+	};
+
+	struct Job
+	{
+		int StreamId;
+		UINT64 Generation;
+		UINT TopMip;
+		wstring File;
+	};
+
+	struct Result
+	{
+		int StreamId;
+		UINT64 Generation;
+		UINT TopMip;
+		HRESULT Hr;
+		DDSTextureUpload12 Upload;
+	};
+
+	// Creates a texture holding mips [topMip, MipCount) and fills an upload buffer
+	// for it straight from the file view. Safe to call from any thread.
+	static HRESULT BuildMips(ID3D12Device* device, const DDSFileView& view, DXGI_FORMAT format, UINT topMip, DDSTextureUpload12& upload);
+	static bool GetTailMip(const DDSFileView& view, UINT& tailMip);
+
+	void WorkerMain();
+	void Publish(int streamId, ComPtr<ID3D12Resource> resource);
+
+	MipResidency mResidency;
+	vector<Stream> mStreams;
+	UINT64 mFrame = 0;
+	UINT64 mNextGeneration = 0;
+	vector<MipResidency::Action> mActions;
+
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::deque<Job> mJobs;
+	std::deque<Result> mResults;
+	vector<std::thread> mWorkers;
+	bool mStopping = false;
+};
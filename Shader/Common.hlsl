@@ -13,6 +13,16 @@ struct MaterialData
 	uint     MatPad2;
 };
 
+struct ObjectData
+{
+	float4x4 World;
+	float4x4 TexTransform;
+	uint     MaterialIndex;
+	uint     ObjPad0;
+	uint     ObjPad1;
+	uint     ObjPad2;
+};
+
 TextureCube gCubeMap : register(t0);
 Texture2D gShadowMap : register(t1);
 Texture2D gSsaoMap : register(t12);
@@ -22,14 +32,16 @@ Texture2D WorldPosTex : register(t14);
 Texture2D WorldNormalTex : register(t15);
 Texture2D materialTex: register(t16);
 
-// An array of textures, which is only supported in shader model 5.1+.  Unlike Texture2DArray, the textures
-// in this array can be different sizes and formats, making it more flexible than texture arrays.
-Texture2D gDiffuseMap[10] : register(t2);
+// Unbounded array over the whole shader visible heap, only supported in shader model 5.1+.  Unlike
+// Texture2DArray, the textures can be different sizes and formats.  Materials store the heap index
+// of their texture, so adding textures never touches the root signature.
+Texture2D gTextureMaps[] : register(t0, space2);
 
 
-// Put in space1, so the texture array does not overlap with these resources.  
-// The texture array will occupy registers t0, t1, ..., t3 in space0. 
+// Put in space1, so the material buffer does not overlap with the space0 tables above.
 StructuredBuffer<MaterialData> gMaterialData : register(t0, space1);
+// One entry per render item, picked by gObjectIndex.
+StructuredBuffer<ObjectData> gObjectData : register(t1, space1);
 
 
 SamplerState gsamPointWrap        : register(s0);
@@ -40,17 +52,6 @@ SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 SamplerComparisonState gsamShadow : register(s6);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
-{
-    float4x4 gWorld;
-	float4x4 gTexTransform;
-	uint gMaterialIndex;
-	uint gObjPad0;
-	uint gObjPad1;
-	uint gObjPad2;
-};
-
 // Constant data that varies per material.
 cbuffer cbPerPass : register(b1)
 {
@@ -73,6 +74,12 @@ cbuffer cbFeature : register(b2)
 	float4x4 gShadowTransform;
 };
 
+// Index of the object drawn into gObjectData, a root constant every draw sets.
+cbuffer cbObjectIndex : register(b3)
+{
+	uint gObjectIndex;
+};
+
 float CalcShadowFactor(float4 shadowPosH)
 {
 	// Complete projection by doing division by w.
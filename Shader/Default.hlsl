@@ -1,3 +1,5 @@
+// keywords: SHADOWS SSAO
+
 // Include common HLSL code.
 #include "Common.hlsl"
 
@@ -45,12 +47,20 @@ float4 PS(VertexOut pin) : SV_Target
 
     // Finish texture projection and sample SSAO map.
     //pin.SsaoPosH /= pin.SsaoPosH.w;
+#if SSAO
     float ambientAccess = gSsaoMap.Sample(gsamLinearClamp, pin.TexC, 0.0f).r;
+#else
+    float ambientAccess = 1.0f;
+#endif
 
     // Light terms.
 	float4 ambient = gAmbientLight * diffuse * ambientAccess;
 
+#if SHADOWS
 	float shadowFactor = CalcShadowFactor(mul(float4(worldPos, 1.0f), gShadowTransform));
+#else
+	float shadowFactor = 1.0f;
+#endif
 	const float shininess = 1.0f - roughness;
 	Material mat = { diffuse, fresnelR0, shininess };
 	float4 directLight = ComputeLighting(gLights, mat, worldPos,
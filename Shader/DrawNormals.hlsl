@@ -22,14 +22,15 @@ VertexOut VS(VertexIn vin)
 {
 	VertexOut vout = (VertexOut)0.0f;
 
-	// Fetch the material data.
-	MaterialData matData = gMaterialData[gMaterialIndex];
+	// Fetch the object and material data.
+	ObjectData objData = gObjectData[gObjectIndex];
+	MaterialData matData = gMaterialData[objData.MaterialIndex];
 	
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(vin.NormalL, (float3x3)objData.World);
 
     // Transform to homogeneous clip space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), objData.World);
     vout.PosH = mul(posW, gViewProj);
 	
     return vout;
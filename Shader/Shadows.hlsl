@@ -17,8 +17,10 @@ VertexOut VS(VertexIn vin)
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+	ObjectData objData = gObjectData[gObjectIndex];
+
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), objData.World);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
@@ -22,7 +22,7 @@ VertexOut VS(VertexIn vin)
 	vout.PosL = vin.PosL;
 	
 	// Transform to world space.
-	float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+	float4 posW = mul(float4(vin.PosL, 1.0f), gObjectData[gObjectIndex].World);
 
 	// Always center sky about camera.
 	posW.xyz += gEyePosW;
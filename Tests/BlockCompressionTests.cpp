@@ -0,0 +1,294 @@
+#include "Test.h"
+#include "BlockCompression.h"
+#include "DDSFileView.h"
+#include "ImageFile.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static const uint32_t BC1 = 71;
+static const uint32_t BC3 = 77;
+static const uint32_t BC4 = 80;
+static const uint32_t BC5 = 83;
+static const uint32_t BC7 = 98;
+
+// Decode has no BC7 path; the encoder only writes mode 6, which is all this reads.
+static bool DecodeBC7Mode6(const uint8_t* block, uint8_t texels[16][4])
+{
+	uint64_t low, high;
+	memcpy(&low, block, 8);
+	memcpy(&high, block + 8, 8);
+	int bit = 0;
+	auto read = [&](int count)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < count; ++i, ++bit)
+			value |= (uint32_t)(((bit < 64 ? low : high) >> (bit & 63)) & 1) << i;
+		return value;
+	};
+	if (read(7) != 0x40)
+		return false;
+
+	int endpoints[2][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = read(7);
+		endpoints[1][c] = read(7);
+	}
+	int pbit0 = read(1);
+	int pbit1 = read(1);
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	for (int i = 0; i < 16; ++i)
+	{
+		int index = read(i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; ++c)
+		{
+			int a = endpoints[0][c] << 1 | pbit0;
+			int b = endpoints[1][c] << 1 | pbit1;
+			texels[i][c] = (uint8_t)(((64 - weights[index]) * a + weights[index] * b + 32) >> 6);
+		}
+	}
+	return true;
+}
+
+static bool RoundTrip(uint32_t format, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height,
+	BlockCompression::Quality quality, std::vector<uint8_t>& decoded)
+{
+	size_t blockSize = BlockCompression::GetBlockSize(format);
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+	std::vector<uint8_t> blocks(blocksWide * blocksHigh * blockSize);
+	if (!BlockCompression::Encode(format, rgba.data(), width * 4, width, height, blocks.data(), blocksWide * blockSize, quality))
+		return false;
+
+	decoded.assign(rgba.size(), 0);
+	if (format != BC7)
+		return BlockCompression::Decode(format, blocks.data(), blocksWide * blockSize, width, height, decoded.data(), width * 4);
+
+	for (uint32_t by = 0; by < blocksHigh; ++by)
+	{
+		for (uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			uint8_t texels[16][4];
+			if (!DecodeBC7Mode6(&blocks[(by * blocksWide + bx) * blockSize], texels))
+				return false;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				uint32_t x = bx * 4 + i % 4;
+				uint32_t y = by * 4 + i / 4;
+				if (x < width && y < height)
+					memcpy(&decoded[(y * width + x) * 4], texels[i], 4);
+			}
+		}
+	}
+	return true;
+}
+
+// Over the first channels of every texel; BC1 skips texels it makes transparent.
+static double Psnr(uint32_t format, const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int channels)
+{
+	double squared = 0.0;
+	size_t count = 0;
+	for (size_t p = 0; p * 4 < a.size(); ++p)
+	{
+		if (format == BC1 && a[p * 4 + 3] < 128)
+			continue;
+		for (int c = 0; c < channels; ++c)
+		{
+			double d = (double)a[p * 4 + c] - b[p * 4 + c];
+			squared += d * d;
+			++count;
+		}
+	}
+	if (squared == 0.0)
+		return 99.0;
+	return 10.0 * std::log10(255.0 * 255.0 / (squared / count));
+}
+
+static std::vector<uint8_t> MakeGradient(uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> rgba(width * height * 4);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t* p = &rgba[(y * width + x) * 4];
+			p[0] = (uint8_t)(x * 255 / (width - 1));
+			p[1] = (uint8_t)(y * 255 / (height - 1));
+			p[2] = (uint8_t)((x + y) * 255 / (width + height - 2));
+			p[3] = (uint8_t)(255 - x * 255 / (width - 1));
+		}
+	}
+	return rgba;
+}
+
+TEST(BlockCompressionFormats)
+{
+	CHECK(BlockCompression::GetBlockSize(BC1) == 8);
+	CHECK(BlockCompression::GetBlockSize(BC4) == 8);
+	CHECK(BlockCompression::GetBlockSize(BC3) == 16);
+	CHECK(BlockCompression::GetBlockSize(BC7) == 16);
+	CHECK(BlockCompression::GetBlockSize(28) == 0);
+	CHECK(BlockCompression::CanEncode(BC7) && !BlockCompression::CanDecode(BC7));
+	CHECK(BlockCompression::CanDecode(BC5) && BlockCompression::CanEncode(BC5));
+}
+
+TEST(BlockCompressionFlatColor)
+{
+	// Representable in 5:6:5, so BC1 and BC3 are exact. BC7 mode 6 shares one
+	// p-bit between the channels of an endpoint, which costs it a step.
+	std::vector<uint8_t> rgba(8 * 8 * 4);
+	for (size_t i = 0; i < rgba.size(); i += 4)
+	{
+		rgba[i] = 255;
+		rgba[i + 1] = 0;
+		rgba[i + 2] = 255;
+		rgba[i + 3] = 255;
+	}
+	const uint32_t formats[] = { BC1, BC3, BC7 };
+	for (uint32_t format : formats)
+	{
+		std::vector<uint8_t> decoded;
+		CHECK(RoundTrip(format, rgba, 8, 8, BlockCompression::Quality::Normal, decoded));
+		for (size_t i = 0; i < rgba.size(); ++i)
+			CHECK(std::abs((int)decoded[i] - (int)rgba[i]) <= (format == BC7 ? 2 : 0));
+	}
+}
+
+TEST(BlockCompressionBC1Transparency)
+{
+	std::vector<uint8_t> rgba = MakeGradient(8, 8);
+	std::vector<uint8_t> decoded;
+	CHECK(RoundTrip(BC1, rgba, 8, 8, BlockCompression::Quality::Normal, decoded));
+	for (size_t p = 0; p < 64; ++p)
+	{
+		if (rgba[p * 4 + 3] < 128)
+			CHECK(decoded[p * 4] == 0 && decoded[p * 4 + 3] == 0);
+		else
+			CHECK(decoded[p * 4 + 3] == 255);
+	}
+}
+
+TEST(BlockCompressionGradientQuality)
+{
+	// 61x37 also exercises the edge blocks.
+	std::vector<uint8_t> rgba = MakeGradient(61, 37);
+	struct Case
+	{
+		uint32_t Format;
+		int Channels;
+		double MinPsnr;
+	};
+	const Case cases[] = { { BC1, 3, 35.0 }, { BC3, 4, 35.0 }, { BC4, 1, 48.0 }, { BC5, 2, 48.0 }, { BC7, 4, 35.0 } };
+	for (const Case& c : cases)
+	{
+		double psnr[3];
+		for (int quality = 0; quality < 3; ++quality)
+		{
+			std::vector<uint8_t> decoded;
+			CHECK(RoundTrip(c.Format, rgba, 61, 37, (BlockCompression::Quality)quality, decoded));
+			psnr[quality] = Psnr(c.Format, rgba, decoded, c.Channels);
+		}
+		CHECK(psnr[1] >= c.MinPsnr);
+		CHECK(psnr[1] >= psnr[0]);
+		CHECK(psnr[2] >= psnr[1] - 0.1);
+	}
+}
+
+TEST(BlockCompressionIsDeterministic)
+{
+	std::vector<uint8_t> rgba = MakeGradient(16, 16);
+	for (size_t i = 0; i < rgba.size(); ++i)
+		rgba[i] ^= (uint8_t)(i * 37);
+	std::vector<uint8_t> first, second;
+	CHECK(RoundTrip(BC7, rgba, 16, 16, BlockCompression::Quality::High, first));
+	CHECK(RoundTrip(BC7, rgba, 16, 16, BlockCompression::Quality::High, second));
+	CHECK(first == second);
+}
+
+static bool LoadImage(const char* fileName, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba)
+{
+	ImageFile image;
+	if (image.Open(fileName))
+	{
+		width = image.GetWidth();
+		height = image.GetHeight();
+		rgba.resize((size_t)width * height * 4);
+		image.ReadRGBA(rgba.data(), width * 4);
+		return true;
+	}
+
+	std::ifstream in(fileName, std::ios::binary);
+	std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	DDSFileView view;
+	std::vector<DDSSubresource> subs;
+	if (!view.Parse(file.data(), file.size()) || !view.GetSubresources(subs))
+		return false;
+	width = view.GetWidth();
+	height = view.GetHeight();
+	rgba.resize((size_t)width * height * 4);
+	if (BlockCompression::CanDecode(view.GetDxgiFormat()))
+		return BlockCompression::Decode(view.GetDxgiFormat(), subs[0].Data, subs[0].RowPitch, width, height, rgba.data(), width * 4);
+	if (view.GetDxgiFormat() != 28 || subs[0].RowPitch != width * 4)
+		return false;
+	memcpy(rgba.data(), subs[0].Data, rgba.size());
+	return true;
+}
+
+// BCEncode <image.ppm|bmp|dds>...
+// Encodes level 0 of every image into each format and preset, reporting PSNR
+// over the encoded channels and single thread throughput.
+BENCHMARK(BCEncode)
+{
+	struct Format
+	{
+		uint32_t Dxgi;
+		const char* Name;
+		int Channels;
+	};
+	const Format formats[] = { { BC1, "BC1", 3 }, { BC3, "BC3", 4 }, { BC4, "BC4", 1 }, { BC5, "BC5", 2 }, { BC7, "BC7", 4 } };
+	const char* qualities[] = { "Fast", "Normal", "High" };
+
+	int failed = 0;
+	for (int i = 0; i < argc; ++i)
+	{
+		uint32_t width, height;
+		std::vector<uint8_t> rgba;
+		if (!LoadImage(argv[i], width, height, rgba))
+		{
+			printf("skipped %s\n", argv[i]);
+			++failed;
+			continue;
+		}
+		printf("%s %ux%u\n", argv[i], width, height);
+		for (const Format& format : formats)
+		{
+			for (int quality = 0; quality < 3; ++quality)
+			{
+				size_t blockSize = BlockCompression::GetBlockSize(format.Dxgi);
+				size_t blockPitch = (width + 3) / 4 * blockSize;
+				std::vector<uint8_t> blocks(blockPitch * ((height + 3) / 4));
+				int runs = 0;
+				double ms = 0.0;
+				auto start = std::chrono::steady_clock::now();
+				do
+				{
+					BlockCompression::Encode(format.Dxgi, rgba.data(), width * 4, width, height, blocks.data(), blockPitch,
+						(BlockCompression::Quality)quality);
+					++runs;
+					ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				} while (ms < 200.0);
+				std::vector<uint8_t> decoded;
+				RoundTrip(format.Dxgi, rgba, width, height, (BlockCompression::Quality)quality, decoded);
+				printf("  %s %-6s %6.2f dB %6.1f Mpix/s\n", format.Name, qualities[quality],
+					Psnr(format.Dxgi, rgba, decoded, format.Channels), (double)width * height * runs / ms / 1000.0);
+			}
+		}
+	}
+	return failed;
+}
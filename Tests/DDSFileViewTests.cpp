@@ -0,0 +1,135 @@
+#include "Test.h"
+#include "DDSFileView.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+static void Put32(std::vector<uint8_t>& file, size_t offset, uint32_t value)
+{
+	memcpy(file.data() + offset, &value, sizeof(value));
+}
+
+// Legacy DXT1 header followed by bitBytes of pattern data.
+static std::vector<uint8_t> MakeDxt1(uint32_t width, uint32_t height, uint32_t mips, size_t bitBytes)
+{
+	std::vector<uint8_t> file(4 + DDSFileView::HeaderSize + bitBytes);
+	Put32(file, 0, DDSFileView::Magic);
+	Put32(file, 4 + 0, (uint32_t)DDSFileView::HeaderSize);
+	Put32(file, 4 + 8, height);
+	Put32(file, 4 + 12, width);
+	Put32(file, 4 + 24, mips);
+	Put32(file, 4 + 72, (uint32_t)DDSFileView::PixelFormatSize);
+	Put32(file, 4 + 76, 0x4);
+	Put32(file, 4 + 80, 0x31545844); // "DXT1"
+	for (size_t i = 0; i < bitBytes; ++i)
+		file[4 + DDSFileView::HeaderSize + i] = (uint8_t)i;
+	return file;
+}
+
+TEST(DDSFileViewSubresourcesAndStaging)
+{
+	// 8x8 BC1 with a full chain: 32 + 8 + 8 + 8 bytes of blocks.
+	std::vector<uint8_t> file = MakeDxt1(8, 8, 4, 56);
+	DDSFileView view;
+	CHECK(view.Parse(file.data(), file.size()));
+	CHECK(view.GetDxgiFormat() == 71);
+	CHECK(view.IsBlockCompressed());
+	CHECK(!view.IsCube() && view.GetArraySize() == 1);
+
+	std::vector<DDSSubresource> subs;
+	CHECK(view.GetSubresources(subs));
+	CHECK(subs.size() == 4);
+	CHECK(subs[0].RowPitch == 16 && subs[0].NumRows == 2);
+	CHECK(subs[1].RowPitch == 8 && subs[1].NumRows == 1);
+	CHECK(subs[3].Width == 1 && subs[3].RowPitch == 8);
+	CHECK(subs[1].Data == view.GetBitData() + 32);
+
+	// 256 byte rows, each subresource starting on 512 bytes.
+	CHECK(DDSFileView::GetStagingSize(subs) == 1536 + 256);
+	std::vector<uint8_t> staging(DDSFileView::GetStagingSize(subs), 0xcd);
+	DDSFileView::CopyToStaging(subs, staging.data());
+	CHECK(staging[0] == 0 && staging[15] == 15 && staging[16] == 0xcd);
+	CHECK(staging[256] == 16 && staging[256 + 15] == 31);
+	CHECK(staging[512] == 32 && staging[1024] == 40 && staging[1536] == 48);
+}
+
+TEST(DDSFileViewRejectsBadFiles)
+{
+	DDSFileView view;
+	std::vector<uint8_t> file = MakeDxt1(8, 8, 4, 56);
+	CHECK(!view.Parse(file.data(), 64));
+
+	// The header claims more mips than the file holds.
+	std::vector<uint8_t> truncated = MakeDxt1(8, 8, 4, 40);
+	std::vector<DDSSubresource> subs;
+	CHECK(view.Parse(truncated.data(), truncated.size()));
+	CHECK(!view.GetSubresources(subs));
+	CHECK(subs.empty());
+
+	file[0] = 'X';
+	CHECK(!view.Parse(file.data(), file.size()));
+}
+
+// DDSLoad [-map] <file.dds>...
+// Parses every file and copies it into a staging buffer 20 times, either read
+// into a heap buffer first (the old loader) or straight from a mapping.
+BENCHMARK(DDSLoad)
+{
+	bool mapped = argc > 0 && strcmp(argv[0], "-map") == 0;
+	int first = mapped ? 1 : 0;
+	const int passes = 20;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t staged = 0;
+	int loaded = 0;
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		for (int i = first; i < argc; ++i)
+		{
+			MappedFile mapping;
+			std::unique_ptr<uint8_t[]> buffer;
+			const uint8_t* data;
+			size_t size;
+			if (mapped)
+			{
+				if (!mapping.Open(argv[i]))
+					continue;
+				data = mapping.GetData();
+				size = mapping.GetSize();
+			}
+			else
+			{
+				std::ifstream in(argv[i], std::ios::binary | std::ios::ate);
+				if (!in)
+					continue;
+				size = (size_t)in.tellg();
+				buffer.reset(new uint8_t[size]);
+				in.seekg(0);
+				in.read((char*)buffer.get(), size);
+				data = buffer.get();
+			}
+
+			DDSFileView view;
+			std::vector<DDSSubresource> subs;
+			if (!view.Parse(data, size) || !view.GetSubresources(subs))
+			{
+				if (pass == 0)
+					printf("skipped %s\n", argv[i]);
+				continue;
+			}
+			size_t stagingSize = DDSFileView::GetStagingSize(subs);
+			std::unique_ptr<uint8_t[]> staging(new uint8_t[stagingSize]);
+			DDSFileView::CopyToStaging(subs, staging.get());
+			staged += stagingSize;
+			if (pass == 0)
+				++loaded;
+		}
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("%s: %d of %d files, %d passes, %.1f MB staged, %.2f ms per pass\n",
+		mapped ? "mapped" : "read", loaded, argc - first, passes, staged / 1048576.0, ms / passes);
+	return loaded == argc - first ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include "Test.h"
+#include "FenceRetireQueue.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+// The fence is a plain counter standing in for ID3D12Fence::GetCompletedValue.
+
+TEST(FenceRetireQueueRetiresInFenceOrder)
+{
+	FenceRetireQueue queue;
+	std::vector<int> order;
+	// Deferred out of order, as loader threads do against older fences.
+	queue.Enqueue(5, [&]() { order.push_back(5); });
+	queue.Enqueue(3, [&]() { order.push_back(3); });
+	queue.Enqueue(7, [&]() { order.push_back(7); });
+	queue.Enqueue(3, [&]() { order.push_back(30); });
+	CHECK(queue.GetPendingCount() == 4);
+	CHECK(queue.GetOldestFenceValue() == 3);
+
+	uint64_t completed = 2;
+	CHECK(queue.Retire(completed) == 0);
+	CHECK(order.empty());
+
+	completed = 5;
+	CHECK(queue.Retire(completed) == 3);
+	// Equal fence values keep the order they were deferred in.
+	CHECK((order == std::vector<int>{ 3, 30, 5 }));
+	CHECK(queue.GetPendingCount() == 1);
+	CHECK(queue.GetOldestFenceValue() == 7);
+
+	completed = 7;
+	CHECK(queue.Retire(completed) == 1);
+	CHECK(order.back() == 7);
+	CHECK(queue.GetPendingCount() == 0);
+	CHECK(queue.GetOldestFenceValue() == 0);
+}
+
+TEST(FenceRetireQueueReleasesCapturesOnRetire)
+{
+	FenceRetireQueue queue;
+	std::shared_ptr<int> resource = std::make_shared<int>(1);
+	std::weak_ptr<int> watch = resource;
+	queue.Enqueue(2, [resource]() {});
+	resource.reset();
+
+	CHECK(queue.Retire(1) == 0);
+	CHECK(!watch.expired());
+	CHECK(queue.Retire(2) == 1);
+	CHECK(watch.expired());
+}
+
+TEST(FenceRetireQueueCallbacksMayEnqueue)
+{
+	FenceRetireQueue queue;
+	int ran = 0;
+	queue.Enqueue(1, [&]()
+	{
+		++ran;
+		queue.Enqueue(4, [&]() { ++ran; });
+	});
+	CHECK(queue.Retire(10) == 1);
+	CHECK(ran == 1);
+	// Enqueued while retiring, so it waits for the next call.
+	CHECK(queue.GetPendingCount() == 1);
+	CHECK(queue.Retire(10) == 1);
+	CHECK(ran == 2);
+}
+
+TEST(FenceRetireQueueShutdownFlush)
+{
+	// GpuTimeline::Shutdown waits for the last signal, retires everything, then clears.
+	FenceRetireQueue queue;
+	int ran = 0;
+	for (uint64_t fence = 1; fence <= 8; ++fence)
+		queue.Enqueue(fence, [&]() { ++ran; });
+	CHECK(queue.Retire(UINT64_MAX) == 8);
+	CHECK(ran == 8);
+
+	// Teardown without a device: nothing runs, but captured objects are released.
+	std::shared_ptr<int> resource = std::make_shared<int>(1);
+	std::weak_ptr<int> watch = resource;
+	queue.Enqueue(9, [&ran, resource]() { ++ran; });
+	resource.reset();
+	queue.Clear();
+	CHECK(ran == 8);
+	CHECK(watch.expired());
+	CHECK(queue.GetPendingCount() == 0);
+}
+
+TEST(FenceRetireQueueConcurrentEnqueue)
+{
+	FenceRetireQueue queue;
+	const int PerThread = 10000;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&queue, t]()
+		{
+			for (int i = 0; i < PerThread; ++i)
+				queue.Enqueue((uint64_t)(i % 97 + t), []() {});
+		});
+	}
+	size_t retired = 0;
+	for (uint64_t completed = 0; completed < 50; ++completed)
+		retired += queue.Retire(completed);
+	for (std::thread& thread : threads)
+		thread.join();
+	retired += queue.Retire(UINT64_MAX);
+	CHECK(retired == 4 * PerThread);
+}
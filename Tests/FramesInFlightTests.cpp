@@ -0,0 +1,153 @@
+#include "Test.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double Ms(Clock::duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Sleeps rather than spins, so the two stages overlap even on one core.
+static void Work(double ms)
+{
+	std::this_thread::sleep_until(Clock::now() + std::chrono::microseconds((long long)(ms * 1000.0)));
+}
+
+// Stands in for the queue and its fence: frames are executed in submit order
+// on a second thread, and the fence value is the last frame it finished.
+class SimulatedGpu
+{
+public:
+	SimulatedGpu(double gpuMs, size_t frameCount)
+		: mGpuMs(gpuMs), mDone(frameCount)
+	{
+		mThread = std::thread([this]() { Execute(); });
+	}
+
+	~SimulatedGpu()
+	{
+		Submit(0);
+		mThread.join();
+	}
+
+	// Frame 0 stops the thread.
+	void Submit(uint64_t frame)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.push_back(frame);
+		mWake.notify_all();
+	}
+
+	void Wait(uint64_t frame)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mWake.wait(lock, [&]() { return mFence >= frame; });
+	}
+
+	Clock::time_point GetDoneTime(uint64_t frame) const { return mDone[frame - 1]; }
+
+private:
+	void Execute()
+	{
+		for (;;)
+		{
+			uint64_t frame;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWake.wait(lock, [&]() { return !mQueue.empty(); });
+				frame = mQueue.front();
+				mQueue.pop_front();
+			}
+			if (frame == 0)
+				return;
+			Work(mGpuMs);
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDone[frame - 1] = Clock::now();
+			mFence = frame;
+			mWake.notify_all();
+		}
+	}
+
+	double mGpuMs;
+	std::vector<Clock::time_point> mDone;
+	std::deque<uint64_t> mQueue;
+	uint64_t mFence = 0;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::thread mThread;
+};
+
+struct FrameTimes
+{
+	double FrameMs;
+	double LatencyMs;
+	double CpuWaitMs;
+};
+
+// The loop FrameResource::Begin drives: before recording frame N the CPU waits
+// for frame N - framesInFlight. Latency runs from the start of recording, where
+// input is read, to the end of that frame's GPU work.
+static FrameTimes RunFrames(size_t framesInFlight, double cpuMs, double gpuMs, size_t frameCount)
+{
+	std::vector<Clock::time_point> start(frameCount);
+	Clock::duration cpuWait = Clock::duration::zero();
+	SimulatedGpu gpu(gpuMs, frameCount);
+	for (uint64_t frame = 1; frame <= frameCount; ++frame)
+	{
+		Clock::time_point waitStart = Clock::now();
+		if (frame > framesInFlight)
+			gpu.Wait(frame - framesInFlight);
+		start[frame - 1] = Clock::now();
+		cpuWait += start[frame - 1] - waitStart;
+		Work(cpuMs);
+		gpu.Submit(frame);
+	}
+	gpu.Wait(frameCount);
+
+	// The first frames fill the pipeline, so only the second half counts.
+	size_t first = frameCount / 2;
+	FrameTimes times;
+	times.FrameMs = Ms(gpu.GetDoneTime(frameCount) - gpu.GetDoneTime(first)) / (frameCount - first);
+	times.LatencyMs = 0.0;
+	for (size_t frame = first + 1; frame <= frameCount; ++frame)
+		times.LatencyMs += Ms(gpu.GetDoneTime(frame) - start[frame - 1]);
+	times.LatencyMs /= frameCount - first;
+	times.CpuWaitMs = Ms(cpuWait) / frameCount;
+	return times;
+}
+
+// FramesInFlight [cpu ms] [gpu ms] [frames]
+// A model, not a measurement of the renderer: the CPU and GPU stages are sleeps
+// on two threads with the fence waits FrameResource does, for 1, 2 and 3 frames
+// in flight. With no arguments runs CPU bound, balanced and GPU bound cases.
+BENCHMARK(FramesInFlight)
+{
+	struct Case
+	{
+		double CpuMs;
+		double GpuMs;
+	};
+	std::vector<Case> cases = { { 8.0, 4.0 }, { 6.0, 6.0 }, { 4.0, 8.0 } };
+	if (argc >= 2)
+		cases = { { atof(argv[0]), atof(argv[1]) } };
+	size_t frameCount = argc >= 3 ? (size_t)atoi(argv[2]) : 200;
+
+	for (const Case& c : cases)
+	{
+		printf("CPU %.1f ms, GPU %.1f ms\n", c.CpuMs, c.GpuMs);
+		for (size_t framesInFlight = 1; framesInFlight <= 3; ++framesInFlight)
+		{
+			FrameTimes times = RunFrames(framesInFlight, c.CpuMs, c.GpuMs, frameCount);
+			printf("  -frames %zu: frame %.2f ms, latency %.2f ms, CPU wait %.2f ms\n",
+				framesInFlight, times.FrameMs, times.LatencyMs, times.CpuWaitMs);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include "Test.h"
+#include "ImageFile.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void Put(std::vector<uint8_t>& data, size_t offset, uint32_t value, int bytes)
+{
+	for (int i = 0; i < bytes; ++i)
+		data[offset + i] = (uint8_t)(value >> (i * 8));
+}
+
+// BI_RGB BMP; pixel (x, y) of the top-down image is { x, y, x + y, alpha(x, y) }
+// in RGBA order.
+static std::vector<uint8_t> MakeBmp(int32_t width, int32_t height, int bitCount, bool withAlpha)
+{
+	uint32_t rows = height > 0 ? height : -height;
+	size_t rowBytes = ((size_t)width * bitCount + 31) / 32 * 4;
+	std::vector<uint8_t> data(54 + rowBytes * rows, 0xee);
+	data[0] = 'B';
+	data[1] = 'M';
+	Put(data, 2, (uint32_t)data.size(), 4);
+	Put(data, 10, 54, 4);
+	Put(data, 14, 40, 4);
+	Put(data, 18, (uint32_t)width, 4);
+	Put(data, 22, (uint32_t)height, 4);
+	Put(data, 26, 1, 2);
+	Put(data, 28, bitCount, 2);
+	Put(data, 30, 0, 4);
+	for (uint32_t y = 0; y < rows; ++y)
+	{
+		uint32_t stored = height > 0 ? rows - 1 - y : y;
+		uint8_t* row = &data[54 + rowBytes * stored];
+		for (int32_t x = 0; x < width; ++x)
+		{
+			uint8_t* p = row + x * (bitCount / 8);
+			p[0] = (uint8_t)(x + y);
+			p[1] = (uint8_t)y;
+			p[2] = (uint8_t)x;
+			if (bitCount == 32)
+				p[3] = withAlpha ? (uint8_t)(x * 16) : 0;
+		}
+	}
+	return data;
+}
+
+static bool CheckPixels(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, bool withAlpha)
+{
+	bool ok = true;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint8_t* p = &rgba[(y * width + x) * 4];
+			uint8_t alpha = withAlpha ? (uint8_t)(x * 16) : 255;
+			ok &= p[0] == (uint8_t)x && p[1] == (uint8_t)y && p[2] == (uint8_t)(x + y) && p[3] == alpha;
+		}
+	}
+	return ok;
+}
+
+TEST(ImageFilePpm)
+{
+	// Not square, so swapping width and height would show.
+	std::string header = "P6\n# written by hand\n3 2\n255\n";
+	std::vector<uint8_t> data(header.begin(), header.end());
+	for (uint8_t i = 0; i < 3 * 2 * 3; ++i)
+		data.push_back(i);
+
+	ImageFile image;
+	CHECK(image.Parse(data.data(), data.size()));
+	CHECK(image.GetWidth() == 3 && image.GetHeight() == 2);
+	// Padded rows, as in a mapped linear image.
+	std::vector<uint8_t> rgba(2 * 16, 0xcd);
+	image.ReadRGBA(rgba.data(), 16);
+	CHECK(rgba[0] == 0 && rgba[1] == 1 && rgba[2] == 2 && rgba[3] == 255);
+	CHECK(rgba[8] == 6 && rgba[11] == 255 && rgba[12] == 0xcd);
+	CHECK(rgba[16] == 9 && rgba[16 + 8] == 15 && rgba[16 + 10] == 17);
+
+	CHECK(!image.Parse(data.data(), data.size() - 1));
+	std::string wrongMax = "P6 3 2 65535\n";
+	CHECK(!image.Parse((const uint8_t*)wrongMax.data(), wrongMax.size()));
+}
+
+TEST(ImageFileBmp)
+{
+	struct Case
+	{
+		int32_t Height;
+		int BitCount;
+		bool WithAlpha;
+	};
+	// 5 wide, so 24 bit rows are padded. Negative heights are stored top-down.
+	const Case cases[] = { { 3, 24, false }, { -3, 24, false }, { 3, 32, true }, { -3, 32, false } };
+	for (const Case& c : cases)
+	{
+		std::vector<uint8_t> data = MakeBmp(5, c.Height, c.BitCount, c.WithAlpha);
+		ImageFile image;
+		CHECK(image.Parse(data.data(), data.size()));
+		CHECK(image.GetWidth() == 5 && image.GetHeight() == 3);
+		std::vector<uint8_t> rgba(5 * 3 * 4);
+		image.ReadRGBA(rgba.data(), 5 * 4);
+		// An all-zero fourth byte reads as opaque.
+		CHECK(CheckPixels(rgba, 5, 3, c.WithAlpha));
+	}
+
+	std::vector<uint8_t> compressed = MakeBmp(5, 3, 24, false);
+	Put(compressed, 30, 1, 4);
+	ImageFile image;
+	CHECK(!image.Parse(compressed.data(), compressed.size()));
+	std::vector<uint8_t> truncated = MakeBmp(5, 3, 24, false);
+	CHECK(!image.Parse(truncated.data(), truncated.size() - 1));
+}
+
+// The loop CGame::ReadTextureFromFile ran: a first call for the size, a second
+// that freads three bytes per pixel. It also read the height first.
+static bool ReadPpmOld(const char* fileName, uint8_t* rgba, size_t rowPitch, int32_t* width, int32_t* height)
+{
+	FILE* file = fopen(fileName, "rb");
+	if (file == nullptr)
+		return false;
+	char header[256];
+	char* line = fgets(header, 256, file);
+	if (line == nullptr || strncmp(header, "P6\n", 3) != 0)
+	{
+		fclose(file);
+		return false;
+	}
+	do
+	{
+		line = fgets(header, 256, file);
+		if (line == nullptr)
+		{
+			fclose(file);
+			return false;
+		}
+	} while (strncmp(header, "#", 1) == 0);
+	sscanf(header, "%d %d", height, width);
+	if (rgba == nullptr)
+	{
+		fclose(file);
+		return true;
+	}
+	line = fgets(header, 256, file);
+	for (int32_t y = 0; y < *height; ++y)
+	{
+		uint8_t* row = rgba;
+		for (int32_t x = 0; x < *width; ++x)
+		{
+			size_t read = fread(row, 3, 1, file);
+			(void)read;
+			row[3] = 255;
+			row += 4;
+		}
+		rgba += rowPitch;
+	}
+	fclose(file);
+	return true;
+}
+
+// ImageRead <square.ppm>...
+// Old loop (both calls) against ImageFile, reading into 256 byte aligned rows,
+// 50 runs each. Fails if the outputs differ.
+BENCHMARK(ImageRead)
+{
+	const int runs = 50;
+	int failed = 0;
+	for (int i = 0; i < argc; ++i)
+	{
+		int32_t width, height;
+		if (!ReadPpmOld(argv[i], nullptr, 0, &width, &height))
+		{
+			printf("skipped %s\n", argv[i]);
+			++failed;
+			continue;
+		}
+		size_t pitch = ((size_t)width * 4 + 255) & ~(size_t)255;
+		std::vector<uint8_t> before(pitch * height), after(pitch * height);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; ++run)
+		{
+			ReadPpmOld(argv[i], nullptr, 0, &width, &height);
+			ReadPpmOld(argv[i], before.data(), pitch, &width, &height);
+		}
+		double oldMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+
+		start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; ++run)
+		{
+			ImageFile image;
+			image.Open(argv[i]);
+			image.ReadRGBA(after.data(), pitch);
+		}
+		double newMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+
+		bool same = true;
+		for (int32_t y = 0; y < height; ++y)
+			same &= memcmp(&before[y * pitch], &after[y * pitch], (size_t)width * 4) == 0;
+		failed += !same;
+		printf("%s %dx%d: old %.3f ms, ImageFile %.3f ms, %s\n", argv[i], width, height, oldMs, newMs,
+			same ? "identical" : "DIFFERENT");
+	}
+	return failed;
+}
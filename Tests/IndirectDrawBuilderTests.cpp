@@ -0,0 +1,146 @@
+#include "Test.h"
+#include "IndirectDrawBuilder.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+typedef IndirectDrawBuilder::Item Item;
+
+// x and y pass through, z in [0, 10] maps to depth [0, 1].
+static const float sBoxViewProj[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 0.1f, 0 }, { 0, 0, 0, 1 } };
+
+static float Distance(const float plane[4], float x, float y, float z)
+{
+	return plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+}
+
+static Item MakeItem(uint32_t group, uint32_t sortKey, float x, float y, float z, float radius)
+{
+	Item item = { group, sortKey, { x, y, z }, radius };
+	return item;
+}
+
+TEST(IndirectDrawBuilderFrustumPlanes)
+{
+	float planes[6][4];
+	IndirectDrawBuilder::ExtractFrustumPlanes(sBoxViewProj, planes);
+	// Left, right, bottom, top, near, far.
+	const float expected[6][4] = { { 1, 0, 0, 1 }, { -1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, -1, 0, 1 },
+		{ 0, 0, 0.1f, 0 }, { 0, 0, -0.1f, 1 } };
+	bool same = true;
+	for (int p = 0; p < 6; ++p)
+		for (int i = 0; i < 4; ++i)
+			same &= std::fabs(planes[p][i] - expected[p][i]) < 1e-6f;
+	CHECK(same);
+
+	// A perspective projection, 90 degree field of view, near 1, far 100,
+	// with the camera turned to look down -x: the far corner of the view is
+	// inside every plane, a point behind the camera is outside the near one.
+	const float n = 1.0f, f = 100.0f;
+	const float proj[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, f / (f - n), 1 }, { 0, 0, -n * f / (f - n), 0 } };
+	const float view[4][4] = { { 0, 0, -1, 0 }, { 0, 1, 0, 0 }, { 1, 0, 0, 0 }, { 0, 0, 0, 1 } };
+	float viewProj[4][4] = {};
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			for (int k = 0; k < 4; ++k)
+				viewProj[r][c] += view[r][k] * proj[k][c];
+	IndirectDrawBuilder::ExtractFrustumPlanes(viewProj, planes);
+	bool inside = true;
+	for (int p = 0; p < 6; ++p)
+		inside &= Distance(planes[p], -99.0f, 98.0f, 98.0f) >= 0.0f;
+	CHECK(inside);
+	CHECK(Distance(planes[4], 0.5f, 0.0f, 0.0f) < 0.0f);
+	CHECK(Distance(planes[4], -1.5f, 0.0f, 0.0f) > 0.0f);
+	CHECK(Distance(planes[5], -101.0f, 0.0f, 0.0f) < 0.0f);
+	CHECK(Distance(planes[0], -10.0f, 0.0f, 11.0f) < 0.0f || Distance(planes[1], -10.0f, 0.0f, 11.0f) < 0.0f);
+}
+
+TEST(IndirectDrawBuilderCullsAtTheEdges)
+{
+	float planes[6][4];
+	IndirectDrawBuilder::ExtractFrustumPlanes(sBoxViewProj, planes);
+	// Planes are normalized first, so the near plane's 0.1 scale does not
+	// shrink the radius test.
+	std::vector<Item> items = {
+		MakeItem(0, 0, 1.5f, 0.0f, 5.0f, 0.5f),    // touches the right plane
+		MakeItem(0, 0, 1.51f, 0.0f, 5.0f, 0.5f),   // just past it
+		MakeItem(0, 0, 0.0f, -1.25f, 5.0f, 0.5f),  // straddles the bottom plane
+		MakeItem(0, 0, 0.0f, 0.0f, -0.5f, 0.5f),   // touches the near plane
+		MakeItem(0, 0, 0.0f, 0.0f, -0.51f, 0.5f),  // just behind it
+		MakeItem(0, 0, 0.0f, 0.0f, 10.49f, 0.5f),  // straddles the far plane
+		MakeItem(0, 0, 0.0f, 0.0f, 10.51f, 0.5f),  // past it
+		MakeItem(0, 0, 2.0f, 2.0f, 5.0f, 0.9f),    // outside the corner, near both
+	};
+	IndirectDrawBuilder builder;
+	builder.Build(items, planes, 6);
+	CHECK((builder.GetOrder() == std::vector<uint32_t>{ 0, 2, 3, 5 }));
+	CHECK(builder.GetCulledCount() == 4);
+
+	// Without planes, or with only degenerate ones, everything is kept.
+	builder.Build(items, nullptr, 0);
+	CHECK(builder.GetOrder().size() == items.size());
+	CHECK(builder.GetCulledCount() == 0);
+	const float degenerate[1][4] = { { 0, 0, 0, -1 } };
+	builder.Build(items, degenerate, 1);
+	CHECK(builder.GetCulledCount() == 0);
+}
+
+TEST(IndirectDrawBuilderSortsIntoGroupRanges)
+{
+	std::vector<Item> items = {
+		MakeItem(4, 5, 0, 0, 0, 1),
+		MakeItem(1, 9, 0, 0, 0, 1),
+		MakeItem(4, 1, 0, 0, 0, 1),
+		MakeItem(1, 2, 0, 0, 0, 1),
+		MakeItem(4, 5, 0, 0, 0, 1),
+		MakeItem(1, 9, 0, 0, 0, 1),
+		MakeItem(2, 0xffffffff, 0, 0, 0, 1),
+	};
+	IndirectDrawBuilder builder;
+	builder.Build(items, nullptr, 0);
+	// By group, then key; equal keys keep their given order.
+	CHECK((builder.GetOrder() == std::vector<uint32_t>{ 3, 1, 5, 6, 2, 0, 4 }));
+	const std::vector<IndirectDrawBuilder::Range>& ranges = builder.GetRanges();
+	CHECK(ranges.size() == 3);
+	CHECK(ranges[0].Group == 1 && ranges[0].First == 0 && ranges[0].Count == 3);
+	CHECK(ranges[1].Group == 2 && ranges[1].First == 3 && ranges[1].Count == 1);
+	CHECK(ranges[2].Group == 4 && ranges[2].First == 4 && ranges[2].Count == 3);
+
+	// Culling an entire group leaves no empty range behind.
+	const float keepNone[1][4] = { { 1, 0, 0, -10 } };
+	items.push_back(MakeItem(3, 0, 20, 0, 0, 1));
+	builder.Build(items, keepNone, 1);
+	CHECK((builder.GetOrder() == std::vector<uint32_t>{ 7 }));
+	CHECK(builder.GetRanges().size() == 1 && builder.GetRanges()[0].Group == 3);
+
+	builder.Build(std::vector<Item>(), nullptr, 0);
+	CHECK(builder.GetOrder().empty() && builder.GetRanges().empty());
+}
+
+// IndirectBuild [items]
+// Average of 50 builds of random items in 3 groups with 64 sort keys, about
+// a sixth of them inside the view.
+BENCHMARK(IndirectBuild)
+{
+	size_t count = argc > 0 ? (size_t)atoi(argv[0]) : 50000;
+	float planes[6][4];
+	IndirectDrawBuilder::ExtractFrustumPlanes(sBoxViewProj, planes);
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> spread(-2.0f, 2.0f);
+	std::vector<Item> items(count);
+	for (size_t i = 0; i < count; ++i)
+		items[i] = MakeItem((uint32_t)(i % 3), random() % 64, spread(random), spread(random), spread(random) * 5.0f + 5.0f, 0.1f);
+
+	IndirectDrawBuilder builder;
+	builder.Build(items, planes, 6);
+	const int runs = 50;
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < runs; ++run)
+		builder.Build(items, planes, 6);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+	printf("%zu items: %.3f ms per build (%.1f ns per item), %zu kept, %zu ranges\n", count, ms,
+		ms * 1e6 / count, builder.GetOrder().size(), builder.GetRanges().size());
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include "Test.h"
+#include "JobSystem.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// Every test runs with no workers (everything on the caller) up to four.
+static const size_t sMaxWorkers = 4;
+
+TEST(JobSystemParallelForCoversRange)
+{
+	for (size_t workers = 0; workers <= sMaxWorkers; ++workers)
+	{
+		JobSystem jobs;
+		jobs.Start(workers);
+		std::vector<int> hits(100000, 0);
+		jobs.ParallelFor(0, hits.size(), 64, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				++hits[i];
+		});
+		bool once = true;
+		for (int hit : hits)
+			once &= hit == 1;
+		CHECK(once);
+
+		// Empty and single-grain ranges run inline.
+		int calls = 0;
+		jobs.ParallelFor(5, 5, 16, [&](size_t, size_t) { ++calls; });
+		jobs.ParallelFor(0, 16, 16, [&](size_t begin, size_t end) { calls += (int)(end - begin); });
+		CHECK(calls == 16);
+		jobs.Stop();
+	}
+}
+
+TEST(JobSystemNestedParallelFor)
+{
+	for (size_t workers = 0; workers <= sMaxWorkers; ++workers)
+	{
+		JobSystem jobs;
+		jobs.Start(workers);
+		std::atomic<long> sum(0);
+		// Waiting inside a job runs other jobs instead of blocking.
+		jobs.ParallelFor(0, 64, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				jobs.ParallelFor(0, 1000, 16, [&](size_t innerBegin, size_t innerEnd)
+				{
+					sum += (long)(innerEnd - innerBegin);
+				});
+			}
+		});
+		CHECK(sum == 64000);
+		jobs.Stop();
+	}
+}
+
+TEST(JobSystemContinuationsRunInOrder)
+{
+	for (size_t workers = 0; workers <= sMaxWorkers; ++workers)
+	{
+		JobSystem jobs;
+		jobs.Start(workers);
+		bool ordered = true;
+		for (int chain = 0; chain < 2000; ++chain)
+		{
+			JobSystem::Counter first, second, third;
+			std::atomic<int> stage(0);
+			std::atomic<bool> bad(false);
+			for (int i = 0; i < 8; ++i)
+				jobs.Run([&]() { stage.fetch_add(1); }, &first);
+			jobs.RunAfter(first, [&]()
+			{
+				if (stage.load() != 8)
+					bad = true;
+				stage.fetch_add(100);
+			}, &second);
+			jobs.RunAfter(second, [&]()
+			{
+				if (stage.load() != 108)
+					bad = true;
+				stage.fetch_add(1000);
+			}, &third);
+			jobs.Wait(third);
+			ordered &= !bad && stage == 1108;
+		}
+		CHECK(ordered);
+
+		// A continuation on a counter that is already zero starts right away.
+		JobSystem::Counter idle, done;
+		bool ran = false;
+		jobs.RunAfter(idle, [&]() { ran = true; }, &done);
+		jobs.Wait(done);
+		CHECK(ran);
+		jobs.Stop();
+	}
+}
+
+TEST(JobSystemParticipants)
+{
+	JobSystem jobs;
+	jobs.Start(3);
+	CHECK(jobs.GetThreadCount() == 3);
+	CHECK(jobs.GetParticipantCount() == 4);
+	CHECK(jobs.GetParticipant() == 0);
+
+	std::vector<std::atomic<int>> perThread(4);
+	for (std::atomic<int>& count : perThread)
+		count = 0;
+	std::atomic<bool> inRange(true);
+	jobs.ParallelFor(0, 4096, 8, [&](size_t, size_t)
+	{
+		size_t participant = jobs.GetParticipant();
+		if (participant >= 4)
+			inRange = false;
+		else
+			++perThread[participant];
+	});
+	CHECK(inRange);
+	jobs.Stop();
+}
+
+// JobOverhead [max workers]
+// Cost of an empty job and a 5 x 4M element ParallelFor for 0..max workers.
+BENCHMARK(JobOverhead)
+{
+	size_t maxWorkers = argc > 0 ? (size_t)atoi(argv[0]) : JobSystem::GetDefaultThreadCount();
+	typedef std::chrono::steady_clock Clock;
+	for (size_t workers = 0; workers <= maxWorkers; ++workers)
+	{
+		JobSystem jobs;
+		jobs.Start(workers);
+
+		const int count = 200000;
+		JobSystem::Counter counter;
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < count; ++i)
+			jobs.Run([]() {}, &counter);
+		jobs.Wait(counter);
+		double emptyNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+		std::vector<float> data(1 << 22);
+		start = Clock::now();
+		for (int run = 0; run < 5; ++run)
+		{
+			jobs.ParallelFor(0, data.size(), 4096, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					data[i] = std::sqrt((float)i * 1.0001f + data[i]);
+			});
+		}
+		double forMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		printf("%zu workers: empty job %.0f ns, ParallelFor 5 x 4M sqrt %.1f ms, %zu steals\n",
+			workers, emptyNs, forMs, jobs.GetStealCount());
+		jobs.Stop();
+	}
+	return 0;
+}
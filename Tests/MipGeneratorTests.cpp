@@ -0,0 +1,135 @@
+#include "Test.h"
+#include "MipGenerator.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static bool AllPixelsNear(const MipLevel& level, const uint8_t expected[4], int tolerance)
+{
+	for (size_t i = 0; i < level.Pixels.size(); ++i)
+	{
+		if (std::abs((int)level.Pixels[i] - (int)expected[i % 4]) > tolerance)
+			return false;
+	}
+	return true;
+}
+
+TEST(MipGeneratorChainSizes)
+{
+	CHECK(MipGenerator::GetMipCount(1, 1) == 1);
+	CHECK(MipGenerator::GetMipCount(1024, 1024) == 11);
+	CHECK(MipGenerator::GetMipCount(5, 3) == 3);
+
+	std::vector<uint8_t> image(5 * 3 * 4, 128);
+	std::vector<MipLevel> levels;
+	MipGenerator::Options options;
+	options.Kernel = MipGenerator::Filter::Box;
+	MipGenerator::Generate(image.data(), 5, 3, 5 * 4, options, levels);
+	CHECK(levels.size() == 3);
+	CHECK(levels[1].Width == 2 && levels[1].Height == 1);
+	CHECK(levels[2].Width == 1 && levels[2].Height == 1);
+	CHECK(levels[1].Pixels.size() == 2 * 4);
+	CHECK(levels[0].Pixels == image);
+
+	options.MaxLevels = 2;
+	MipGenerator::Generate(image.data(), 5, 3, 5 * 4, options, levels);
+	CHECK(levels.size() == 2);
+}
+
+TEST(MipGeneratorKeepsFlatColor)
+{
+	const uint8_t color[4] = { 200, 40, 90, 255 };
+	std::vector<uint8_t> image(64 * 32 * 4);
+	for (size_t i = 0; i < image.size(); ++i)
+		image[i] = color[i % 4];
+
+	for (int kernel = 0; kernel < 2; ++kernel)
+	{
+		for (int srgb = 0; srgb < 2; ++srgb)
+		{
+			MipGenerator::Options options;
+			options.Kernel = kernel ? MipGenerator::Filter::Kaiser : MipGenerator::Filter::Box;
+			options.SRGB = srgb != 0;
+			std::vector<MipLevel> levels;
+			MipGenerator::Generate(image.data(), 64, 32, 64 * 4, options, levels);
+			CHECK(levels.size() == 7);
+			for (const MipLevel& level : levels)
+				CHECK(AllPixelsNear(level, color, 1));
+		}
+	}
+}
+
+TEST(MipGeneratorBoxAveragesInLinearLight)
+{
+	// Black and white columns: linear average is 0.5, which is 188 in sRGB.
+	std::vector<uint8_t> image(2 * 2 * 4, 255);
+	image[0] = image[1] = image[2] = 0;
+	image[8] = image[9] = image[10] = 0;
+	MipGenerator::Options options;
+	options.Kernel = MipGenerator::Filter::Box;
+	std::vector<MipLevel> levels;
+
+	MipGenerator::Generate(image.data(), 2, 2, 2 * 4, options, levels);
+	CHECK(levels.size() == 2);
+	CHECK(std::abs((int)levels[1].Pixels[0] - 128) <= 1);
+
+	options.SRGB = true;
+	MipGenerator::Generate(image.data(), 2, 2, 2 * 4, options, levels);
+	CHECK(std::abs((int)levels[1].Pixels[0] - 188) <= 1);
+	CHECK(levels[1].Pixels[3] == 255);
+}
+
+TEST(MipGeneratorPreservesAlphaCoverage)
+{
+	// A quarter of the texels pass the alpha test, in 2x2 dots spread 4 apart.
+	const uint32_t size = 64;
+	std::vector<uint8_t> image(size * size * 4, 255);
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+			image[(y * size + x) * 4 + 3] = (x % 4 < 2 && y % 4 < 2) ? 255 : 0;
+	}
+	CHECK(MipGenerator::IsAlphaTested(image.data(), size, size, size * 4));
+
+	MipGenerator::Options options;
+	options.PreserveAlphaCoverage = true;
+	std::vector<MipLevel> levels;
+	MipGenerator::Generate(image.data(), size, size, size * 4, options, levels);
+	for (size_t i = 1; i + 2 < levels.size(); ++i)
+	{
+		const MipLevel& level = levels[i];
+		size_t passing = 0;
+		size_t count = (size_t)level.Width * level.Height;
+		for (size_t p = 0; p < count; ++p)
+			passing += level.Pixels[p * 4 + 3] >= 128;
+		// Plain filtering would leave every texel at 25% alpha, all failing.
+		CHECK(passing * 8 >= count && passing * 8 <= count * 3);
+	}
+}
+
+// MipGenerate [size]
+// Full chain of a random sRGB image with both kernels, averaged over 5 runs.
+BENCHMARK(MipGenerate)
+{
+	uint32_t size = argc > 0 ? (uint32_t)atoi(argv[0]) : 1024;
+	std::vector<uint8_t> image((size_t)size * size * 4);
+	srand(1);
+	for (uint8_t& value : image)
+		value = (uint8_t)rand();
+
+	const int runs = 5;
+	for (int kernel = 0; kernel < 2; ++kernel)
+	{
+		MipGenerator::Options options;
+		options.Kernel = kernel ? MipGenerator::Filter::Kaiser : MipGenerator::Filter::Box;
+		options.SRGB = true;
+		std::vector<MipLevel> levels;
+		auto start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; ++run)
+			MipGenerator::Generate(image.data(), size, size, size * 4, options, levels);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+		printf("%ux%u %s: %zu levels, %.1f ms\n", size, size, kernel ? "kaiser" : "box", levels.size(), ms);
+	}
+	return 0;
+}
@@ -0,0 +1,211 @@
+#include "Test.h"
+#include "MipResidency.h"
+#include <cmath>
+#include <vector>
+
+// Five mips, the last three (42 bytes) are the tail that never streams.
+static const uint64_t sMipBytes[5] = { 512, 128, 32, 8, 2 };
+static const uint64_t sTailBytes = 42;
+static const uint64_t sFullBytes = 682;
+
+TEST(MipResidencyDesiredMip)
+{
+	CHECK(MipResidency::ComputeDesiredMip(10.0f, 100.0f) == 0.0f);
+	CHECK(std::fabs(MipResidency::ComputeDesiredMip(1024.0f, 256.0f) - 2.0f) < 1e-5f);
+	CHECK(MipResidency::ComputeDesiredMip(1024.0f, 0.0f) > 100.0f);
+}
+
+TEST(MipResidencyLoadsWithinBudget)
+{
+	MipResidency residency;
+	residency.SetBudget(1000);
+	int id = residency.AddTexture(sMipBytes, 5, 2);
+	CHECK(residency.GetResidentMip(id) == 2);
+	CHECK(residency.GetResidentBytes() == sTailBytes);
+
+	std::vector<MipResidency::Action> actions;
+	residency.BeginFrame(1);
+	// Requests below the tail clamp to it, the most detailed request wins.
+	residency.Request(id, 4.0f);
+	residency.Request(id, 0.7f);
+	residency.Update(actions);
+	CHECK(actions.size() == 1);
+	CHECK(actions[0].Id == id && actions[0].TargetMip == 0 && !actions[0].Evict);
+	// Counted as soon as it is scheduled.
+	CHECK(residency.GetResidentBytes() == sFullBytes);
+	CHECK(residency.IsPending(id));
+
+	// Nothing more is scheduled for a pending texture.
+	residency.BeginFrame(2);
+	residency.Request(id, 0.0f);
+	residency.Update(actions);
+	CHECK(actions.empty());
+
+	residency.OnStreamed(id, 0);
+	CHECK(!residency.IsPending(id));
+	residency.Update(actions);
+	CHECK(actions.empty());
+}
+
+TEST(MipResidencyFailedLoadKeepsPreviousMip)
+{
+	MipResidency residency;
+	residency.SetBudget(1000);
+	int id = residency.AddTexture(sMipBytes, 5, 2);
+	std::vector<MipResidency::Action> actions;
+	residency.BeginFrame(1);
+	residency.Request(id, 0.0f);
+	residency.Update(actions);
+	CHECK(actions.size() == 1);
+
+	residency.OnStreamed(id, 2);
+	CHECK(residency.GetResidentMip(id) == 2);
+	CHECK(residency.GetResidentBytes() == sTailBytes);
+	// Still wanted, so it is tried again.
+	residency.Update(actions);
+	CHECK(actions.size() == 1 && actions[0].TargetMip == 0);
+}
+
+TEST(MipResidencyEvictsLeastRecentlyUsed)
+{
+	MipResidency residency;
+	residency.SetBudget(1500);
+	int a = residency.AddTexture(sMipBytes, 5, 2);
+	int b = residency.AddTexture(sMipBytes, 5, 2);
+	int c = residency.AddTexture(sMipBytes, 5, 2);
+	std::vector<MipResidency::Action> actions;
+
+	residency.BeginFrame(1);
+	residency.Request(a, 0.0f);
+	residency.Update(actions);
+	residency.OnStreamed(a, 0);
+
+	residency.BeginFrame(2);
+	residency.Request(b, 0.0f);
+	residency.Update(actions);
+	residency.OnStreamed(b, 0);
+	CHECK(residency.GetResidentBytes() == 2 * sFullBytes + sTailBytes);
+
+	// c does not fit next to both: a was used longest ago, so it drops to its tail.
+	residency.BeginFrame(3);
+	residency.Request(b, 0.0f);
+	residency.Request(c, 0.0f);
+	residency.Update(actions);
+	CHECK(actions.size() == 2);
+	CHECK(actions[0].Id == a && actions[0].Evict && actions[0].TargetMip == 2);
+	CHECK(actions[1].Id == c && !actions[1].Evict && actions[1].TargetMip == 0);
+	CHECK(residency.GetResidentMip(b) == 0);
+	CHECK(residency.GetResidentBytes() == 2 * sFullBytes + sTailBytes);
+	CHECK(residency.GetResidentBytes() <= residency.GetBudget());
+}
+
+TEST(MipResidencyTakesBestMipThatFits)
+{
+	MipResidency residency;
+	residency.SetBudget(300);
+	int a = residency.AddTexture(sMipBytes, 5, 2);
+	int b = residency.AddTexture(sMipBytes, 5, 2);
+	std::vector<MipResidency::Action> actions;
+	residency.BeginFrame(1);
+	residency.Request(a, 0.0f);
+	residency.Request(b, 1.0f);
+	residency.Update(actions);
+	// Mip 0 of a needs 640 more bytes and nothing can be evicted; mip 1 fits.
+	CHECK(actions.size() == 1);
+	CHECK(actions[0].Id == a && actions[0].TargetMip == 1);
+	CHECK(residency.GetResidentBytes() == 2 * sTailBytes + 128);
+	CHECK(residency.GetResidentMip(b) == 2);
+}
+
+TEST(MipResidencyLimitsActionsPerUpdate)
+{
+	MipResidency residency;
+	residency.SetBudget(1 << 20);
+	residency.SetMaxActionsPerUpdate(2);
+	int ids[4];
+	for (int& id : ids)
+		id = residency.AddTexture(sMipBytes, 5, 2);
+	std::vector<MipResidency::Action> actions;
+	residency.BeginFrame(1);
+	residency.Request(ids[0], 1.0f);
+	residency.Request(ids[1], 0.0f);
+	residency.Request(ids[2], 1.0f);
+	residency.Request(ids[3], 0.0f);
+	residency.Update(actions);
+	// Biggest gap first, ties on id.
+	CHECK(actions.size() == 2);
+	CHECK(actions[0].Id == ids[1] && actions[1].Id == ids[3]);
+	residency.Update(actions);
+	CHECK(actions.size() == 2);
+	CHECK(actions[0].Id == ids[0] && actions[1].Id == ids[2]);
+}
+
+TEST(MipResidencyLoweredBudgetEvicts)
+{
+	MipResidency residency;
+	residency.SetBudget(1000);
+	int id = residency.AddTexture(sMipBytes, 5, 2);
+	std::vector<MipResidency::Action> actions;
+	residency.BeginFrame(1);
+	residency.Request(id, 0.0f);
+	residency.Update(actions);
+	residency.OnStreamed(id, 0);
+
+	residency.SetBudget(100);
+	residency.BeginFrame(2);
+	residency.Update(actions);
+	CHECK(actions.size() == 1);
+	CHECK(actions[0].Id == id && actions[0].Evict && actions[0].TargetMip == 2);
+	CHECK(residency.GetResidentBytes() == sTailBytes);
+}
+
+TEST(MipResidencyIsDeterministic)
+{
+	// The same calls give the same actions, whatever ran before.
+	std::vector<MipResidency::Action> runs[2];
+	for (auto& run : runs)
+	{
+		MipResidency residency;
+		residency.SetBudget(2000);
+		int ids[6];
+		for (int& id : ids)
+			id = residency.AddTexture(sMipBytes, 5, 2);
+		std::vector<MipResidency::Action> actions;
+		for (uint64_t frame = 1; frame <= 12; ++frame)
+		{
+			residency.BeginFrame(frame);
+			for (int i = 0; i < 6; ++i)
+			{
+				if ((frame + i) % 3 != 0)
+					residency.Request(ids[i], (float)((frame * 7 + i) % 4));
+			}
+			residency.Update(actions);
+			for (const MipResidency::Action& action : actions)
+			{
+				residency.OnStreamed(action.Id, action.TargetMip);
+				run.push_back(action);
+			}
+			CHECK(residency.GetResidentBytes() <= residency.GetBudget());
+		}
+	}
+	CHECK(runs[0].size() == runs[1].size());
+	for (size_t i = 0; i < runs[0].size() && i < runs[1].size(); ++i)
+	{
+		CHECK(runs[0][i].Id == runs[1][i].Id);
+		CHECK(runs[0][i].TargetMip == runs[1][i].TargetMip);
+		CHECK(runs[0][i].Evict == runs[1][i].Evict);
+	}
+}
+
+TEST(MipResidencyReusesRemovedIds)
+{
+	MipResidency residency;
+	int a = residency.AddTexture(sMipBytes, 5, 2);
+	int b = residency.AddTexture(sMipBytes, 5, 2);
+	residency.RemoveTexture(a);
+	CHECK(residency.GetResidentBytes() == sTailBytes);
+	CHECK(residency.AddTexture(sMipBytes, 5, 3) == a);
+	CHECK(residency.GetResidentMip(a) == 3);
+	CHECK(residency.GetResidentBytes() == sTailBytes + 10);
+	CHECK(b != a);
+}
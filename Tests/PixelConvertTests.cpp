@@ -0,0 +1,108 @@
+#include "Test.h"
+#include "PixelConvert.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+typedef PixelConvert::Source Source;
+
+static const Source sSources[] = { Source::RGB8, Source::BGR8, Source::RGBX8, Source::BGRX8,
+	Source::BGRA8, Source::L8, Source::A8L8, Source::B5G6R5 };
+static const char* sSourceNames[] = { "RGB8", "BGR8", "RGBX8", "BGRX8", "BGRA8", "L8", "A8L8", "B5G6R5" };
+
+TEST(PixelConvertSimdMatchesScalar)
+{
+	// Every length up to 199 from unaligned sources, so each kernel's tail runs.
+	std::mt19937 random(1);
+	for (Source source : sSources)
+	{
+		size_t bytes = PixelConvert::GetSourceBytes(source);
+		for (size_t pixels = 0; pixels < 200; ++pixels)
+		{
+			for (size_t offset = 0; offset < 3; ++offset)
+			{
+				std::vector<uint8_t> src(pixels * bytes + offset + 1);
+				for (uint8_t& value : src)
+					value = (uint8_t)random();
+				// One byte past the end catches overruns.
+				std::vector<uint8_t> simd(pixels * 4 + 1, 7), scalar(pixels * 4 + 1, 7);
+				uint8_t simdAlpha = PixelConvert::ToRGBA8(source, src.data() + offset, simd.data(), pixels, true);
+				uint8_t scalarAlpha = PixelConvert::ToRGBA8(source, src.data() + offset, scalar.data(), pixels, false);
+				CHECK(simd == scalar);
+				CHECK(simdAlpha == scalarAlpha);
+				CHECK(simd.back() == 7);
+			}
+		}
+
+		if (bytes == 2)
+		{
+			std::vector<uint8_t> src(65536 * 2);
+			for (uint32_t i = 0; i < 65536; ++i)
+			{
+				src[i * 2] = (uint8_t)i;
+				src[i * 2 + 1] = (uint8_t)(i >> 8);
+			}
+			std::vector<uint8_t> simd(65536 * 4), scalar(65536 * 4);
+			PixelConvert::ToRGBA8(source, src.data(), simd.data(), 65536, true);
+			PixelConvert::ToRGBA8(source, src.data(), scalar.data(), 65536, false);
+			CHECK(simd == scalar);
+		}
+	}
+}
+
+TEST(PixelConvertLayouts)
+{
+	const uint8_t rgb[3] = { 10, 20, 30 };
+	uint8_t out[4];
+	CHECK(PixelConvert::ToRGBA8(Source::BGR8, rgb, out, 1, false) == 255);
+	CHECK(out[0] == 30 && out[1] == 20 && out[2] == 10 && out[3] == 255);
+
+	const uint8_t bgra[4] = { 1, 2, 3, 0 };
+	CHECK(PixelConvert::ToRGBA8(Source::BGRA8, bgra, out, 1, false) == 0);
+	CHECK(out[0] == 3 && out[1] == 2 && out[2] == 1 && out[3] == 0);
+
+	const uint8_t luminanceAlpha[2] = { 77, 99 };
+	PixelConvert::ToRGBA8(Source::A8L8, luminanceAlpha, out, 1, false);
+	CHECK(out[0] == 77 && out[1] == 77 && out[2] == 77 && out[3] == 99);
+
+	// Full and half intensity per channel, rounded like a UNORM fetch.
+	const uint8_t white565[2] = { 0xff, 0xff };
+	PixelConvert::ToRGBA8(Source::B5G6R5, white565, out, 1, false);
+	CHECK(out[0] == 255 && out[1] == 255 && out[2] == 255 && out[3] == 255);
+	const uint16_t mid = (16 << 11) | (32 << 5) | 16;
+	const uint8_t mid565[2] = { (uint8_t)mid, (uint8_t)(mid >> 8) };
+	PixelConvert::ToRGBA8(Source::B5G6R5, mid565, out, 1, false);
+	CHECK(out[0] == 132 && out[1] == 130 && out[2] == 132);
+}
+
+// PixelConvert [megapixels]
+// Best of 10 runs per source layout, SIMD kernel against the scalar reference.
+BENCHMARK(PixelConvert)
+{
+	size_t pixels = (size_t)(argc > 0 ? atof(argv[0]) : 4.0) * 1024 * 1024;
+	std::mt19937 random(1);
+	for (size_t s = 0; s < sizeof(sSources) / sizeof(sSources[0]); ++s)
+	{
+		std::vector<uint8_t> src(pixels * PixelConvert::GetSourceBytes(sSources[s]));
+		for (uint8_t& value : src)
+			value = (uint8_t)random();
+		std::vector<uint8_t> dst(pixels * 4);
+
+		double msPerMegapixel[2];
+		for (int simd = 1; simd >= 0; --simd)
+		{
+			double best = 1e9;
+			for (int run = 0; run < 10; ++run)
+			{
+				auto start = std::chrono::steady_clock::now();
+				PixelConvert::ToRGBA8(sSources[s], src.data(), dst.data(), pixels, simd != 0);
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				best = ms < best ? ms : best;
+			}
+			msPerMegapixel[simd] = best * 1024 * 1024 / pixels;
+		}
+		printf("%-7s SIMD %.2f ms/Mpix, scalar %.2f ms/Mpix\n", sSourceNames[s], msPerMegapixel[1], msPerMegapixel[0]);
+	}
+	return 0;
+}
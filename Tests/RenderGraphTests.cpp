@@ -0,0 +1,148 @@
+#include "Test.h"
+#include "RenderGraph.h"
+#include <string>
+#include <vector>
+
+typedef RenderGraph Graph;
+
+static bool Same(const std::vector<Graph::Barrier>& actual, const std::vector<Graph::Barrier>& expected)
+{
+	if (actual.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < actual.size(); ++i)
+	{
+		const Graph::Barrier& a = actual[i];
+		const Graph::Barrier& e = expected[i];
+		if (a.Kind != e.Kind || a.Texture != e.Texture || a.Since != e.Since)
+			return false;
+		if (a.Kind == Graph::Barrier::Transition && (a.Before != e.Before || a.After != e.After))
+			return false;
+	}
+	return true;
+}
+
+static Graph::Barrier Transition(Graph::Handle texture, uint32_t before, uint32_t after, Graph::Handle since)
+{
+	return { Graph::Barrier::Transition, texture, before, after, since };
+}
+
+static Graph::Barrier Aliasing(Graph::Handle texture, Graph::Handle since)
+{
+	return { Graph::Barrier::Aliasing, texture, Graph::AccessNone, Graph::AccessNone, since };
+}
+
+TEST(RenderGraphBarriersAndOffsets)
+{
+	Graph graph;
+	Graph::Handle scene = graph.AddTexture("Scene", 100, 64);
+	Graph::Handle blur = graph.AddTexture("Blur", 100, 64);
+	Graph::Handle overlay = graph.AddTexture("Overlay", 50, 64);
+	Graph::Handle debug = graph.AddTexture("Debug", 10, 64);
+	Graph::Handle back = graph.Import("BackBuffer", Graph::AccessPresent);
+
+	Graph::Handle scenePass = graph.AddPass("Scene");
+	graph.Write(scenePass, scene, Graph::AccessRenderTarget);
+	Graph::Handle blurPass = graph.AddPass("Blur");
+	graph.Read(blurPass, scene, Graph::AccessShaderRead);
+	graph.Write(blurPass, blur, Graph::AccessRenderTarget);
+	Graph::Handle composePass = graph.AddPass("Compose");
+	graph.Read(composePass, blur, Graph::AccessShaderRead);
+	graph.Write(composePass, back, Graph::AccessRenderTarget);
+	Graph::Handle overlayPass = graph.AddPass("Overlay");
+	graph.Write(overlayPass, overlay, Graph::AccessRenderTarget);
+	Graph::Handle finalPass = graph.AddPass("Final");
+	graph.Read(finalPass, overlay, Graph::AccessShaderRead);
+	graph.Read(finalPass, blur, Graph::AccessShaderRead);
+	graph.Write(finalPass, back, Graph::AccessRenderTarget);
+	// Nothing reads Debug, so this pass goes.
+	Graph::Handle debugPass = graph.AddPass("Debug");
+	graph.Read(debugPass, scene, Graph::AccessShaderRead);
+	graph.Write(debugPass, debug, Graph::AccessRenderTarget);
+
+	std::string error;
+	CHECK(graph.Compile(&error));
+	CHECK(error.empty());
+	CHECK((graph.GetOrder() == std::vector<Graph::Handle>{ scenePass, blurPass, composePass, overlayPass, finalPass }));
+	CHECK(graph.IsCulled(debugPass));
+	CHECK(graph.GetPosition(overlayPass) == 3);
+
+	const uint32_t RT = Graph::AccessRenderTarget;
+	const uint32_t SR = Graph::AccessShaderRead;
+	// Transients start in the state the frame leaves them in. Overlay reuses
+	// Scene's memory, so both get an aliasing barrier and their first
+	// transition cannot start early.
+	CHECK(Same(graph.GetBarriers(scenePass), { Aliasing(scene, scenePass), Transition(scene, SR, RT, scenePass) }));
+	CHECK(Same(graph.GetBarriers(blurPass), { Transition(scene, RT, SR, blurPass), Transition(blur, SR, RT, scenePass) }));
+	// Blur's two reads share one state, so Final needs nothing for it.
+	CHECK(Same(graph.GetBarriers(composePass), { Transition(blur, RT, SR, composePass), Transition(back, Graph::AccessPresent, RT, scenePass) }));
+	CHECK(Same(graph.GetBarriers(overlayPass), { Aliasing(overlay, overlayPass), Transition(overlay, SR, RT, overlayPass) }));
+	CHECK(Same(graph.GetBarriers(finalPass), { Transition(overlay, RT, SR, finalPass) }));
+	CHECK(Same(graph.GetFinalBarriers(), { Transition(back, RT, Graph::AccessPresent, Graph::Invalid) }));
+	CHECK(graph.GetBarrierCount() == 10);
+	CHECK(graph.GetSplittableCount() == 2);
+
+	CHECK(graph.GetInitialAccess(scene) == SR);
+	CHECK(graph.GetInitialAccess(debug) == Graph::AccessNone);
+
+	// Largest first at the lowest free offset: Blur overlaps Scene in time, Overlay
+	// only Blur. Debug is never used and costs nothing.
+	CHECK(graph.GetOffset(scene) == 0);
+	CHECK(graph.GetOffset(blur) == 128);
+	CHECK(graph.GetOffset(overlay) == 0);
+	CHECK(graph.GetOffset(debug) == 0);
+	CHECK(graph.GetHeapSize() == 228);
+	CHECK(graph.GetUnaliasedSize() == 128 + 128 + 64 + 64);
+
+	// Compiling again gives the same result.
+	CHECK(graph.Compile());
+	CHECK(graph.GetBarrierCount() == 10);
+	CHECK(graph.GetHeapSize() == 228);
+}
+
+TEST(RenderGraphSideEffectsAndImports)
+{
+	Graph graph;
+	Graph::Handle shadow = graph.Import("ShadowMap", Graph::AccessShaderRead);
+	Graph::Handle scratch = graph.AddTexture("Scratch", 16, 1);
+	// Writing an import keeps the pass, even with no reader in the graph.
+	Graph::Handle shadowPass = graph.AddPass("Shadow");
+	graph.Write(shadowPass, shadow, Graph::AccessDepthWrite);
+	Graph::Handle capturePass = graph.AddPass("Capture", true);
+	graph.Write(capturePass, scratch, Graph::AccessCopyDest);
+	Graph::Handle unusedPass = graph.AddPass("Unused");
+	graph.Write(unusedPass, scratch, Graph::AccessRenderTarget);
+
+	CHECK(graph.Compile());
+	CHECK((graph.GetOrder() == std::vector<Graph::Handle>{ shadowPass, capturePass }));
+	CHECK(graph.IsCulled(unusedPass));
+	CHECK(Same(graph.GetBarriers(shadowPass), { Transition(shadow, Graph::AccessShaderRead, Graph::AccessDepthWrite, shadowPass) }));
+	// A single use leaves the transient in the state it starts in.
+	CHECK(graph.GetBarriers(capturePass).empty());
+	CHECK(graph.GetInitialAccess(scratch) == Graph::AccessCopyDest);
+	CHECK(Same(graph.GetFinalBarriers(), { Transition(shadow, Graph::AccessDepthWrite, Graph::AccessShaderRead, Graph::Invalid) }));
+}
+
+TEST(RenderGraphRejectsBadGraphs)
+{
+	{
+		Graph graph;
+		Graph::Handle texture = graph.AddTexture("Texture", 16, 1);
+		Graph::Handle back = graph.Import("BackBuffer", Graph::AccessPresent);
+		Graph::Handle pass = graph.AddPass("Pass");
+		graph.Read(pass, texture, Graph::AccessShaderRead);
+		graph.Write(pass, back, Graph::AccessRenderTarget);
+		std::string error;
+		CHECK(!graph.Compile(&error));
+		CHECK(error == "Pass reads Texture before anything wrote it");
+	}
+	{
+		Graph graph;
+		Graph::Handle texture = graph.AddTexture("Texture", 16, 1);
+		Graph::Handle pass = graph.AddPass("Pass", true);
+		graph.Write(pass, texture, Graph::AccessRenderTarget);
+		graph.Read(pass, texture, Graph::AccessShaderRead);
+		std::string error;
+		CHECK(!graph.Compile(&error));
+		CHECK(error == "Pass combines a write to Texture with another access");
+	}
+}
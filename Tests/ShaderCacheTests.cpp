@@ -0,0 +1,139 @@
+#include "Test.h"
+#include "ShaderCache.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// Sources live in a map instead of on disk, so edits are one assignment.
+struct ShaderFiles
+{
+	std::map<std::string, std::string> Files;
+	ShaderCache Cache;
+
+	ShaderFiles()
+	{
+		Cache.SetFileReader([this](const std::string& path, std::string& contents)
+		{
+			auto it = Files.find(path);
+			if (it == Files.end())
+				return false;
+			contents = it->second;
+			return true;
+		});
+		Files["Shader/Default.hlsl"] = "#include \"Common.hlsl\"\n// #include \"Unused.hlsl\"\nfloat4 PS() : SV_Target { return 0; }\n";
+		Files["Shader/Common.hlsl"] = "#include \"Lighting/Util.hlsl\"\ncbuffer cb : register(b0) {};\n";
+		Files["Shader/Lighting/Util.hlsl"] = "float3 Fresnel() { return 0; }\n";
+		Files["Shader/Unused.hlsl"] = "float unused;\n";
+	}
+
+	uint64_t Key(const ShaderCache::Request& request)
+	{
+		uint64_t key = 0;
+		CHECK(Cache.ComputeKey(request, key));
+		return key;
+	}
+};
+
+static ShaderCache::Request MakeRequest()
+{
+	ShaderCache::Request request;
+	request.File = "Shader\\Default.hlsl";
+	request.EntryPoint = "PS";
+	request.Target = "ps_5_1";
+	request.CompilerVersion = 0x000a00004a610001ull;
+	return request;
+}
+
+TEST(ShaderCacheKeyIgnoresDefineOrder)
+{
+	ShaderFiles files;
+	ShaderCache::Request request = MakeRequest();
+	request.Defines = { { "SHADOWS", "1" }, { "SSAO", "1" }, { "ALPHA_TEST", "" } };
+	uint64_t key = files.Key(request);
+
+	ShaderCache::Request reordered = MakeRequest();
+	reordered.Defines = { { "SSAO", "1" }, { "ALPHA_TEST", "" }, { "SHADOWS", "1" } };
+	CHECK(files.Key(reordered) == key);
+
+	reordered.Defines[0].Value = "0";
+	CHECK(files.Key(reordered) != key);
+	reordered.Defines[0].Value = "1";
+	reordered.Defines.pop_back();
+	CHECK(files.Key(reordered) != key);
+
+	// The same name twice: the last one wins, so that order does count.
+	ShaderCache::Request repeated = MakeRequest();
+	repeated.Defines = { { "SSAO", "0" }, { "SSAO", "1" } };
+	uint64_t repeatedKey = files.Key(repeated);
+	std::swap(repeated.Defines[0], repeated.Defines[1]);
+	CHECK(files.Key(repeated) != repeatedKey);
+
+	// Name and value are hashed with their lengths, so they cannot run together.
+	ShaderCache::Request split = MakeRequest();
+	split.Defines = { { "AB", "C" } };
+	uint64_t splitKey = files.Key(split);
+	split.Defines = { { "A", "BC" } };
+	CHECK(files.Key(split) != splitKey);
+}
+
+TEST(ShaderCacheKeyHashesIncludes)
+{
+	ShaderFiles files;
+	ShaderCache::Request request = MakeRequest();
+	uint64_t key = 0;
+	std::vector<std::string> used;
+	CHECK(files.Cache.ComputeKey(request, key, &used));
+	// Depth first from the request file; the commented out include is skipped.
+	CHECK((used == std::vector<std::string>{ "Shader/Default.hlsl", "Shader/Common.hlsl", "Shader/Lighting/Util.hlsl" }));
+
+	// An edit two includes deep lands on a new key, undoing it on the old one.
+	std::string util = files.Files["Shader/Lighting/Util.hlsl"];
+	files.Files["Shader/Lighting/Util.hlsl"] = util + "// edited\n";
+	CHECK(files.Key(request) != key);
+	files.Files["Shader/Lighting/Util.hlsl"] = util;
+	CHECK(files.Key(request) == key);
+
+	files.Files["Shader/Unused.hlsl"] = "float changed;\n";
+	CHECK(files.Key(request) == key);
+
+	// A missing include means the compiler has to run and report it.
+	files.Files.erase("Shader/Lighting/Util.hlsl");
+	uint64_t missing;
+	CHECK(!files.Cache.ComputeKey(request, missing));
+}
+
+TEST(ShaderCacheKeyIncludesCompilerVersion)
+{
+	ShaderFiles files;
+	ShaderCache::Request request = MakeRequest();
+	uint64_t key = files.Key(request);
+
+	// Only the low word of the file version moves on a compiler update.
+	ShaderCache::Request updated = request;
+	updated.CompilerVersion = request.CompilerVersion + 1;
+	CHECK(files.Key(updated) != key);
+	updated.CompilerVersion = request.CompilerVersion + (1ull << 32);
+	CHECK(files.Key(updated) != key);
+
+	ShaderCache::Request other = request;
+	other.Flags = 1;
+	CHECK(files.Key(other) != key);
+	other = request;
+	other.Target = "ps_5_0";
+	CHECK(files.Key(other) != key);
+	other = request;
+	other.EntryPoint = "PS2";
+	CHECK(files.Key(other) != key);
+	CHECK(files.Key(request) == key);
+}
+
+TEST(ShaderCacheFindsIncludesAndKeywords)
+{
+	std::vector<std::string> includes;
+	ShaderCache::FindIncludes("// #include \"a\"\n/* #include \"b\" */\n  #  include <c>\nx #include \"d\"\n#include \"e\"", includes);
+	CHECK((includes == std::vector<std::string>{ "c", "e" }));
+
+	std::vector<std::string> keywords;
+	ShaderCache::FindKeywords("// Common\n// keywords: SHADOWS SSAO\r\nfloat x; // keywords: NO\n  //keywords:\tALPHA\n", keywords);
+	CHECK((keywords == std::vector<std::string>{ "SHADOWS", "SSAO", "ALPHA" }));
+}
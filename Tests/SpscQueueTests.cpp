@@ -0,0 +1,96 @@
+#include "Test.h"
+#include "SpscQueue.h"
+#include <thread>
+#include <vector>
+
+TEST(SpscQueueFullAndEmpty)
+{
+	SpscQueue<int, 4> queue;
+	CHECK(queue.BeginPop() == nullptr);
+
+	// All four slots can be queued; the fifth push waits for a pop.
+	for (int i = 0; i < 4; ++i)
+	{
+		int* slot = queue.BeginPush();
+		CHECK(slot != nullptr);
+		*slot = i;
+		queue.EndPush();
+	}
+	CHECK(queue.BeginPush() == nullptr);
+
+	// A slot being read is still the consumer's until EndPop.
+	const int* front = queue.BeginPop();
+	CHECK(front != nullptr && *front == 0);
+	CHECK(queue.BeginPush() == nullptr);
+	queue.EndPop();
+	CHECK(queue.BeginPush() != nullptr);
+
+	// The slot just taken was never ended, so only the three queued come out.
+	for (int i = 1; i < 4; ++i)
+	{
+		const int* slot = queue.BeginPop();
+		CHECK(slot != nullptr && *slot == i);
+		queue.EndPop();
+	}
+	CHECK(queue.BeginPop() == nullptr);
+}
+
+TEST(SpscQueueReusesSlots)
+{
+	SpscQueue<std::vector<int>, 2> queue;
+	std::vector<int>* first = queue.BeginPush();
+	first->assign(100, 7);
+	queue.EndPush();
+	queue.BeginPop();
+	queue.EndPop();
+	std::vector<int>* second = queue.BeginPush();
+	queue.EndPush();
+	queue.BeginPop();
+	queue.EndPop();
+
+	// Two laps later the producer gets the first slot back as it was left, so a
+	// clear keeps the allocation.
+	std::vector<int>* again = queue.BeginPush();
+	CHECK(again == first && second != first);
+	CHECK(again->size() == 100 && (*again)[99] == 7);
+	size_t capacity = again->capacity();
+	again->clear();
+	CHECK(again->capacity() == capacity);
+}
+
+TEST(SpscQueueKeepsOrderAcrossThreads)
+{
+	struct Packet
+	{
+		unsigned Sequence;
+		unsigned Check;
+	};
+	const unsigned count = 200000;
+	SpscQueue<Packet, 8> queue;
+	std::thread producer([&]()
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			Packet* slot;
+			while ((slot = queue.BeginPush()) == nullptr)
+				std::this_thread::yield();
+			slot->Sequence = i;
+			slot->Check = i * 2654435761u;
+			queue.EndPush();
+		}
+	});
+
+	bool ordered = true;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const Packet* slot;
+		while ((slot = queue.BeginPop()) == nullptr)
+			std::this_thread::yield();
+		// Both fields are written before EndPush, so both must be visible.
+		ordered &= slot->Sequence == i && slot->Check == i * 2654435761u;
+		queue.EndPop();
+	}
+	producer.join();
+	CHECK(ordered);
+	CHECK(queue.BeginPop() == nullptr);
+}
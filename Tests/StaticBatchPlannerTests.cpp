@@ -0,0 +1,155 @@
+#include "Test.h"
+#include "StaticBatchPlanner.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+typedef StaticBatchPlanner::Item Item;
+
+static Item MakeItem(uint32_t material, float x, float y, float z, size_t bytes)
+{
+	Item item = { material, { x, y, z }, bytes };
+	return item;
+}
+
+static bool SameCell(const StaticBatchPlanner::Batch& batch, int32_t x, int32_t y, int32_t z)
+{
+	return batch.Cell[0] == x && batch.Cell[1] == y && batch.Cell[2] == z;
+}
+
+TEST(StaticBatchPlannerGroupsSharedMaterials)
+{
+	// Three items with their own materials and five sharing one, like a box and
+	// a row of crates around it.
+	std::vector<Item> items = {
+		MakeItem(0, 0.0f, 1.0f, 0.0f, 100),
+		MakeItem(1, 0.0f, 0.0f, 0.0f, 100),
+		MakeItem(2, 10.0f, 0.1f, 0.0f, 100),
+		MakeItem(3, 10.0f, 1.15f, 0.0f, 10),
+		MakeItem(3, 6.5f, 1.15f, 3.5f, 10),
+		MakeItem(3, 9.0f, 1.15f, 3.5f, 10),
+		MakeItem(3, 11.5f, 1.15f, 3.5f, 10),
+		MakeItem(3, 14.0f, 1.15f, 3.5f, 10),
+	};
+	StaticBatchPlanner planner;
+	planner.Plan(items, 32.0f, 1 << 20);
+	CHECK(planner.GetBatches().size() == 1);
+	const StaticBatchPlanner::Batch& batch = planner.GetBatches()[0];
+	CHECK(batch.Material == 3 && SameCell(batch, 0, 0, 0));
+	CHECK((batch.Items == std::vector<uint32_t>{ 3, 4, 5, 6, 7 }));
+	CHECK(batch.Bytes == 50 && planner.GetBytes() == 50);
+	CHECK((planner.GetUnbatched() == std::vector<uint32_t>{ 0, 1, 2 }));
+
+	// Cells are floored, so a crate just below zero is in cell -1 and splits off.
+	items[4].Center[2] = -0.5f;
+	items[5].Center[2] = -0.5f;
+	planner.Plan(items, 32.0f, 1 << 20);
+	CHECK(planner.GetBatches().size() == 2);
+	CHECK(SameCell(planner.GetBatches()[0], 0, 0, -1));
+	CHECK((planner.GetBatches()[0].Items == std::vector<uint32_t>{ 4, 5 }));
+	CHECK((planner.GetBatches()[1].Items == std::vector<uint32_t>{ 3, 6, 7 }));
+
+	// With 4 unit cells only the box and the crate next to it share one; an
+	// item alone in its cell is not a batch.
+	planner.Plan(items, 4.0f, 1 << 20);
+	CHECK(planner.GetBatches().size() == 1);
+	CHECK(SameCell(planner.GetBatches()[0], 2, 0, 0));
+	CHECK((planner.GetBatches()[0].Items == std::vector<uint32_t>{ 3, 6 }));
+	CHECK(planner.GetUnbatched().size() == items.size() - 2);
+}
+
+TEST(StaticBatchPlannerByteBudget)
+{
+	std::vector<Item> items = {
+		MakeItem(0, 0.0f, 0.0f, 0.0f, 40),
+		MakeItem(0, 1.0f, 0.0f, 0.0f, 40),
+		MakeItem(1, 0.0f, 0.0f, 0.0f, 100),
+		MakeItem(1, 1.0f, 0.0f, 0.0f, 100),
+		MakeItem(2, 0.0f, 0.0f, 0.0f, 10),
+		MakeItem(2, 1.0f, 0.0f, 0.0f, 10),
+	};
+	StaticBatchPlanner planner;
+	planner.Plan(items, 16.0f, 100);
+	// Material 1 does not fit after material 0; material 2 still does.
+	CHECK(planner.GetBatches().size() == 2);
+	CHECK(planner.GetBatches()[0].Material == 0 && planner.GetBatches()[1].Material == 2);
+	CHECK(planner.GetBytes() == 100);
+	CHECK((planner.GetUnbatched() == std::vector<uint32_t>{ 2, 3 }));
+
+	planner.Plan(items, 16.0f, 0);
+	CHECK(planner.GetBatches().empty() && planner.GetBytes() == 0);
+	CHECK(planner.GetUnbatched().size() == items.size());
+}
+
+TEST(StaticBatchPlannerIgnoresItemOrder)
+{
+	std::mt19937 random(1);
+	std::vector<Item> items(1000);
+	for (Item& item : items)
+		item = MakeItem(random() % 4, (float)(random() % 200) - 100.0f, (float)(random() % 200) - 100.0f,
+			(float)(random() % 200) - 100.0f, 1000);
+	StaticBatchPlanner planner;
+	planner.Plan(items, 16.0f, 400000);
+	CHECK(planner.GetBytes() <= 400000);
+	size_t covered = planner.GetUnbatched().size();
+	bool pairs = true;
+	for (const StaticBatchPlanner::Batch& batch : planner.GetBatches())
+	{
+		pairs &= batch.Items.size() > 1;
+		covered += batch.Items.size();
+	}
+	CHECK(pairs);
+	CHECK(covered == items.size());
+
+	// The same items shuffled bake the same batches, with the items renamed.
+	std::vector<uint32_t> order(items.size());
+	for (uint32_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), random);
+	std::vector<Item> shuffled(items.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		shuffled[i] = items[order[i]];
+	StaticBatchPlanner other;
+	other.Plan(shuffled, 16.0f, 400000);
+	CHECK(other.GetBatches().size() == planner.GetBatches().size());
+	CHECK(other.GetBytes() == planner.GetBytes());
+	bool same = true;
+	for (size_t i = 0; i < planner.GetBatches().size() && same; ++i)
+	{
+		const StaticBatchPlanner::Batch& a = planner.GetBatches()[i];
+		const StaticBatchPlanner::Batch& b = other.GetBatches()[i];
+		std::vector<uint32_t> renamed;
+		for (uint32_t index : b.Items)
+			renamed.push_back(order[index]);
+		std::sort(renamed.begin(), renamed.end());
+		same = a.Material == b.Material && std::equal(a.Cell, a.Cell + 3, b.Cell) && renamed == a.Items;
+	}
+	CHECK(same);
+}
+
+// StaticBatchPlan [items] [cell size]
+// Average of 20 plans of random items over 8 materials in a 1000 x 50 x 1000
+// slab, with no byte budget.
+BENCHMARK(StaticBatchPlan)
+{
+	size_t count = argc > 0 ? (size_t)atoi(argv[0]) : 100000;
+	float cellSize = argc > 1 ? (float)atof(argv[1]) : 32.0f;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> spread(-500.0f, 500.0f);
+	std::vector<Item> items(count);
+	for (Item& item : items)
+		item = MakeItem(random() % 8, spread(random), spread(random) * 0.05f, spread(random), 4096);
+
+	StaticBatchPlanner planner;
+	const int runs = 20;
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < runs; ++run)
+		planner.Plan(items, cellSize, SIZE_MAX);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+	printf("%zu items, cell %.0f: %.3f ms per plan, %zu batches, %zu unbatched, %zu draws after\n", count, cellSize, ms,
+		planner.GetBatches().size(), planner.GetUnbatched().size(), planner.GetBatches().size() + planner.GetUnbatched().size());
+	return 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdio>
+
+// A minimal test registry, so the tests need nothing beyond the standard
+// library. TEST(Name) defines a test that TestMain runs; CHECK records a
+// failure and carries on. BENCHMARK(Name) defines a driver that only runs when
+// asked for by name, with the remaining command line arguments.
+struct TestCase
+{
+	const char* Name;
+	void (*Run)();
+	TestCase* Next;
+};
+
+struct BenchmarkCase
+{
+	const char* Name;
+	int (*Run)(int argc, char** argv);
+	BenchmarkCase* Next;
+};
+
+TestCase*& GetTests();
+BenchmarkCase*& GetBenchmarks();
+void ReportFailure(const char* file, int line, const char* expression);
+
+struct TestRegistrar
+{
+	TestRegistrar(TestCase& test) { test.Next = GetTests(); GetTests() = &test; }
+	TestRegistrar(BenchmarkCase& benchmark) { benchmark.Next = GetBenchmarks(); GetBenchmarks() = &benchmark; }
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestCase name##Case = { #name, name, nullptr }; \
+	static TestRegistrar name##Registrar(name##Case); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static int name(int argc, char** argv); \
+	static BenchmarkCase name##Case = { #name, name, nullptr }; \
+	static TestRegistrar name##Registrar(name##Case); \
+	static int name(int argc, char** argv)
+
+#define CHECK(expression) \
+	do { if (!(expression)) ReportFailure(__FILE__, __LINE__, #expression); } while (0)
@@ -0,0 +1,60 @@
+#include "Test.h"
+#include <cstring>
+
+// Tests.exe runs every test and returns the number that failed.
+// Tests.exe -bench <Name> [args] runs one benchmark, -bench alone lists them.
+//
+// Everything here only uses the standard library and the std-only parts of
+// Tools, so it builds on Linux as well, e.g.
+//   g++ -std=c++14 -O2 -msse4.1 -pthread -ITools Tests/*.cpp <the Tools/*.cpp they use>
+
+TestCase*& GetTests()
+{
+	static TestCase* tests = nullptr;
+	return tests;
+}
+
+BenchmarkCase*& GetBenchmarks()
+{
+	static BenchmarkCase* benchmarks = nullptr;
+	return benchmarks;
+}
+
+static int sFailures = 0;
+
+void ReportFailure(const char* file, int line, const char* expression)
+{
+	printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+	++sFailures;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+	{
+		for (BenchmarkCase* benchmark = GetBenchmarks(); benchmark != nullptr; benchmark = benchmark->Next)
+		{
+			if (argc == 2)
+				printf("%s\n", benchmark->Name);
+			else if (strcmp(argv[2], benchmark->Name) == 0)
+				return benchmark->Run(argc - 3, argv + 3);
+		}
+		return argc == 2 ? 0 : 1;
+	}
+
+	int failedTests = 0;
+	int testCount = 0;
+	for (TestCase* test = GetTests(); test != nullptr; test = test->Next)
+	{
+		int failuresBefore = sFailures;
+		test->Run();
+		++testCount;
+		if (sFailures != failuresBefore)
+		{
+			printf("FAILED %s\n", test->Name);
+			++failedTests;
+		}
+	}
+	printf("%d of %d tests passed\n", testCount - failedTests, testCount);
+	return failedTests;
+}
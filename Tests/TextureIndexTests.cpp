@@ -0,0 +1,206 @@
+#include "Test.h"
+#include "TextureIndex.h"
+#include "DDSFileView.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <sys/stat.h>
+#include <sys/utime.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+// A fresh directory under the system temp directory, removed with the files the
+// test wrote when it goes out of scope.
+class TempDirectory
+{
+public:
+	TempDirectory()
+	{
+#ifdef _WIN32
+		char base[MAX_PATH];
+		GetTempPathA(MAX_PATH, base);
+		char name[MAX_PATH];
+		GetTempFileNameA(base, "tix", 0, name);
+		DeleteFileA(name);
+		mPath = name;
+		_mkdir(mPath.c_str());
+#else
+		char name[] = "/tmp/TextureIndexXXXXXX";
+		mPath = mkdtemp(name) ? name : "";
+#endif
+	}
+
+	~TempDirectory()
+	{
+		for (const std::string& file : mFiles)
+			remove(file.c_str());
+#ifdef _WIN32
+		_rmdir(mPath.c_str());
+#else
+		rmdir(mPath.c_str());
+#endif
+	}
+
+	const std::string& GetPath() const { return mPath; }
+
+	std::string Write(const char* name, const std::vector<uint8_t>& bytes)
+	{
+		std::string file = mPath + "/" + name;
+		FILE* out = fopen(file.c_str(), "wb");
+		fwrite(bytes.data(), 1, bytes.size(), out);
+		fclose(out);
+		mFiles.push_back(file);
+		return file;
+	}
+
+private:
+	std::string mPath;
+	std::vector<std::string> mFiles;
+};
+
+// The index compares write times for equality only, and they may be whole
+// seconds, so the tests set them rather than wait for the clock.
+static void SetWriteTime(const std::string& file, long long seconds)
+{
+#ifdef _WIN32
+	struct _utimbuf times = { (time_t)seconds, (time_t)seconds };
+	_utime(file.c_str(), &times);
+#else
+	struct utimbuf times = { (time_t)seconds, (time_t)seconds };
+	utime(file.c_str(), &times);
+#endif
+}
+
+static long long GetWriteTime(const std::string& file)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	return _stat64(file.c_str(), &info) == 0 ? (long long)info.st_mtime : -1;
+#else
+	struct stat info;
+	return stat(file.c_str(), &info) == 0 ? (long long)info.st_mtime : -1;
+#endif
+}
+
+static void Put32(std::vector<uint8_t>& file, size_t offset, uint32_t value)
+{
+	memcpy(file.data() + offset, &value, sizeof(value));
+}
+
+// Legacy DXT1 header for a single mip, followed by its blocks.
+static std::vector<uint8_t> MakeDxt1(uint32_t width, uint32_t height)
+{
+	size_t bitBytes = ((width + 3) / 4) * ((height + 3) / 4) * 8;
+	std::vector<uint8_t> file(4 + DDSFileView::HeaderSize + bitBytes);
+	Put32(file, 0, DDSFileView::Magic);
+	Put32(file, 4 + 0, (uint32_t)DDSFileView::HeaderSize);
+	Put32(file, 4 + 8, height);
+	Put32(file, 4 + 12, width);
+	Put32(file, 4 + 24, 1);
+	Put32(file, 4 + 72, (uint32_t)DDSFileView::PixelFormatSize);
+	Put32(file, 4 + 76, 0x4);
+	Put32(file, 4 + 80, 0x31545844); // "DXT1"
+	return file;
+}
+
+TEST(TextureIndexRefreshesOnlyWhatChanged)
+{
+	TempDirectory dir;
+	CHECK(!dir.GetPath().empty());
+	std::string a = dir.Write("A.dds", MakeDxt1(8, 8));
+	std::string b = dir.Write("b.dds", MakeDxt1(16, 4));
+	std::string c = dir.Write("c.dds", std::vector<uint8_t>(10, 'x'));
+	dir.Write("notes.txt", std::vector<uint8_t>(10, 'x'));
+	SetWriteTime(a, 1000000000);
+	SetWriteTime(b, 1000000000);
+	SetWriteTime(c, 1000000000);
+	std::string indexFile = dir.Write("textures.idx", std::vector<uint8_t>());
+
+	// An empty index file does not load, so everything is built.
+	TextureIndex index;
+	CHECK(index.Refresh(dir.GetPath().c_str(), indexFile.c_str()));
+	CHECK(index.GetRebuiltCount() == 3 && index.GetEntries().size() == 3);
+	std::string path = dir.GetPath() + "/a.dds";
+	const TextureIndex::Entry* entry = index.Find(path.c_str());
+	CHECK(entry != nullptr && entry->Width == 8 && entry->Height == 8);
+	CHECK(entry && entry->Flags == TextureIndex::Valid && entry->DataOffset == 4 + DDSFileView::HeaderSize);
+	path = dir.GetPath() + "/C.DDS";
+	CHECK(index.Find(path.c_str()) && index.Find(path.c_str())->Flags == 0);
+
+	// Nothing changed: nothing is parsed and the index file is left alone.
+	SetWriteTime(indexFile, 1000000000);
+	TextureIndex current;
+	CHECK(current.Refresh(dir.GetPath().c_str(), indexFile.c_str()));
+	CHECK(current.GetRebuiltCount() == 0 && current.GetEntries().size() == 3);
+	CHECK(GetWriteTime(indexFile) == 1000000000);
+
+	// A touched file and a resized one are parsed again, the third is kept.
+	SetWriteTime(a, 1000000100);
+	dir.Write("b.dds", MakeDxt1(32, 32));
+	SetWriteTime(b, 1000000000);
+	CHECK(current.Refresh(dir.GetPath().c_str(), indexFile.c_str()));
+	CHECK(current.GetRebuiltCount() == 2);
+	path = dir.GetPath() + "/b.dds";
+	CHECK(current.Find(path.c_str()) && current.Find(path.c_str())->Width == 32);
+	CHECK(GetWriteTime(indexFile) != 1000000000);
+
+	// A deleted file drops out, and the smaller index is what the next run loads.
+	remove(c.c_str());
+	CHECK(current.Refresh(dir.GetPath().c_str(), indexFile.c_str()));
+	CHECK(current.GetRebuiltCount() == 0 && current.GetEntries().size() == 2);
+	path = dir.GetPath() + "/c.dds";
+	CHECK(current.Find(path.c_str()) == nullptr);
+	TextureIndex reloaded;
+	CHECK(reloaded.Load(indexFile.c_str()) && reloaded.GetEntries().size() == 2);
+}
+
+TEST(TextureIndexRebuildsBadIndexFiles)
+{
+	TempDirectory dir;
+	std::string a = dir.Write("a.dds", MakeDxt1(8, 8));
+	std::string b = dir.Write("b.dds", MakeDxt1(4, 4));
+	std::string indexFile = dir.Write("textures.idx", std::vector<uint8_t>());
+	TextureIndex index;
+	CHECK(index.Refresh(dir.GetPath().c_str(), indexFile.c_str()));
+	CHECK(index.GetRebuiltCount() == 2);
+
+	std::vector<uint8_t> saved;
+	{
+		FILE* in = fopen(indexFile.c_str(), "rb");
+		int byte;
+		while ((byte = fgetc(in)) != EOF)
+			saved.push_back((uint8_t)byte);
+		fclose(in);
+	}
+	CHECK(saved.size() > 16);
+
+	// Truncated, a bad magic, and a path pointing past the strings: each fails
+	// to load and is rebuilt in full, then loads again.
+	std::vector<uint8_t> truncated(saved.begin(), saved.end() - 1);
+	std::vector<uint8_t> badMagic = saved;
+	badMagic[0] ^= 0xff;
+	std::vector<uint8_t> badPath = saved;
+	Put32(badPath, 16 + 40, 0xffff);
+	const std::vector<uint8_t>* corrupt[] = { &truncated, &badMagic, &badPath };
+	for (const std::vector<uint8_t>* bytes : corrupt)
+	{
+		dir.Write("textures.idx", *bytes);
+		TextureIndex rebuilt;
+		CHECK(!rebuilt.Load(indexFile.c_str()) && rebuilt.GetEntries().empty());
+		CHECK(rebuilt.Refresh(dir.GetPath().c_str(), indexFile.c_str()));
+		CHECK(rebuilt.GetRebuiltCount() == 2 && rebuilt.GetEntries().size() == 2);
+		CHECK(rebuilt.Load(indexFile.c_str()));
+	}
+
+	// A directory that cannot be listed fails without touching the index.
+	std::string missing = dir.GetPath() + "/missing";
+	CHECK(!index.Refresh(missing.c_str(), indexFile.c_str()));
+}
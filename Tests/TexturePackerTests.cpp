@@ -0,0 +1,140 @@
+#include "Test.h"
+#include "TexturePacker.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+typedef TexturePacker::Size Size;
+typedef TexturePacker::Placement Placement;
+
+static bool Overlap(const Placement& a, const Placement& b)
+{
+	return a.CellX < b.CellX + b.CellWidth && b.CellX < a.CellX + a.CellWidth &&
+		a.CellY < b.CellY + b.CellHeight && b.CellY < a.CellY + a.CellHeight;
+}
+
+TEST(TexturePackerCellsAreAlignedAndApart)
+{
+	std::mt19937 random(1);
+	std::vector<Size> sizes(40);
+	for (Size& size : sizes)
+		size = { 1 + (uint32_t)(random() % 100), 1 + (uint32_t)(random() % 100) };
+	TexturePacker::Options options;
+	options.Gutter = 8;
+	uint32_t width = 0, height = 0;
+	std::vector<Placement> placements;
+	CHECK(TexturePacker::Pack(sizes, options, width, height, placements));
+	CHECK(placements.size() == sizes.size());
+	CHECK(width % options.Gutter == 0 && height % options.Gutter == 0);
+	CHECK(width <= options.MaxSize && height <= options.MaxSize);
+
+	bool inside = true, aligned = true, guttered = true, apart = true, uv = true;
+	for (size_t i = 0; i < placements.size(); ++i)
+	{
+		const Placement& p = placements[i];
+		inside &= p.CellX + p.CellWidth <= width && p.CellY + p.CellHeight <= height;
+		aligned &= p.CellX % options.Gutter == 0 && p.CellY % options.Gutter == 0 &&
+			p.CellWidth % options.Gutter == 0 && p.CellHeight % options.Gutter == 0;
+		// At least a full gutter on every side of the texture.
+		guttered &= p.Width == sizes[i].Width && p.Height == sizes[i].Height &&
+			p.X == p.CellX + options.Gutter && p.Y == p.CellY + options.Gutter &&
+			p.X + p.Width + options.Gutter <= p.CellX + p.CellWidth &&
+			p.Y + p.Height + options.Gutter <= p.CellY + p.CellHeight;
+		uv &= std::fabs(p.OffsetU * width - p.X) < 1e-3f &&
+			std::fabs((p.ScaleU + p.OffsetU) * width - (p.X + p.Width)) < 1e-3f;
+		for (size_t j = 0; j < i; ++j)
+			apart &= !Overlap(p, placements[j]);
+	}
+	CHECK(inside);
+	CHECK(aligned);
+	CHECK(guttered);
+	CHECK(apart);
+	CHECK(uv);
+}
+
+TEST(TexturePackerMaxSize)
+{
+	// With the default gutter of 16 a 16 texel square takes a 48 x 48 cell: nine
+	// fit in 144 x 144, a tenth does not.
+	TexturePacker::Options options;
+	options.MaxSize = 144;
+	std::vector<Size> sizes(9, Size{ 16, 16 });
+	uint32_t width = 0, height = 0;
+	std::vector<Placement> placements;
+	CHECK(TexturePacker::Pack(sizes, options, width, height, placements));
+	CHECK(width == 144 && height == 144);
+	sizes.push_back(Size{ 16, 16 });
+	CHECK(!TexturePacker::Pack(sizes, options, width, height, placements));
+
+	// A single texture wider than MaxSize after its gutter never fits.
+	std::vector<Size> wide(1, Size{ 120, 8 });
+	CHECK(!TexturePacker::Pack(wide, options, width, height, placements));
+	wide[0].Width = 112;
+	CHECK(TexturePacker::Pack(wide, options, width, height, placements));
+	CHECK(width == 144 && height == 48);
+}
+
+TEST(TexturePackerBlitClampsIntoTheGutter)
+{
+	TexturePacker::Options options;
+	options.Gutter = 4;
+	std::vector<Size> sizes(1, Size{ 2, 3 });
+	uint32_t width = 0, height = 0;
+	std::vector<Placement> placements;
+	CHECK(TexturePacker::Pack(sizes, options, width, height, placements));
+	const Placement& p = placements[0];
+	CHECK(p.CellWidth == 12 && p.CellHeight == 12);
+
+	// Texel (x, y) holds x + 10 * y in every channel.
+	uint8_t image[3][2][4];
+	for (int y = 0; y < 3; ++y)
+		for (int x = 0; x < 2; ++x)
+			for (int c = 0; c < 4; ++c)
+				image[y][x][c] = (uint8_t)(x + 10 * y);
+	std::vector<uint8_t> atlas((size_t)width * height * 4, 0xee);
+	TexturePacker::Blit(&image[0][0][0], sizeof(image[0]), p, atlas.data(), width);
+
+	bool clamped = true;
+	for (uint32_t y = p.CellY; y < p.CellY + p.CellHeight; ++y)
+	{
+		for (uint32_t x = p.CellX; x < p.CellX + p.CellWidth; ++x)
+		{
+			int sx = (int)x - (int)p.X, sy = (int)y - (int)p.Y;
+			sx = sx < 0 ? 0 : sx > 1 ? 1 : sx;
+			sy = sy < 0 ? 0 : sy > 2 ? 2 : sy;
+			for (int c = 0; c < 4; ++c)
+				clamped &= atlas[((size_t)y * width + x) * 4 + c] == image[sy][sx][c];
+		}
+	}
+	CHECK(clamped);
+	// The corners take the corner texels.
+	CHECK(atlas[((size_t)p.CellY * width + p.CellX) * 4] == 0);
+	size_t last = ((size_t)(p.CellY + p.CellHeight - 1) * width + p.CellX + p.CellWidth - 1) * 4;
+	CHECK(atlas[last] == 21);
+}
+
+TEST(TexturePackerMipCount)
+{
+	TexturePacker::Options options;
+	// 16, 8, 4, 2 and 1 texel gutters.
+	CHECK(TexturePacker::GetMipCount(options, 1024, 512) == 5);
+	options.Gutter = 4;
+	CHECK(TexturePacker::GetMipCount(options, 1024, 512) == 3);
+	options.Gutter = 1;
+	CHECK(TexturePacker::GetMipCount(options, 1024, 512) == 1);
+	// A small atlas runs out of texels first.
+	options.Gutter = 16;
+	CHECK(TexturePacker::GetMipCount(options, 4, 2) == 3);
+
+	// At the last level every cell still has a texel of its own gutter.
+	std::vector<Size> sizes = { { 30, 17 }, { 5, 64 }, { 1, 1 } };
+	uint32_t width = 0, height = 0;
+	std::vector<Placement> placements;
+	CHECK(TexturePacker::Pack(sizes, options, width, height, placements));
+	uint32_t scale = 1u << (TexturePacker::GetMipCount(options, width, height) - 1);
+	CHECK(scale == options.Gutter);
+	bool separate = true;
+	for (const Placement& p : placements)
+		separate &= p.CellX % scale == 0 && p.CellWidth / scale >= 3 && p.X - p.CellX == scale;
+	CHECK(separate);
+}
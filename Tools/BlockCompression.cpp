@@ -0,0 +1,788 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_COMPRESSION_SSE2 1
+#endif
+
+enum BlockKind
+{
+	BlockNone,
+	BlockBC1,
+	BlockBC2,
+	BlockBC3,
+	BlockBC4,
+	BlockBC5,
+	BlockBC7,
+};
+
+static BlockKind GetBlockKind(uint32_t f)
+{
+	if (f >= 70 && f <= 72) return BlockBC1;
+	if (f >= 73 && f <= 75) return BlockBC2;
+	if (f >= 76 && f <= 78) return BlockBC3;
+	// SNORM BC4/BC5 would need signed endpoints; not supported.
+	if (f >= 79 && f <= 80) return BlockBC4;
+	if (f >= 82 && f <= 83) return BlockBC5;
+	if (f >= 97 && f <= 99) return BlockBC7;
+	return BlockNone;
+}
+
+static size_t GetBlockBytes(BlockKind kind)
+{
+	return kind == BlockBC1 || kind == BlockBC4 ? 8 : 16;
+}
+
+static uint16_t Read16(const uint8_t* p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void Write16(uint8_t* p, uint16_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void Expand565(uint16_t c, uint8_t* rgb)
+{
+	uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (uint8_t)((r << 3) | (r >> 2));
+	rgb[1] = (uint8_t)((g << 2) | (g >> 4));
+	rgb[2] = (uint8_t)((b << 3) | (b >> 2));
+}
+
+// Palette of the color part shared by BC1-BC3. BC2/BC3 always use the four color mode.
+static void BuildColorPalette(uint16_t c0, uint16_t c1, bool allowPunchThrough, uint8_t palette[4][4])
+{
+	Expand565(c0, palette[0]);
+	Expand565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	if (c0 > c1 || !allowPunchThrough)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (uint8_t)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+			palette[3][c] = (uint8_t)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+		}
+	}
+	else
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (uint8_t)((palette[0][c] + palette[1][c]) / 2);
+			palette[3][c] = 0;
+		}
+		palette[3][3] = 0;
+	}
+}
+
+static void DecodeColor(const uint8_t* block, bool allowPunchThrough, uint8_t texels[16][4])
+{
+	uint8_t palette[4][4];
+	BuildColorPalette(Read16(block), Read16(block + 2), allowPunchThrough, palette);
+
+	uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+	for (int i = 0; i < 16; ++i)
+		memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4);
+}
+
+// BC3 alpha / BC4 / BC5 channel block: two endpoints and 3 bit indices.
+static void BuildChannelPalette(uint8_t e0, uint8_t e1, uint8_t palette[8])
+{
+	palette[0] = e0;
+	palette[1] = e1;
+	if (e0 > e1)
+	{
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = (uint8_t)(((7 - i) * e0 + i * e1 + 3) / 7);
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+			palette[i + 1] = (uint8_t)(((5 - i) * e0 + i * e1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static void DecodeChannel(const uint8_t* block, uint8_t texels[16][4], int channel)
+{
+	uint8_t palette[8];
+	BuildChannelPalette(block[0], block[1], palette);
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; ++i)
+		indices |= (uint64_t)block[2 + i] << (8 * i);
+	for (int i = 0; i < 16; ++i)
+		texels[i][channel] = palette[(indices >> (3 * i)) & 7];
+}
+
+size_t BlockCompression::GetBlockSize(uint32_t dxgiFormat)
+{
+	BlockKind kind = GetBlockKind(dxgiFormat);
+	return kind == BlockNone ? 0 : GetBlockBytes(kind);
+}
+
+bool BlockCompression::CanDecode(uint32_t dxgiFormat)
+{
+	BlockKind kind = GetBlockKind(dxgiFormat);
+	return kind != BlockNone && kind != BlockBC7;
+}
+
+bool BlockCompression::Decode(uint32_t dxgiFormat, const uint8_t* blocks, size_t blockPitch,
+	uint32_t width, uint32_t height, uint8_t* rgba, size_t rowPitch)
+{
+	if (!CanDecode(dxgiFormat))
+		return false;
+
+	BlockKind kind = GetBlockKind(dxgiFormat);
+	size_t blockBytes = GetBlockBytes(kind);
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+	for (uint32_t by = 0; by < blocksHigh; ++by)
+	{
+		const uint8_t* blockRow = blocks + by * blockPitch;
+		for (uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			const uint8_t* block = blockRow + bx * blockBytes;
+			uint8_t texels[16][4];
+			switch (kind)
+			{
+			case BlockBC1:
+				DecodeColor(block, true, texels);
+				break;
+			case BlockBC2:
+				DecodeColor(block + 8, false, texels);
+				for (int i = 0; i < 16; ++i)
+				{
+					uint8_t a = (block[i / 2] >> (4 * (i & 1))) & 15;
+					texels[i][3] = (uint8_t)(a * 17);
+				}
+				break;
+			case BlockBC3:
+				DecodeColor(block + 8, false, texels);
+				DecodeChannel(block, texels, 3);
+				break;
+			default:
+				memset(texels, 0, sizeof(texels));
+				for (int i = 0; i < 16; ++i)
+					texels[i][3] = 255;
+				DecodeChannel(block, texels, 0);
+				if (kind == BlockBC5)
+					DecodeChannel(block + 8, texels, 1);
+				break;
+			}
+
+			// Partial blocks on the right and bottom edge only write what is inside.
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+			{
+				uint8_t* out = rgba + (by * 4 + y) * rowPitch + bx * 16;
+				uint32_t columns = width - bx * 4 < 4 ? width - bx * 4 : 4;
+				memcpy(out, texels[y * 4], columns * 4);
+			}
+		}
+	}
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// Encoder
+// ---------------------------------------------------------------------------
+
+static int ClampInt(int v, int lo, int hi)
+{
+	return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Closest palette entry per texel by squared error over all four channels;
+// callers zero the channels that do not take part. Ties go to the lower index,
+// so the SSE2 and scalar paths pick the same indices. Returns the summed error.
+static uint32_t SelectIndices(const uint8_t (*texels)[4], int count, const uint8_t (*palette)[4],
+	int paletteSize, uint8_t* indices)
+{
+#ifdef BLOCK_COMPRESSION_SSE2
+	// Four registers of four texels each, every texel as 4 x int16 twice over so
+	// one madd gives two partial sums per texel.
+	uint8_t padded[16][4];
+	memcpy(padded, texels, count * 4);
+	for (int i = count; i < 16; ++i)
+		memcpy(padded[i], texels[0], 4);
+
+	const __m128i zero = _mm_setzero_si128();
+	__m128i pairs[8];
+	for (int i = 0; i < 8; ++i)
+		pairs[i] = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)padded[2 * i]), zero);
+
+	__m128i best[4], bestIndex[4];
+	for (int g = 0; g < 4; ++g)
+	{
+		best[g] = _mm_set1_epi32(0x7fffffff);
+		bestIndex[g] = zero;
+	}
+	for (int j = 0; j < paletteSize; ++j)
+	{
+		int32_t entry;
+		memcpy(&entry, palette[j], 4);
+		__m128i p = _mm_unpacklo_epi8(_mm_set1_epi32(entry), zero);
+		__m128i index = _mm_set1_epi32(j);
+		for (int g = 0; g < 4; ++g)
+		{
+			__m128i d0 = _mm_sub_epi16(pairs[2 * g], p);
+			__m128i d1 = _mm_sub_epi16(pairs[2 * g + 1], p);
+			__m128i s0 = _mm_madd_epi16(d0, d0);
+			__m128i s1 = _mm_madd_epi16(d1, d1);
+			s0 = _mm_add_epi32(s0, _mm_shuffle_epi32(s0, _MM_SHUFFLE(2, 3, 0, 1)));
+			s1 = _mm_add_epi32(s1, _mm_shuffle_epi32(s1, _MM_SHUFFLE(2, 3, 0, 1)));
+			__m128i error = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(s0), _mm_castsi128_ps(s1),
+				_MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i better = _mm_cmplt_epi32(error, best[g]);
+			best[g] = _mm_or_si128(_mm_and_si128(better, error), _mm_andnot_si128(better, best[g]));
+			bestIndex[g] = _mm_or_si128(_mm_and_si128(better, index), _mm_andnot_si128(better, bestIndex[g]));
+		}
+	}
+
+	int32_t errors[16], selected[16];
+	for (int g = 0; g < 4; ++g)
+	{
+		_mm_storeu_si128((__m128i*)&errors[4 * g], best[g]);
+		_mm_storeu_si128((__m128i*)&selected[4 * g], bestIndex[g]);
+	}
+	uint32_t total = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		indices[i] = (uint8_t)selected[i];
+		total += (uint32_t)errors[i];
+	}
+	return total;
+#else
+	uint32_t total = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		int32_t best = 0x7fffffff;
+		int bestIndex = 0;
+		for (int j = 0; j < paletteSize; ++j)
+		{
+			int32_t error = 0;
+			for (int c = 0; c < 4; ++c)
+			{
+				int32_t d = texels[i][c] - palette[j][c];
+				error += d * d;
+			}
+			if (error < best)
+			{
+				best = error;
+				bestIndex = j;
+			}
+		}
+		indices[i] = (uint8_t)bestIndex;
+		total += (uint32_t)best;
+	}
+	return total;
+#endif
+}
+
+// Bounding box endpoints, inset by 1/16 of the range like most fast encoders.
+static void FitBoundingBox(const float (*points)[4], int count, int channels, float lo[4], float hi[4])
+{
+	for (int c = 0; c < channels; ++c)
+	{
+		lo[c] = 255.0f;
+		hi[c] = 0.0f;
+		for (int i = 0; i < count; ++i)
+		{
+			lo[c] = std::min(lo[c], points[i][c]);
+			hi[c] = std::max(hi[c], points[i][c]);
+		}
+		float inset = (hi[c] - lo[c]) / 16.0f;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+}
+
+// Endpoints at the extremes of the points projected onto the main axis of
+// their covariance, found by power iteration.
+static void FitPrincipalAxis(const float (*points)[4], int count, int channels, float lo[4], float hi[4])
+{
+	float mean[4] = {};
+	for (int i = 0; i < count; ++i)
+	{
+		for (int c = 0; c < channels; ++c)
+			mean[c] += points[i][c];
+	}
+	for (int c = 0; c < channels; ++c)
+		mean[c] /= count;
+
+	float cov[4][4] = {};
+	for (int i = 0; i < count; ++i)
+	{
+		for (int a = 0; a < channels; ++a)
+		{
+			for (int b = 0; b < channels; ++b)
+				cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+		}
+	}
+
+	// Start from the largest diagonal so a single dominant channel converges at once.
+	float axis[4] = {};
+	int start = 0;
+	for (int c = 1; c < channels; ++c)
+	{
+		if (cov[c][c] > cov[start][start])
+			start = c;
+	}
+	axis[start] = 1.0f;
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (int a = 0; a < channels; ++a)
+		{
+			for (int b = 0; b < channels; ++b)
+				next[a] += cov[a][b] * axis[b];
+			length = std::max(length, std::fabs(next[a]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int c = 0; c < channels; ++c)
+			axis[c] = next[c] / length;
+	}
+
+	float axisLength2 = 0.0f;
+	for (int c = 0; c < channels; ++c)
+		axisLength2 += axis[c] * axis[c];
+	float tMin = 0.0f, tMax = 0.0f;
+	for (int i = 0; i < count; ++i)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			t += (points[i][c] - mean[c]) * axis[c];
+		t /= axisLength2;
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	for (int c = 0; c < channels; ++c)
+	{
+		lo[c] = std::min(std::max(mean[c] + tMin * axis[c], 0.0f), 255.0f);
+		hi[c] = std::min(std::max(mean[c] + tMax * axis[c], 0.0f), 255.0f);
+	}
+}
+
+// Least squares endpoints for fixed indices, weights[index] being how much of
+// the second endpoint that index blends in. False when the system is singular,
+// for example when every point uses the same index.
+static bool RefineEndpoints(const float (*points)[4], const uint8_t* indices, int count, const float* weights,
+	int channels, float lo[4], float hi[4])
+{
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < count; ++i)
+	{
+		float b = weights[indices[i]];
+		float a = 1.0f - b;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for (int c = 0; c < channels; ++c)
+		{
+			ax[c] += a * points[i][c];
+			bx[c] += b * points[i][c];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return false;
+	for (int c = 0; c < channels; ++c)
+	{
+		lo[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / det, 0.0f), 255.0f);
+		hi[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / det, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static int GetRefinePasses(BlockCompression::Quality quality)
+{
+	return quality == BlockCompression::Quality::Fast ? 0 : (quality == BlockCompression::Quality::Normal ? 1 : 3);
+}
+
+static uint16_t To565(const float c[4])
+{
+	int r = ClampInt((int)(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+	int g = ClampInt((int)(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+	int b = ClampInt((int)(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// Quantizes lo/hi to one BC1-BC3 color block. Four color mode needs c0 > c1 and
+// three color mode c0 <= c1, so the endpoints swap as required; indices refer to
+// the final order. Returns the error over the opaque texels.
+static uint32_t QuantizeColorBlock(const uint8_t (*opaque)[4], int opaqueCount, bool threeColor,
+	const float lo[4], const float hi[4], uint16_t& c0, uint16_t& c1, uint8_t* indices)
+{
+	c0 = To565(lo);
+	c1 = To565(hi);
+	if (threeColor ? c0 > c1 : c0 < c1)
+		std::swap(c0, c1);
+
+	uint8_t palette[4][4];
+	BuildColorPalette(c0, c1, true, palette);
+	for (int i = 0; i < 4; ++i)
+		palette[i][3] = 0;
+	// Equal endpoints read as three color mode, where index 3 is transparent.
+	int paletteSize = threeColor || c0 == c1 ? 3 : 4;
+	return SelectIndices(opaque, opaqueCount, palette, paletteSize, indices);
+}
+
+static void EncodeColor(const uint8_t texels[16][4], bool punchThrough, BlockCompression::Quality quality, uint8_t* block)
+{
+	// Texels below half alpha use the transparent index of BC1's three color mode.
+	uint8_t opaque[16][4];
+	float points[16][4];
+	int slot[16];
+	int opaqueCount = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		slot[i] = -1;
+		if (punchThrough && texels[i][3] < 128)
+			continue;
+		slot[i] = opaqueCount;
+		for (int c = 0; c < 3; ++c)
+		{
+			opaque[opaqueCount][c] = texels[i][c];
+			points[opaqueCount][c] = texels[i][c];
+		}
+		opaque[opaqueCount][3] = 0;
+		points[opaqueCount][3] = 0.0f;
+		++opaqueCount;
+	}
+	if (opaqueCount == 0)
+	{
+		Write16(block, 0);
+		Write16(block + 2, 0);
+		memset(block + 4, 0xff, 4);
+		return;
+	}
+	bool threeColor = opaqueCount < 16;
+
+	float lo[4], hi[4];
+	if (quality == BlockCompression::Quality::Fast)
+		FitBoundingBox(points, opaqueCount, 3, lo, hi);
+	else
+		FitPrincipalAxis(points, opaqueCount, 3, lo, hi);
+
+	static const float fourColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	static const float threeColorWeights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+	uint32_t bestError = 0xffffffff;
+	uint16_t bestC0 = 0, bestC1 = 0;
+	uint8_t bestIndices[16] = {};
+	for (int pass = 0; ; ++pass)
+	{
+		uint16_t c0, c1;
+		uint8_t indices[16];
+		uint32_t error = QuantizeColorBlock(opaque, opaqueCount, threeColor, lo, hi, c0, c1, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			bestC0 = c0;
+			bestC1 = c1;
+			memcpy(bestIndices, indices, opaqueCount);
+		}
+		if (pass == GetRefinePasses(quality) || bestError == 0)
+			break;
+		const float* weights = threeColor || c0 == c1 ? threeColorWeights : fourColorWeights;
+		if (!RefineEndpoints(points, indices, opaqueCount, weights, 3, lo, hi))
+			break;
+	}
+
+	Write16(block, bestC0);
+	Write16(block + 2, bestC1);
+	uint32_t packed = 0;
+	for (int i = 0; i < 16; ++i)
+		packed |= (uint32_t)(slot[i] < 0 ? 3 : bestIndices[slot[i]]) << (2 * i);
+	memcpy(block + 4, &packed, 4);
+}
+
+static uint32_t EvaluateChannel(const uint8_t* values, uint8_t e0, uint8_t e1, uint8_t* indices)
+{
+	uint8_t palette[8];
+	BuildChannelPalette(e0, e1, palette);
+	uint32_t total = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0x7fffffff;
+		for (int j = 0; j < 8; ++j)
+		{
+			int d = values[i] - palette[j];
+			if (d * d < best)
+			{
+				best = d * d;
+				indices[i] = (uint8_t)j;
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+// One BC4 style channel. Tries the eight value mode between min and max and,
+// above Fast, the six value mode that has exact 0 and 255 for free; High also
+// searches a small window around both.
+static void EncodeChannel(const uint8_t texels[16][4], int channel, BlockCompression::Quality quality, uint8_t* block)
+{
+	uint8_t values[16];
+	int minValue = 255, maxValue = 0;
+	int minInner = 255, maxInner = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		values[i] = texels[i][channel];
+		minValue = std::min(minValue, (int)values[i]);
+		maxValue = std::max(maxValue, (int)values[i]);
+		if (values[i] != 0 && values[i] != 255)
+		{
+			minInner = std::min(minInner, (int)values[i]);
+			maxInner = std::max(maxInner, (int)values[i]);
+		}
+	}
+
+	uint32_t bestError = 0xffffffff;
+	uint8_t bestE0 = 0, bestE1 = 0;
+	uint8_t bestIndices[16] = {};
+	auto tryEndpoints = [&](int e0, int e1)
+	{
+		uint8_t indices[16];
+		uint32_t error = EvaluateChannel(values, (uint8_t)e0, (uint8_t)e1, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			bestE0 = (uint8_t)e0;
+			bestE1 = (uint8_t)e1;
+			memcpy(bestIndices, indices, 16);
+		}
+	};
+
+	int window = quality == BlockCompression::Quality::High ? 1 : 0;
+	if (maxValue > minValue)
+	{
+		for (int d0 = -window; d0 <= window; ++d0)
+		{
+			for (int d1 = -window; d1 <= window; ++d1)
+			{
+				int e0 = ClampInt(maxValue + d0, 0, 255), e1 = ClampInt(minValue + d1, 0, 255);
+				if (e0 > e1)
+					tryEndpoints(e0, e1);
+			}
+		}
+	}
+	else
+	{
+		tryEndpoints(minValue, minValue);
+	}
+
+	if (quality != BlockCompression::Quality::Fast && bestError != 0)
+	{
+		if (minInner > maxInner)
+			minInner = maxInner = minValue;
+		for (int d0 = -window; d0 <= window; ++d0)
+		{
+			for (int d1 = -window; d1 <= window; ++d1)
+			{
+				int e0 = ClampInt(minInner + d0, 0, 255), e1 = ClampInt(maxInner + d1, 0, 255);
+				if (e0 <= e1)
+					tryEndpoints(e0, e1);
+			}
+		}
+	}
+
+	block[0] = bestE0;
+	block[1] = bestE1;
+	uint64_t packed = 0;
+	for (int i = 0; i < 16; ++i)
+		packed |= (uint64_t)bestIndices[i] << (3 * i);
+	for (int i = 0; i < 6; ++i)
+		block[2 + i] = (uint8_t)(packed >> (8 * i));
+}
+
+// BC7 mode 6: 7 bit RGBA endpoints plus one p-bit each, 16 interpolation steps.
+static const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Endpoint
+{
+	uint8_t Value[4];
+	uint8_t PBit;
+};
+
+static float QuantizeBC7Endpoint(const float e[4], int pBit, BC7Endpoint& out)
+{
+	float error = 0.0f;
+	for (int c = 0; c < 4; ++c)
+	{
+		int q = ClampInt((int)std::floor((e[c] - pBit) / 2.0f + 0.5f), 0, 127);
+		out.Value[c] = (uint8_t)q;
+		float d = (float)((q << 1) | pBit) - e[c];
+		error += d * d;
+	}
+	out.PBit = (uint8_t)pBit;
+	return error;
+}
+
+static uint32_t EvaluateBC7(const uint8_t texels[16][4], const BC7Endpoint& e0, const BC7Endpoint& e1, uint8_t* indices)
+{
+	uint8_t palette[16][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		int a = (e0.Value[c] << 1) | e0.PBit;
+		int b = (e1.Value[c] << 1) | e1.PBit;
+		for (int i = 0; i < 16; ++i)
+			palette[i][c] = (uint8_t)(((64 - BC7Weights4[i]) * a + BC7Weights4[i] * b + 32) >> 6);
+	}
+	return SelectIndices(texels, 16, palette, 16, indices);
+}
+
+static void EncodeBC7(const uint8_t texels[16][4], BlockCompression::Quality quality, uint8_t* block)
+{
+	float points[16][4];
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+			points[i][c] = texels[i][c];
+	}
+
+	float lo[4], hi[4];
+	if (quality == BlockCompression::Quality::Fast)
+		FitBoundingBox(points, 16, 4, lo, hi);
+	else
+		FitPrincipalAxis(points, 16, 4, lo, hi);
+
+	float weights[16];
+	for (int i = 0; i < 16; ++i)
+		weights[i] = BC7Weights4[i] / 64.0f;
+
+	uint32_t bestError = 0xffffffff;
+	BC7Endpoint best0 = {}, best1 = {};
+	uint8_t bestIndices[16] = {};
+	for (int pass = 0; ; ++pass)
+	{
+		// Below High each endpoint takes the p-bit closest to it on its own;
+		// High tries the four combinations against the real error.
+		BC7Endpoint candidates[2][2];
+		float pError[2][2];
+		for (int p = 0; p < 2; ++p)
+		{
+			pError[0][p] = QuantizeBC7Endpoint(lo, p, candidates[0][p]);
+			pError[1][p] = QuantizeBC7Endpoint(hi, p, candidates[1][p]);
+		}
+
+		for (int p0 = 0; p0 < 2; ++p0)
+		{
+			for (int p1 = 0; p1 < 2; ++p1)
+			{
+				if (quality != BlockCompression::Quality::High &&
+					(p0 != (pError[0][1] < pError[0][0] ? 1 : 0) || p1 != (pError[1][1] < pError[1][0] ? 1 : 0)))
+					continue;
+				uint8_t indices[16];
+				uint32_t error = EvaluateBC7(texels, candidates[0][p0], candidates[1][p1], indices);
+				if (error < bestError)
+				{
+					bestError = error;
+					best0 = candidates[0][p0];
+					best1 = candidates[1][p1];
+					memcpy(bestIndices, indices, 16);
+				}
+			}
+		}
+		if (pass == GetRefinePasses(quality) || bestError == 0)
+			break;
+		if (!RefineEndpoints(points, bestIndices, 16, weights, 4, lo, hi))
+			break;
+	}
+
+	// The first index has an implicit 0 top bit; flip the block when it is set.
+	if (bestIndices[0] & 8)
+	{
+		std::swap(best0, best1);
+		for (int i = 0; i < 16; ++i)
+			bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+	}
+
+	uint64_t bits[2] = {};
+	int position = 0;
+	auto write = [&](uint32_t value, int count)
+	{
+		for (int i = 0; i < count; ++i, ++position)
+			bits[position >> 6] |= (uint64_t)((value >> i) & 1) << (position & 63);
+	};
+	write(1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		write(best0.Value[c], 7);
+		write(best1.Value[c], 7);
+	}
+	write(best0.PBit, 1);
+	write(best1.PBit, 1);
+	write(bestIndices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		write(bestIndices[i], 4);
+	for (int i = 0; i < 16; ++i)
+		block[i] = (uint8_t)(bits[i >> 3] >> (8 * (i & 7)));
+}
+
+bool BlockCompression::CanEncode(uint32_t dxgiFormat)
+{
+	BlockKind kind = GetBlockKind(dxgiFormat);
+	return kind != BlockNone && kind != BlockBC2;
+}
+
+bool BlockCompression::Encode(uint32_t dxgiFormat, const uint8_t* rgba, size_t rowPitch,
+	uint32_t width, uint32_t height, uint8_t* blocks, size_t blockPitch, Quality quality)
+{
+	if (!CanEncode(dxgiFormat) || width == 0 || height == 0)
+		return false;
+
+	BlockKind kind = GetBlockKind(dxgiFormat);
+	size_t blockBytes = GetBlockBytes(kind);
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+	for (uint32_t by = 0; by < blocksHigh; ++by)
+	{
+		uint8_t* blockRow = blocks + by * blockPitch;
+		for (uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			uint8_t texels[16][4];
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				uint32_t sy = std::min(by * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					uint32_t sx = std::min(bx * 4 + x, width - 1);
+					memcpy(texels[y * 4 + x], rgba + sy * rowPitch + sx * 4, 4);
+				}
+			}
+
+			uint8_t* block = blockRow + bx * blockBytes;
+			switch (kind)
+			{
+			case BlockBC1:
+				EncodeColor(texels, true, quality, block);
+				break;
+			case BlockBC3:
+				EncodeChannel(texels, 3, quality, block);
+				EncodeColor(texels, false, quality, block + 8);
+				break;
+			case BlockBC4:
+				EncodeChannel(texels, 0, quality, block);
+				break;
+			case BlockBC5:
+				EncodeChannel(texels, 0, quality, block);
+				EncodeChannel(texels, 1, quality, block + 8);
+				break;
+			default:
+				EncodeBC7(texels, quality, block);
+				break;
+			}
+		}
+	}
+	return true;
+}
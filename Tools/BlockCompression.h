@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CPU side of the BC formats, working on whole images of 4x4 blocks. DXGI formats
+// are passed as their numeric values like in DDSFileView. Only depends on the
+// standard library.
+class BlockCompression
+{
+public:
+	// Encoder effort. Fast fits endpoints to the bounding box, Normal to the
+	// principal axis with one least squares pass, High iterates the refinement
+	// and searches more endpoint and p-bit candidates.
+	enum class Quality
+	{
+		Fast,
+		Normal,
+		High,
+	};
+
+	// Bytes per 4x4 block, 0 for formats that are not block compressed here.
+	static size_t GetBlockSize(uint32_t dxgiFormat);
+
+	// BC1-BC5, UNORM, SRGB and TYPELESS variants; not the BC4/BC5 SNORM ones.
+	static bool CanDecode(uint32_t dxgiFormat);
+	// Expands blocks into RGBA8. BC4 fills R, BC5 R and G; the rest is 0 with alpha 255.
+	// blockPitch is the byte size of one row of blocks.
+	static bool Decode(uint32_t dxgiFormat, const uint8_t* blocks, size_t blockPitch,
+		uint32_t width, uint32_t height, uint8_t* rgba, size_t rowPitch);
+
+	// BC1, BC3, BC4, BC5 and BC7, same variants as CanDecode. BC7 only writes
+	// mode 6 blocks: one subset, RGBA endpoints and 4 bit indices.
+	static bool CanEncode(uint32_t dxgiFormat);
+	// Compresses RGBA8 into blocks. BC1 alpha below 128 becomes transparent black,
+	// BC4 reads R and BC5 R and G. Edge blocks repeat the last row and column.
+	// Blocks are independent, so callers can split the image across threads by
+	// rows of blocks.
+	static bool Encode(uint32_t dxgiFormat, const uint8_t* rgba, size_t rowPitch,
+		uint32_t width, uint32_t height, uint8_t* blocks, size_t blockPitch, Quality quality);
+};
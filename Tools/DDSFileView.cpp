@@ -0,0 +1,275 @@
+#include "DDSFileView.h"
+#include <cstring>
+
+#define DDS_FOURCC_CODE(a, b, c, d) \
+	((uint32_t)(uint8_t)(a) | ((uint32_t)(uint8_t)(b) << 8) | ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24))
+
+// Field offsets inside DDS_HEADER / DDS_HEADER_DXT10, see DDSTextureLoader.cpp.
+enum
+{
+	HeaderSizeOffset = 0,
+	HeaderFlagsOffset = 4,
+	HeaderHeightOffset = 8,
+	HeaderWidthOffset = 12,
+	HeaderDepthOffset = 20,
+	HeaderMipCountOffset = 24,
+	PixelFormatSizeOffset = 72,
+	PixelFormatFlagsOffset = 76,
+	PixelFormatFourCCOffset = 80,
+	PixelFormatBitCountOffset = 84,
+	PixelFormatRMaskOffset = 88,
+	PixelFormatGMaskOffset = 92,
+	PixelFormatBMaskOffset = 96,
+	PixelFormatAMaskOffset = 100,
+	HeaderCaps2Offset = 108,
+	Dxt10FormatOffset = 124,
+	Dxt10MiscFlagOffset = 132,
+	Dxt10ArraySizeOffset = 136,
+};
+
+static const uint32_t DDSFlagFourCC = 0x00000004;
+static const uint32_t DDSFlagLuminance = 0x00020000;
+static const uint32_t DDSFlagVolume = 0x00800000;
+static const uint32_t DDSCaps2Cubemap = 0x00000200;
+static const uint32_t DDSMiscTextureCube = 0x4;
+
+uint32_t DDSFileView::ReadHeader(size_t offset) const
+{
+	// The header is only 4 byte aligned inside the file, memcpy keeps this portable.
+	uint32_t value;
+	memcpy(&value, GetHeader() + offset, sizeof(value));
+	return value;
+}
+
+static uint32_t LegacyToDxgi(uint32_t flags, uint32_t fourCC, uint32_t bitCount,
+	uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+	if (flags & DDSFlagFourCC)
+	{
+		switch (fourCC)
+		{
+		case DDS_FOURCC_CODE('D', 'X', 'T', '1'): return 71;   // BC1_UNORM
+		case DDS_FOURCC_CODE('D', 'X', 'T', '2'):
+		case DDS_FOURCC_CODE('D', 'X', 'T', '3'): return 74;   // BC2_UNORM
+		case DDS_FOURCC_CODE('D', 'X', 'T', '4'):
+		case DDS_FOURCC_CODE('D', 'X', 'T', '5'): return 77;   // BC3_UNORM
+		case DDS_FOURCC_CODE('A', 'T', 'I', '1'):
+		case DDS_FOURCC_CODE('B', 'C', '4', 'U'): return 80;   // BC4_UNORM
+		case DDS_FOURCC_CODE('B', 'C', '4', 'S'): return 81;   // BC4_SNORM
+		case DDS_FOURCC_CODE('A', 'T', 'I', '2'):
+		case DDS_FOURCC_CODE('B', 'C', '5', 'U'): return 83;   // BC5_UNORM
+		case DDS_FOURCC_CODE('B', 'C', '5', 'S'): return 84;   // BC5_SNORM
+		// D3DFORMAT codes stored in the fourCC field.
+		case 36:  return 11;  // R16G16B16A16_UNORM
+		case 110: return 13;  // R16G16B16A16_SNORM
+		case 111: return 54;  // R16_FLOAT
+		case 112: return 34;  // R16G16_FLOAT
+		case 113: return 10;  // R16G16B16A16_FLOAT
+		case 114: return 41;  // R32_FLOAT
+		case 115: return 16;  // R32G32_FLOAT
+		case 116: return 2;   // R32G32B32A32_FLOAT
+		}
+		return 0;
+	}
+
+	if (bitCount == 32)
+	{
+		if (r == 0x000000ff && g == 0x0000ff00 && b == 0x00ff0000 && a == 0xff000000) return 28; // R8G8B8A8_UNORM
+		if (r == 0x00ff0000 && g == 0x0000ff00 && b == 0x000000ff && a == 0xff000000) return 87; // B8G8R8A8_UNORM
+		if (r == 0x00ff0000 && g == 0x0000ff00 && b == 0x000000ff && a == 0) return 88;          // B8G8R8X8_UNORM
+	}
+	else if (bitCount == 16)
+	{
+		if (r == 0xf800 && g == 0x07e0 && b == 0x001f) return 85; // B5G6R5_UNORM
+	}
+	else if (bitCount == 8)
+	{
+		// L8 would sample as red only; the D3D loader expands it to RGBA8 instead.
+		if (flags & DDSFlagLuminance) return 0;
+		if (r == 0xff && g == 0 && b == 0 && a == 0) return 61; // R8_UNORM
+		if (r == 0 && g == 0 && b == 0 && a == 0xff) return 65; // A8_UNORM
+	}
+	return 0;
+}
+
+bool DDSFileView::Parse(const uint8_t* data, size_t size)
+{
+	mData = data;
+	mSize = size;
+
+	// Need at least enough data to fill the header and magic number to be a valid DDS.
+	if (data == nullptr || size < sizeof(uint32_t) + HeaderSize)
+		return false;
+
+	uint32_t magic;
+	memcpy(&magic, data, sizeof(magic));
+	if (magic != Magic)
+		return false;
+
+	if (ReadHeader(HeaderSizeOffset) != HeaderSize || ReadHeader(PixelFormatSizeOffset) != PixelFormatSize)
+		return false;
+
+	uint32_t pfFlags = ReadHeader(PixelFormatFlagsOffset);
+	uint32_t fourCC = ReadHeader(PixelFormatFourCCOffset);
+	mDxt10 = (pfFlags & DDSFlagFourCC) && fourCC == DDS_FOURCC_CODE('D', 'X', '1', '0');
+	if (mDxt10 && size < sizeof(uint32_t) + HeaderSize + Dxt10HeaderSize)
+		return false;
+	mBitOffset = sizeof(uint32_t) + HeaderSize + (mDxt10 ? Dxt10HeaderSize : 0);
+
+	mWidth = ReadHeader(HeaderWidthOffset);
+	mHeight = ReadHeader(HeaderHeightOffset);
+	mDepth = (ReadHeader(HeaderFlagsOffset) & DDSFlagVolume) ? ReadHeader(HeaderDepthOffset) : 1;
+	mMipCount = ReadHeader(HeaderMipCountOffset);
+	if (mMipCount == 0)
+		mMipCount = 1;
+
+	if (mDxt10)
+	{
+		mDxgiFormat = ReadHeader(Dxt10FormatOffset);
+		mArraySize = ReadHeader(Dxt10ArraySizeOffset);
+		mCube = (ReadHeader(Dxt10MiscFlagOffset) & DDSMiscTextureCube) != 0;
+		if (mArraySize == 0)
+			return false;
+		if (mCube)
+			mArraySize *= 6;
+	}
+	else
+	{
+		mDxgiFormat = LegacyToDxgi(pfFlags, fourCC, ReadHeader(PixelFormatBitCountOffset),
+			ReadHeader(PixelFormatRMaskOffset), ReadHeader(PixelFormatGMaskOffset),
+			ReadHeader(PixelFormatBMaskOffset), ReadHeader(PixelFormatAMaskOffset));
+		mCube = (ReadHeader(HeaderCaps2Offset) & DDSCaps2Cubemap) != 0;
+		mArraySize = mCube ? 6 : 1;
+	}
+
+	return mWidth > 0 && mHeight > 0 && mDepth > 0;
+}
+
+bool DDSFileView::GetFormatInfo(bool& compressed, size_t& bytesPerBlock, size_t& bitsPerPixel) const
+{
+	compressed = false;
+	bytesPerBlock = 0;
+	bitsPerPixel = 0;
+
+	uint32_t f = mDxgiFormat;
+	if ((f >= 70 && f <= 72) || (f >= 79 && f <= 81))
+	{
+		compressed = true;
+		bytesPerBlock = 8;      // BC1, BC4
+	}
+	else if ((f >= 73 && f <= 78) || (f >= 82 && f <= 84) || (f >= 94 && f <= 99))
+	{
+		compressed = true;
+		bytesPerBlock = 16;     // BC2, BC3, BC5, BC6H, BC7
+	}
+	else if (f >= 1 && f <= 4) bitsPerPixel = 128;
+	else if (f >= 5 && f <= 8) bitsPerPixel = 96;
+	else if (f >= 9 && f <= 22) bitsPerPixel = 64;
+	else if ((f >= 23 && f <= 47) || f == 67 || (f >= 87 && f <= 93)) bitsPerPixel = 32;
+	else if ((f >= 48 && f <= 59) || f == 85 || f == 86 || f == 115) bitsPerPixel = 16;
+	else if (f >= 60 && f <= 65) bitsPerPixel = 8;
+	else if (f == 0 && !mDxt10 && !(ReadHeader(PixelFormatFlagsOffset) & DDSFlagFourCC))
+		bitsPerPixel = ReadHeader(PixelFormatBitCountOffset);   // legacy RGB layout we do not name
+
+	return compressed || bitsPerPixel >= 8;
+}
+
+bool DDSFileView::IsBlockCompressed() const
+{
+	bool compressed;
+	size_t bytesPerBlock, bitsPerPixel;
+	GetFormatInfo(compressed, bytesPerBlock, bitsPerPixel);
+	return compressed;
+}
+
+bool DDSFileView::GetSubresources(std::vector<DDSSubresource>& subresources) const
+{
+	subresources.clear();
+
+	bool compressed;
+	size_t bytesPerBlock, bitsPerPixel;
+	if (!GetFormatInfo(compressed, bytesPerBlock, bitsPerPixel))
+		return false;
+
+	subresources.reserve(mArraySize * mMipCount);
+	const uint8_t* src = GetBitData();
+	const uint8_t* end = mData + mSize;
+	for (uint32_t item = 0; item < mArraySize; ++item)
+	{
+		uint32_t w = mWidth, h = mHeight, d = mDepth;
+		for (uint32_t mip = 0; mip < mMipCount; ++mip)
+		{
+			DDSSubresource sub;
+			sub.Width = w;
+			sub.Height = h;
+			sub.Depth = d;
+			if (compressed)
+			{
+				sub.RowPitch = ((w + 3) / 4) * bytesPerBlock;
+				sub.NumRows = (h + 3) / 4;
+			}
+			else
+			{
+				sub.RowPitch = (w * bitsPerPixel + 7) / 8;
+				sub.NumRows = h;
+			}
+			sub.SlicePitch = sub.RowPitch * sub.NumRows;
+			sub.Data = src;
+
+			size_t bytes = sub.SlicePitch * d;
+			if ((size_t)(end - src) < bytes)
+			{
+				subresources.clear();
+				return false;
+			}
+			src += bytes;
+			subresources.push_back(sub);
+
+			w = w > 1 ? w / 2 : 1;
+			h = h > 1 ? h / 2 : 1;
+			d = d > 1 ? d / 2 : 1;
+		}
+	}
+	return true;
+}
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+size_t DDSFileView::GetStagingSize(const std::vector<DDSSubresource>& subresources,
+	size_t rowAlignment, size_t subresourceAlignment)
+{
+	size_t total = 0;
+	for (auto& sub : subresources)
+	{
+		total = AlignUp(total, subresourceAlignment);
+		total += AlignUp(sub.RowPitch, rowAlignment) * sub.NumRows * sub.Depth;
+	}
+	return total;
+}
+
+void DDSFileView::CopyToStaging(const std::vector<DDSSubresource>& subresources, uint8_t* dest,
+	size_t rowAlignment, size_t subresourceAlignment)
+{
+	size_t offset = 0;
+	for (auto& sub : subresources)
+	{
+		offset = AlignUp(offset, subresourceAlignment);
+		size_t destPitch = AlignUp(sub.RowPitch, rowAlignment);
+		const uint8_t* src = sub.Data;
+		uint8_t* dst = dest + offset;
+		size_t rows = sub.NumRows * sub.Depth;
+		if (destPitch == sub.RowPitch)
+		{
+			memcpy(dst, src, sub.RowPitch * rows);
+		}
+		else
+		{
+			for (size_t row = 0; row < rows; ++row)
+				memcpy(dst + row * destPitch, src + row * sub.RowPitch, sub.RowPitch);
+		}
+		offset += destPitch * rows;
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One mip of one array slice (or cube face) inside a DDS file.
+struct DDSSubresource
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t Depth;
+	size_t RowPitch;
+	size_t NumRows;
+	size_t SlicePitch;
+	const uint8_t* Data;
+};
+
+// Validates a DDS file in place and describes its subresources without copying
+// anything. Only depends on the standard library, so it runs unchanged on top of
+// a MappedFile on Windows or Linux. DXGI formats are handled as their numeric
+// values; the D3D loader still owns the full format translation.
+class DDSFileView
+{
+public:
+	static const uint32_t Magic = 0x20534444; // "DDS "
+	static const size_t HeaderSize = 124;
+	static const size_t PixelFormatSize = 32;
+	static const size_t Dxt10HeaderSize = 20;
+
+	// Same checks DDSTextureLoader always did: magic, header sizes and the DX10 extension.
+	bool Parse(const uint8_t* data, size_t size);
+
+	// Points at the DDS_HEADER right after the magic number.
+	const uint8_t* GetHeader() const { return mData + sizeof(uint32_t); }
+	bool HasDxt10Header() const { return mDxt10; }
+	const uint8_t* GetBitData() const { return mData + mBitOffset; }
+	size_t GetBitSize() const { return mSize - mBitOffset; }
+
+	uint32_t GetWidth() const { return mWidth; }
+	uint32_t GetHeight() const { return mHeight; }
+	uint32_t GetDepth() const { return mDepth; }
+	uint32_t GetMipCount() const { return mMipCount; }
+	// Array slices, times six for cube maps.
+	uint32_t GetArraySize() const { return mArraySize; }
+	bool IsCube() const { return mCube; }
+	// DXGI_FORMAT value, 0 for legacy headers the layout code does not know.
+	uint32_t GetDxgiFormat() const { return mDxgiFormat; }
+	// BC1-BC7: stored as 4x4 blocks, so every mip used as a top level needs aligned sizes.
+	bool IsBlockCompressed() const;
+
+	// Fills one entry per subresource, array slice major. Fails when the format is
+	// unknown or the file is shorter than its header claims.
+	bool GetSubresources(std::vector<DDSSubresource>& subresources) const;
+
+	// Size of an upload buffer laid out like D3D12 placed footprints.
+	static size_t GetStagingSize(const std::vector<DDSSubresource>& subresources,
+		size_t rowAlignment = 256, size_t subresourceAlignment = 512);
+	// Copies every subresource straight from the file view into dest with aligned rows.
+	static void CopyToStaging(const std::vector<DDSSubresource>& subresources, uint8_t* dest,
+		size_t rowAlignment = 256, size_t subresourceAlignment = 512);
+
+private:
+	// Either a block size for 4x4 compressed formats or a pixel size in bits.
+	bool GetFormatInfo(bool& compressed, size_t& bytesPerBlock, size_t& bitsPerPixel) const;
+	uint32_t ReadHeader(size_t offset) const;
+
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+	size_t mBitOffset = 0;
+	bool mDxt10 = false;
+	bool mCube = false;
+	uint32_t mWidth = 0;
+	uint32_t mHeight = 0;
+	uint32_t mDepth = 0;
+	uint32_t mMipCount = 0;
+	uint32_t mArraySize = 0;
+	uint32_t mDxgiFormat = 0;
+};
@@ -0,0 +1,65 @@
+#include "FenceRetireQueue.h"
+#include <algorithm>
+#include <vector>
+
+void FenceRetireQueue::Enqueue(uint64_t fenceValue, std::function<void()> callback)
+{
+	if (!callback)
+		return;
+
+	Entry entry;
+	entry.FenceValue = fenceValue;
+	entry.Callback = std::move(callback);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	// Almost everything is enqueued against the newest fence, so appending is the common case.
+	if (mEntries.empty() || mEntries.back().FenceValue <= entry.FenceValue)
+	{
+		mEntries.push_back(std::move(entry));
+		return;
+	}
+
+	auto it = std::upper_bound(mEntries.begin(), mEntries.end(), entry.FenceValue,
+		[](uint64_t value, const Entry& e) { return value < e.FenceValue; });
+	mEntries.insert(it, std::move(entry));
+}
+
+size_t FenceRetireQueue::Retire(uint64_t completedValue)
+{
+	std::vector<Entry> finished;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		while (!mEntries.empty() && mEntries.front().FenceValue <= completedValue)
+		{
+			finished.push_back(std::move(mEntries.front()));
+			mEntries.pop_front();
+		}
+	}
+
+	// Callbacks run outside the lock so they are free to enqueue more work.
+	for (auto& e : finished)
+		e.Callback();
+
+	return finished.size();
+}
+
+void FenceRetireQueue::Clear()
+{
+	std::deque<Entry> dropped;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		dropped.swap(mEntries);
+	}
+}
+
+size_t FenceRetireQueue::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
+
+uint64_t FenceRetireQueue::GetOldestFenceValue()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.empty() ? 0 : mEntries.front().FenceValue;
+}
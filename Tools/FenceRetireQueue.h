@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Work that has to wait until the GPU has passed a fence value: callbacks that
+// want to know when a submission finished, and objects that may still be
+// referenced by recorded commands, kept alive by a callback that captures them.
+// The queue only compares fence values, so it can be driven by a real
+// ID3D12Fence or by a plain counter. Only depends on the standard library.
+class FenceRetireQueue
+{
+public:
+	void Enqueue(uint64_t fenceValue, std::function<void()> callback);
+
+	// Runs and then destroys every callback whose fence value is <= completedValue,
+	// in fence order. Returns the number of entries retired.
+	size_t Retire(uint64_t completedValue);
+
+	// Destroys everything without running callbacks (device teardown); what the
+	// callbacks captured is released all the same.
+	void Clear();
+
+	size_t GetPendingCount();
+	// Smallest fence value still waiting, 0 when the queue is empty.
+	uint64_t GetOldestFenceValue();
+
+private:
+	struct Entry
+	{
+		uint64_t FenceValue;
+		std::function<void()> Callback;
+	};
+
+	std::mutex mMutex;
+	// Kept sorted by FenceValue so retirement only looks at the front.
+	std::deque<Entry> mEntries;
+};
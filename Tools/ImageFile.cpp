@@ -0,0 +1,124 @@
+#include "ImageFile.h"
+#include <cstring>
+
+static uint32_t Read32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t Read16(const uint8_t* p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool ImageFile::Open(const char* fileName)
+{
+	if (!mFile.Open(fileName))
+		return false;
+	return Parse(mFile.GetData(), mFile.GetSize());
+}
+
+// Next PPM header token; '#' comments run to the end of the line.
+static bool ReadPPMNumber(const uint8_t* data, size_t size, size_t& pos, uint32_t& value)
+{
+	while (pos < size)
+	{
+		if (data[pos] == '#')
+		{
+			while (pos < size && data[pos] != '\n')
+				++pos;
+		}
+		else if (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n')
+		{
+			++pos;
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (pos >= size || data[pos] < '0' || data[pos] > '9')
+		return false;
+	value = 0;
+	while (pos < size && data[pos] >= '0' && data[pos] <= '9' && value < 100000)
+		value = value * 10 + (data[pos++] - '0');
+	return true;
+}
+
+bool ImageFile::Parse(const uint8_t* data, size_t size)
+{
+	mPixels = nullptr;
+	mWidth = mHeight = 0;
+	if (size < 2)
+		return false;
+
+	if (data[0] == 'P' && data[1] == '6')
+	{
+		size_t pos = 2;
+		uint32_t width, height, maxValue;
+		if (!ReadPPMNumber(data, size, pos, width) || !ReadPPMNumber(data, size, pos, height) ||
+			!ReadPPMNumber(data, size, pos, maxValue) || maxValue != 255 || width == 0 || height == 0)
+			return false;
+		// Exactly one whitespace byte separates the header from the pixels.
+		++pos;
+		size_t rowBytes = (size_t)width * 3;
+		if (pos > size || size - pos < rowBytes * height)
+			return false;
+
+		mPixels = data + pos;
+		mRowStride = (ptrdiff_t)rowBytes;
+		mSource = PixelConvert::Source::RGB8;
+		mWidth = width;
+		mHeight = height;
+		return true;
+	}
+
+	if (data[0] == 'B' && data[1] == 'M' && size >= 54)
+	{
+		uint32_t offset = Read32(data + 10);
+		uint32_t headerSize = Read32(data + 14);
+		int32_t width = (int32_t)Read32(data + 18);
+		int32_t height = (int32_t)Read32(data + 22);
+		uint16_t bitCount = Read16(data + 28);
+		uint32_t compression = Read32(data + 30);
+		if (headerSize < 40 || width <= 0 || height == 0 || compression != 0 || (bitCount != 24 && bitCount != 32))
+			return false;
+
+		bool bottomUp = height > 0;
+		uint32_t rows = bottomUp ? (uint32_t)height : (uint32_t)-height;
+		// Rows are padded to 4 bytes.
+		size_t rowBytes = ((size_t)width * bitCount + 31) / 32 * 4;
+		if (offset > size || size - offset < rowBytes * rows)
+			return false;
+
+		mPixels = data + offset + (bottomUp ? rowBytes * (rows - 1) : 0);
+		mRowStride = bottomUp ? -(ptrdiff_t)rowBytes : (ptrdiff_t)rowBytes;
+		mSource = bitCount == 24 ? PixelConvert::Source::BGR8 : PixelConvert::Source::BGRA8;
+		mWidth = (uint32_t)width;
+		mHeight = rows;
+		return true;
+	}
+	return false;
+}
+
+void ImageFile::ReadRGBA(uint8_t* rgba, size_t rowPitch) const
+{
+	uint8_t alphaBits = 0;
+	for (uint32_t y = 0; y < mHeight; ++y)
+	{
+		const uint8_t* src = mPixels + mRowStride * (ptrdiff_t)y;
+		uint8_t* dst = rgba + rowPitch * y;
+		alphaBits |= PixelConvert::ToRGBA8(mSource, src, dst, mWidth);
+	}
+
+	// Most 32 bit BMP writers leave the fourth byte at zero; that means opaque.
+	if (mSource == PixelConvert::Source::BGRA8 && alphaBits == 0)
+	{
+		for (uint32_t y = 0; y < mHeight; ++y)
+		{
+			uint8_t* dst = rgba + rowPitch * y;
+			for (uint32_t x = 0; x < mWidth; ++x)
+				dst[x * 4 + 3] = 255;
+		}
+	}
+}
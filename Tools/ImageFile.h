@@ -0,0 +1,34 @@
+#pragma once
+#include "MappedFile.h"
+#include "PixelConvert.h"
+#include <cstddef>
+#include <cstdint>
+
+// Uncompressed source images: binary PPM (P6, maxval 255) and BMP (BI_RGB, 24 or
+// 32 bit, bottom-up or top-down). The file is mapped once and the header parsed
+// once; ReadRGBA then expands straight from the mapping into the destination, so
+// a mapped staging buffer or linear image takes the pixels without a copy.
+// Only depends on the standard library.
+class ImageFile
+{
+public:
+	bool Open(const char* fileName);
+	// Parses an image already in memory; data must outlive the ImageFile.
+	bool Parse(const uint8_t* data, size_t size);
+
+	uint32_t GetWidth() const { return mWidth; }
+	uint32_t GetHeight() const { return mHeight; }
+
+	// Writes RGBA8 rows rowPitch bytes apart, top row first. Alpha is 255 except
+	// for 32 bit BMPs that store any alpha at all.
+	void ReadRGBA(uint8_t* rgba, size_t rowPitch) const;
+
+private:
+	MappedFile mFile;
+	const uint8_t* mPixels = nullptr;
+	// Signed: BMPs stored bottom-up step backwards.
+	ptrdiff_t mRowStride = 0;
+	PixelConvert::Source mSource = PixelConvert::Source::RGB8;
+	uint32_t mWidth = 0;
+	uint32_t mHeight = 0;
+};
@@ -0,0 +1,75 @@
+#include "IndirectDrawBuilder.h"
+#include <algorithm>
+#include <cmath>
+
+void IndirectDrawBuilder::Build(const std::vector<Item>& items, const float (*planes)[4], size_t planeCount)
+{
+	// Normalized, so plane distances compare against the radius.
+	mPlanes.clear();
+	for (size_t i = 0; i < planeCount; ++i)
+	{
+		float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+		if (length == 0.0f)
+			continue;
+		for (int j = 0; j < 4; ++j)
+			mPlanes.push_back(planes[i][j] / length);
+	}
+
+	mEntries.clear();
+	mCulled = 0;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const Item& item = items[i];
+		bool inside = true;
+		for (size_t p = 0; p < mPlanes.size() && inside; p += 4)
+		{
+			float distance = mPlanes[p] * item.Center[0] + mPlanes[p + 1] * item.Center[1] +
+				mPlanes[p + 2] * item.Center[2] + mPlanes[p + 3];
+			inside = distance >= -item.Radius;
+		}
+		if (!inside)
+		{
+			++mCulled;
+			continue;
+		}
+		Entry entry;
+		entry.Key = (uint64_t)item.Group << 32 | item.SortKey;
+		entry.Index = (uint32_t)i;
+		mEntries.push_back(entry);
+	}
+
+	// The index breaks ties, so equal keys keep the order they were given in.
+	std::sort(mEntries.begin(), mEntries.end(), [](const Entry& a, const Entry& b)
+	{
+		return a.Key != b.Key ? a.Key < b.Key : a.Index < b.Index;
+	});
+
+	mOrder.resize(mEntries.size());
+	mRanges.clear();
+	for (size_t i = 0; i < mEntries.size(); ++i)
+	{
+		mOrder[i] = mEntries[i].Index;
+		uint32_t group = (uint32_t)(mEntries[i].Key >> 32);
+		if (mRanges.empty() || mRanges.back().Group != group)
+		{
+			Range range = { group, (uint32_t)i, 0 };
+			mRanges.push_back(range);
+		}
+		++mRanges.back().Count;
+	}
+}
+
+void IndirectDrawBuilder::ExtractFrustumPlanes(const float m[4][4], float planes[6][4])
+{
+	// Clip coordinates are v * m, so each plane is a combination of columns:
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+	for (int r = 0; r < 4; ++r)
+	{
+		planes[0][r] = m[r][3] + m[r][0];
+		planes[1][r] = m[r][3] - m[r][0];
+		planes[2][r] = m[r][3] + m[r][1];
+		planes[3][r] = m[r][3] - m[r][1];
+		planes[4][r] = m[r][2];
+		planes[5][r] = m[r][3] - m[r][2];
+	}
+}
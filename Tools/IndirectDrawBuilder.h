@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decides what an indirect argument buffer holds and in what order. Items whose
+// bounding sphere is outside the view are dropped; the rest are sorted by group,
+// then by sort key, and packed so every group is one contiguous range that a
+// single ExecuteIndirect covers. The caller writes one argument record per
+// entry of GetOrder. Works on plain numbers only, so it can be tested and timed
+// on its own, and a GPU culling pass filling the same buffer can be checked
+// against it. Only depends on the standard library.
+class IndirectDrawBuilder
+{
+public:
+	struct Item
+	{
+		// Items of a group can share an ExecuteIndirect: same PSO and topology.
+		uint32_t Group;
+		// Order within the group, e.g. by mesh or front to back.
+		uint32_t SortKey;
+		float Center[3];
+		float Radius;
+	};
+
+	struct Range
+	{
+		uint32_t Group;
+		// Into GetOrder.
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	// planes holds planeCount planes (a, b, c, d), inside where
+	// a*x + b*y + c*z + d >= 0; they need not be normalized. Without planes
+	// nothing is culled.
+	void Build(const std::vector<Item>& items, const float (*planes)[4], size_t planeCount);
+
+	// Indices into the items given to Build, in draw order.
+	const std::vector<uint32_t>& GetOrder() const { return mOrder; }
+	const std::vector<Range>& GetRanges() const { return mRanges; }
+	size_t GetCulledCount() const { return mCulled; }
+
+	// The six planes of the frustum of a row vector (v * m) view projection
+	// matrix with depth in [0, 1], as D3D uses.
+	static void ExtractFrustumPlanes(const float m[4][4], float planes[6][4]);
+
+private:
+	struct Entry
+	{
+		uint64_t Key;
+		uint32_t Index;
+	};
+
+	// Kept between builds so a steady scene does not allocate.
+	std::vector<Entry> mEntries;
+	std::vector<uint32_t> mOrder;
+	std::vector<Range> mRanges;
+	std::vector<float> mPlanes;
+	size_t mCulled = 0;
+};
@@ -0,0 +1,297 @@
+#include "JobSystem.h"
+
+// The participant the current thread is, valid while sJobSystem matches.
+static thread_local const JobSystem* sJobSystem = nullptr;
+static thread_local size_t sParticipant = 0;
+
+JobSystem::Deque::Deque()
+	: mTop(0), mBottom(0)
+{
+	for (auto& job : mJobs)
+		job.store(nullptr, std::memory_order_relaxed);
+}
+
+bool JobSystem::Deque::Push(Job* job)
+{
+	int64_t bottom = mBottom.load(std::memory_order_relaxed);
+	int64_t top = mTop.load(std::memory_order_acquire);
+	if (bottom - top >= (int64_t)Capacity)
+		return false;
+	mJobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	mBottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+JobSystem::Job* JobSystem::Deque::Pop()
+{
+	int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+	mBottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = mTop.load(std::memory_order_relaxed);
+	if (top > bottom)
+	{
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	Job* job = mJobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// The last job: race the thieves for it through top.
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobSystem::Job* JobSystem::Deque::Steal()
+{
+	int64_t top = mTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = mBottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return nullptr;
+	Job* job = mJobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+JobSystem::JobSystem()
+	: mQueued(0), mSleeping(0), mStopping(false), mSteals(0)
+{
+
+}
+
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+size_t JobSystem::GetDefaultThreadCount()
+{
+	size_t cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 1;
+}
+
+void JobSystem::Start(size_t threadCount)
+{
+	Stop();
+	mStopping = false;
+	mSteals = 0;
+	for (size_t i = 0; i <= threadCount; ++i)
+		mDeques.push_back(std::unique_ptr<Deque>(new Deque()));
+	sJobSystem = this;
+	sParticipant = 0;
+	for (size_t i = 1; i <= threadCount; ++i)
+		mThreads.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+}
+
+void JobSystem::Stop()
+{
+	if (mDeques.empty())
+		return;
+	// The caller's deque is only drained by its owner or by thieves; empty it
+	// here so no job is left behind once the workers are gone.
+	while (Job* job = FindJob(GetParticipant()))
+		Execute(job);
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mStopping = true;
+	}
+	mWake.notify_all();
+	for (auto& thread : mThreads)
+		thread.join();
+	mThreads.clear();
+	mDeques.clear();
+	if (sJobSystem == this)
+		sJobSystem = nullptr;
+}
+
+size_t JobSystem::GetParticipant() const
+{
+	return sJobSystem == this ? sParticipant : mDeques.size();
+}
+
+void JobSystem::Run(Task task, Counter* counter)
+{
+	if (counter)
+		counter->mPending.fetch_add(1);
+	Schedule(std::move(task), counter);
+}
+
+void JobSystem::RunAfter(Counter& dependency, Task task, Counter* counter)
+{
+	if (counter)
+		counter->mPending.fetch_add(1);
+	{
+		// Finish takes the last count under this lock, so the continuation is
+		// either queued here or picked up there, never both.
+		std::lock_guard<std::mutex> lock(dependency.mMutex);
+		if (dependency.mPending.load() != 0)
+		{
+			dependency.mContinuations.push_back({ std::move(task), counter });
+			return;
+		}
+	}
+	Schedule(std::move(task), counter);
+}
+
+void JobSystem::Schedule(Task task, Counter* counter)
+{
+	if (mThreads.empty())
+	{
+		task();
+		Finish(counter);
+		return;
+	}
+
+	Job* job = new Job{ std::move(task), counter };
+	mQueued.fetch_add(1);
+	size_t self = GetParticipant();
+	if (self < mDeques.size())
+	{
+		if (!mDeques[self]->Push(job))
+		{
+			mQueued.fetch_sub(1);
+			Execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(mInjectMutex);
+		mInjected.push_back(job);
+	}
+	if (mSleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mWake.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::FindJob(size_t self)
+{
+	Job* job = self < mDeques.size() ? mDeques[self]->Pop() : nullptr;
+	if (job == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mInjectMutex);
+		if (!mInjected.empty())
+		{
+			job = mInjected.back();
+			mInjected.pop_back();
+		}
+	}
+	// Start with the next participant so thieves spread over the victims.
+	for (size_t i = 1; job == nullptr && i <= mDeques.size(); ++i)
+	{
+		size_t victim = (self + i) % mDeques.size();
+		if (victim == self)
+			continue;
+		job = mDeques[victim]->Steal();
+		if (job)
+			mSteals.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (job)
+		mQueued.fetch_sub(1);
+	return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->Work();
+	Finish(job->Signal);
+	delete job;
+}
+
+void JobSystem::Finish(Counter* counter)
+{
+	if (counter == nullptr)
+		return;
+	int pending = counter->mPending.load();
+	while (pending > 1)
+	{
+		if (counter->mPending.compare_exchange_weak(pending, pending - 1))
+			return;
+	}
+
+	// The last count is dropped under the lock, and Wait takes the lock before
+	// returning, so the counter is not touched after its owner moves on.
+	std::vector<Counter::Continuation> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->mMutex);
+		if (counter->mPending.fetch_sub(1) == 1)
+			continuations.swap(counter->mContinuations);
+	}
+	for (auto& continuation : continuations)
+		Schedule(std::move(continuation.Work), continuation.Signal);
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+	size_t self = GetParticipant();
+	while (counter.mPending.load() != 0)
+	{
+		if (Job* job = FindJob(self))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> lock(counter.mMutex);
+}
+
+void JobSystem::SplitRange(size_t begin, size_t end, size_t grain, const RangeTask* body, Counter* counter)
+{
+	while (end - begin > grain)
+	{
+		size_t middle = begin + (end - begin) / 2;
+		Run([=]() { SplitRange(middle, end, grain, body, counter); }, counter);
+		end = middle;
+	}
+	(*body)(begin, end);
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, const RangeTask& body)
+{
+	if (begin >= end)
+		return;
+	if (grain == 0)
+		grain = 1;
+	if (end - begin <= grain || mThreads.empty())
+	{
+		body(begin, end);
+		return;
+	}
+	Counter counter;
+	SplitRange(begin, end, grain, &body, &counter);
+	Wait(counter);
+}
+
+void JobSystem::WorkerMain(size_t index)
+{
+	sJobSystem = this;
+	sParticipant = index;
+	for (;;)
+	{
+		Job* job = FindJob(index);
+		for (int spin = 0; job == nullptr && spin < 64; ++spin)
+		{
+			std::this_thread::yield();
+			job = FindJob(index);
+		}
+		if (job)
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mSleeping.fetch_add(1);
+		mWake.wait(lock, [this]() { return mStopping.load() || mQueued.load() > 0; });
+		mSleeping.fetch_sub(1);
+		// Stop drained the caller's deque first; leave once nothing is queued.
+		if (mStopping.load() && mQueued.load() <= 0)
+			return;
+	}
+}
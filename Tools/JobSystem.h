@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing scheduler for per frame work. Every worker, and the thread that
+// called Start, owns a Chase-Lev deque: it pushes and pops jobs at the bottom
+// without locks while idle workers steal from the top. Dependencies are
+// counters with continuations rather than fibers; a thread that waits on a
+// counter keeps running jobs until it drops to zero, so waiting inside a job
+// cannot deadlock. Jobs must not throw. Only depends on the standard library.
+class JobSystem
+{
+public:
+	typedef std::function<void()> Task;
+	typedef std::function<void(size_t begin, size_t end)> RangeTask;
+
+	// Jobs run against a counter add one to it and take one away when they
+	// finish. Tasks passed to RunAfter start once it reaches zero. A counter
+	// must outlive its jobs and continuations; once Wait on it returns nothing
+	// touches it any more.
+	class Counter
+	{
+	public:
+		Counter() : mPending(0) {}
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+	private:
+		friend class JobSystem;
+		struct Continuation
+		{
+			Task Work;
+			Counter* Signal;
+		};
+		std::atomic<int> mPending;
+		std::mutex mMutex;
+		std::vector<Continuation> mContinuations;
+	};
+
+	JobSystem();
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// The calling thread becomes a participant next to threadCount workers and
+	// must be the one that calls Stop. 0 workers runs everything on the caller.
+	void Start(size_t threadCount);
+	// Runs what is still queued, then joins the workers.
+	void Stop();
+
+	void Run(Task task, Counter* counter = nullptr);
+	// task is queued once every job counted by dependency has finished.
+	void RunAfter(Counter& dependency, Task task, Counter* counter = nullptr);
+	// Runs queued jobs until counter reaches zero.
+	void Wait(Counter& counter);
+	// Splits [begin, end) in halves down to grain sized ranges, the upper
+	// half of each split left for thieves, and waits for all of them.
+	// Ranges no larger than grain run inline without touching the queues.
+	void ParallelFor(size_t begin, size_t end, size_t grain, const RangeTask& body);
+
+	size_t GetThreadCount() const { return mThreads.size(); }
+	// Workers plus the thread that called Start.
+	size_t GetParticipantCount() const { return mDeques.size(); }
+	// Index of the calling thread among the participants, or
+	// GetParticipantCount() for any other thread. Lets a job pick per thread data.
+	size_t GetParticipant() const;
+	// Jobs taken from another participant's deque.
+	size_t GetStealCount() const { return mSteals.load(); }
+	// One worker per core minus the caller's.
+	static size_t GetDefaultThreadCount();
+
+private:
+	struct Job
+	{
+		Task Work;
+		Counter* Signal;
+	};
+
+	// Chase-Lev deque of fixed capacity, after "Correct and Efficient
+	// Work-Stealing for Weak Memory Models" (Le et al. 2013). Push and Pop are
+	// owner only; Steal may be called from any thread.
+	class Deque
+	{
+	public:
+		static const size_t Capacity = 4096;
+		Deque();
+		// False when full; the caller then runs the job itself.
+		bool Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+
+	private:
+		std::atomic<int64_t> mTop;
+		std::atomic<int64_t> mBottom;
+		std::atomic<Job*> mJobs[Capacity];
+	};
+
+	// Queues task without counting it; Run and RunAfter count it first.
+	void Schedule(Task task, Counter* counter);
+	Job* FindJob(size_t self);
+	void Execute(Job* job);
+	void Finish(Counter* counter);
+	void SplitRange(size_t begin, size_t end, size_t grain, const RangeTask* body, Counter* counter);
+	void WorkerMain(size_t index);
+
+	std::vector<std::unique_ptr<Deque>> mDeques;
+	std::vector<std::thread> mThreads;
+	// Jobs queued from threads that are not participants.
+	std::mutex mInjectMutex;
+	std::vector<Job*> mInjected;
+	// Sleeping workers are woken on push; mQueued closes the gap between a
+	// worker's last look and its wait.
+	std::mutex mSleepMutex;
+	std::condition_variable mWake;
+	std::atomic<int> mQueued;
+	std::atomic<int> mSleeping;
+	std::atomic<bool> mStopping;
+	std::atomic<size_t> mSteals;
+};
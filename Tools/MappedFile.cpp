@@ -0,0 +1,118 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	return Map(file);
+}
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	Close();
+	HANDLE file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	return Map(file);
+}
+
+bool MappedFile::Map(void* file)
+{
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	// Empty files cannot be mapped.
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file.
+	mMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mMapping == nullptr)
+		return false;
+
+	mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if (mData == nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+		return false;
+	}
+	mSize = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	mData = nullptr;
+	mMapping = nullptr;
+	mSize = 0;
+}
+
+#else
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor is closed.
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	// Loaders walk the file front to back exactly once.
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+	mData = static_cast<const uint8_t*>(data);
+	mSize = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData)
+		munmap(const_cast<uint8_t*>(mData), mSize);
+	mData = nullptr;
+	mSize = 0;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file. Pages are faulted in from the file
+// cache on first touch instead of being copied into a heap buffer up front, so
+// loading a texture only ever touches the bytes that get copied to the GPU.
+// Win32 uses CreateFileMapping/MapViewOfFile, everything else open/mmap.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* fileName);
+#ifdef _WIN32
+	bool Open(const wchar_t* fileName);
+#endif
+	void Close();
+
+	bool IsOpen() const { return mData != nullptr; }
+	const uint8_t* GetData() const { return mData; }
+	size_t GetSize() const { return mSize; }
+
+private:
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+#ifdef _WIN32
+	bool Map(void* file);
+	void* mMapping = nullptr;
+#endif
+};
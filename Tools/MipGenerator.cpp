@@ -0,0 +1,365 @@
+#include "MipGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2 1
+#endif
+
+static const float KaiserWidth = 3.0f;
+static const float KaiserAlpha = 4.0f;
+static const float Pi = 3.14159265358979f;
+
+// Linear float RGBA image, four floats per texel.
+struct FloatImage
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	std::vector<float> Texels;
+
+	void Resize(uint32_t width, uint32_t height)
+	{
+		Width = width;
+		Height = height;
+		Texels.resize((size_t)width * height * 4);
+	}
+	float* Row(uint32_t y) { return Texels.data() + (size_t)y * Width * 4; }
+	const float* Row(uint32_t y) const { return Texels.data() + (size_t)y * Width * 4; }
+};
+
+// Per destination texel: Taps clamped source indices and their weights.
+struct FilterTable
+{
+	int Taps = 0;
+	std::vector<uint32_t> Index;
+	std::vector<float> Weight;
+};
+
+struct ColorTables
+{
+	float ByteToLinear[256];
+	float SrgbToLinear[256];
+	// Linear light quantized to 12 bits, straight to an sRGB byte.
+	uint8_t LinearToSrgb[4096];
+
+	ColorTables()
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			float c = i / 255.0f;
+			ByteToLinear[i] = c;
+			SrgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; ++i)
+		{
+			float c = i / 4095.0f;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			LinearToSrgb[i] = (uint8_t)std::min(255.0f, s * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const ColorTables& GetColorTables()
+{
+	static const ColorTables tables;
+	return tables;
+}
+
+static float BesselI0(float x)
+{
+	// Power series, converges fast for the small arguments a Kaiser window uses.
+	float sum = 1.0f;
+	float term = 1.0f;
+	float half = x * 0.5f;
+	for (int k = 1; k < 32; ++k)
+	{
+		term *= (half / k) * (half / k);
+		sum += term;
+		if (term < sum * 1e-7f)
+			break;
+	}
+	return sum;
+}
+
+static float Kaiser(float t)
+{
+	float x = std::fabs(t);
+	if (x >= KaiserWidth)
+		return 0.0f;
+	float sinc = x < 1e-5f ? 1.0f : std::sin(Pi * x) / (Pi * x);
+	float r = x / KaiserWidth;
+	return sinc * BesselI0(KaiserAlpha * std::sqrt(1.0f - r * r)) / BesselI0(KaiserAlpha);
+}
+
+static void BuildFilterTable(uint32_t srcSize, uint32_t dstSize, MipGenerator::Filter filter, FilterTable& table)
+{
+	float scale = (float)srcSize / dstSize;
+	float radius = filter == MipGenerator::Filter::Box ? 0.5f * scale : KaiserWidth * scale;
+	table.Taps = (int)std::ceil(2.0f * radius) + 1;
+	table.Index.assign((size_t)dstSize * table.Taps, 0);
+	table.Weight.assign((size_t)dstSize * table.Taps, 0.0f);
+
+	for (uint32_t x = 0; x < dstSize; ++x)
+	{
+		float center = (x + 0.5f) * scale;
+		int first = (int)std::floor(center - radius);
+		float sum = 0.0f;
+		for (int k = 0; k < table.Taps; ++k)
+		{
+			int j = first + k;
+			float w;
+			if (filter == MipGenerator::Filter::Box)
+			{
+				// Overlap of texel [j, j+1) with the footprint [x*scale, (x+1)*scale).
+				float lo = std::max((float)j, x * scale);
+				float hi = std::min((float)(j + 1), (x + 1) * scale);
+				w = std::max(0.0f, hi - lo);
+			}
+			else
+			{
+				w = Kaiser((j + 0.5f - center) / scale);
+			}
+			size_t slot = (size_t)x * table.Taps + k;
+			table.Index[slot] = (uint32_t)std::min(std::max(j, 0), (int)srcSize - 1);
+			table.Weight[slot] = w;
+			sum += w;
+		}
+		for (int k = 0; k < table.Taps; ++k)
+			table.Weight[(size_t)x * table.Taps + k] /= sum;
+	}
+}
+
+static void Downsample(const FloatImage& src, FloatImage& dst, uint32_t width, uint32_t height,
+	MipGenerator::Filter filter, FloatImage& scratch)
+{
+	FilterTable horizontal, vertical;
+	BuildFilterTable(src.Width, width, filter, horizontal);
+	BuildFilterTable(src.Height, height, filter, vertical);
+
+	// Horizontal pass: src.Height rows of the new width.
+	scratch.Resize(width, src.Height);
+	for (uint32_t y = 0; y < src.Height; ++y)
+	{
+		const float* in = src.Row(y);
+		float* out = scratch.Row(y);
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint32_t* index = &horizontal.Index[(size_t)x * horizontal.Taps];
+			const float* weight = &horizontal.Weight[(size_t)x * horizontal.Taps];
+#ifdef MIP_GENERATOR_SSE2
+			__m128 acc = _mm_setzero_ps();
+			for (int k = 0; k < horizontal.Taps; ++k)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weight[k]), _mm_loadu_ps(in + index[k] * 4)));
+			_mm_storeu_ps(out + x * 4, acc);
+#else
+			float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < horizontal.Taps; ++k)
+			{
+				const float* texel = in + index[k] * 4;
+				for (int c = 0; c < 4; ++c)
+					acc[c] += weight[k] * texel[c];
+			}
+			memcpy(out + x * 4, acc, sizeof(acc));
+#endif
+		}
+	}
+
+	// Vertical pass walks whole rows so every tap streams through memory.
+	dst.Resize(width, height);
+	std::vector<const float*> rows(vertical.Taps);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint32_t* index = &vertical.Index[(size_t)y * vertical.Taps];
+		const float* weight = &vertical.Weight[(size_t)y * vertical.Taps];
+		for (int k = 0; k < vertical.Taps; ++k)
+			rows[k] = scratch.Row(index[k]);
+
+		float* out = dst.Row(y);
+		for (uint32_t x = 0; x < width * 4; x += 4)
+		{
+#ifdef MIP_GENERATOR_SSE2
+			__m128 acc = _mm_setzero_ps();
+			for (int k = 0; k < vertical.Taps; ++k)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weight[k]), _mm_loadu_ps(rows[k] + x)));
+			_mm_storeu_ps(out + x, acc);
+#else
+			float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < vertical.Taps; ++k)
+			{
+				for (int c = 0; c < 4; ++c)
+					acc[c] += weight[k] * rows[k][x + c];
+			}
+			memcpy(out + x, acc, sizeof(acc));
+#endif
+		}
+	}
+}
+
+static float ComputeCoverage(const FloatImage& image, float alphaScale, float reference)
+{
+	size_t count = (size_t)image.Width * image.Height;
+	size_t passed = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (image.Texels[i * 4 + 3] * alphaScale > reference)
+			++passed;
+	}
+	return (float)passed / count;
+}
+
+// Scale for this level's alpha so its coverage matches the target.
+static float FindAlphaScale(const FloatImage& image, float targetCoverage, float reference)
+{
+	float lo = 0.0f;
+	float hi = 4.0f;
+	for (int i = 0; i < 12; ++i)
+	{
+		float mid = 0.5f * (lo + hi);
+		if (ComputeCoverage(image, mid, reference) < targetCoverage)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return 0.5f * (lo + hi);
+}
+
+static void Quantize(const FloatImage& image, bool srgb, float alphaScale, MipLevel& level)
+{
+	const ColorTables& tables = GetColorTables();
+	level.Width = image.Width;
+	level.Height = image.Height;
+	level.Pixels.resize((size_t)image.Width * image.Height * 4);
+
+	size_t count = (size_t)image.Width * image.Height;
+	const float* in = image.Texels.data();
+	uint8_t* out = level.Pixels.data();
+#ifdef MIP_GENERATOR_SSE2
+	// sRGB: RGB go to 12 bit table indices, alpha stays linear in bytes.
+	const __m128 scale = srgb ? _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f * alphaScale)
+		: _mm_setr_ps(255.0f, 255.0f, 255.0f, 255.0f * alphaScale);
+	const __m128 limit = srgb ? _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f) : _mm_set1_ps(255.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (size_t i = 0; i < count; ++i)
+	{
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i * 4), scale), half);
+		v = _mm_min_ps(_mm_max_ps(v, zero), limit);
+		__m128i q = _mm_cvttps_epi32(v);
+		if (srgb)
+		{
+			alignas(16) int32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), q);
+			out[i * 4 + 0] = tables.LinearToSrgb[lanes[0]];
+			out[i * 4 + 1] = tables.LinearToSrgb[lanes[1]];
+			out[i * 4 + 2] = tables.LinearToSrgb[lanes[2]];
+			out[i * 4 + 3] = (uint8_t)lanes[3];
+		}
+		else
+		{
+			q = _mm_packs_epi32(q, q);
+			q = _mm_packus_epi16(q, q);
+			int32_t packed = _mm_cvtsi128_si32(q);
+			memcpy(out + i * 4, &packed, 4);
+		}
+	}
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			float v = in[i * 4 + c];
+			if (c == 3)
+				v *= alphaScale;
+			v = std::min(std::max(v, 0.0f), 1.0f);
+			if (srgb && c < 3)
+				out[i * 4 + c] = tables.LinearToSrgb[(int)(v * 4095.0f + 0.5f)];
+			else
+				out[i * 4 + c] = (uint8_t)(v * 255.0f + 0.5f);
+		}
+	}
+#endif
+}
+
+uint32_t MipGenerator::GetMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+		++count;
+	}
+	return count;
+}
+
+bool MipGenerator::IsAlphaTested(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch)
+{
+	size_t binary = 0;
+	size_t transparent = 0;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* row = rgba + y * rowPitch;
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t a = row[x * 4 + 3];
+			if (a == 0 || a == 255)
+				++binary;
+			if (a < 128)
+				++transparent;
+		}
+	}
+	size_t count = (size_t)width * height;
+	return transparent > 0 && binary * 10 >= count * 9;
+}
+
+void MipGenerator::Generate(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch,
+	const Options& options, std::vector<MipLevel>& levels)
+{
+	uint32_t mipCount = GetMipCount(width, height);
+	if (options.MaxLevels != 0)
+		mipCount = std::min(mipCount, options.MaxLevels);
+	levels.resize(mipCount);
+
+	// Level 0 is the source as is.
+	levels[0].Width = width;
+	levels[0].Height = height;
+	levels[0].Pixels.resize((size_t)width * height * 4);
+	for (uint32_t y = 0; y < height; ++y)
+		memcpy(&levels[0].Pixels[(size_t)y * width * 4], rgba + y * rowPitch, (size_t)width * 4);
+	if (mipCount == 1)
+		return;
+
+	const ColorTables& tables = GetColorTables();
+	const float* rgbTable = options.SRGB ? tables.SrgbToLinear : tables.ByteToLinear;
+	FloatImage current;
+	current.Resize(width, height);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* in = rgba + y * rowPitch;
+		float* out = current.Row(y);
+		for (uint32_t x = 0; x < width * 4; x += 4)
+		{
+			out[x + 0] = rgbTable[in[x + 0]];
+			out[x + 1] = rgbTable[in[x + 1]];
+			out[x + 2] = rgbTable[in[x + 2]];
+			out[x + 3] = tables.ByteToLinear[in[x + 3]];
+		}
+	}
+
+	float targetCoverage = options.PreserveAlphaCoverage
+		? ComputeCoverage(current, 1.0f, options.AlphaReference) : 0.0f;
+
+	FloatImage next, scratch;
+	for (uint32_t mip = 1; mip < mipCount; ++mip)
+	{
+		Downsample(current, next, std::max(1u, current.Width / 2), std::max(1u, current.Height / 2),
+			options.Kernel, scratch);
+		std::swap(current, next);
+
+		float alphaScale = options.PreserveAlphaCoverage
+			? FindAlphaScale(current, targetCoverage, options.AlphaReference) : 1.0f;
+		Quantize(current, options.SRGB, alphaScale, levels[mip]);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One level of a generated chain, RGBA8 with tight rows.
+struct MipLevel
+{
+	uint32_t Width;
+	uint32_t Height;
+	std::vector<uint8_t> Pixels;
+};
+
+// Builds a full mip chain for an RGBA8 image on the CPU. Filtering runs on
+// linear float RGBA, one SSE register per pixel where SSE2 is available and in
+// plain C++ otherwise, so the results only differ by float rounding. Every level
+// is filtered from the unquantized level above it.
+//
+// sRGB images are decoded to linear light before filtering and encoded again on
+// output. With alpha coverage preservation each level's alpha is scaled so the
+// fraction of texels passing AlphaReference matches level 0, which keeps alpha
+// tested foliage and fences from thinning out in the distance.
+class MipGenerator
+{
+public:
+	enum class Filter
+	{
+		// Exact area average, also for odd sizes.
+		Box,
+		// Kaiser windowed sinc, 3 lobes. Sharper, costs about three times as much.
+		Kaiser,
+	};
+
+	struct Options
+	{
+		Filter Kernel = Filter::Kaiser;
+		bool SRGB = false;
+		bool PreserveAlphaCoverage = false;
+		float AlphaReference = 0.5f;
+		// Stops the chain early; 0 goes down to 1x1.
+		uint32_t MaxLevels = 0;
+	};
+
+	// Levels down to 1x1.
+	static uint32_t GetMipCount(uint32_t width, uint32_t height);
+	// True when almost every alpha value is 0 or 255, which is what alpha tested
+	// textures look like; those want PreserveAlphaCoverage.
+	static bool IsAlphaTested(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch);
+
+	// Fills levels with the chain, levels[0] being a copy of the source.
+	static void Generate(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch,
+		const Options& options, std::vector<MipLevel>& levels);
+};
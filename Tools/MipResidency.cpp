@@ -0,0 +1,170 @@
+#include "MipResidency.h"
+#include <algorithm>
+#include <cmath>
+
+float MipResidency::ComputeDesiredMip(float texelsAcross, float pixelsAcross)
+{
+	if (pixelsAcross <= 0.0f)
+		return 1e9f;
+	if (texelsAcross <= pixelsAcross)
+		return 0.0f;
+	return std::log2(texelsAcross / pixelsAcross);
+}
+
+int MipResidency::AddTexture(const uint64_t* mipBytes, uint32_t mipCount, uint32_t tailMip)
+{
+	int id;
+	if (!mFreeIds.empty())
+	{
+		id = mFreeIds.back();
+		mFreeIds.pop_back();
+	}
+	else
+	{
+		id = (int)mTextures.size();
+		mTextures.push_back(Entry());
+	}
+
+	Entry& e = mTextures[id];
+	e = Entry();
+	e.Used = true;
+	e.MipCount = mipCount;
+	e.TailMip = std::min(tailMip, mipCount - 1);
+	e.ResidentMip = e.TailMip;
+	e.WantedMip = e.TailMip;
+	e.LastUsedFrame = mFrame;
+	e.BytesFrom.assign(mipCount + 1, 0);
+	for (uint32_t i = mipCount; i-- > 0;)
+		e.BytesFrom[i] = e.BytesFrom[i + 1] + mipBytes[i];
+
+	mResidentBytes += BytesAt(e, e.ResidentMip);
+	return id;
+}
+
+void MipResidency::RemoveTexture(int id)
+{
+	Entry& e = mTextures[id];
+	if (!e.Used)
+		return;
+	mResidentBytes -= BytesAt(e, e.ResidentMip);
+	e = Entry();
+	mFreeIds.push_back(id);
+}
+
+void MipResidency::BeginFrame(uint64_t frame)
+{
+	mFrame = frame;
+	for (auto& e : mTextures)
+		e.WantedMip = e.TailMip;
+}
+
+void MipResidency::Request(int id, float desiredMip)
+{
+	Entry& e = mTextures[id];
+	uint32_t mip = desiredMip <= 0.0f ? 0 : (uint32_t)std::min(std::floor(desiredMip), (float)e.TailMip);
+	e.WantedMip = std::min(e.WantedMip, mip);
+	e.LastUsedFrame = mFrame;
+}
+
+void MipResidency::OnStreamed(int id, uint32_t residentMip)
+{
+	SetResident(id, residentMip);
+	mTextures[id].Pending = false;
+}
+
+void MipResidency::SetResident(int id, uint32_t mip)
+{
+	Entry& e = mTextures[id];
+	mResidentBytes -= BytesAt(e, e.ResidentMip);
+	mResidentBytes += BytesAt(e, mip);
+	e.ResidentMip = mip;
+}
+
+bool MipResidency::MakeRoom(uint64_t need, int loadingId, std::vector<Action>& actions, uint32_t& budgetActions)
+{
+	// Textures nobody used this frame go first, oldest first; textures that hold more
+	// detail than this frame asked for come after them. Ties break on id.
+	std::vector<int> victims;
+	for (int id = 0; id < (int)mTextures.size(); ++id)
+	{
+		const Entry& e = mTextures[id];
+		if (!e.Used || e.Pending || id == loadingId || e.ResidentMip >= e.TailMip)
+			continue;
+		if (e.LastUsedFrame < mFrame || e.ResidentMip < e.WantedMip)
+			victims.push_back(id);
+	}
+	std::sort(victims.begin(), victims.end(), [this](int a, int b)
+	{
+		const Entry& ea = mTextures[a];
+		const Entry& eb = mTextures[b];
+		if (ea.LastUsedFrame != eb.LastUsedFrame)
+			return ea.LastUsedFrame < eb.LastUsedFrame;
+		return a < b;
+	});
+
+	for (int id : victims)
+	{
+		if (mResidentBytes + need <= mBudget || budgetActions == 0)
+			break;
+
+		Entry& e = mTextures[id];
+		uint32_t target = e.LastUsedFrame < mFrame ? e.TailMip : e.WantedMip;
+		SetResident(id, target);
+		e.Pending = true;
+		actions.push_back({ id, target, true });
+		--budgetActions;
+	}
+	return mResidentBytes + need <= mBudget;
+}
+
+void MipResidency::Update(std::vector<Action>& actions)
+{
+	actions.clear();
+	uint32_t budgetActions = mMaxActions;
+
+	// Biggest quality gap first, ties break on id.
+	std::vector<int> loads;
+	for (int id = 0; id < (int)mTextures.size(); ++id)
+	{
+		const Entry& e = mTextures[id];
+		if (e.Used && !e.Pending && e.WantedMip < e.ResidentMip)
+			loads.push_back(id);
+	}
+	std::sort(loads.begin(), loads.end(), [this](int a, int b)
+	{
+		uint32_t gapA = mTextures[a].ResidentMip - mTextures[a].WantedMip;
+		uint32_t gapB = mTextures[b].ResidentMip - mTextures[b].WantedMip;
+		if (gapA != gapB)
+			return gapA > gapB;
+		return a < b;
+	});
+
+	for (int id : loads)
+	{
+		if (budgetActions == 0)
+			break;
+
+		Entry& e = mTextures[id];
+		uint32_t target = e.WantedMip;
+		uint64_t need = BytesAt(e, target) - BytesAt(e, e.ResidentMip);
+		if (mResidentBytes + need > mBudget && !MakeRoom(need, id, actions, budgetActions))
+		{
+			// Not everything fits: take the most detailed mip that does.
+			while (target < e.ResidentMip && mResidentBytes + BytesAt(e, target) - BytesAt(e, e.ResidentMip) > mBudget)
+				++target;
+			if (target == e.ResidentMip)
+				continue;
+		}
+		if (budgetActions == 0)
+			break;
+
+		SetResident(id, target);
+		e.Pending = true;
+		actions.push_back({ id, target, false });
+		--budgetActions;
+	}
+
+	// The budget may have been lowered underneath us.
+	if (mResidentBytes > mBudget)
+		MakeRoom(0, -1, actions, budgetActions);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Decides which mips of which streamed textures should be resident. Pure CPU
+// bookkeeping with no device or clock access: the same sequence of calls always
+// produces the same actions, so it can be driven by a test or a replay.
+//
+// A texture always keeps its mip tail [TailMip, MipCount). Everything above the
+// tail is streamed: each frame the renderer reports the most detailed mip it
+// wants per texture, Update turns that into load/evict actions that respect the
+// byte budget, evicting the least recently used textures first.
+class MipResidency
+{
+public:
+	struct Action
+	{
+		int Id;
+		// New most detailed resident mip.
+		uint32_t TargetMip;
+		// True when the texture gives memory back.
+		bool Evict;
+	};
+
+	// Mip a surface should sample at, from how many texels of it are spread across
+	// how many pixels on screen. 0 is full resolution.
+	static float ComputeDesiredMip(float texelsAcross, float pixelsAcross);
+
+	void SetBudget(uint64_t budgetBytes) { mBudget = budgetBytes; }
+	uint64_t GetBudget() const { return mBudget; }
+	void SetMaxActionsPerUpdate(uint32_t count) { mMaxActions = count; }
+
+	// mipBytes[i] is the size of mip i over all array slices. The texture starts
+	// with only its tail resident. Returns the id used by every other call.
+	int AddTexture(const uint64_t* mipBytes, uint32_t mipCount, uint32_t tailMip);
+	void RemoveTexture(int id);
+
+	void BeginFrame(uint64_t frame);
+	// Keeps the most detailed request of the frame.
+	void Request(int id, float desiredMip);
+	void Update(std::vector<Action>& actions);
+	// The action issued for id finished with residentMip actually resident (the
+	// target, or the previous mip if the load failed). It may be scheduled again.
+	void OnStreamed(int id, uint32_t residentMip);
+
+	uint32_t GetResidentMip(int id) const { return mTextures[id].ResidentMip; }
+	bool IsPending(int id) const { return mTextures[id].Pending; }
+	// Bytes of every resident mip, including work already scheduled.
+	uint64_t GetResidentBytes() const { return mResidentBytes; }
+
+private:
+	struct Entry
+	{
+		bool Used = false;
+		bool Pending = false;
+		uint32_t MipCount = 0;
+		uint32_t TailMip = 0;
+		uint32_t ResidentMip = 0;
+		// Requested this frame, TailMip when nobody asked.
+		uint32_t WantedMip = 0;
+		uint64_t LastUsedFrame = 0;
+		// Suffix sums: bytes of mips [i, MipCount).
+		std::vector<uint64_t> BytesFrom;
+	};
+
+	uint64_t BytesAt(const Entry& e, uint32_t mip) const { return e.BytesFrom[mip]; }
+	void SetResident(int id, uint32_t mip);
+	// Frees memory until need bytes fit, skipping the texture being loaded.
+	bool MakeRoom(uint64_t need, int loadingId, std::vector<Action>& actions, uint32_t& budgetActions);
+
+	std::vector<Entry> mTextures;
+	std::vector<int> mFreeIds;
+	uint64_t mBudget = 64ull * 1024 * 1024;
+	uint64_t mResidentBytes = 0;
+	uint64_t mFrame = 0;
+	uint32_t mMaxActions = 4;
+};
@@ -0,0 +1,282 @@
+#include "PixelConvert.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <tmmintrin.h>
+#define PIXEL_CONVERT_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PIXEL_CONVERT_SSSE3_FUNCTION
+#else
+#define PIXEL_CONVERT_SSSE3_FUNCTION __attribute__((target("ssse3")))
+#endif
+#endif
+
+// UNORM to UNORM8 with round to nearest, the same bytes a GPU fetch produces.
+static uint8_t Expand5(uint32_t v)
+{
+	return (uint8_t)((v * 527 + 23) >> 6);
+}
+
+static uint8_t Expand6(uint32_t v)
+{
+	return (uint8_t)((v * 259 + 33) >> 6);
+}
+
+static void ConvertScalar(PixelConvert::Source source, const uint8_t* src, uint8_t* dst, size_t pixels, uint8_t& alphaBits)
+{
+	typedef PixelConvert::Source Source;
+	for (size_t i = 0; i < pixels; ++i, dst += 4)
+	{
+		switch (source)
+		{
+		case Source::RGB8:
+		case Source::BGR8:
+		{
+			bool swap = source == Source::BGR8;
+			dst[0] = src[swap ? 2 : 0];
+			dst[1] = src[1];
+			dst[2] = src[swap ? 0 : 2];
+			dst[3] = 255;
+			src += 3;
+			break;
+		}
+		case Source::RGBX8:
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = 255;
+			src += 4;
+			break;
+		case Source::BGRX8:
+		case Source::BGRA8:
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+			dst[3] = source == Source::BGRA8 ? src[3] : 255;
+			src += 4;
+			break;
+		case Source::L8:
+			dst[0] = dst[1] = dst[2] = src[0];
+			dst[3] = 255;
+			src += 1;
+			break;
+		case Source::A8L8:
+			dst[0] = dst[1] = dst[2] = src[0];
+			dst[3] = src[1];
+			src += 2;
+			break;
+		case Source::B5G6R5:
+		{
+			uint32_t v = src[0] | (src[1] << 8);
+			dst[0] = Expand5(v >> 11);
+			dst[1] = Expand6((v >> 5) & 0x3f);
+			dst[2] = Expand5(v & 0x1f);
+			dst[3] = 255;
+			src += 2;
+			break;
+		}
+		}
+		alphaBits |= dst[3];
+	}
+}
+
+#ifdef PIXEL_CONVERT_SSE2
+// SSSE3 is not part of the x64 baseline; pick the path once per process.
+static bool HasSSSE3()
+{
+#ifdef _MSC_VER
+	static const bool has = []()
+	{
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 9)) != 0;
+	}();
+	return has;
+#else
+	static const bool has = __builtin_cpu_supports("ssse3") != 0;
+	return has;
+#endif
+}
+
+// 16 pixels of 3 bytes per iteration: three loads, each lane of four pixels
+// realigned to its first byte and spread out by one shuffle.
+PIXEL_CONVERT_SSSE3_FUNCTION
+static size_t Expand3To4SSSE3(const uint8_t* src, uint8_t* dst, size_t pixels, bool swap)
+{
+	const __m128i shuffle = swap
+		? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+		: _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	size_t i = 0;
+	for (; i + 16 <= pixels; i += 16, src += 48, dst += 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)src);
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+		__m128i p0 = a;
+		__m128i p1 = _mm_alignr_epi8(b, a, 12);
+		__m128i p2 = _mm_alignr_epi8(c, b, 8);
+		__m128i p3 = _mm_srli_si128(c, 4);
+		_mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_shuffle_epi8(p0, shuffle), alpha));
+		_mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_shuffle_epi8(p1, shuffle), alpha));
+		_mm_storeu_si128((__m128i*)(dst + 32), _mm_or_si128(_mm_shuffle_epi8(p2, shuffle), alpha));
+		_mm_storeu_si128((__m128i*)(dst + 48), _mm_or_si128(_mm_shuffle_epi8(p3, shuffle), alpha));
+	}
+	return i;
+}
+
+// 4 pixels per iteration. Red and blue trade places through two shifts of the
+// masked pair, so plain SSE2 is enough.
+static size_t Swizzle4SSE2(const uint8_t* src, uint8_t* dst, size_t pixels, bool swap, bool opaque, __m128i& alphaBits)
+{
+	const __m128i redBlue = _mm_set1_epi32(0x00ff00ff);
+	const __m128i alpha = _mm_set1_epi32(opaque ? (int)0xff000000 : 0);
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4, src += 16, dst += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)src);
+		if (swap)
+		{
+			__m128i rb = _mm_and_si128(v, redBlue);
+			__m128i ga = _mm_andnot_si128(redBlue, v);
+			v = _mm_or_si128(ga, _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)));
+		}
+		v = _mm_or_si128(v, alpha);
+		alphaBits = _mm_or_si128(alphaBits, v);
+		_mm_storeu_si128((__m128i*)dst, v);
+	}
+	return i;
+}
+
+// 16 pixels per iteration: L L and L FF byte pairs interleaved into L L L FF.
+static size_t ExpandL8SSE2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+	const __m128i alpha = _mm_set1_epi8((char)0xff);
+	size_t i = 0;
+	for (; i + 16 <= pixels; i += 16, src += 16, dst += 64)
+	{
+		__m128i l = _mm_loadu_si128((const __m128i*)src);
+		__m128i ll0 = _mm_unpacklo_epi8(l, l);
+		__m128i ll1 = _mm_unpackhi_epi8(l, l);
+		__m128i la0 = _mm_unpacklo_epi8(l, alpha);
+		__m128i la1 = _mm_unpackhi_epi8(l, alpha);
+		_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(ll0, la0));
+		_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(ll0, la0));
+		_mm_storeu_si128((__m128i*)(dst + 32), _mm_unpacklo_epi16(ll1, la1));
+		_mm_storeu_si128((__m128i*)(dst + 48), _mm_unpackhi_epi16(ll1, la1));
+	}
+	return i;
+}
+
+// 8 pixels per iteration: the source word L A already is the upper half of L L L A.
+static size_t ExpandA8L8SSE2(const uint8_t* src, uint8_t* dst, size_t pixels, __m128i& alphaBits)
+{
+	const __m128i low = _mm_set1_epi16(0xff);
+	size_t i = 0;
+	for (; i + 8 <= pixels; i += 8, src += 16, dst += 32)
+	{
+		__m128i la = _mm_loadu_si128((const __m128i*)src);
+		__m128i l = _mm_and_si128(la, low);
+		__m128i ll = _mm_or_si128(l, _mm_slli_epi16(l, 8));
+		alphaBits = _mm_or_si128(alphaBits, la);
+		_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(ll, la));
+		_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(ll, la));
+	}
+	return i;
+}
+
+// 8 pixels per iteration, each channel rounded in a 16 bit lane with the scalar formula.
+static size_t ExpandB5G6R5SSE2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	const __m128i mask6 = _mm_set1_epi16(0x3f);
+	const __m128i alpha = _mm_set1_epi16((short)0xff00);
+	size_t i = 0;
+	for (; i + 8 <= pixels; i += 8, src += 16, dst += 32)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)src);
+		__m128i r = _mm_srli_epi16(v, 11);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), mask6);
+		__m128i b = _mm_and_si128(v, mask5);
+		r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+		g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(259)), _mm_set1_epi16(33)), 6);
+		b = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+		__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+		__m128i ba = _mm_or_si128(b, alpha);
+		_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+	}
+	return i;
+}
+
+static uint8_t GetAlphaBits(__m128i bits, int byteOffset)
+{
+	uint8_t lanes[16];
+	_mm_storeu_si128((__m128i*)lanes, bits);
+	uint8_t result = 0;
+	for (int i = byteOffset; i < 16; i += 4)
+		result |= lanes[i];
+	return result;
+}
+#endif
+
+size_t PixelConvert::GetSourceBytes(Source source)
+{
+	switch (source)
+	{
+	case Source::RGB8:
+	case Source::BGR8:
+		return 3;
+	case Source::RGBX8:
+	case Source::BGRX8:
+	case Source::BGRA8:
+		return 4;
+	case Source::L8:
+		return 1;
+	case Source::A8L8:
+	case Source::B5G6R5:
+		return 2;
+	}
+	return 0;
+}
+
+uint8_t PixelConvert::ToRGBA8(Source source, const uint8_t* src, uint8_t* dst, size_t pixels, bool simd)
+{
+	uint8_t alphaBits = 0;
+	size_t done = 0;
+#ifdef PIXEL_CONVERT_SSE2
+	if (simd)
+	{
+		__m128i bits = _mm_setzero_si128();
+		switch (source)
+		{
+		case Source::RGB8:
+		case Source::BGR8:
+			if (HasSSSE3())
+				done = Expand3To4SSSE3(src, dst, pixels, source == Source::BGR8);
+			break;
+		case Source::RGBX8:
+		case Source::BGRX8:
+		case Source::BGRA8:
+			done = Swizzle4SSE2(src, dst, pixels, source != Source::RGBX8, source != Source::BGRA8, bits);
+			alphaBits = GetAlphaBits(bits, 3);
+			break;
+		case Source::L8:
+			done = ExpandL8SSE2(src, dst, pixels);
+			break;
+		case Source::A8L8:
+			done = ExpandA8L8SSE2(src, dst, pixels, bits);
+			// Words of L A: the alpha bytes sit at odd offsets.
+			alphaBits = GetAlphaBits(bits, 1) | GetAlphaBits(bits, 3);
+			break;
+		case Source::B5G6R5:
+			done = ExpandB5G6R5SSE2(src, dst, pixels);
+			break;
+		}
+		if (done > 0 && alphaBits == 0 && source != Source::BGRA8 && source != Source::A8L8)
+			alphaBits = 255;
+	}
+#endif
+	ConvertScalar(source, src + done * GetSourceBytes(source), dst + done * 4, pixels - done, alphaBits);
+	return alphaBits;
+}
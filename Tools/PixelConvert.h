@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Row converters from the uncompressed layouts older files store, in byte order,
+// to RGBA8. Every source has a scalar reference and, on x86, an SSE2 or SSSE3
+// kernel that produces the same bytes; pass simd = false to run the reference.
+// Only depends on the standard library.
+class PixelConvert
+{
+public:
+	enum class Source
+	{
+		// 24 bit, alpha 255.
+		RGB8,
+		BGR8,
+		// 32 bit with an undefined fourth byte, alpha 255.
+		RGBX8,
+		BGRX8,
+		BGRA8,
+		// Luminance replicated to red, green and blue.
+		L8,
+		// Luminance in the low byte, alpha in the high one.
+		A8L8,
+		// Blue in the low bits, rounded to 8 bits like a UNORM fetch.
+		B5G6R5,
+	};
+
+	static size_t GetSourceBytes(Source source);
+	// Converts pixels from src to dst, which must not overlap. Returns the OR of
+	// every alpha value written, so callers can tell a channel nobody filled in.
+	static uint8_t ToRGBA8(Source source, const uint8_t* src, uint8_t* dst, size_t pixels, bool simd = true);
+};
@@ -0,0 +1,378 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <cstdio>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool IsReadOnly(uint32_t access)
+{
+	return access != RenderGraph::AccessNone && (access & ~RenderGraph::AccessReadMask) == 0;
+}
+
+void RenderGraph::Reset()
+{
+	mPasses.clear();
+	mTextures.clear();
+	mOrder.clear();
+	mFinalBarriers.clear();
+	mHeapSize = 0;
+}
+
+RenderGraph::Handle RenderGraph::AddTexture(const std::string& name, uint64_t size, uint64_t alignment)
+{
+	Texture texture;
+	texture.Name = name;
+	texture.Size = size;
+	texture.Alignment = alignment ? alignment : 1;
+	mTextures.push_back(texture);
+	return (Handle)mTextures.size() - 1;
+}
+
+RenderGraph::Handle RenderGraph::Import(const std::string& name, uint32_t access)
+{
+	Texture texture;
+	texture.Name = name;
+	texture.Imported = true;
+	texture.ImportAccess = access;
+	mTextures.push_back(texture);
+	return (Handle)mTextures.size() - 1;
+}
+
+RenderGraph::Handle RenderGraph::AddPass(const std::string& name, bool sideEffect)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.SideEffect = sideEffect;
+	mPasses.push_back(pass);
+	return (Handle)mPasses.size() - 1;
+}
+
+void RenderGraph::AddUse(Handle pass, Handle texture, uint32_t access)
+{
+	for (Use& use : mPasses[pass].Uses)
+	{
+		if (use.Texture == texture)
+		{
+			use.Access |= access;
+			return;
+		}
+	}
+	mPasses[pass].Uses.push_back({ texture, access });
+}
+
+void RenderGraph::Read(Handle pass, Handle texture, uint32_t access)
+{
+	AddUse(pass, texture, access);
+}
+
+void RenderGraph::Write(Handle pass, Handle texture, uint32_t access)
+{
+	AddUse(pass, texture, access);
+}
+
+bool RenderGraph::Compile(std::string* error)
+{
+	mOrder.clear();
+	mFinalBarriers.clear();
+	mHeapSize = 0;
+	for (Pass& pass : mPasses)
+		pass.Barriers.clear();
+
+	Cull();
+	if (!Validate(error))
+		return false;
+	BuildBarriers();
+	PlaceTransients();
+	return true;
+}
+
+void RenderGraph::Cull()
+{
+	// Walking backwards, a pass lives when it writes something a live pass
+	// after it uses, or something outside the graph sees.
+	std::vector<bool> needed(mTextures.size(), false);
+	for (size_t i = mPasses.size(); i-- > 0;)
+	{
+		Pass& pass = mPasses[i];
+		bool live = pass.SideEffect;
+		for (const Use& use : pass.Uses)
+		{
+			if ((use.Access & AccessWriteMask) && (mTextures[use.Texture].Imported || needed[use.Texture]))
+				live = true;
+		}
+		pass.Culled = !live;
+		if (!live)
+			continue;
+		for (const Use& use : pass.Uses)
+			needed[use.Texture] = true;
+	}
+	for (size_t i = 0; i < mPasses.size(); ++i)
+	{
+		if (mPasses[i].Culled)
+			continue;
+		mPasses[i].Position = mOrder.size();
+		mOrder.push_back((Handle)i);
+	}
+}
+
+bool RenderGraph::Validate(std::string* error) const
+{
+	std::vector<bool> written(mTextures.size(), false);
+	for (Handle index : mOrder)
+	{
+		const Pass& pass = mPasses[index];
+		for (const Use& use : pass.Uses)
+		{
+			const Texture& texture = mTextures[use.Texture];
+			uint32_t writes = use.Access & AccessWriteMask;
+			if (writes && use.Access != writes)
+			{
+				if (error)
+					*error = pass.Name + " combines a write to " + texture.Name + " with another access";
+				return false;
+			}
+			if (writes && (writes & (writes - 1)))
+			{
+				if (error)
+					*error = pass.Name + " writes " + texture.Name + " in two ways";
+				return false;
+			}
+			if (!writes && !texture.Imported && !written[use.Texture])
+			{
+				if (error)
+					*error = pass.Name + " reads " + texture.Name + " before anything wrote it";
+				return false;
+			}
+			if (writes)
+				written[use.Texture] = true;
+		}
+	}
+	return true;
+}
+
+void RenderGraph::BuildBarriers()
+{
+	// Every use of every texture, in execution order.
+	struct Step
+	{
+		size_t Position;
+		uint32_t Access;
+	};
+	std::vector<std::vector<Step>> steps(mTextures.size());
+	for (size_t position = 0; position < mOrder.size(); ++position)
+	{
+		for (const Use& use : mPasses[mOrder[position]].Uses)
+			steps[use.Texture].push_back({ position, use.Access });
+	}
+
+	for (Handle handle = 0; handle < mTextures.size(); ++handle)
+	{
+		Texture& texture = mTextures[handle];
+		std::vector<Step>& list = steps[handle];
+
+		// A run of reads shares one state holding all of their bits, so reads
+		// following reads need no barrier in between.
+		for (size_t i = 0; i < list.size();)
+		{
+			size_t end = i + 1;
+			if (IsReadOnly(list[i].Access))
+			{
+				uint32_t combined = list[i].Access;
+				while (end < list.size() && IsReadOnly(list[end].Access))
+					combined |= list[end++].Access;
+				for (size_t j = i; j < end; ++j)
+					list[j].Access = combined;
+			}
+			i = end;
+		}
+
+		if (!list.empty())
+		{
+			texture.First = list.front().Position;
+			texture.Last = list.back().Position;
+		}
+		// A transient starts each frame in the state the previous frame left it in.
+		uint32_t state = texture.Imported ? texture.ImportAccess : (list.empty() ? AccessNone : list.back().Access);
+		texture.StartAccess = state;
+		size_t since = 0;
+		for (const Step& step : list)
+		{
+			if (step.Access != state)
+				mPasses[mOrder[step.Position]].Barriers.push_back({ Barrier::Transition, handle, state, step.Access, mOrder[since] });
+			state = step.Access;
+			since = step.Position + 1;
+		}
+		if (texture.Imported && state != texture.ImportAccess)
+			mFinalBarriers.push_back({ Barrier::Transition, handle, state, texture.ImportAccess, Invalid });
+	}
+}
+
+void RenderGraph::PlaceTransients()
+{
+	std::vector<Handle> used;
+	uint64_t unusedSize = 0;
+	for (Handle handle = 0; handle < mTextures.size(); ++handle)
+	{
+		Texture& texture = mTextures[handle];
+		if (texture.Imported)
+			continue;
+		texture.Offset = 0;
+		texture.Aliased = false;
+		if (texture.First <= texture.Last)
+			used.push_back(handle);
+		else
+			unusedSize = std::max(unusedSize, texture.Size);
+	}
+
+	// Largest first, each at the lowest offset clear of every placed texture
+	// alive at the same time.
+	std::sort(used.begin(), used.end(), [this](Handle a, Handle b)
+	{
+		const Texture& ta = mTextures[a];
+		const Texture& tb = mTextures[b];
+		if (ta.Size != tb.Size)
+			return ta.Size > tb.Size;
+		return ta.First != tb.First ? ta.First < tb.First : a < b;
+	});
+	std::vector<Handle> placed;
+	for (Handle handle : used)
+	{
+		Texture& texture = mTextures[handle];
+		std::vector<const Texture*> live;
+		std::vector<uint64_t> candidates(1, 0);
+		for (Handle other : placed)
+		{
+			const Texture& o = mTextures[other];
+			if (o.First <= texture.Last && texture.First <= o.Last)
+			{
+				live.push_back(&o);
+				candidates.push_back(AlignUp(o.Offset + o.Size, texture.Alignment));
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+		for (uint64_t offset : candidates)
+		{
+			bool clear = true;
+			for (const Texture* o : live)
+			{
+				if (offset < o->Offset + o->Size && o->Offset < offset + texture.Size)
+				{
+					clear = false;
+					break;
+				}
+			}
+			if (clear)
+			{
+				texture.Offset = offset;
+				break;
+			}
+		}
+		mHeapSize = std::max(mHeapSize, texture.Offset + texture.Size);
+		placed.push_back(handle);
+	}
+	// Textures nobody uses sit at offset 0 and must still fit.
+	mHeapSize = std::max(mHeapSize, unusedSize);
+
+	// Sharing memory with another used texture means activating it each frame.
+	for (size_t i = 0; i < placed.size(); ++i)
+	{
+		for (size_t j = i + 1; j < placed.size(); ++j)
+		{
+			Texture& a = mTextures[placed[i]];
+			Texture& b = mTextures[placed[j]];
+			if (a.Offset < b.Offset + b.Size && b.Offset < a.Offset + a.Size)
+				a.Aliased = b.Aliased = true;
+		}
+	}
+	for (Handle handle : placed)
+	{
+		const Texture& texture = mTextures[handle];
+		if (texture.Aliased)
+		{
+			// Its memory holds another texture until then, so nothing may start early.
+			std::vector<Barrier>& barriers = mPasses[mOrder[texture.First]].Barriers;
+			for (Barrier& barrier : barriers)
+			{
+				if (barrier.Texture == handle)
+					barrier.Since = mOrder[texture.First];
+			}
+			barriers.insert(barriers.begin(), { Barrier::Aliasing, handle, AccessNone, AccessNone, mOrder[texture.First] });
+		}
+	}
+}
+
+uint64_t RenderGraph::GetUnaliasedSize() const
+{
+	uint64_t size = 0;
+	for (const Texture& texture : mTextures)
+	{
+		if (!texture.Imported)
+			size += AlignUp(texture.Size, texture.Alignment);
+	}
+	return size;
+}
+
+size_t RenderGraph::GetBarrierCount() const
+{
+	size_t count = mFinalBarriers.size();
+	for (Handle pass : mOrder)
+		count += mPasses[pass].Barriers.size();
+	return count;
+}
+
+size_t RenderGraph::GetSplittableCount() const
+{
+	size_t count = 0;
+	for (Handle pass : mOrder)
+	{
+		for (const Barrier& barrier : mPasses[pass].Barriers)
+			count += barrier.Since != pass ? 1 : 0;
+	}
+	return count;
+}
+
+std::string RenderGraph::GetReport() const
+{
+	const double MB = 1.0 / (1024.0 * 1024.0);
+	std::string report;
+	char line[256];
+	for (const Texture& texture : mTextures)
+	{
+		if (texture.Imported)
+			continue;
+		if (texture.First <= texture.Last)
+		{
+			snprintf(line, sizeof(line), "Render graph: %-24s %7.2f MB at %7.2f MB, %s to %s%s\n", texture.Name.c_str(),
+				texture.Size * MB, texture.Offset * MB, mPasses[mOrder[texture.First]].Name.c_str(),
+				mPasses[mOrder[texture.Last]].Name.c_str(), texture.Aliased ? ", aliased" : "");
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "Render graph: %-24s %7.2f MB unused\n", texture.Name.c_str(), texture.Size * MB);
+		}
+		report += line;
+	}
+
+	std::string culled;
+	size_t batches = mFinalBarriers.empty() ? 0 : 1;
+	for (const Pass& pass : mPasses)
+	{
+		if (pass.Culled)
+			culled += (culled.empty() ? " (" : ", ") + pass.Name;
+		else if (!pass.Barriers.empty())
+			++batches;
+	}
+	if (!culled.empty())
+		culled += ")";
+	uint64_t unaliased = GetUnaliasedSize();
+	snprintf(line, sizeof(line), "Render graph: %zu passes, %zu culled%s, %zu barriers in %zu batches, %zu splittable\n",
+		mPasses.size(), mPasses.size() - mOrder.size(), culled.c_str(), GetBarrierCount(), batches, GetSplittableCount());
+	report += line;
+	snprintf(line, sizeof(line), "Render graph: %.2f MB of transient textures in a %.2f MB heap, %.2f MB saved\n",
+		unaliased * MB, mHeapSize * MB, (unaliased - std::min(unaliased, mHeapSize)) * MB);
+	report += line;
+	return report;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame graph compiler. Passes declare the textures they read and write, in the
+// order they should run; Compile then
+//  - keeps that order, which every dependency already follows, and culls passes
+//    whose writes reach neither a pass with side effects nor an imported texture,
+//  - works out the transitions each pass needs: one barrier per texture per pass,
+//    batched per pass, with consecutive reads merged into one combined read state,
+//  - places transient textures in one heap, letting textures whose lifetimes in
+//    the compiled order do not overlap share memory.
+// There is no graphics API here; the engine maps access bits to resource states
+// and offsets to placed resources, so compilation runs in a plain CPU test.
+// Only depends on the standard library.
+class RenderGraph
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle Invalid = ~0u;
+
+	// Read bits combine with each other; a write bit excludes every other bit.
+	enum Access : uint32_t
+	{
+		AccessNone = 0,
+		AccessRenderTarget = 1 << 0,
+		AccessDepthWrite = 1 << 1,
+		AccessCopyDest = 1 << 2,
+		AccessDepthRead = 1 << 3,
+		AccessShaderRead = 1 << 4,
+		AccessCopySource = 1 << 5,
+		AccessPresent = 1 << 6,
+		AccessWriteMask = AccessRenderTarget | AccessDepthWrite | AccessCopyDest,
+		AccessReadMask = AccessDepthRead | AccessShaderRead | AccessCopySource,
+	};
+
+	struct Barrier
+	{
+		enum Type
+		{
+			Transition,
+			// The texture takes over memory another transient used; Before and After are unused.
+			Aliasing,
+		};
+		Type Kind;
+		Handle Texture;
+		uint32_t Before;
+		uint32_t After;
+		// The earliest live pass the transition may start at, the one after the
+		// texture's previous use. When that is an earlier pass recorded in the
+		// same list, the barrier can be split across the passes in between.
+		Handle Since;
+	};
+
+	void Reset();
+
+	// A texture the graph owns. Its contents do not survive the frame: the first
+	// pass to use it has to write all of it (clear or copy) before anything reads.
+	Handle AddTexture(const std::string& name, uint64_t size, uint64_t alignment);
+	// A texture owned elsewhere, in state access when the frame starts and again
+	// when it ends.
+	Handle Import(const std::string& name, uint32_t access);
+	// sideEffect keeps the pass even if nothing reads what it writes.
+	Handle AddPass(const std::string& name, bool sideEffect = false);
+	void Read(Handle pass, Handle texture, uint32_t access);
+	void Write(Handle pass, Handle texture, uint32_t access);
+
+	// False, with a reason in error, when a pass reads a transient nothing wrote
+	// before it or combines a write with any other access to the same texture.
+	bool Compile(std::string* error = nullptr);
+
+	// Live passes in execution order.
+	const std::vector<Handle>& GetOrder() const { return mOrder; }
+	bool IsCulled(Handle pass) const { return mPasses[pass].Culled; }
+	// Index of a live pass in GetOrder.
+	size_t GetPosition(Handle pass) const { return mPasses[pass].Position; }
+	// To record before the pass, aliasing barriers first.
+	const std::vector<Barrier>& GetBarriers(Handle pass) const { return mPasses[pass].Barriers; }
+	// Imported textures back to the state they came in with, after the last pass.
+	const std::vector<Barrier>& GetFinalBarriers() const { return mFinalBarriers; }
+
+	size_t GetTextureCount() const { return mTextures.size(); }
+	const std::string& GetTextureName(Handle texture) const { return mTextures[texture].Name; }
+	const std::string& GetPassName(Handle pass) const { return mPasses[pass].Name; }
+	bool IsImported(Handle texture) const { return mTextures[texture].Imported; }
+	// Where a transient lives in the heap. One no live pass uses gets offset 0:
+	// it never becomes active, so it costs nothing.
+	uint64_t GetOffset(Handle texture) const { return mTextures[texture].Offset; }
+	// The state a transient is left in at the end of a frame, and so the one to
+	// create it in. AccessNone for a transient no live pass uses.
+	uint32_t GetInitialAccess(Handle texture) const { return mTextures[texture].StartAccess; }
+	uint64_t GetHeapSize() const { return mHeapSize; }
+	// What the transients would take in separate allocations.
+	uint64_t GetUnaliasedSize() const;
+	size_t GetBarrierCount() const;
+	// Transitions with passes between their Since and their own pass.
+	size_t GetSplittableCount() const;
+	// One line per transient and a summary, for the debug output.
+	std::string GetReport() const;
+
+private:
+	struct Use
+	{
+		Handle Texture;
+		uint32_t Access;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		bool SideEffect = false;
+		bool Culled = false;
+		size_t Position = 0;
+		std::vector<Use> Uses;
+		std::vector<Barrier> Barriers;
+	};
+
+	struct Texture
+	{
+		std::string Name;
+		bool Imported = false;
+		uint64_t Size = 0;
+		uint64_t Alignment = 1;
+		uint32_t ImportAccess = AccessNone;
+		uint32_t StartAccess = AccessNone;
+		uint64_t Offset = 0;
+		// Positions in mOrder; First > Last when no live pass uses it.
+		size_t First = 1;
+		size_t Last = 0;
+		bool Aliased = false;
+	};
+
+	void AddUse(Handle pass, Handle texture, uint32_t access);
+	void Cull();
+	bool Validate(std::string* error) const;
+	void BuildBarriers();
+	void PlaceTransients();
+
+	std::vector<Pass> mPasses;
+	std::vector<Texture> mTextures;
+	std::vector<Handle> mOrder;
+	std::vector<Barrier> mFinalBarriers;
+	uint64_t mHeapSize = 0;
+};
@@ -0,0 +1,296 @@
+#include "ShaderCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// On disk: EntryHeader then Size bytes of bytecode. PayloadHash catches a file
+// cut short by a crash during Store.
+struct EntryHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Key;
+	uint64_t PayloadHash;
+	uint64_t Size;
+};
+
+// FNV-1a, 64 bit.
+static void HashBytes(uint64_t& hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+}
+
+// Length first, so "ab" + "c" and "a" + "bc" hash differently.
+static void HashString(uint64_t& hash, const std::string& value)
+{
+	uint64_t size = value.size();
+	HashBytes(hash, &size, sizeof(size));
+	HashBytes(hash, value.data(), value.size());
+}
+
+static uint64_t HashPayload(const void* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	HashBytes(hash, data, size);
+	return hash;
+}
+
+static bool ReadWholeFile(const std::string& path, std::string& contents)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	contents.clear();
+	char buffer[16384];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		contents.append(buffer, read);
+	fclose(file);
+	return true;
+}
+
+static std::string NormalizePath(const std::string& path)
+{
+	std::string result = path;
+	for (char& c : result)
+	{
+		if (c == '\\')
+			c = '/';
+	}
+	return result;
+}
+
+// The standard include handler looks next to the including file first.
+static std::string GetDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of('/');
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Case folded so "Common.hlsl" and "common.hlsl" count once, like on Windows.
+static std::string GetVisitKey(const std::string& path)
+{
+	std::string key = path;
+	for (char& c : key)
+	{
+		if (c >= 'A' && c <= 'Z')
+			c = (char)(c - 'A' + 'a');
+	}
+	return key;
+}
+
+ShaderCache::ShaderCache()
+	: mReader(ReadWholeFile)
+{
+
+}
+
+void ShaderCache::SetDirectory(const char* directory)
+{
+	mDirectory = NormalizePath(directory);
+	if (!mDirectory.empty() && mDirectory.back() != '/')
+		mDirectory += '/';
+#ifdef _WIN32
+	CreateDirectoryA(mDirectory.c_str(), nullptr);
+#else
+	mkdir(mDirectory.c_str(), 0755);
+#endif
+}
+
+void ShaderCache::FindIncludes(const std::string& source, std::vector<std::string>& includes)
+{
+	size_t i = 0, size = source.size();
+	bool lineStart = true;
+	while (i < size)
+	{
+		char c = source[i];
+		if (c == '/' && i + 1 < size && source[i + 1] == '/')
+		{
+			while (i < size && source[i] != '\n')
+				++i;
+		}
+		else if (c == '/' && i + 1 < size && source[i + 1] == '*')
+		{
+			size_t end = source.find("*/", i + 2);
+			i = end == std::string::npos ? size : end + 2;
+		}
+		else if (c == '\n')
+		{
+			lineStart = true;
+			++i;
+		}
+		else if (c == ' ' || c == '\t' || c == '\r')
+		{
+			++i;
+		}
+		else if (c == '#' && lineStart)
+		{
+			lineStart = false;
+			++i;
+			while (i < size && (source[i] == ' ' || source[i] == '\t'))
+				++i;
+			if (source.compare(i, 7, "include") != 0)
+				continue;
+			i += 7;
+			while (i < size && (source[i] == ' ' || source[i] == '\t'))
+				++i;
+			if (i >= size || (source[i] != '"' && source[i] != '<'))
+				continue;
+			char close = source[i] == '"' ? '"' : '>';
+			size_t end = source.find_first_of(std::string(1, close) + "\n", i + 1);
+			if (end != std::string::npos && source[end] == close)
+				includes.push_back(source.substr(i + 1, end - i - 1));
+			i = end == std::string::npos ? size : end;
+		}
+		else
+		{
+			lineStart = false;
+			++i;
+		}
+	}
+}
+
+void ShaderCache::FindKeywords(const std::string& source, std::vector<std::string>& keywords)
+{
+	static const char tag[] = "keywords:";
+	size_t lineStart = 0, size = source.size();
+	while (lineStart < size)
+	{
+		size_t lineEnd = source.find('\n', lineStart);
+		if (lineEnd == std::string::npos)
+			lineEnd = size;
+		size_t i = source.find_first_not_of(" \t", lineStart);
+		if (i != std::string::npos && i + 2 <= lineEnd && source.compare(i, 2, "//") == 0)
+		{
+			i = source.find_first_not_of(" \t", i + 2);
+			if (i != std::string::npos && i < lineEnd && source.compare(i, sizeof(tag) - 1, tag) == 0)
+			{
+				i += sizeof(tag) - 1;
+				while (i < lineEnd)
+				{
+					i = source.find_first_not_of(" \t\r", i);
+					if (i == std::string::npos || i >= lineEnd)
+						break;
+					size_t end = source.find_first_of(" \t\r\n", i);
+					if (end == std::string::npos || end > lineEnd)
+						end = lineEnd;
+					keywords.push_back(source.substr(i, end - i));
+					i = end;
+				}
+			}
+		}
+		lineStart = lineEnd + 1;
+	}
+}
+
+bool ShaderCache::ComputeKey(const Request& request, uint64_t& key, std::vector<std::string>* files) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t header[2] = { Version, request.Flags };
+	HashBytes(hash, header, sizeof(header));
+	HashBytes(hash, &request.CompilerVersion, sizeof(request.CompilerVersion));
+	HashString(hash, request.EntryPoint);
+	HashString(hash, request.Target);
+	// Distinct defines do not depend on each other's order; a repeated name keeps
+	// its relative order, since the last definition wins.
+	std::vector<Define> defines = request.Defines;
+	std::stable_sort(defines.begin(), defines.end(), [](const Define& a, const Define& b) { return a.Name < b.Name; });
+	for (const Define& define : defines)
+	{
+		HashString(hash, define.Name);
+		HashString(hash, define.Value);
+	}
+	// Debug bytecode carries the file name, so it is part of the key too.
+	std::string root = NormalizePath(request.File);
+	HashString(hash, root);
+
+	// Depth first in include order, each file once: the same walk the preprocessor
+	// makes as long as the headers have include guards.
+	std::vector<std::string> pending(1, root);
+	std::unordered_set<std::string> visited;
+	std::string contents;
+	std::vector<std::string> includes;
+	while (!pending.empty())
+	{
+		std::string path = pending.back();
+		pending.pop_back();
+		if (!visited.insert(GetVisitKey(path)).second)
+			continue;
+		if (!mReader(path, contents))
+			return false;
+		if (files)
+			files->push_back(path);
+		HashString(hash, path);
+		HashString(hash, contents);
+
+		includes.clear();
+		FindIncludes(contents, includes);
+		std::string directory = GetDirectory(path);
+		for (size_t i = includes.size(); i-- > 0;)
+			pending.push_back(directory + NormalizePath(includes[i]));
+	}
+	key = hash;
+	return true;
+}
+
+std::string ShaderCache::GetEntryPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cso", (unsigned long long)key);
+	return mDirectory + name;
+}
+
+bool ShaderCache::Load(uint64_t key, std::vector<uint8_t>& bytecode) const
+{
+	if (mDirectory.empty())
+		return false;
+	FILE* file = fopen(GetEntryPath(key).c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	EntryHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.Magic == Magic &&
+		header.Version == Version && header.Key == key && header.Size > 0 && header.Size < (1ull << 31);
+	if (ok)
+	{
+		bytecode.resize((size_t)header.Size);
+		ok = fread(bytecode.data(), 1, bytecode.size(), file) == bytecode.size() &&
+			HashPayload(bytecode.data(), bytecode.size()) == header.PayloadHash;
+	}
+	fclose(file);
+	return ok;
+}
+
+bool ShaderCache::Store(uint64_t key, const void* bytecode, size_t size) const
+{
+	if (mDirectory.empty())
+		return false;
+	EntryHeader header = { Magic, Version, key, HashPayload(bytecode, size), size };
+	std::string path = GetEntryPath(key);
+	// Written aside and renamed, so a reader never sees half an entry.
+	std::string temp = path + ".tmp";
+	FILE* file = fopen(temp.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(bytecode, 1, size, file) == size;
+	ok = fclose(file) == 0 && ok;
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(temp.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+		remove(temp.c_str());
+	return ok;
+}
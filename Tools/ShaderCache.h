@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Compiled shader bytecode kept on disk between runs, one file per key. The key
+// hashes everything the compiler output depends on: the source file, every file
+// it includes (transitively, by content), the defines (in any order), entry
+// point, target, flags and compiler version. Any edit therefore lands on a new key and the stale
+// entry is simply never read again. Key computation only reads text through the
+// FileReader, so it runs without a compiler. Only depends on the standard library.
+class ShaderCache
+{
+public:
+	static const uint32_t Magic = 0x43444853; // "SHDC"
+	static const uint32_t Version = 1;
+
+	struct Define
+	{
+		std::string Name;
+		std::string Value;
+	};
+
+	struct Request
+	{
+		std::string File;
+		std::vector<Define> Defines;
+		std::string EntryPoint;
+		std::string Target;
+		uint32_t Flags = 0;
+		// Build of the compiler, e.g. the file version of the loaded DLL; a
+		// compiler update then misses every entry.
+		uint64_t CompilerVersion = 0;
+	};
+
+	// Returns the whole file; false when it does not exist.
+	typedef std::function<bool(const std::string& path, std::string& contents)> FileReader;
+
+	ShaderCache();
+	// Entries go to directory, created when missing. Without one nothing is cached.
+	void SetDirectory(const char* directory);
+	// Replaces the disk reader used for sources and includes.
+	void SetFileReader(FileReader reader) { mReader = reader; }
+
+	// False when the source or one of its includes cannot be read; the compiler
+	// will report that, so the caller just compiles without the cache. files, when
+	// given, receives every source that went into the key, the request file first.
+	bool ComputeKey(const Request& request, uint64_t& key, std::vector<std::string>* files = nullptr) const;
+	bool Load(uint64_t key, std::vector<uint8_t>& bytecode) const;
+	bool Store(uint64_t key, const void* bytecode, size_t size) const;
+	std::string GetEntryPath(uint64_t key) const;
+
+	// #include targets in source order, skipping commented out lines.
+	static void FindIncludes(const std::string& source, std::vector<std::string>& includes);
+	// Feature keywords a shader declares on a "// keywords: A B" line, in order.
+	// Each one is tested with #if, so the defines pick the permutation.
+	static void FindKeywords(const std::string& source, std::vector<std::string>& keywords);
+
+private:
+	std::string mDirectory;
+	FileReader mReader;
+};
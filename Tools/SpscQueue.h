@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Fixed ring of Capacity slots handed from one producer thread to one consumer
+// thread without locks. Slots are filled and read in place and reused, so
+// whatever they hold keeps its allocations from one lap to the next. A slot
+// stays the consumer's until EndPop, so the producer is at most Capacity - 1
+// slots ahead of the one being read. Only depends on the standard library.
+template<class T, size_t Capacity>
+class SpscQueue
+{
+public:
+	SpscQueue() : mHead(0), mTail(0) {}
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer: the slot to fill next, or null while every slot is still
+	// queued or being read.
+	T* BeginPush()
+	{
+		size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHead.load(std::memory_order_acquire) == Capacity)
+			return nullptr;
+		return &mSlots[tail % Capacity];
+	}
+	// Producer: hands the slot BeginPush returned to the consumer.
+	void EndPush() { mTail.store(mTail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	// Consumer: the oldest slot pushed, or null when there is none.
+	const T* BeginPop() const
+	{
+		size_t head = mHead.load(std::memory_order_relaxed);
+		if (mTail.load(std::memory_order_acquire) == head)
+			return nullptr;
+		return &mSlots[head % Capacity];
+	}
+	// Consumer: gives the slot BeginPop returned back to the producer.
+	void EndPop() { mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+	T mSlots[Capacity];
+	// Counts of slots popped and pushed; each is written by one side only.
+	std::atomic<size_t> mHead;
+	std::atomic<size_t> mTail;
+};
@@ -0,0 +1,61 @@
+#include "StaticBatchPlanner.h"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+void StaticBatchPlanner::Plan(const std::vector<Item>& items, float cellSize, size_t byteBudget)
+{
+	struct Entry
+	{
+		uint32_t Material;
+		int32_t Cell[3];
+		uint32_t Index;
+	};
+
+	std::vector<Entry> entries(items.size());
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		entries[i].Material = items[i].Material;
+		for (int j = 0; j < 3; ++j)
+			entries[i].Cell[j] = (int32_t)std::floor(items[i].Center[j] / cellSize);
+		entries[i].Index = (uint32_t)i;
+	}
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+	{
+		return std::tie(a.Material, a.Cell[0], a.Cell[1], a.Cell[2], a.Index) <
+			std::tie(b.Material, b.Cell[0], b.Cell[1], b.Cell[2], b.Index);
+	});
+
+	mBatches.clear();
+	mUnbatched.clear();
+	mBytes = 0;
+	for (size_t first = 0; first < entries.size();)
+	{
+		size_t last = first + 1;
+		while (last < entries.size() && entries[last].Material == entries[first].Material &&
+			std::equal(entries[last].Cell, entries[last].Cell + 3, entries[first].Cell))
+			++last;
+
+		size_t bytes = 0;
+		for (size_t i = first; i < last; ++i)
+			bytes += items[entries[i].Index].Bytes;
+		if (last - first > 1 && mBytes + bytes <= byteBudget)
+		{
+			Batch batch;
+			batch.Material = entries[first].Material;
+			std::copy(entries[first].Cell, entries[first].Cell + 3, batch.Cell);
+			for (size_t i = first; i < last; ++i)
+				batch.Items.push_back(entries[i].Index);
+			batch.Bytes = bytes;
+			mBatches.push_back(batch);
+			mBytes += bytes;
+		}
+		else
+		{
+			for (size_t i = first; i < last; ++i)
+				mUnbatched.push_back(entries[i].Index);
+		}
+		first = last;
+	}
+	std::sort(mUnbatched.begin(), mUnbatched.end());
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decides which static items a bake merges into one world space mesh. Items
+// with the same material whose bounds center falls in the same grid cell form
+// a batch; a batch of one would only copy its mesh, so those stay as they are.
+// Batches are taken in a fixed order (material, then cell) until the merged
+// meshes would exceed the byte budget, so the same scene always bakes the same
+// way, whatever order its items were added in. Only depends on the standard
+// library.
+class StaticBatchPlanner
+{
+public:
+	struct Item
+	{
+		uint32_t Material;
+		// World space.
+		float Center[3];
+		// Vertex and index bytes the item adds to a merged mesh.
+		size_t Bytes;
+	};
+
+	struct Batch
+	{
+		uint32_t Material;
+		int32_t Cell[3];
+		// Indices into the planned items, ascending.
+		std::vector<uint32_t> Items;
+		size_t Bytes;
+	};
+
+	void Plan(const std::vector<Item>& items, float cellSize, size_t byteBudget);
+
+	const std::vector<Batch>& GetBatches() const { return mBatches; }
+	// Items left as they are, ascending.
+	const std::vector<uint32_t>& GetUnbatched() const { return mUnbatched; }
+	// Sum of the batches' Bytes, at most the budget.
+	size_t GetBytes() const { return mBytes; }
+
+private:
+	std::vector<Batch> mBatches;
+	std::vector<uint32_t> mUnbatched;
+	size_t mBytes = 0;
+};
@@ -0,0 +1,311 @@
+#include "TextureIndex.h"
+#include "DDSFileView.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// On disk: FileHeader, Count records, then the UTF-8 paths they point at. Written
+// in host byte order; a file from another machine fails the magic check and is
+// simply rebuilt.
+struct FileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Count;
+	uint32_t StringBytes;
+};
+
+struct Record
+{
+	uint64_t FileSize;
+	uint64_t WriteTime;
+	uint64_t ContentHash;
+	uint64_t DataOffset;
+	uint64_t DataSize;
+	uint32_t PathOffset;
+	uint32_t PathLength;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t Depth;
+	uint32_t MipCount;
+	uint32_t ArraySize;
+	uint32_t DxgiFormat;
+	uint32_t Flags;
+	uint32_t Reserved;
+};
+static_assert(sizeof(Record) == 80, "Record is part of the file format");
+
+struct DirectoryFile
+{
+	std::string Name;
+	uint64_t Size;
+	uint64_t WriteTime;
+};
+
+static bool HasDDSExtension(const std::string& name)
+{
+	if (name.size() < 4)
+		return false;
+	std::string ext = TextureIndex::NormalizePath(name.c_str() + name.size() - 4);
+	return ext == ".dds";
+}
+
+#ifdef _WIN32
+static bool ListDirectory(const char* directory, std::vector<DirectoryFile>& files)
+{
+	std::string pattern = std::string(directory) + "/*.dds";
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return GetLastError() == ERROR_FILE_NOT_FOUND;
+	do
+	{
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+		DirectoryFile file;
+		file.Name = data.cFileName;
+		file.Size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+		file.WriteTime = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+		// "*.dds" also matches longer extensions through 8.3 short names.
+		if (HasDDSExtension(file.Name))
+			files.push_back(file);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+	return true;
+}
+#else
+static bool ListDirectory(const char* directory, std::vector<DirectoryFile>& files)
+{
+	DIR* dir = opendir(directory);
+	if (dir == nullptr)
+		return false;
+	while (dirent* item = readdir(dir))
+	{
+		std::string name = item->d_name;
+		if (!HasDDSExtension(name))
+			continue;
+		struct stat info;
+		if (stat((std::string(directory) + "/" + name).c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+			continue;
+		DirectoryFile file;
+		file.Name = name;
+		file.Size = (uint64_t)info.st_size;
+		file.WriteTime = (uint64_t)info.st_mtime;
+		files.push_back(file);
+	}
+	closedir(dir);
+	return true;
+}
+#endif
+
+uint64_t TextureIndex::HashContent(const uint8_t* data, size_t size)
+{
+	// FNV-1a, 64 bit.
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string TextureIndex::NormalizePath(const char* path)
+{
+	if (path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+		path += 2;
+	std::string result = path;
+	for (char& c : result)
+	{
+		if (c == '\\')
+			c = '/';
+		else if (c >= 'A' && c <= 'Z')
+			c = (char)(c - 'A' + 'a');
+	}
+	return result;
+}
+
+void TextureIndex::Build(const std::string& file, Entry& entry)
+{
+	entry.Flags = 0;
+	entry.ContentHash = 0;
+	MappedFile mapped;
+	if (!mapped.Open(file.c_str()))
+		return;
+	entry.ContentHash = HashContent(mapped.GetData(), mapped.GetSize());
+
+	DDSFileView view;
+	if (!view.Parse(mapped.GetData(), mapped.GetSize()))
+		return;
+	entry.DataOffset = (uint64_t)(view.GetBitData() - mapped.GetData());
+	entry.DataSize = view.GetBitSize();
+	entry.Width = view.GetWidth();
+	entry.Height = view.GetHeight();
+	entry.Depth = view.GetDepth();
+	entry.MipCount = view.GetMipCount();
+	entry.ArraySize = view.GetArraySize();
+	entry.DxgiFormat = view.GetDxgiFormat();
+	entry.Flags = Valid | (view.IsCube() ? (uint32_t)Cube : 0u);
+}
+
+void TextureIndex::BuildLookup()
+{
+	mLookup.clear();
+	mLookup.reserve(mEntries.size());
+	for (size_t i = 0; i < mEntries.size(); ++i)
+		mLookup[mEntries[i].Path] = i;
+}
+
+bool TextureIndex::Load(const char* indexFile)
+{
+	mEntries.clear();
+	mLookup.clear();
+
+	MappedFile file;
+	if (!file.Open(indexFile) || file.GetSize() < sizeof(FileHeader))
+		return false;
+	const uint8_t* data = file.GetData();
+	FileHeader header;
+	memcpy(&header, data, sizeof(header));
+	size_t stringsOffset = sizeof(FileHeader) + (size_t)header.Count * sizeof(Record);
+	if (header.Magic != Magic || header.Version != Version ||
+		file.GetSize() != stringsOffset + header.StringBytes)
+		return false;
+
+	const char* strings = (const char*)data + stringsOffset;
+	mEntries.resize(header.Count);
+	for (uint32_t i = 0; i < header.Count; ++i)
+	{
+		Record record;
+		memcpy(&record, data + sizeof(FileHeader) + i * sizeof(Record), sizeof(record));
+		if ((uint64_t)record.PathOffset + record.PathLength > header.StringBytes)
+		{
+			mEntries.clear();
+			return false;
+		}
+		Entry& entry = mEntries[i];
+		entry.Path.assign(strings + record.PathOffset, record.PathLength);
+		entry.FileSize = record.FileSize;
+		entry.WriteTime = record.WriteTime;
+		entry.ContentHash = record.ContentHash;
+		entry.DataOffset = record.DataOffset;
+		entry.DataSize = record.DataSize;
+		entry.Width = record.Width;
+		entry.Height = record.Height;
+		entry.Depth = record.Depth;
+		entry.MipCount = record.MipCount;
+		entry.ArraySize = record.ArraySize;
+		entry.DxgiFormat = record.DxgiFormat;
+		entry.Flags = record.Flags;
+	}
+	BuildLookup();
+	return true;
+}
+
+bool TextureIndex::Save(const char* indexFile) const
+{
+	std::vector<uint8_t> bytes(sizeof(FileHeader) + mEntries.size() * sizeof(Record));
+	std::string strings;
+	for (size_t i = 0; i < mEntries.size(); ++i)
+	{
+		const Entry& entry = mEntries[i];
+		Record record = {};
+		record.FileSize = entry.FileSize;
+		record.WriteTime = entry.WriteTime;
+		record.ContentHash = entry.ContentHash;
+		record.DataOffset = entry.DataOffset;
+		record.DataSize = entry.DataSize;
+		record.PathOffset = (uint32_t)strings.size();
+		record.PathLength = (uint32_t)entry.Path.size();
+		record.Width = entry.Width;
+		record.Height = entry.Height;
+		record.Depth = entry.Depth;
+		record.MipCount = entry.MipCount;
+		record.ArraySize = entry.ArraySize;
+		record.DxgiFormat = entry.DxgiFormat;
+		record.Flags = entry.Flags;
+		memcpy(bytes.data() + sizeof(FileHeader) + i * sizeof(Record), &record, sizeof(record));
+		strings += entry.Path;
+	}
+	FileHeader header = { Magic, Version, (uint32_t)mEntries.size(), (uint32_t)strings.size() };
+	memcpy(bytes.data(), &header, sizeof(header));
+	bytes.insert(bytes.end(), strings.begin(), strings.end());
+
+	FILE* file = fopen(indexFile, "wb");
+	if (file == nullptr)
+		return false;
+	bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	return fclose(file) == 0 && written;
+}
+
+bool TextureIndex::Refresh(const char* directory, const char* indexFile)
+{
+	mRebuilt = 0;
+	bool loaded = Load(indexFile);
+
+	std::vector<DirectoryFile> files;
+	if (!ListDirectory(directory, files))
+		return false;
+	// Sorted, so the index does not change with the listing order.
+	std::sort(files.begin(), files.end(), [](const DirectoryFile& a, const DirectoryFile& b)
+	{
+		return a.Name < b.Name;
+	});
+
+	std::string prefix = directory;
+	if (!prefix.empty() && prefix.back() != '/' && prefix.back() != '\\')
+		prefix += '/';
+
+	std::vector<Entry> entries(files.size());
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		std::string path = prefix + files[i].Name;
+		Entry& entry = entries[i];
+		entry.Path = NormalizePath(path.c_str());
+		const Entry* old = Find(entry.Path.c_str());
+		if (old && old->FileSize == files[i].Size && old->WriteTime == files[i].WriteTime)
+		{
+			entry = *old;
+			continue;
+		}
+		entry.FileSize = files[i].Size;
+		entry.WriteTime = files[i].WriteTime;
+		Build(path, entry);
+		++mRebuilt;
+	}
+
+	// Deleted files drop out as well.
+	bool changed = !loaded || mRebuilt > 0 || entries.size() != mEntries.size();
+	mEntries.swap(entries);
+	BuildLookup();
+	if (changed)
+		Save(indexFile);
+	return true;
+}
+
+const TextureIndex::Entry* TextureIndex::Find(const char* path) const
+{
+	auto it = mLookup.find(NormalizePath(path));
+	return it == mLookup.end() ? nullptr : &mEntries[it->second];
+}
+
+const TextureIndex::Entry* TextureIndex::Find(const wchar_t* path) const
+{
+	// Texture paths are ASCII; anything else cannot be in the index.
+	std::string narrow;
+	for (; *path; ++path)
+	{
+		if ((unsigned)*path > 0x7f)
+			return nullptr;
+		narrow.push_back((char)*path);
+	}
+	return Find(narrow.c_str());
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Prebuilt metadata for every DDS file in one directory, kept in a single binary
+// file next to the textures. Startup reads that one file to size descriptor heaps
+// and caches before any texture is opened. Refresh compares each file's size and
+// last write time with the index; only new or changed files are parsed and hashed
+// again, and the file is rewritten only when something changed. Only depends on
+// the standard library and the platform directory listing.
+class TextureIndex
+{
+public:
+	static const uint32_t Magic = 0x58444954; // "TIDX"
+	static const uint32_t Version = 1;
+
+	enum Flags : uint32_t
+	{
+		// The DDS header parsed; the layout fields are meaningless otherwise.
+		Valid = 1,
+		Cube = 2,
+	};
+
+	struct Entry
+	{
+		// Normalized: lowercase, '/' separators.
+		std::string Path;
+		uint64_t FileSize = 0;
+		// Platform file time, only ever compared for equality.
+		uint64_t WriteTime = 0;
+		uint64_t ContentHash = 0;
+		// Pixel data inside the file, right after the DDS headers.
+		uint64_t DataOffset = 0;
+		uint64_t DataSize = 0;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t Depth = 0;
+		uint32_t MipCount = 0;
+		// Array slices, times six for cube maps.
+		uint32_t ArraySize = 0;
+		uint32_t DxgiFormat = 0;
+		uint32_t Flags = 0;
+	};
+
+	// Loads indexFile, rescans directory and saves the index back when it is
+	// missing, stale or unreadable. False when the directory cannot be listed.
+	bool Refresh(const char* directory, const char* indexFile);
+	bool Load(const char* indexFile);
+	bool Save(const char* indexFile) const;
+
+	// nullptr when the file is not indexed.
+	const Entry* Find(const char* path) const;
+	const Entry* Find(const wchar_t* path) const;
+	const std::vector<Entry>& GetEntries() const { return mEntries; }
+	// Files parsed and hashed by the last Refresh; 0 when the index was current.
+	size_t GetRebuiltCount() const { return mRebuilt; }
+
+	// FNV-1a, 64 bit, over the whole file. Also the texture cache's content key.
+	static uint64_t HashContent(const uint8_t* data, size_t size);
+	static std::string NormalizePath(const char* path);
+
+private:
+	// Reads the header and hashes the file; the entry keeps Flags 0 if it is not a DDS.
+	static void Build(const std::string& file, Entry& entry);
+	void BuildLookup();
+
+	std::vector<Entry> mEntries;
+	std::unordered_map<std::string, size_t> mLookup;
+	size_t mRebuilt = 0;
+};
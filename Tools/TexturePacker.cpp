@@ -0,0 +1,121 @@
+#include "TexturePacker.h"
+#include <algorithm>
+#include <cstring>
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Shelves left to right, top to bottom, in the order given. Returns the used height.
+static uint32_t PlaceShelves(const std::vector<TexturePacker::Size>& cells, const std::vector<size_t>& order,
+	uint32_t width, std::vector<TexturePacker::Placement>& placements)
+{
+	uint32_t x = 0, y = 0, shelfHeight = 0;
+	for (size_t i : order)
+	{
+		if (x + cells[i].Width > width)
+		{
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		placements[i].CellX = x;
+		placements[i].CellY = y;
+		placements[i].CellWidth = cells[i].Width;
+		placements[i].CellHeight = cells[i].Height;
+		x += cells[i].Width;
+		shelfHeight = std::max(shelfHeight, cells[i].Height);
+	}
+	return y + shelfHeight;
+}
+
+bool TexturePacker::Pack(const std::vector<Size>& sizes, const Options& options,
+	uint32_t& atlasWidth, uint32_t& atlasHeight, std::vector<Placement>& placements)
+{
+	uint32_t gutter = options.Gutter;
+	std::vector<Size> cells(sizes.size());
+	uint32_t minWidth = gutter;
+	for (size_t i = 0; i < sizes.size(); ++i)
+	{
+		cells[i].Width = AlignUp(sizes[i].Width + 2 * gutter, gutter);
+		cells[i].Height = AlignUp(sizes[i].Height + 2 * gutter, gutter);
+		minWidth = std::max(minWidth, cells[i].Width);
+	}
+
+	// Tallest first keeps the shelves tight.
+	std::vector<size_t> order(sizes.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&cells](size_t a, size_t b)
+	{
+		return cells[a].Height > cells[b].Height;
+	});
+
+	uint64_t bestArea = UINT64_MAX;
+	std::vector<Placement> candidate(sizes.size());
+	for (uint32_t width = minWidth; width <= options.MaxSize; width += gutter)
+	{
+		uint32_t height = PlaceShelves(cells, order, width, candidate);
+		if (height > options.MaxSize)
+			continue;
+		uint64_t area = (uint64_t)width * height;
+		// Equal areas keep the squarer, narrower one found first.
+		if (area < bestArea)
+		{
+			bestArea = area;
+			atlasWidth = width;
+			atlasHeight = std::max(height, gutter);
+			placements = candidate;
+		}
+	}
+	if (bestArea == UINT64_MAX)
+		return false;
+
+	for (size_t i = 0; i < sizes.size(); ++i)
+	{
+		Placement& p = placements[i];
+		p.X = p.CellX + gutter;
+		p.Y = p.CellY + gutter;
+		p.Width = sizes[i].Width;
+		p.Height = sizes[i].Height;
+		p.ScaleU = (float)p.Width / atlasWidth;
+		p.ScaleV = (float)p.Height / atlasHeight;
+		p.OffsetU = (float)p.X / atlasWidth;
+		p.OffsetV = (float)p.Y / atlasHeight;
+	}
+	return true;
+}
+
+uint32_t TexturePacker::GetMipCount(const Options& options, uint32_t atlasWidth, uint32_t atlasHeight)
+{
+	uint32_t count = 1;
+	for (uint32_t gutter = options.Gutter; gutter > 1 && (atlasWidth > 1 || atlasHeight > 1); gutter /= 2)
+	{
+		atlasWidth = std::max(1u, atlasWidth / 2);
+		atlasHeight = std::max(1u, atlasHeight / 2);
+		++count;
+	}
+	return count;
+}
+
+void TexturePacker::Blit(const uint8_t* rgba, size_t rowPitch, const Placement& placement,
+	uint8_t* atlas, uint32_t atlasWidth)
+{
+	for (uint32_t y = 0; y < placement.CellHeight; ++y)
+	{
+		uint32_t cellY = placement.CellY + y;
+		int sy = std::min(std::max((int)cellY - (int)placement.Y, 0), (int)placement.Height - 1);
+		const uint8_t* src = rgba + sy * rowPitch;
+		uint8_t* dst = atlas + ((size_t)cellY * atlasWidth + placement.CellX) * 4;
+
+		uint32_t left = placement.X - placement.CellX;
+		uint32_t right = placement.CellWidth - left - placement.Width;
+		for (uint32_t x = 0; x < left; ++x, dst += 4)
+			memcpy(dst, src, 4);
+		memcpy(dst, src, (size_t)placement.Width * 4);
+		dst += (size_t)placement.Width * 4;
+		for (uint32_t x = 0; x < right; ++x, dst += 4)
+			memcpy(dst, src + ((size_t)placement.Width - 1) * 4, 4);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lays out small textures in one 2D atlas. Every texture sits in its own cell,
+// surrounded by a gutter of repeated edge texels. Cells start and end on
+// multiples of the gutter, a power of two, so a box filtered mip chain never
+// mixes two cells down to the level where the gutter is one texel wide; the
+// atlas stops there. Only depends on the standard library.
+class TexturePacker
+{
+public:
+	struct Options
+	{
+		// Power of two, also the cell alignment. 16 keeps five mip levels.
+		uint32_t Gutter = 16;
+		uint32_t MaxSize = 4096;
+	};
+
+	struct Size
+	{
+		uint32_t Width;
+		uint32_t Height;
+	};
+
+	struct Placement
+	{
+		// Texels of the texture itself.
+		uint32_t X, Y, Width, Height;
+		// The whole cell, gutter and alignment padding included.
+		uint32_t CellX, CellY, CellWidth, CellHeight;
+		// Atlas UV = UV * Scale + Offset.
+		float ScaleU, ScaleV, OffsetU, OffsetV;
+	};
+
+	// Shelf packs the sizes, trying every aligned atlas width and keeping the
+	// smallest area. False when they do not fit in MaxSize x MaxSize.
+	static bool Pack(const std::vector<Size>& sizes, const Options& options,
+		uint32_t& atlasWidth, uint32_t& atlasHeight, std::vector<Placement>& placements);
+	// Levels that keep at least one gutter texel around every cell.
+	static uint32_t GetMipCount(const Options& options, uint32_t atlasWidth, uint32_t atlasHeight);
+	// Copies an RGBA8 image into its placement and clamps it over the rest of the cell.
+	static void Blit(const uint8_t* rgba, size_t rowPitch, const Placement& placement,
+		uint8_t* atlas, uint32_t atlasWidth);
+};
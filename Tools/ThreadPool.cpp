@@ -0,0 +1,83 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool()
+{
+
+}
+
+ThreadPool::~ThreadPool()
+{
+	Stop();
+}
+
+size_t ThreadPool::GetDefaultThreadCount()
+{
+	size_t cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 1;
+}
+
+void ThreadPool::Start(size_t threadCount)
+{
+	Stop();
+	mStopping = false;
+	for (size_t i = 0; i < threadCount; ++i)
+		mThreads.push_back(std::thread(&ThreadPool::WorkerMain, this));
+}
+
+void ThreadPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWake.notify_all();
+	for (auto& thread : mThreads)
+		thread.join();
+	mThreads.clear();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	if (mThreads.empty())
+	{
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(std::move(task));
+	}
+	mWake.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdle.wait(lock, [this]() { return mTasks.empty() && mRunning == 0; });
+}
+
+void ThreadPool::WorkerMain()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+			// Drain the queue before leaving so nobody waits on a task that never ran.
+			if (mTasks.empty())
+				return;
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+			++mRunning;
+		}
+
+		task();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		--mRunning;
+		if (mTasks.empty() && mRunning == 0)
+			mIdle.notify_all();
+	}
+}
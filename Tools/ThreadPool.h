@@ -0,0 +1,44 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining one FIFO of tasks. Tasks must not throw;
+// report failures through whatever they fill in. Only depends on the standard
+// library.
+class ThreadPool
+{
+public:
+	ThreadPool();
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// 0 threads is valid: Submit then runs every task inline.
+	void Start(size_t threadCount);
+	// Runs what is still queued, then joins the workers.
+	void Stop();
+
+	void Submit(std::function<void()> task);
+	// Blocks until the queue is empty and no task is running.
+	void WaitIdle();
+
+	size_t GetThreadCount() const { return mThreads.size(); }
+	// One thread per core minus the caller's.
+	static size_t GetDefaultThreadCount();
+
+private:
+	void WorkerMain();
+
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mIdle;
+	std::deque<std::function<void()>> mTasks;
+	std::vector<std::thread> mThreads;
+	size_t mRunning = 0;
+	bool mStopping = false;
+};
@@ -15,6 +15,13 @@ bool CGame::Initialize(HINSTANCE hInstance, HWND hWnd)
 		}
 		EndCommandBuffer(m_VulkanCommandBuffer);
 		FlushCommandBuffer(m_VulkanCommandBuffer);
+		// The flush waited for the uploads.
+		for (auto &staging : m_TextureStaging)
+		{
+			vkDestroyBuffer(m_VulkanDevice, staging.buffer, NULL);
+			vkFreeMemory(m_VulkanDevice, staging.memory, NULL);
+		}
+		m_TextureStaging.clear();
 	}
 	else
 	{
@@ -509,164 +516,175 @@ bool CGame::LoadTexture()
 	{
 		"source/Textures/bricks.ppm",
 	};
-	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-	VkFormatProperties	formatProperties;
-	vkGetPhysicalDeviceFormatProperties(m_VulkanGpu, format, &formatProperties);
-	int32_t iWidth = 0;
-	int32_t iHeight = 0;
-	if (formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+	for (auto &v : textureFile)
 	{
-		for (auto &v : textureFile)
+		Texture tex = {};
+		ImageFile image;
+		if (!image.Open(v.c_str()))
+		{
+			return false;
+		}
+		uint32_t width = image.GetWidth();
+		uint32_t height = image.GetHeight();
+		std::vector<uint8_t> rgba((size_t)width * height * 4);
+		image.ReadRGBA(rgba.data(), (size_t)width * 4);
+
+		// The full chain, filtered like the D3D loader does for single level files.
+		std::vector<MipLevel> levels;
+		MipGenerator::Options mipOptions;
+		mipOptions.PreserveAlphaCoverage = MipGenerator::IsAlphaTested(rgba.data(), width, height, (size_t)width * 4);
+		MipGenerator::Generate(rgba.data(), width, height, (size_t)width * 4, mipOptions, levels);
+
+		// BC7 where the device samples it and the top level is whole blocks,
+		// RGBA8 otherwise.
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(m_VulkanGpu, VK_FORMAT_BC7_UNORM_BLOCK, &formatProperties);
+		if (m_TextureCompressionBC && width % 4 == 0 && height % 4 == 0 &&
+			(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			format = VK_FORMAT_BC7_UNORM_BLOCK;
+		}
+		const uint32_t bc7 = 98; // DXGI_FORMAT_BC7_UNORM
+		bool compressed = format == VK_FORMAT_BC7_UNORM_BLOCK;
+
+		// One region per level, packed tightly; 16 keeps every offset on a
+		// block and a texel.
+		std::vector<VkBufferImageCopy> regions(levels.size());
+		VkDeviceSize stagingSize = 0;
+		for (size_t i = 0; i != levels.size(); ++i)
+		{
+			VkBufferImageCopy &region = regions[i];
+			region = {};
+			region.bufferOffset = stagingSize;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = (uint32_t)i;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { levels[i].Width, levels[i].Height, 1 };
+			VkDeviceSize size = compressed
+				? (VkDeviceSize)((levels[i].Width + 3) / 4) * ((levels[i].Height + 3) / 4) * 16
+				: (VkDeviceSize)levels[i].Pixels.size();
+			stagingSize += (size + 15) & ~(VkDeviceSize)15;
+		}
+
+		StagingBuffer staging = {};
+		VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.size = stagingSize;
+		VK_RETURN_IF_FAILED(vkCreateBuffer(m_VulkanDevice, &bufferInfo, NULL, &staging.buffer));
+		VkMemoryRequirements memoryReq;
+		vkGetBufferMemoryRequirements(m_VulkanDevice, staging.buffer, &memoryReq);
+		if (!AllocMemory(memoryReq, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&staging.memory))
+		{
+			return false;
+		}
+		VK_RETURN_IF_FAILED(vkBindBufferMemory(m_VulkanDevice, staging.buffer, staging.memory, 0));
+		// Freed once the copy below has run, see Initialize.
+		m_TextureStaging.push_back(staging);
+
+		// Levels are encoded straight into the mapping.
+		uint8_t *data = nullptr;
+		VK_RETURN_IF_FAILED(vkMapMemory(m_VulkanDevice, staging.memory, 0, stagingSize, 0, (void **)&data));
+		for (size_t i = 0; i != levels.size(); ++i)
 		{
-			Texture tex = {};
-			if (!ReadTextureFromFile(v.c_str(), NULL, NULL, &iWidth, &iHeight))
+			const MipLevel &level = levels[i];
+			uint8_t *dst = data + regions[i].bufferOffset;
+			if (compressed)
 			{
-				return false;
+				BlockCompression::Encode(bc7, level.Pixels.data(), (size_t)level.Width * 4, level.Width, level.Height,
+					dst, (size_t)((level.Width + 3) / 4) * 16, BlockCompression::Quality::Normal);
 			}
-			VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-			imageInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageInfo.format = format;
-			imageInfo.extent.depth = 1;
-			imageInfo.extent.width = (uint32_t)iWidth;
-			imageInfo.extent.height = (uint32_t)iHeight;
-			imageInfo.mipLevels = 1;
-			imageInfo.arrayLayers = 1;
-			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageInfo.tiling = VK_IMAGE_TILING_LINEAR;
-			imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-			imageInfo.flags = 0;
-			imageInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-
-			VK_RETURN_IF_FAILED(vkCreateImage(m_VulkanDevice, &imageInfo, NULL, &tex.image));
-
-			VkMemoryRequirements memoryReq;
-			vkGetImageMemoryRequirements(m_VulkanDevice, tex.image, &memoryReq);
-			// alloc memory 
-			if (!AllocMemory(memoryReq, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &tex.memory))
+			else
 			{
-				return false;
-			}
-
-			VK_RETURN_IF_FAILED(vkBindImageMemory(m_VulkanDevice, tex.image, tex.memory, 0));
-
-			//only when VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT is set
-			VkImageSubresource sub = {};
-			sub.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			sub.mipLevel = 0;
-			sub.arrayLayer = 0;
-
-			VkSubresourceLayout layout;
-			void *_data;
-			vkGetImageSubresourceLayout(m_VulkanDevice, tex.image, &sub, &layout);
-			VK_RETURN_IF_FAILED(vkMapMemory(m_VulkanDevice, tex.memory, 0, memoryReq.size, 0, &_data));
-			if (!ReadTextureFromFile(v.c_str(), (uint8_t*)_data, &layout, &iWidth, &iHeight)) {
-				assert(0);
-				return false;
+				memcpy(dst, level.Pixels.data(), level.Pixels.size());
 			}
-			vkUnmapMemory(m_VulkanDevice, tex.memory);
-
-			SetImageLayout(
-				m_VulkanCommandBuffer,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				tex.image,
-				VK_IMAGE_LAYOUT_PREINITIALIZED,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,	// use in shader
-				VK_ACCESS_HOST_WRITE_BIT);
-
-			//create sampler
-			VkSamplerCreateInfo sampler = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
-			sampler.magFilter = VK_FILTER_NEAREST;
-			sampler.minFilter = VK_FILTER_NEAREST;
-			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-			sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			sampler.mipLodBias = 0.0f;
-			sampler.anisotropyEnable = VK_FALSE;
-			sampler.maxAnisotropy = 1;
-			sampler.compareOp = VK_COMPARE_OP_NEVER;
-			sampler.minLod = 0.0f;
-			sampler.maxLod = 0.0f;
-			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			sampler.unnormalizedCoordinates = VK_FALSE;
-			/* create sampler */
-			VK_RETURN_IF_FAILED(vkCreateSampler(m_VulkanDevice, &sampler,
-				NULL, &tex.sampler));
-
-			VkImageViewCreateInfo _view = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-			_view.image = tex.image;
-			_view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			_view.format = format;
-			_view.components.a = VK_COMPONENT_SWIZZLE_A;
-			_view.components.r = VK_COMPONENT_SWIZZLE_R;
-			_view.components.g = VK_COMPONENT_SWIZZLE_G;
-			_view.components.b = VK_COMPONENT_SWIZZLE_B;
-			_view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			_view.subresourceRange.baseMipLevel = 0;
-			_view.subresourceRange.levelCount = 1;
-			_view.subresourceRange.baseArrayLayer = 0;
-			_view.subresourceRange.layerCount = 1;
-			/* create image view */
-			VK_RETURN_IF_FAILED(vkCreateImageView(m_VulkanDevice, &_view, NULL, &tex.imageView));
-
-			tex.imageDescriptor.sampler = tex.sampler;
-			tex.imageDescriptor.imageView = tex.imageView;
-			tex.imageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-			m_TextureArray.push_back(tex);
 		}
-		return true;
-	}
-	return false;
-}
-
-/* Load a ppm file into memory */
-bool CGame::ReadTextureFromFile(const char *filename, uint8_t *rgba_data,
-	VkSubresourceLayout *layout, int32_t *width, int32_t *height) {
-
-	FILE *fPtr = NULL;
-	fopen_s(&fPtr, filename, "rb");
-	char header[256], *cPtr, *tmp;
-
-	if (!fPtr)
-		return false;
-
-	cPtr = fgets(header, 256, fPtr); // P6
-	if (cPtr == NULL || strncmp(header, "P6\n", 3)) {
-		fclose(fPtr);
-		return false;
-	}
-
-	do {
-		cPtr = fgets(header, 256, fPtr);
-		if (cPtr == NULL) {
-			fclose(fPtr);
+		vkUnmapMemory(m_VulkanDevice, staging.memory);
+
+		VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent.depth = 1;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.mipLevels = (uint32_t)levels.size();
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.flags = 0;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VK_RETURN_IF_FAILED(vkCreateImage(m_VulkanDevice, &imageInfo, NULL, &tex.image));
+
+		vkGetImageMemoryRequirements(m_VulkanDevice, tex.image, &memoryReq);
+		if (!AllocMemory(memoryReq, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tex.memory))
+		{
 			return false;
 		}
-	} while (!strncmp(header, "#", 1));
-
-	sscanf_s(header, "%u %u", height, width);
-	if (rgba_data == NULL) {
-		fclose(fPtr);
-		return true;
-	}
-	tmp = fgets(header, 256, fPtr); // Format
-	(void)tmp;
-	if (cPtr == NULL || strncmp(header, "255\n", 3)) {
-		fclose(fPtr);
-		return false;
-	}
-
-	for (int y = 0; y < *height; y++) {
-		uint8_t *rowPtr = rgba_data;
-		for (int x = 0; x < *width; x++) {
-			size_t s = fread(rowPtr, 3, 1, fPtr);
-			(void)s;
-			rowPtr[3] = 255; /* Alpha of 1 */
-			rowPtr += 4;
-		}
-		rgba_data += layout->rowPitch;
+		VK_RETURN_IF_FAILED(vkBindImageMemory(m_VulkanDevice, tex.image, tex.memory, 0));
+
+		SetImageLayout(
+			m_VulkanCommandBuffer,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			tex.image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			(VkAccessFlagBits)0,
+			imageInfo.mipLevels);
+		vkCmdCopyBufferToImage(m_VulkanCommandBuffer, staging.buffer, tex.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+		SetImageLayout(
+			m_VulkanCommandBuffer,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			tex.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,	// use in shader
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			imageInfo.mipLevels);
+
+		//create sampler
+		VkSamplerCreateInfo sampler = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.mipLodBias = 0.0f;
+		sampler.anisotropyEnable = VK_FALSE;
+		sampler.maxAnisotropy = 1;
+		sampler.compareOp = VK_COMPARE_OP_NEVER;
+		sampler.minLod = 0.0f;
+		sampler.maxLod = (float)imageInfo.mipLevels;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		sampler.unnormalizedCoordinates = VK_FALSE;
+		/* create sampler */
+		VK_RETURN_IF_FAILED(vkCreateSampler(m_VulkanDevice, &sampler,
+			NULL, &tex.sampler));
+
+		VkImageViewCreateInfo _view = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+		_view.image = tex.image;
+		_view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		_view.format = format;
+		_view.components.a = VK_COMPONENT_SWIZZLE_A;
+		_view.components.r = VK_COMPONENT_SWIZZLE_R;
+		_view.components.g = VK_COMPONENT_SWIZZLE_G;
+		_view.components.b = VK_COMPONENT_SWIZZLE_B;
+		_view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		_view.subresourceRange.baseMipLevel = 0;
+		_view.subresourceRange.levelCount = imageInfo.mipLevels;
+		_view.subresourceRange.baseArrayLayer = 0;
+		_view.subresourceRange.layerCount = 1;
+		/* create image view */
+		VK_RETURN_IF_FAILED(vkCreateImageView(m_VulkanDevice, &_view, NULL, &tex.imageView));
+
+		tex.imageDescriptor.sampler = tex.sampler;
+		tex.imageDescriptor.imageView = tex.imageView;
+		tex.imageDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		m_TextureArray.push_back(tex);
 	}
-	fclose(fPtr);
 	return true;
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "VulkanBase.h"
+#include "ImageFile.h"
+#include "MipGenerator.h"
+#include "BlockCompression.h"
 
 class CGame : public CVulkanBase
 {
@@ -14,6 +17,13 @@ public:
 		VkDescriptorImageInfo imageDescriptor;
 	};
 
+	// Source of a texture upload, alive until the upload was flushed.
+	struct StagingBuffer
+	{
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+	};
+
 	struct VertexBuffer
 	{
 		VkBuffer buffer;
@@ -33,14 +43,13 @@ private:
 	bool LoadMeshData();
 	bool loadShader();
 	bool LoadTexture();
-	bool ReadTextureFromFile(const char *filename, uint8_t *rgba_data,
-		VkSubresourceLayout *layout, int32_t *width, int32_t *height);
 
 private:
 	VkPipeline m_Pipeline;
 	VkPipelineCache	m_PipelineCache;
 	VkDescriptorSet m_DescriptorSet;	// fill data to describe 
 	std::vector<Texture> m_TextureArray;
+	std::vector<StagingBuffer> m_TextureStaging;
 	VkShaderModule m_ShaderVertex;
 	VkShaderModule m_ShaderPix;
 	VertexBuffer m_VertexBuffer;
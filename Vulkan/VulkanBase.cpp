@@ -261,7 +261,7 @@ bool CVulkanBase::InilializeDescriptorPool()
 // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR is about to be presented to the display
 void CVulkanBase::SetImageLayout(VkCommandBuffer cmd, VkImageAspectFlags  aspectMask,
 	VkImage image, VkImageLayout oldLayout,
-	VkImageLayout newLayout, VkAccessFlagBits srcAccessFlags)
+	VkImageLayout newLayout, VkAccessFlagBits srcAccessFlags, uint32_t levelCount)
 
 {
 	VkImageMemoryBarrier imageMemoryBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
@@ -273,12 +273,20 @@ void CVulkanBase::SetImageLayout(VkCommandBuffer cmd, VkImageAspectFlags  aspect
 	imageMemoryBarrier.subresourceRange.aspectMask = aspectMask;
 	imageMemoryBarrier.subresourceRange.layerCount = 1;
 	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-	imageMemoryBarrier.subresourceRange.levelCount = 1;
+	imageMemoryBarrier.subresourceRange.levelCount = levelCount;
 	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
 
+	VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	VkPipelineStageFlags destStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	if (srcAccessFlags & VK_ACCESS_TRANSFER_WRITE_BIT) {
+		/* A copy into the image has to land before it is read */
+		srcStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+
 	if (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-		/* Make sure anything that was copying from this image has completed */
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		/* The copy into the image waits for the layout change */
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		destStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
 	}
 
 	if (newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
@@ -293,11 +301,10 @@ void CVulkanBase::SetImageLayout(VkCommandBuffer cmd, VkImageAspectFlags  aspect
 		/* Make sure any Copy or CPU writes to image are flushed */
 		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
 			| VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		if (srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT)
+			destStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
 
-	VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-	VkPipelineStageFlags destStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-
 	vkCmdPipelineBarrier(cmd, srcStages, destStages, 0, 0, nullptr, 0, nullptr, 1,
 		&imageMemoryBarrier);
 }
@@ -664,6 +671,13 @@ bool CVulkanBase::InitializeDeviceAndQueue()
 	//It is a must to create 1 queue for graphic
 	deviceInfo.queueCreateInfoCount = 1;
 
+	VkPhysicalDeviceFeatures supported;
+	vkGetPhysicalDeviceFeatures(m_VulkanGpu, &supported);
+	VkPhysicalDeviceFeatures features = {};
+	features.textureCompressionBC = supported.textureCompressionBC;
+	m_TextureCompressionBC = supported.textureCompressionBC == VK_TRUE;
+	deviceInfo.pEnabledFeatures = &features;
+
 	VK_RETURN_IF_FAILED(vkCreateDevice(m_VulkanGpu, &deviceInfo, nullptr, &m_VulkanDevice));
 	vkGetDeviceQueue(m_VulkanDevice, m_QueueFamilyIndex, 0, &m_VulkanQueue);
 	return true;
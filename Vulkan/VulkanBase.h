@@ -35,7 +35,8 @@ protected:
 	bool AllocMemory(const VkMemoryRequirements & _memory_requirement, VkFlags required_mask,
 		VkDeviceMemory* _device_memory);
 	void SetImageLayout(VkCommandBuffer _cmd, VkImageAspectFlags  _aspectMask, VkImage _image,
-		VkImageLayout _old_layout, VkImageLayout _new_layout, VkAccessFlagBits _srcAccessFlags);
+		VkImageLayout _old_layout, VkImageLayout _new_layout, VkAccessFlagBits _srcAccessFlags,
+		uint32_t _levelCount = 1);
 
 private:
 	bool InitializeInstanceLayerAndExt();
@@ -67,6 +68,8 @@ protected:
 	VkExtent2D m_SurfaceExtent;
 	VkFormat m_SurfaceFormat = VK_FORMAT_B8G8R8A8_UNORM;
 	VkPhysicalDevice m_VulkanGpu;
+	// Enabled on the device when the GPU has it, for BC textures.
+	bool m_TextureCompressionBC = false;
 	VkDevice m_VulkanDevice;
 	uint32_t m_QueueFamilyIndex = -1;
 	VkQueue m_VulkanQueue;
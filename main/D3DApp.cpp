@@ -7,10 +7,25 @@
 #include "Ssao.h"
 
 D3DApp::D3DApp()
+	: mStopping(false)
 {
 	mCBFeature = nullptr;
 }
 
+D3DApp::~D3DApp()
+{
+	mStopping = true;
+	if (mGameThread.joinable())
+	{
+		SetEvent(mPacketFree);
+		mGameThread.join();
+	}
+	if (mPacketReady)
+		CloseHandle(mPacketReady);
+	if (mPacketFree)
+		CloseHandle(mPacketFree);
+}
+
 bool D3DApp::Init(int Width, int Height, HWND wnd)
 {
 	GetEngine()->Init(Width, Height, wnd, D3D_FEATURE_LEVEL_11_0);
@@ -21,22 +36,137 @@ bool D3DApp::Init(int Width, int Height, HWND wnd)
 	GetEngine()->SetPosition(0.0f, 2.0f, -15.0f);
 	GetEngine()->SetLens(0.25f*MathHelper::Pi, GetEngine()->AspectRatio(), mNearPlane, mFarPlane);
 
+	// "-serialload" keeps every load on this thread, to compare startup timings.
+	GetEngine()->GetAssetLoader()->Begin(wcsstr(GetCommandLineW(), L"-serialload") == nullptr);
 	LoadRenderItem();
-	mCBFeature = make_unique<ConstantBuffer<CBFeature>>(GetEngine()->GetDevice(), 1, true);
+	mCBFeature = make_unique<ConstantBuffer<CBFeature>>(GetEngine()->GetDevice(), GetEngine()->GetFrameResource(), 1, true);
+
+	// "-noshadows" and "-nossao" render with the lighting permutation without them.
+	mFeatures = SHADER_FEATURE_ALL;
+	if (wcsstr(GetCommandLineW(), L"-noshadows"))
+		mFeatures &= ~SHADER_FEATURE_SHADOWS;
+	if (wcsstr(GetCommandLineW(), L"-nossao"))
+		mFeatures &= ~SHADER_FEATURE_SSAO;
 
 	mShadowMap = new ShadowMap(2048, 2048);
 	mSsao = new Ssao(Width, Height);
-	m_DeferredShading = new DeferredShading(Width, Height);
+	m_DeferredShading = new DeferredShading(Width, Height, mFeatures);
 	m_PostProcess = new PostProcess(Width, Height, mFarPlane);
+	// The features above only registered their transient textures; place them
+	// all in one heap, then make the views on them. CreateGbufferView takes the
+	// G-buffer RTVs and SRVs as one block each, as they are bound as ranges.
+	BuildRenderGraph();
+	GetEngine()->GetRenderGraph()->Create();
+	m_DeferredShading->CreateGbufferView();
+	mSsao->CreateSsaoDescriptors();
+	m_PostProcess->CreatePostProcessView();
+	// Every feature above only registered its PSOs; build them all at once.
+	// "-serialpso" compiles them one after another, to compare.
+	GetEngine()->GetPipelineBuilder()->Build(wcsstr(GetCommandLineW(), L"-serialpso") == nullptr);
 
 	GetEngine()->SendCommandAndFulsh();
+	GetEngine()->GetAssetLoader()->End();
+	GetEngine()->GetTextureList()->LogStats();
+	GetEngine()->GetShader()->LogStats();
+	GetEngine()->GetPipelineBuilder()->LogTimings();
+	GetEngine()->GetPipelineBuilder()->LogPermutations();
+	GetEngine()->GetRenderGraph()->LogReport();
+
+	// From here on the scene belongs to the game thread and rendering only
+	// sees it through frame packets. "-singlethread" runs both halves in turn
+	// on this thread, to compare.
+	if (wcsstr(GetCommandLineW(), L"-singlethread") == nullptr)
+	{
+		mPacketReady = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+		mPacketFree = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+		if (mPacketReady == nullptr || mPacketFree == nullptr)
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+		mGameThread = std::thread(&D3DApp::GameMain, this);
+	}
 	return true;
 }
 
+void D3DApp::BuildRenderGraph()
+{
+	RenderGraphHeap* heap = GetEngine()->GetRenderGraph();
+	RenderGraph* graph = heap->GetGraph();
+	mBackBuffer = heap->Import("BackBuffer", RenderGraph::AccessPresent);
+	RenderGraph::Handle depth = heap->Import("Depth", RenderGraph::AccessDepthWrite, GetEngine()->GetDsBuffer());
+	RenderGraph::Handle shadowMap = heap->Import("ShadowMap", RenderGraph::AccessShaderRead, mShadowMap->GetResource());
+	RenderGraph::Handle gbuffer[BUFFER_COUNT];
+	for (int i = 0; i < BUFFER_COUNT; ++i)
+		gbuffer[i] = m_DeferredShading->GetGBufferTexture((GBufferType)i);
+	RenderGraph::Handle ssaoMap = mSsao->GetSsaoTexture();
+	RenderGraph::Handle postCopy = m_PostProcess->GetPostProcessTexture();
+
+	mGBufferPass = graph->AddPass("GBuffer");
+	for (int i = 0; i < BUFFER_COUNT; ++i)
+		graph->Write(mGBufferPass, gbuffer[i], RenderGraph::AccessRenderTarget);
+	graph->Write(mGBufferPass, depth, RenderGraph::AccessDepthWrite);
+
+	mShadowPass = RenderGraph::Invalid;
+	if (mFeatures & SHADER_FEATURE_SHADOWS)
+	{
+		mShadowPass = graph->AddPass("Shadow");
+		graph->Write(mShadowPass, shadowMap, RenderGraph::AccessDepthWrite);
+	}
+
+	mSsaoPass = RenderGraph::Invalid;
+	if (mFeatures & SHADER_FEATURE_SSAO)
+	{
+		mSsaoPass = graph->AddPass("Ssao");
+		graph->Write(mSsaoPass, ssaoMap, RenderGraph::AccessRenderTarget);
+		graph->Read(mSsaoPass, gbuffer[GBufferType::Pos], RenderGraph::AccessShaderRead);
+		graph->Read(mSsaoPass, gbuffer[GBufferType::Normal], RenderGraph::AccessShaderRead);
+		graph->Read(mSsaoPass, depth, RenderGraph::AccessShaderRead);
+	}
+
+	// Deferred lighting, then the sky depth tested against the G-buffer depth.
+	mLightingPass = graph->AddPass("Lighting");
+	graph->Write(mLightingPass, mBackBuffer, RenderGraph::AccessRenderTarget);
+	graph->Write(mLightingPass, depth, RenderGraph::AccessDepthWrite);
+	for (int i = GBufferType::Diffuse; i <= GBufferType::Material; ++i)
+		graph->Read(mLightingPass, gbuffer[i], RenderGraph::AccessShaderRead);
+	if (mShadowPass != RenderGraph::Invalid)
+		graph->Read(mLightingPass, shadowMap, RenderGraph::AccessShaderRead);
+	if (mSsaoPass != RenderGraph::Invalid)
+		graph->Read(mLightingPass, ssaoMap, RenderGraph::AccessShaderRead);
+
+	mPostCopyPass = graph->AddPass("PostCopy");
+	graph->Read(mPostCopyPass, mBackBuffer, RenderGraph::AccessCopySource);
+	graph->Write(mPostCopyPass, postCopy, RenderGraph::AccessCopyDest);
+
+	mSsrPass = graph->AddPass("Ssr");
+	graph->Write(mSsrPass, mBackBuffer, RenderGraph::AccessRenderTarget);
+	graph->Read(mSsrPass, postCopy, RenderGraph::AccessShaderRead);
+	graph->Read(mSsrPass, gbuffer[GBufferType::Pos], RenderGraph::AccessShaderRead);
+	graph->Read(mSsrPass, gbuffer[GBufferType::Normal], RenderGraph::AccessShaderRead);
+	graph->Read(mSsrPass, gbuffer[GBufferType::FeatureAttr], RenderGraph::AccessShaderRead);
+}
+
+bool D3DApp::IsLive(RenderGraph::Handle pass)
+{
+	return pass != RenderGraph::Invalid && !GetEngine()->GetRenderGraph()->GetGraph()->IsCulled(pass);
+}
+
 void D3DApp::LoadRenderItem()
 {
+	// Start the file work for everything below before the first load needs it.
+	AssetLoader* loader = GetEngine()->GetAssetLoader();
+	loader->PrefetchMesh("source/Models/skull.txt");
+	loader->PrefetchTexture(L"source/Textures/tile.dds");
+	mSky.PrefetchAssets();
+
 	GetEngine()->BuildBaseRootSignature();
 
+	// Textures sampled without repeats share one atlas, one resource and one SRV;
+	// the materials below pick up their UV remap when they load them. The grid
+	// tiles its texture, which an atlas cannot wrap, so it keeps its own.
+	GetEngine()->GetTextureList()->LoadAtlas(L"source/Textures/scene.atlas", {
+		L"source/Textures/white1x1.dds",
+		L"source/Textures/plane.dds",
+		L"source/Textures/crate.dds" });
+
 	auto skull = std::make_unique<MeshInfo>();
 	auto skullRitem = std::make_unique<RenderItem>();
 
@@ -58,6 +188,7 @@ XMStoreFloat4x4(&skullRitem->World, XMMatrixScaling(0.4f, 0.4f, 0.4f)*XMMatrixTr
 	skullRitem->TexTransform = MathHelper::Identity4x4();
 	skullRitem->ObjCBIndex = 0;
 	skullRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	skullRitem->Static = true;
 
 	GetEngine()->AddRenderItem(RenderLayer::Opaque, skullRitem);
 
@@ -83,6 +214,7 @@ XMStoreFloat4x4(&skullRitem->World, XMMatrixScaling(0.4f, 0.4f, 0.4f)*XMMatrixTr
 	gridRitem->Mat = move(tile0);
 	gridRitem->Geo = move(grid);
 	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	gridRitem->Static = true;
 	GetEngine()->AddRenderItem(RenderLayer::Opaque, gridRitem);
 
 	auto plane = std::make_unique<MeshInfo>();
@@ -106,6 +238,7 @@ XMStoreFloat4x4(&skullRitem->World, XMMatrixScaling(0.4f, 0.4f, 0.4f)*XMMatrixTr
 	planeRitem->Mat = move(tile1);
 	planeRitem->Geo = move(plane);
 	planeRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	planeRitem->Static = true;
 	GetEngine()->AddRenderItem(RenderLayer::Opaque, planeRitem);
 
 	auto box = std::make_unique<MeshInfo>();
@@ -129,132 +262,260 @@ XMStoreFloat4x4(&skullRitem->World, XMMatrixScaling(0.4f, 0.4f, 0.4f)*XMMatrixTr
 	boxRitem->Mat = move(tile2);
 	boxRitem->Geo = move(box);
 	boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	boxRitem->Static = true;
 
 	GetEngine()->AddRenderItem(RenderLayer::Opaque, boxRitem);
 
 	mSky.LoadRenderItem();
+	// Static items sharing a material merge into one draw per 32 unit cell.
+	// "-nostaticbatch" keeps each its own draw, to compare.
+	if (wcsstr(GetCommandLineW(), L"-nostaticbatch") == nullptr)
+		GetEngine()->BakeStaticBatches(32.0f, 16 * 1024 * 1024);
 	GetEngine()->CreateShaderParameter();
 
 }
 
-void D3DApp::Run()
+void D3DApp::GameMain()
 {
-	GetEngine()->Run();
- 	Update(GetEngine()->GetTimer());
-	m_PostProcess->Update(GetEngine()->GetTimer());
- 	Render(GetEngine()->GetTimer());
+	while (!mStopping)
+	{
+		FramePacket* packet = mPackets.BeginPush();
+		if (packet == nullptr)
+		{
+			// Both packets are taken; the render thread frees one every frame.
+			// An EndPop since the check above leaves the event set.
+			WaitForSingleObject(mPacketFree, INFINITE);
+			continue;
+		}
+		GetEngine()->Simulate(*packet);
+		mPackets.EndPush();
+		SetEvent(mPacketReady);
+	}
 }
 
-void D3DApp::Update(const GameTimer& Timer)
+void D3DApp::Run()
 {
-	// Cycle through the circular frame resource array.
-	mCurrFrameResource = GetEngine()->GetFrameResource();
-	mCurrFrameResource->Update();
-
-	// Has the GPU finished processing the commands of the current frame resource?
-	// If not, wait until the GPU has completed commands up to this fence point.
-	if (mCurrFrameResource->GetFence() != 0 && GetEngine()->GetFence()->GetCompletedValue() < mCurrFrameResource->GetFence())
+	if (!mGameThread.joinable())
 	{
-		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-		ThrowIfFailed(GetEngine()->GetFence()->SetEventOnCompletion(mCurrFrameResource->GetFence(), eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
+		GetEngine()->Simulate(*mPackets.BeginPush());
+		mPackets.EndPush();
+	}
+	// While the game thread is still simulating, sleep until it publishes the
+	// packet or a window message arrives, then go back to the message loop.
+	const FramePacket* packet = mPackets.BeginPop();
+	if (packet == nullptr)
+	{
+		MsgWaitForMultipleObjectsEx(1, &mPacketReady, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		return;
 	}
 
-	mShadowMap->Update(Timer);
-	mSsao->Update(Timer);
-	UpdateFeatureCB(Timer);
+	// Constants of this frame wait for its frame resource, the game thread
+	// meanwhile works on the next packet.
+	Update(*packet);
+	m_PostProcess->Update(packet->Timer);
+	Render(packet->Timer);
+	GetEngine()->EndFrame(*packet);
+	mPackets.EndPop();
+	if (mPacketFree)
+		SetEvent(mPacketFree);
+}
+
+void D3DApp::Update(const FramePacket& packet)
+{
+	const GameTimer& Timer = packet.Timer;
+	// Cycle through the circular frame resource array, waiting for the GPU to
+	// be done with the next one.
+	mCurrFrameResource = GetEngine()->GetFrameResource();
+	mCurrFrameResource->Begin();
+	GetEngine()->BeginFrame(packet);
+
+	// SSAO constants only read the camera; the feature constants need the shadow
+	// transform, so they follow the shadow update as its continuation.
+	JobSystem* jobs = GetEngine()->GetJobs();
+	JobSystem::Counter shadow, done;
+	jobs->Run([&]() { mShadowMap->Update(Timer); }, &shadow);
+	jobs->Run([&]() { mSsao->Update(Timer); }, &done);
+	jobs->RunAfter(shadow, [&]() { UpdateFeatureCB(Timer); }, &done);
+	jobs->Wait(done);
 
 }
 
 void D3DApp::UpdateFeatureCB(const GameTimer& Timer)
 {
-	mCBFeature->Update();
 	XMMATRIX shadowTransform = XMLoadFloat4x4(&(mShadowMap->GetShadowTransform()));
 	XMStoreFloat4x4(&mFeatureCB.ShadowTransform, XMMatrixTranspose(shadowTransform));
 	mCBFeature->Update(0, mFeatureCB);
 }
 
-void D3DApp::Render(const GameTimer& Timer)
+void D3DApp::BindBaseState(ID3D12GraphicsCommandList* cmdList)
 {
-	ComPtr<ID3D12CommandAllocator> cmdListAlloc = mCurrFrameResource->GetCurrentCommandAllocator();
-	auto mCommandList = GetEngine()->GetCommandList();
-
-	// Reuse the memory associated with command recording.
-	// We can only reset when the associated command lists have finished execution on the GPU.
-	ThrowIfFailed(cmdListAlloc->Reset());
-
-	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
-	// Reusing the command list reuses memory.
-	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));// mBasePSO.Get()));
-
 	ID3D12DescriptorHeap* descriptorHeaps[] = { GetEngine()->GetSrvDescHeap() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	mCommandList->SetGraphicsRootSignature(GetEngine()->GetBaseRootSignature());
+	cmdList->SetGraphicsRootSignature(GetEngine()->GetBaseRootSignature());
 
 	// Bind the sky cube map.  For our demos, we just use one "world" cube map representing the environment
 	// from far away, so all objects will use the same cube map and we only need to set it once per-frame.  
 	// If we wanted to use "local" cube maps, we would have to change them per-object, or dynamically
 	// index into an array of cube maps.
-	GetEngine()->SetBaseRootSignature1();
-	GetEngine()->SetBaseRootSignature3();
-	mCommandList->SetGraphicsRootDescriptorTable(5, GetEngine()->GetSrvDescHeap()->GetGPUDescriptorHandleForHeapStart());
-	m_DeferredShading->RenderGBuffer(mCommandList);
-
-	mShadowMap->DrawSceneToShadowMap();
-
-	mSsao->SetNormalSrvIndex(m_DeferredShading->GetGBufferSrv(GBufferType::Normal));
-	mSsao->SetWPosSrvIndex(m_DeferredShading->GetGBufferSrv(GBufferType::Pos));
-	mSsao->ComputeSsao(mCommandList,m_PostProcess);
+	GetEngine()->SetBaseRootSignature0(cmdList);
+	GetEngine()->SetBaseRootSignature1(cmdList);
+	cmdList->SetGraphicsRootConstantBufferView(2, mCBFeature->Resource()->GetGPUVirtualAddress());
+	GetEngine()->SetBaseRootSignature3(cmdList);
+	cmdList->SetGraphicsRootDescriptorTable(4, mBaseTable);
+	cmdList->SetGraphicsRootDescriptorTable(5, GetEngine()->GetSrvDescHeap()->GetGPUDescriptorHandleForHeapStart());
+	cmdList->SetGraphicsRootDescriptorTable(6, mSsao->GetSsaoSrvGpuHandle());
+	cmdList->SetGraphicsRootDescriptorTable(7, m_DeferredShading->GetGBufferSrvGpuHandle());
+}
 
-	mCommandList->SetGraphicsRootSignature(GetEngine()->GetBaseRootSignature());
-	GetEngine()->SetBaseRootSignature1();
-	mCommandList->SetGraphicsRootConstantBufferView(2, mCBFeature->Resource()->GetGPUVirtualAddress());
-	GetEngine()->SetBaseRootSignature3();
-	mCommandList->SetGraphicsRootDescriptorTable(4, mSky.GetSkyHeapStart());
-	mCommandList->SetGraphicsRootDescriptorTable(5, GetEngine()->GetSrvDescHeap()->GetGPUDescriptorHandleForHeapStart());
-	mCommandList->SetGraphicsRootDescriptorTable(6, mSsao->GetSsaoSrvGpuHandle());
-	mCommandList->SetGraphicsRootDescriptorTable(7, m_DeferredShading->GetGBufferSrvGpuHandle());
+void D3DApp::RecordPass(ID3D12GraphicsCommandList** slot,
+	const std::function<void(ID3D12GraphicsCommandList*, ResourceStateTracker&)>& record)
+{
+	CommandListPool* pool = GetEngine()->GetCommandListPool();
+	ID3D12GraphicsCommandList* cmdList = pool->Acquire(GetEngine()->GetJobs()->GetParticipant());
+	if (cmdList == nullptr)
+		return;
+	// Lists inherit no state, so every pass starts from the same bindings.
+	BindBaseState(cmdList);
+	ResourceStateTracker tracker;
+	record(cmdList, tracker);
+	tracker.Finish(cmdList);
+	pool->Close(cmdList);
+	*slot = cmdList;
+}
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(GetEngine()->CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+void D3DApp::Render(const GameTimer& Timer)
+{
+	ComPtr<ID3D12CommandAllocator> cmdListAlloc = mCurrFrameResource->GetCurrentCommandAllocator();
+	auto mCommandList = GetEngine()->GetCommandList();
 
-	m_DeferredShading->Render(mCommandList);
+	// Reuse the memory associated with command recording.
+	// We can only reset when the associated command lists have finished execution on the GPU.
+	ThrowIfFailed(cmdListAlloc->Reset());
 
+	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
+	// Reusing the command list reuses memory.
+	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));// mBasePSO.Get()));
+	mCurrFrameResource->WriteStartTimestamp(mCommandList);
 
-	mSky.Draw(Timer);
+	// Copy in texture mips the streaming workers finished; their SRVs go out with the commit below.
+	GetEngine()->GetTextureStreamer()->RecordUploads(mCommandList);
 
-	m_PostProcess->Prepare(mCommandList, m_DeferredShading);
-	m_PostProcess->Render(mCommandList);
- 	//mSsao->SetNormalSrvIndex(m_DeferredShading->GetGBufferSrv(GBufferType::Normal));
- 	//mSsao->SetWPosSrvIndex(m_DeferredShading->GetGBufferSrv(GBufferType::Pos));
+	// Publish descriptors written since last frame; may swap in a larger visible heap.
+	// Done before any pass records, since every pass binds the visible heap.
+	DescriptorHeap* heap = GetEngine()->GetDescriptorHeap();
+	heap->CommitSrvDescriptors();
+	int baseTable[] = { mSky.GetSkySrvIndex(), mShadowMap->GetShadowMapSrvIndex() };
+	mBaseTable = heap->CopyToTransientSrv(baseTable, _countof(baseTable));
+	ThrowIfFailed(mCommandList->Close());
 
-	//m_PostProcess->Render(mCommandList);
+	// Every pass, and every chunk of G-buffer draws, records into a list of its
+	// own on the job system. The lists go out in slot order, which is the order
+	// the passes depend on each other.
+	GetEngine()->GetCommandListPool()->BeginFrame(mCurrFrameResource->GetIndex());
+	size_t opaqueCount = GetEngine()->GetRenderItemCount(RenderLayer::Opaque);
+	size_t gbufferLists = max<size_t>(1, (opaqueCount + DrawsPerList - 1) / DrawsPerList);
+	enum { ShadowSlot, SsaoSlot, LightingSlot, PostSlot, PassSlots };
+	vector<ID3D12GraphicsCommandList*> lists(gbufferLists + PassSlots, nullptr);
+	ID3D12GraphicsCommandList** passLists = lists.data() + gbufferLists;
+
+	// Each pass list starts with the barriers the render graph put before the
+	// pass; the back buffer is the only texture that changes between frames.
+	RenderGraphHeap* graph = GetEngine()->GetRenderGraph();
+	graph->SetImported(mBackBuffer, GetEngine()->CurrentBackBuffer());
+
+	JobSystem* jobs = GetEngine()->GetJobs();
+	JobSystem::Counter recorded;
+	for (size_t i = 0; i < gbufferLists; ++i)
+	{
+		jobs->Run([&, i]()
+		{
+			RecordPass(&lists[i], [&, i](ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker)
+			{
+				if (i == 0)
+				{
+					graph->RecordBarriers(cmdList, tracker, mGBufferPass);
+					m_DeferredShading->BeginGBuffer(cmdList);
+				}
+				m_DeferredShading->DrawGBuffer(cmdList, i * DrawsPerList, (i + 1) * DrawsPerList);
+			});
+		}, &recorded);
+	}
 
-		// Indicate a state transition on the resource usage.
- 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(GetEngine()->CurrentBackBuffer(),
- 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	if (IsLive(mShadowPass))
+	{
+		jobs->Run([&]()
+		{
+			RecordPass(&passLists[ShadowSlot], [&](ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker)
+			{
+				graph->RecordBarriers(cmdList, tracker, mShadowPass);
+				mShadowMap->DrawSceneToShadowMap(cmdList);
+			});
+		}, &recorded);
+	}
 
-	// Done recording commands.
-	ThrowIfFailed(mCommandList->Close());
+	if (IsLive(mSsaoPass))
+	{
+		mSsao->SetNormalSrvIndex(m_DeferredShading->GetGBufferSrv(GBufferType::Normal));
+		mSsao->SetWPosSrvIndex(m_DeferredShading->GetGBufferSrv(GBufferType::Pos));
+		jobs->Run([&]()
+		{
+			RecordPass(&passLists[SsaoSlot], [&](ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker)
+			{
+				graph->RecordBarriers(cmdList, tracker, mSsaoPass);
+				mSsao->ComputeSsao(cmdList, m_PostProcess);
+			});
+		}, &recorded);
+	}
 
-	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { mCommandList };
-	GetEngine()->GetCommandQueue()->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	jobs->Run([&]()
+	{
+		RecordPass(&passLists[LightingSlot], [&](ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker)
+		{
+			graph->RecordBarriers(cmdList, tracker, mLightingPass);
+			m_DeferredShading->Render(cmdList);
+			mSky.Draw(cmdList);
+		});
+	}, &recorded);
+
+	jobs->Run([&]()
+	{
+		RecordPass(&passLists[PostSlot], [&](ID3D12GraphicsCommandList* cmdList, ResourceStateTracker& tracker)
+		{
+			// What Ssr needs and the copy does not touch starts moving before the copy.
+			graph->BeginBarriers(tracker, mSsrPass, mPostCopyPass);
+			graph->RecordBarriers(cmdList, tracker, mPostCopyPass);
+			m_PostProcess->Prepare(cmdList, m_DeferredShading);
+			graph->RecordBarriers(cmdList, tracker, mSsrPass);
+			m_PostProcess->Render(cmdList);
+			// Back buffer to PRESENT.
+			graph->RecordFinalBarriers(cmdList, tracker);
+			mCurrFrameResource->WriteEndTimestamp(cmdList);
+		});
+	}, &recorded);
+
+	jobs->Wait(recorded);
+	ThrowIfFailed(GetEngine()->GetCommandListPool()->TakeFailure());
+
+	// Add the command lists to the queue for execution, uploads first.
+	vector<ID3D12CommandList*> cmdsLists(1, mCommandList);
+	for (ID3D12GraphicsCommandList* cmdList : lists)
+	{
+		if (cmdList)
+			cmdsLists.push_back(cmdList);
+	}
+	GetEngine()->GetCommandQueue()->ExecuteCommandLists((UINT)cmdsLists.size(), cmdsLists.data());
 
 	// Swap the back and front buffers
 	ThrowIfFailed(GetEngine()->GetSwapChain()->Present(0, 0));
 	GetEngine()->SetCurrBackBufferIndex();
 
 	// Advance the fence value to mark commands up to this fence point.
-	mCurrFrameResource->SetFence(GetEngine()->IncreaseFence());
+	mCurrFrameResource->SetFence(GetEngine()->GetTimeline()->Signal());
+	GetEngine()->GetDescriptorHeap()->EndFrame(mCurrFrameResource->GetFence());
 
-	// Add an instruction to the command queue to set a new fence point. 
-	// Because we are on the GPU timeline, the new fence point won't be 
-	// set until the GPU finishes processing all the commands prior to this Signal().
-	GetEngine()->GetCommandQueue()->Signal(GetEngine()->GetFence(), GetEngine()->GetCurrentFence());
+	// Free anything whose last use the GPU has already passed.
+	GetEngine()->GetTimeline()->Retire();
 }
 
 
@@ -9,6 +9,11 @@
 #include "Sky.h"
 #include "ShadowMap.h"
 #include "DeferredShading.h"
+#include "FramePacket.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <functional>
+#include <thread>
 
 class PostProcess;
 class Ssao;
@@ -17,19 +22,39 @@ class D3DApp
 {
 public:
 	D3DApp();
+	~D3DApp();
 	bool Init(int Width, int Height, HWND wnd);
+	// Renders the next simulated frame, if the game thread has one ready.
 	void Run();
 	void Render(const GameTimer& Timer);
-	void Update(const GameTimer& Timer);
+	void Update(const FramePacket& packet);
 	void UpdateFeatureCB(const GameTimer& Timer);
 
 private:
 	void LoadRenderItem();
+	// Game thread: simulates frames as fast as the render thread frees packets.
+	void GameMain();
+	// Declares every pass with what it reads and writes; disabled features add no pass.
+	void BuildRenderGraph();
+	bool IsLive(RenderGraph::Handle pass);
+	// Descriptor heap and base root signature bindings every pass list starts with.
+	void BindBaseState(ID3D12GraphicsCommandList* cmdList);
+	// Records one list on the calling job system participant and stores it in
+	// slot; slot stays null if the pool failed. record queues its transitions
+	// on the list's tracker, which is finished before the list closes.
+	void RecordPass(ID3D12GraphicsCommandList** slot,
+		const std::function<void(ID3D12GraphicsCommandList*, ResourceStateTracker&)>& record);
+
+	// G-buffer draws per command list; larger scenes record in more lists.
+	static const size_t DrawsPerList = 256;
 
 	FrameResource* mCurrFrameResource;
 	float mNearPlane;
 	float mFarPlane;
 	CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv;
+	// Root table 4 for this frame: sky cube map then shadow map, gathered into
+	// the transient ring since the two SRVs are not adjacent in the heap.
+	CD3DX12_GPU_DESCRIPTOR_HANDLE mBaseTable;
 	CBFeature mFeatureCB;  // index 0 of pass cbuffer.
 	unique_ptr< ConstantBuffer<CBFeature> > mCBFeature = nullptr;
 	Sky mSky;
@@ -37,6 +62,26 @@ private:
 	DeferredShading* m_DeferredShading;
 	PostProcess* m_PostProcess;
 	Ssao* mSsao;
+	// ShaderFeature bits; a disabled feature skips its pass and its shader code.
+	UINT mFeatures;
+	// Render graph passes, RenderGraph::Invalid when not added.
+	RenderGraph::Handle mGBufferPass;
+	RenderGraph::Handle mShadowPass;
+	RenderGraph::Handle mSsaoPass;
+	RenderGraph::Handle mLightingPass;
+	RenderGraph::Handle mPostCopyPass;
+	RenderGraph::Handle mSsrPass;
+	RenderGraph::Handle mBackBuffer;
+	// The frame being rendered plus the one the game thread simulates meanwhile;
+	// the game never gets further ahead than that.
+	SpscQueue<FramePacket, 2> mPackets;
+	// Not started with "-singlethread", Run then simulates each frame itself.
+	std::thread mGameThread;
+	std::atomic<bool> mStopping;
+	// Auto-reset events set after EndPush and EndPop, so each side sleeps
+	// instead of spinning while the other holds both packets.
+	HANDLE mPacketReady = nullptr;
+	HANDLE mPacketFree = nullptr;
 
 };
 